@@ -13,10 +13,8 @@
 #include "ip.h"
 
 #include "dhcp.h"
+#include "usdt.h"
 
-DEFN_ERROR(E_DHCPOPTDESC,	"Wrong DHCP option description.")
-DEFN_ERROR(E_DHCPOPTDESCDUP,	"DHCP option already defined.")
-DEFN_ERROR(E_DHCPOPTDESCADD,	"Unable to add DHCP option (rbtree_insert() failed).")
 DEFN_ERROR(E_DHCPOPTDECODE,	"DHCP option decoding error occured.\n")
 DEFN_ERROR(E_DHCPENDOFDATA,	"Unexpected end of received DHCP data.")
 DEFN_ERROR(E_DHCPDATAINCOMPLETE,"DHCP data is incomplete.")
@@ -77,149 +75,82 @@ dhcp_htype(uint8_t htype)
 }
 
 
-static
-int
-dhcpopt_descriptor_cmp(const struct dhcpopt_descriptor *a, const struct dhcpopt_descriptor *b)
-{
-	return (int)a->code - (int)b->code;
-}
-static
-void 
-dhcpopt_descriptor_free(struct dhcpopt_descriptor *optd)
-{
-	if (optd->fini)
-		optd->fini(optd);
-}
-static inline
-void
-dhcpopt_dtree_destroy(struct rbtree *dtree)
-{
-	rbtree_destroy(dtree, DFREE_CAST(dhcpopt_descriptor_free));
-}
-static
-struct rbtree *
-dhcpopt_dtree_create(struct dhcpopt_descriptor **ddtab, int n)
-{
-	struct ectlfr fr[1];
-	struct rbtree *volatile dtree;
-
-	ectlfr_begin(fr, L_0);
-
-	dtree = rbtree_create(DCMP_CAST(dhcpopt_descriptor_cmp));
-	ectlfr_ontrap(fr, L_1);
-
-	for (int i = 0; i < n; i++) {
-		struct rbglue *g, *cg;
-
-		if (ddtab[i]->flags & DHCPOPT_F_NOVALUE) {
-			if (ddtab[i]->elsz || ddtab[i]->min || ddtab[i]->max) {
-				ectlno_seterror(E_DHCPOPTDESC);
-				ectlno_printf("%s(),%d: {%s} dhcp option %" PRIu8 " %s is no value. elsz, min and max fields must be zero.\n", 
-					__func__, __LINE__, error_name(ectlno_error), ddtab[i]->code, ddtab[i]->name);
-				ectlfr_goto(fr);
-			}
-		} else if (ddtab[i]->flags & DHCPOPT_F_NOLENGTH) {
-			/* XXX: Нет поля длины, но есть поле данных. Я такой опции не встречал,
-			 * но в принципе такое возможно (код опции определяет фиксированную для
-			 * себя длину поля данных. почему бы и нет?).
-			 */
-			if (ddtab[i]->min != ddtab[i]->elsz || ddtab[i]->max != ddtab[i]->elsz) {
-				ectlno_seterror(E_DHCPOPTDESC);
-				ectlno_printf("%s(),%d: {%s} dhcp option %" PRIu8 " %s defined as DHCPOPT_F_NOLENGTH only, "
-					"but elsz != min or elsz != max (strict dhcpopt_descriptor).\n",
-					__func__, __LINE__, error_name(ectlno_error), ddtab[i]->code, ddtab[i]->name);
-				ectlfr_goto(fr);
-			}
-		} else {
-			if (!ddtab[i]->elsz) {
-				ectlno_seterror(E_DHCPOPTDESC);
-				ectlno_printf("%s(),%d: {%s} dhcp option %" PRIu8 " %s: elsz (%" PRIu8 ") is 0.\n", 
-					__func__, __LINE__, error_name(ectlno_error), 
-					ddtab[i]->code, ddtab[i]->name, ddtab[i]->elsz);
-				ectlfr_goto(fr);
-			}
-			if (ddtab[i]->min % ddtab[i]->elsz) {
-				ectlno_seterror(E_DHCPOPTDESC);
-				ectlno_printf("%s(),%d: {%s} dhcp option %" PRIu8 " %s: min (%" PRIu8 ") "
-					"shall be the multiple elsz (%" PRIu8 ").\n", 
-					__func__, __LINE__, error_name(ectlno_error), 
-					ddtab[i]->code, ddtab[i]->name, ddtab[i]->min, ddtab[i]->elsz);
-				ectlfr_goto(fr);
-			}
-			if (ddtab[i]->max % ddtab[i]->elsz) {
-				ectlno_seterror(E_DHCPOPTDESC);
-				ectlno_printf("%s(),%d: {%s} dhcp option %" PRIu8 " %s: max (%" PRIu8 ") "
-					"shall be the multiple elsz (%" PRIu8 ").\n", 
-					__func__, __LINE__, error_name(ectlno_error),
-					ddtab[i]->code, ddtab[i]->name, ddtab[i]->max, ddtab[i]->elsz);
-				ectlfr_goto(fr);
-			}
-			if (ddtab[i]->max && ddtab[i]->max < ddtab[i]->min) {
-				ectlno_seterror(E_DHCPOPTDESC);
-				ectlno_printf("%s(),%d: {%s} dhcp option %" PRIu8 " %s: "
-					"condition max (%" PRIu8 ") < min(%" PRIu8 ") is wrong.\n", 
-					__func__, __LINE__, error_name(ectlno_error), ddtab[i]->code, ddtab[i]->name, ddtab[i]->max, ddtab[i]->min);
-				ectlfr_goto(fr);
-			}
-		}
-
-		if (ddtab[i]->init)
-			ddtab[i]->init(ddtab[i]);
-
-		g = rbtree_insert(dtree, ddtab[i], &cg);
-		if (!g) {
-			if (cg) {
-				ectlno_seterror(E_DHCPOPTDESCDUP);
-				ectlno_printf("%s(),%d: {%s} dhcpopt_description collision for code %d.\n", 
-					__func__, __LINE__, error_name(ectlno_error), ddtab[i]->code);
-			} else {
-				ectlno_seterror(E_DHCPOPTDESCADD);
-				ectlno_printf("%s(),%d: {%s} rbtree_insert() error. %s\n", 
-					__func__, __LINE__, error_name(ectlno_error), error_desc(ectlno_error));
-			}
-			ectlfr_goto(fr);
-		}
-	}
-
-	ectlfr_end(fr);
-	return dtree;
-
-L_1:	ectlfr_ontrap(fr, L_0);
-	dhcpopt_dtree_destroy(dtree);
-L_0:	ectlfr_end(fr);
-	ectlfr_trap();
-}
-
-
-static struct rbtree *dhcpopt_dtree = NULL;
+/* Описание опции: DHCPOPT_DESCRIPTOR(ident, code, flags, elsz, min, max, name, ...)
+ *
+ * Описания - константы, собранные в плотные таблицы на этапе компиляции. code, flags,
+ * elsz, min и max передаются отдельно, чтобы проверить их согласованность через
+ * _Static_assert(), name (строковая константа) - чтобы из него и кода собрать
+ * заголовок строки вывода (DHCPOPT_HDR_INIT()). Вслед за описанием объявляется
+ * константа ident_code, по которой DHCPOPT_DTAB() раскладывает описания по таблице и
+ * ловит повтор кода (duplicate case).
+ */
+#define DHCPOPT_DESCRIPTOR(ident, ocode, oflags, oelsz, omin, omax, oname, ...)		\
+	enum { ident##_code = (ocode) };							\
+	_Static_assert(!((oflags) & DHCPOPT_F_NOVALUE) || 					\
+			(!(oelsz) && !(omin) && !(omax)),					\
+		#ident ": no value option, elsz, min and max fields must be zero");		\
+	_Static_assert(((oflags) & DHCPOPT_F_NOVALUE) || !((oflags) & DHCPOPT_F_NOLENGTH) ||	\
+			((omin) == (oelsz) && (omax) == (oelsz)),				\
+		#ident ": no length option, elsz != min or elsz != max");			\
+	_Static_assert(((oflags) & (DHCPOPT_F_NOVALUE|DHCPOPT_F_NOLENGTH)) || (oelsz),		\
+		#ident ": elsz is 0");								\
+	_Static_assert(((oflags) & (DHCPOPT_F_NOVALUE|DHCPOPT_F_NOLENGTH)) ||			\
+			!(oelsz) || !((omin) % ((oelsz) ?: 1)),					\
+		#ident ": min shall be the multiple elsz");					\
+	_Static_assert(((oflags) & (DHCPOPT_F_NOVALUE|DHCPOPT_F_NOLENGTH)) ||			\
+			!(oelsz) || !((omax) % ((oelsz) ?: 1)),					\
+		#ident ": max shall be the multiple elsz");					\
+	_Static_assert(((oflags) & (DHCPOPT_F_NOVALUE|DHCPOPT_F_NOLENGTH)) ||			\
+			!(omax) || (omax) >= (omin),						\
+		#ident ": condition max < min is wrong");					\
+	_Static_assert(sizeof(oname) <= 256, #ident ": name is too long");			\
+	static const struct dhcpopt_descriptor ident[1] = {{					\
+		.name	= (oname),								\
+		.hdr	= &(const struct dhcpopt_hdr)DHCPOPT_HDR_INIT(ocode, oname),		\
+		.code	= ident##_code,								\
+		.flags	= (oflags),								\
+		.elsz	= (oelsz),								\
+		.min	= (omin),								\
+		.max	= (omax),								\
+		__VA_ARGS__									\
+	}}
+
+#define DHCPOPT_DTAB_ENTRY(ident)	[ident##_code] = ident,
+#define DHCPOPT_DTAB_CASE(ident)	case ident##_code:
+
+/* DHCPOPT_DTAB(tab, LIST): LIST(X) - список X(ident) описаний таблицы */
+#define DHCPOPT_DTAB(tab, LIST)								\
+	static inline void __unused tab##_chkdup(void) { switch (0) { LIST(DHCPOPT_DTAB_CASE) break; } } \
+	static const struct dhcpopt_descriptor *const tab[256] = { LIST(DHCPOPT_DTAB_ENTRY) }
+
+static const struct dhcpopt_descriptor *const dhcpopt_dtab[256];
 
-struct dhcpopt_descriptor *
-dhcp_getoptdescriptor(struct rbtree *dtree, int code)
+static inline
+const struct dhcpopt_descriptor *
+dhcp_getoptdescriptor(const struct dhcpopt_descriptor *const *dtab, uint8_t code)
 {
-	struct dhcpopt_descriptor dd, *ddp;
-	struct rbglue *g;
-
-	if (!dtree)
-		dtree = dhcpopt_dtree;
-	dd.code = code;
-	ddp = NULL;
-	g = rbtree_find(dtree, &dd);
-	if (g)
-		ddp = (struct dhcpopt_descriptor *)rbglue_dptr(g);
-	return ddp;
+	if (!dtab)
+		dtab = dhcpopt_dtab;
+	return dtab[code];
 }
 const char *
-dhcp_option(struct rbtree *dtree, uint8_t code)
+dhcp_option(const struct dhcpopt_descriptor *const *dtab, uint8_t code)
 {
 	const char *s = NULL;
-	struct dhcpopt_descriptor *optd;
+	const struct dhcpopt_descriptor *optd;
 
-	optd = dhcp_getoptdescriptor(dtree, code);
+	optd = dhcp_getoptdescriptor(dtab, code);
 	if (optd)
 		s = optd->name;
 	return s;
 }
 
+const char *
+dhcp_option_enum(const struct dhcpopt_descriptor *const *dtab, uint8_t code, void *value)
+{
+	return dhcpopt_enum(dhcp_getoptdescriptor(dtab, code), value);
+}
+
 
 /* Ширина поля вывода названия опции для функций dhcpopt_show_XXX().
  * Есть опции с названиями длиннее чем здесь выбрано, просто они должны
@@ -227,9 +158,88 @@ dhcp_option(struct rbtree *dtree, uint8_t code)
  */
 #define DHCPOPTNAME_MAX		40
 
+/* Заголовок строки опции "option CCC (LLL) имя " у каждого описания собирается
+ * при компиляции (DHCPOPT_HDR_INIT()): код тремя знаками и имя, дополненное
+ * пробелами до DHCPOPTNAME_MAX (склейкой строковых констант). При выводе он
+ * копируется за отступом из строки пробелов, и в копию вписываются три знака
+ * длины из dhcpopt_hdr_lens - вместо разбора формата и ширины полей printf()
+ * для каждой опции каждого пакета.
+ */
+#define DHCPOPT_HDR_LENPOS	(sizeof "option 255 (" - 1)
+#define DHCPOPT_HDR_NAMEPOS	(sizeof "option 255 (255) " - 1)
+#define DHCPOPT_HDR_WIDTH	(DHCPOPT_HDR_NAMEPOS + DHCPOPTNAME_MAX + 1)
+#define DHCPOPT_HDR_PAD		"                                        "
+_Static_assert(sizeof DHCPOPT_HDR_PAD - 1 == DHCPOPTNAME_MAX, "DHCPOPT_HDR_PAD is not DHCPOPTNAME_MAX wide");
+
+struct dhcpopt_hdr {
+	char		head[DHCPOPT_HDR_NAMEPOS];	/* "option CCC (LLL) " */
+	uint8_t		width;				/* знаков name в заголовке */
+	const char *	name;				/* имя и DHCPOPTNAME_MAX пробелов */
+};
+
+/* n (0..255) тремя знаками, как %3u */
+#define DHCPOPT_HDR_DIGITS(n)								\
+	(n) >= 100 ? '0' + (n) / 100 : ' ', (n) >= 10 ? '0' + (n) / 10 % 10 : ' ', '0' + (n) % 10
+#define DHCPOPT_HDR_INIT(ocode, oname) {							\
+		.head	= { 'o', 'p', 't', 'i', 'o', 'n', ' ', DHCPOPT_HDR_DIGITS(ocode),		\
+			    ' ', '(', 'L', 'L', 'L', ')', ' ' },				\
+		.width	= sizeof(oname) - 1 > DHCPOPTNAME_MAX ? sizeof(oname) - 1 : DHCPOPTNAME_MAX,	\
+		.name	= oname DHCPOPT_HDR_PAD,						\
+	}
+
+#define DHCPOPT_HDR_LEN(n)	{ DHCPOPT_HDR_DIGITS(n) }
+#define DHCPOPT_HDR_LEN4(n)	DHCPOPT_HDR_LEN(n), DHCPOPT_HDR_LEN(n + 1), DHCPOPT_HDR_LEN(n + 2), DHCPOPT_HDR_LEN(n + 3)
+#define DHCPOPT_HDR_LEN16(n)	DHCPOPT_HDR_LEN4(n), DHCPOPT_HDR_LEN4(n + 4), DHCPOPT_HDR_LEN4(n + 8), DHCPOPT_HDR_LEN4(n + 12)
+#define DHCPOPT_HDR_LEN64(n)	DHCPOPT_HDR_LEN16(n), DHCPOPT_HDR_LEN16(n + 16), DHCPOPT_HDR_LEN16(n + 32), DHCPOPT_HDR_LEN16(n + 48)
+static const char dhcpopt_hdr_lens[256][3] = {	/* "  0" ... "255" */
+	DHCPOPT_HDR_LEN64(0), DHCPOPT_HDR_LEN64(64), DHCPOPT_HDR_LEN64(128), DHCPOPT_HDR_LEN64(192)
+};
+static const char dhcpopt_hdr_spaces[] =
+	"                                                                "
+	"                                                                ";
+
+/* заголовок строки опции; end - его последний знак: ' ' - значение следует,
+ * '\n' - значения в строке нет
+ */
+static
+void
+dhcpopt_show_hdr(const struct dhcpopt *opt, int indent, int end, FILE *fp)
+{
+	const struct dhcpopt_hdr *hdr = opt->optd->hdr;
+	char buf[sizeof dhcpopt_hdr_spaces - 1 + DHCPOPT_HDR_NAMEPOS + 256 + 1], *p;
+
+	if (indent < 0 || (size_t)indent > sizeof dhcpopt_hdr_spaces - 1) {
+		fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s%c",
+			indent, "", opt->code, opt->length, DHCPOPTNAME_MAX, opt->optd->name, end);
+		return;
+	}
+	p = buf;
+	memcpy(p, dhcpopt_hdr_spaces, indent);
+	p += indent;
+	memcpy(p, hdr->head, DHCPOPT_HDR_NAMEPOS);
+	memcpy(p + DHCPOPT_HDR_LENPOS, dhcpopt_hdr_lens[opt->length], 3);
+	p += DHCPOPT_HDR_NAMEPOS;
+	memcpy(p, hdr->name, hdr->width);
+	p += hdr->width;
+	*p++ = end;
+	fwrite(buf, 1, p - buf, fp);
+}
+
+/* отступ следующей строки значения опции: под значением в строке заголовка */
+static
+void
+dhcpopt_show_cont(int indent, FILE *fp)
+{
+	size_t n = indent + DHCPOPT_HDR_WIDTH;
+
+	for (; n > sizeof dhcpopt_hdr_spaces - 1; n -= sizeof dhcpopt_hdr_spaces - 1)
+		fwrite(dhcpopt_hdr_spaces, 1, sizeof dhcpopt_hdr_spaces - 1, fp);
+	fwrite(dhcpopt_hdr_spaces, 1, n, fp);
+}
+
 static
 struct dhcpopt *
-dhcpopt_decode_novalue(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
+dhcpopt_decode_novalue(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
 {
 	struct dhcpopt *opt;
 
@@ -243,7 +253,7 @@ dhcpopt_decode_novalue(struct dhcpopt_descriptor *optd, const uint8_t **curp, co
 
 static 
 struct dhcpopt *
-dhcpopt_decode_u8(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp) 
+dhcpopt_decode_u8(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp) 
 {
 	struct dhcpopt *opt;
 	uint8_t length;
@@ -263,7 +273,7 @@ dhcpopt_decode_u8(struct dhcpopt_descriptor *optd, const uint8_t **curp, const u
 
 static
 const char *
-dhcpopt_enumfn_u8_no_yes(struct dhcpopt_descriptor *optd __unused, void *value)
+dhcpopt_enumfn_u8_no_yes(const struct dhcpopt_descriptor *optd __unused, void *value)
 {
 	const char *s = NULL;
 	switch (*(uint8_t *)value) {
@@ -279,7 +289,7 @@ dhcpopt_enumfn_u8_no_yes(struct dhcpopt_descriptor *optd __unused, void *value)
 
 static 
 struct dhcpopt *
-dhcpopt_decode_u16(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
+dhcpopt_decode_u16(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
 {
 	struct dhcpopt *opt;
 	uint8_t length, n;
@@ -302,7 +312,7 @@ dhcpopt_decode_u16(struct dhcpopt_descriptor *optd, const uint8_t **curp, const
 
 static 
 struct dhcpopt *
-dhcpopt_decode_u32(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
+dhcpopt_decode_u32(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
 {
 	struct dhcpopt *opt;
 	uint8_t length, n;
@@ -325,7 +335,7 @@ dhcpopt_decode_u32(struct dhcpopt_descriptor *optd, const uint8_t **curp, const
 
 static 
 struct dhcpopt *
-dhcpopt_decode_u32x2(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
+dhcpopt_decode_u32x2(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
 {
 	struct dhcpopt *opt;
 	uint8_t length, n;
@@ -349,7 +359,7 @@ dhcpopt_decode_u32x2(struct dhcpopt_descriptor *optd, const uint8_t **curp, cons
 
 static
 struct dhcpopt *
-dhcpopt_decode_s(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
+dhcpopt_decode_s(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
 {
 	struct dhcpopt *opt;
 	uint8_t length;
@@ -367,15 +377,74 @@ dhcpopt_decode_s(struct dhcpopt_descriptor *optd, const uint8_t **curp, const ui
 	return opt;
 }
 
+static void dhcpopt_chktlv(const struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8_t *endp);
+
+/* дубликаты кода остаются в списке, но индекс указывает на первую опцию */
+static inline
+void
+dhcpoptlst_insert_tail(struct dhcpoptlst *lst, struct dhcpopt *opt)
+{
+	struct dhcpopt **slot;
+
+	TAILQ_INSERT_TAIL(lst->head, opt, ent);
+	if (!dhcpoptset_isset(&lst->set, opt->code)) {
+		slot = dhcpoptlst_slot(lst, opt->code);
+		memmove(slot + 1, slot, (lst->idx + lst->n - slot) * sizeof *slot);
+		*slot = opt;
+		lst->n++;
+		dhcpoptset_add(&lst->set, opt->code);
+	}
+}
+
+/* Опция остаётся ссылкой на исходный буфер, декодирование откладывается до первого
+ * обращения. Длина уже проверена в dhcpopt_chktlv().
+ */
+static
+struct dhcpopt *
+dhcpopt_defer(const struct dhcpopt_descriptor *optd, const uint8_t **curp)
+{
+	struct dhcpopt *opt;
+
+	opt = MALLOC(sizeof(struct dhcpopt));
+	opt->optd = optd;
+	opt->code = optd->code;
+	opt->length = (*curp)[1];
+	opt->raw = *curp;
+	*curp += 2 + opt->length;
+	return opt;
+}
+
+static
+struct dhcpopt *
+dhcpopt_undefer(struct dhcpopt *lazy)
+{
+	const uint8_t *p = lazy->raw;
+	struct dhcpopt *opt;
+
+	opt = lazy->optd->decode(lazy->optd, &p, p + 2 + lazy->length);
+	opt->raw = NULL;
+	return opt;
+}
+
 void
-dhcp_decode_opts(struct dhcpoptlst *lst, struct rbtree *dtree, const uint8_t **curp, const uint8_t *endp)
+dhcp_decode_opts(struct dhcpoptlst *lst, const struct dhcpopt_descriptor *const *dtab, const struct dhcpoptset *demand,
+	const uint8_t **curp, const uint8_t *endp)
 {
 	struct dhcpopt *opt;
+	const struct dhcpopt_descriptor *optd;
 
-	if (!dtree)
-		dtree = dhcpopt_dtree;
+	if (!dtab)
+		dtab = dhcpopt_dtab;
 	while (*curp < endp) {
-		opt = dhcpopt_decode(dtree, curp, endp);
+		if (demand && !dhcpoptset_isset(demand, **curp) && 
+				(optd = dhcp_getoptdescriptor(dtab, **curp)) &&
+				!(optd->flags & DHCPOPT_F_NOLENGTH)) {
+			dhcpopt_chktlv(optd, *curp, endp);
+			opt = dhcpopt_defer(optd, curp);
+			dhcpoptlst_insert_tail(lst, opt);
+			continue;
+		}
+		opt = dhcpopt_decode(dtab, curp, endp);
 		if (dhcpopt_ispad(opt)) {
 			dhcpopt_free(opt);
 			continue;
@@ -384,22 +453,62 @@ dhcp_decode_opts(struct dhcpoptlst *lst, struct rbtree *dtree, const uint8_t **c
 			dhcpopt_free(opt);
 			break;
 		}
-		STAILQ_INSERT_TAIL(lst, opt, ent);
+		dhcpoptlst_insert_tail(lst, opt);
 	}
 }
 void
 dhcp_free_opts(struct dhcpoptlst *lst)
 {
-	for (struct dhcpopt *p = STAILQ_FIRST(lst), *q; p; p = q) {
-		q = STAILQ_NEXT(p, ent);
+	for (struct dhcpopt *p = TAILQ_FIRST(lst->head), *q; p; p = q) {
+		q = TAILQ_NEXT(p, ent);
 		dhcpopt_free(p);
 	}
-	STAILQ_INIT(lst);
+	dhcpoptlst_init(lst, lst->idx);
+}
+
+/* заменяет в списке отложенную опцию на декодированную */
+static
+struct dhcpopt *
+dhcpoptlst_undefer(struct dhcpoptlst *lst, struct dhcpopt *lazy)
+{
+	struct dhcpopt *opt, **slot;
+
+	opt = dhcpopt_undefer(lazy);
+	TAILQ_INSERT_BEFORE(lazy, opt, ent);
+	TAILQ_REMOVE(lst->head, lazy, ent);
+	slot = dhcpoptlst_slot(lst, opt->code);
+	if (*slot == lazy)
+		*slot = opt;
+	free(lazy);
+	return opt;
+}
+
+struct dhcpopt *
+dhcpoptlst_find(struct dhcpoptlst *lst, uint8_t optcode)
+{
+	struct dhcpopt *opt;
+
+	if (!dhcpoptset_isset(&lst->set, optcode))
+		return NULL;
+	opt = *dhcpoptlst_slot(lst, optcode);
+	if (!dhcpopt_isdecoded(opt))
+		opt = dhcpoptlst_undefer(lst, opt);
+	return opt;
+}
+
+void
+dhcpoptlst_resolve(struct dhcpoptlst *lst)
+{
+	struct dhcpopt *opt;
+
+	DHCPOPTLST_FOREACH(opt, lst)
+		if (!dhcpopt_isdecoded(opt))
+			opt = dhcpoptlst_undefer(lst, opt);
 }
 
 static
 struct dhcpopt *
-dhcpopt_decode_lst(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
+dhcpopt_decode_lst(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp)
 {
 	struct ectlfr fr[1];
 	struct dhcpopt *volatile opt;
@@ -409,15 +518,15 @@ dhcpopt_decode_lst(struct dhcpopt_descriptor *optd, const uint8_t **curp, const
 
 	length = (*curp)[1];
 	n = offsetof(struct dhcpopt, lst) + sizeof(struct dhcpoptlst [1]);
-	opt = MALLOC(n);
+	opt = MALLOC(n + DHCPOPTLST_IDXMAX(length) * sizeof(struct dhcpopt *));
 	opt->optd = optd;
 	opt->code = optd->code;
 	opt->length = length;
 	ectlfr_begin(fr, L_1);
 
-	STAILQ_INIT(opt->lst);
+	dhcpoptlst_init(opt->lst, (struct dhcpopt **)((char *)opt + n));
 	p = *curp + 2;
-	dhcp_decode_opts(opt->lst, optd->dtree, &p, p + length);
+	dhcp_decode_opts(opt->lst, optd->dtab, NULL, &p, p + length);
 	*curp += 2 + length;
 
 	ectlfr_end(fr);
@@ -441,10 +550,8 @@ dhcpopt_show_lst(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	struct dhcpopt *p;
 
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s\n", 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name);
-	STAILQ_FOREACH(p, opt->lst, ent)
+	dhcpopt_show_hdr(opt, indent, '\n', fp);
+	DHCPOPTLST_FOREACH(p, opt->lst)
 		dhcpopt_show(p, indent + 2, fp);
 }
 
@@ -461,9 +568,8 @@ void
 dhcpopt_show_u8(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	int n = opt->length;
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s %" PRIu8, 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name, opt->u8[0]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%" PRIu8, opt->u8[0]);
 	if (opt->optd->enumfn) {
 		const char *s;
 		s = opt->optd->enumfn(opt->optd, opt->u8);
@@ -474,9 +580,8 @@ dhcpopt_show_u8(struct dhcpopt *opt, int indent, FILE *fp)
 			s = opt->optd->enumfn(opt->optd, opt->u8 + i);
 			if (!s)
 				s = "???";
-			fprintf(fp, "%*s%*s %3s  %3s  %*s %" PRIu8 " %s\n", 
-				indent, "", (int)sizeof "option" - 1, "", "", "", DHCPOPTNAME_MAX, "",
-				opt->u8[i], s);
+			dhcpopt_show_cont(indent, fp);
+			fprintf(fp, "%" PRIu8 " %s\n", opt->u8[i], s);
 		}
 	} else {
 		for (int i = 1; i < n; i++)
@@ -491,9 +596,8 @@ void
 dhcpopt_show_i8(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	int n = opt->length;
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s %" PRIi8, 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name, opt->i8[0]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%" PRIi8, opt->i8[0]);
 	for (int i = 1; i < n; i++)
 		fprintf(fp, ", %" PRIi8, opt->i8[i]);
 	if (opt->optd->metric)
@@ -506,9 +610,8 @@ void
 dhcpopt_show_x8(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	int n = opt->length;
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s %02" PRIx8, 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name, opt->u8[0]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%02" PRIx8, opt->u8[0]);
 	for (int i = 1; i < n; i++)
 		fprintf(fp, ":%02" PRIx8, opt->u8[i]);
 	if (opt->optd->metric)
@@ -522,15 +625,14 @@ void
 dhcpopt_show_u16(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	int n = opt->length / sizeof(uint16_t);
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s %" PRIu16, 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name, opt->u16[0]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%" PRIu16, opt->u16[0]);
 	if (opt->optd->enumfn) {
 		fprintf(fp, " %s\n", opt->optd->enumfn(opt->optd, opt->u16));
-		for (int i = 1; i < n; i++)
-			fprintf(fp, "%*s%*s %3s  %3s  %*s %" PRIu16 " %s\n", 
-				indent, "", (int)sizeof "option" - 1, "", "", "", DHCPOPTNAME_MAX, "",
-				opt->u16[i], opt->optd->enumfn(opt->optd, opt->u16 + i));
+		for (int i = 1; i < n; i++) {
+			dhcpopt_show_cont(indent, fp);
+			fprintf(fp, "%" PRIu16 " %s\n", opt->u16[i], opt->optd->enumfn(opt->optd, opt->u16 + i));
+		}
 	} else {
 		for (int i = 1; i < n; i++)
 			fprintf(fp, ", %" PRIu16, opt->u16[i]);
@@ -544,9 +646,8 @@ void
 dhcpopt_show_i16(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	int n = opt->length / sizeof(int16_t);
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s %" PRIi16, 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name, opt->i16[0]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%" PRIi16, opt->i16[0]);
 	for (int i = 1; i < n; i++)
 		fprintf(fp, ", %" PRIi16, opt->i16[i]);
 	if (opt->optd->metric)
@@ -560,9 +661,8 @@ void
 dhcpopt_show_u32(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	int n = opt->length / sizeof(uint32_t);
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s %" PRIu32, 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name, opt->u32[0]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%" PRIu32, opt->u32[0]);
 	for (int i = 1; i < n; i++)
 		fprintf(fp, ", %" PRIu32, opt->u32[i]);
 	if (opt->optd->metric)
@@ -575,9 +675,8 @@ void
 dhcpopt_show_i32(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	int n = opt->length / sizeof(int32_t);
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s %" PRIi32, 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name, opt->i32[0]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%" PRIi32, opt->i32[0]);
 	for (int i = 1; i < n; i++)
 		fprintf(fp, ", %" PRIi32, opt->i32[i]);
 	if (opt->optd->metric)
@@ -593,9 +692,8 @@ dhcpopt_show_u32_ip(struct dhcpopt *opt, int indent, FILE *fp)
 	union { uint8_t u8[4]; uint32_t ip; } u;
 
 	u.ip = htonl(opt->u32[0]);
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8, 
-		indent, "", opt->code, opt->length, DHCPOPTNAME_MAX, opt->optd->name, 
-		u.u8[0], u.u8[1], u.u8[2], u.u8[3]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8, u.u8[0], u.u8[1], u.u8[2], u.u8[3]);
 	for (int i = 1; i < n; i++) {
 		u.ip = htonl(opt->u32[i]);
 		fprintf(fp, ", %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8,
@@ -612,8 +710,8 @@ dhcpopt_show_u32x2_ip_and_mask(struct dhcpopt *opt, int indent, FILE *fp)
 
 	u[0].ip = htonl(opt->u32x2[0][0]);
 	u[1].ip = htonl(opt->u32x2[0][1]);
-	fprintf(fp, "%*soption %3"PRIu8" (%3"PRIu8") %-*s %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8"/%"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8, 
-		indent, "", opt->code, opt->length, DHCPOPTNAME_MAX, opt->optd->name, 
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8"/%"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8, 
 		u[0].u8[0], u[0].u8[1], u[0].u8[2], u[0].u8[3],
 		u[1].u8[0], u[1].u8[1], u[1].u8[2], u[1].u8[3]);
 	for (int i = 1; i < n; i++) {
@@ -630,9 +728,7 @@ static
 void
 dhcpopt_show_s(struct dhcpopt *opt, int indent, FILE *fp)
 {
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s ", 
-		indent, "", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
         for (const char *p = opt->s; p < opt->s + opt->length; p++)
                 fprintf(fp, "%c", (isascii(*p) && isprint(*p)) ? *p : '.');
 	fprintf(fp, "\n");
@@ -653,22 +749,14 @@ dhcpopt_show_s(struct dhcpopt *opt, int indent, FILE *fp)
    |  0  |
    +-----+
 #endif 
-static struct dhcpopt_descriptor dhcpoptd0_pad[1] = {{
-		.name	= "Pad",
-		.flags	= DHCPOPT_F_NOLENGTH|DHCPOPT_F_NOVALUE|DHCPOPT_F_PAD,
-		.code	= 0,
-		.elsz	= 0,
-		.min	= 0,
-		.max	= 0,
-		.metric = NULL,
-		.decode = dhcpopt_decode_novalue,
-		.free   = NULL,
+DHCPOPT_DESCRIPTOR(dhcpoptd0_pad, 0, DHCPOPT_F_NOLENGTH|DHCPOPT_F_NOVALUE|DHCPOPT_F_PAD, 0, 0, 0,
+		"Pad",
+		.metric	= NULL,
+		.decode	= dhcpopt_decode_novalue,
+		.free	= NULL,
 		.show	= dhcpopt_show_novalue,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -687,22 +775,14 @@ static struct dhcpopt_descriptor dhcpoptd0_pad[1] = {{
    |  1  |  4  |  m1 |  m2 |  m3 |  m4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd1_subnet_mask[1] = {{
-		.name	= "Subnet Mask",
-		.flags	= 0,
-		.code	= 1,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd1_subnet_mask, 1, 0, 4, 4, 4,
+		"Subnet Mask",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -721,22 +801,14 @@ struct dhcpopt_descriptor dhcpoptd1_subnet_mask[1] = {{
    |  2  |  4  |  n1 |  n2 |  n3 |  n4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd2_time_offset[1] = {{
-		.name	= "Time Offset",
-		.flags	= 0,
-		.code	= 2,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd2_time_offset, 2, 0, 4, 4, 4,
+		"Time Offset",
 		.metric	= "seconds",
 		.decode	= dhcpopt_decode_i32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_i32,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -754,22 +826,14 @@ struct dhcpopt_descriptor dhcpoptd2_time_offset[1] = {{
    |  3  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd3_routers[1] = {{
-		.name	= "Routers",
-		.flags	= 0,
-		.code	= 3,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd3_routers, 3, 0, 4, 4, 0,
+		"Routers",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -788,22 +852,14 @@ struct dhcpopt_descriptor dhcpoptd3_routers[1] = {{
    |  4  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd4_time_server[1] = {{
-		.name	= "Time Server",
-		.flags	= 0,
-		.code	= 4,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd4_time_server, 4, 0, 4, 4, 0,
+		"Time Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 
@@ -823,22 +879,14 @@ struct dhcpopt_descriptor dhcpoptd4_time_server[1] = {{
    |  5  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd5_name_server[1] = {{
-		.name	= "Name Server",
-		.flags	= 0,
-		.code	= 5,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd5_name_server, 5, 0, 4, 4, 0,
+		"Name Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -857,22 +905,14 @@ struct dhcpopt_descriptor dhcpoptd5_name_server[1] = {{
    |  6  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd6_dns_server[1] = {{
-		.name	= "DNS Server",
-		.flags	= 0,
-		.code	= 6,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd6_dns_server, 6, 0, 4, 4, 0,
+		"DNS Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -890,22 +930,14 @@ struct dhcpopt_descriptor dhcpoptd6_dns_server[1] = {{
    |  7  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd7_log_server[1] = {{
-		.name	= "Log Server",
-		.flags	= 0,
-		.code	= 7,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd7_log_server, 7, 0, 4, 4, 0,
+		"Log Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 
@@ -924,22 +956,14 @@ struct dhcpopt_descriptor dhcpoptd7_log_server[1] = {{
    |  8  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd8_cookie_server[1] = {{
-		.name	= "Cookie Server",
-		.flags	= 0,
-		.code	= 8,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd8_cookie_server, 8, 0, 4, 4, 0,
+		"Cookie Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -957,22 +981,14 @@ struct dhcpopt_descriptor dhcpoptd8_cookie_server[1] = {{
    |  9  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd9_lpr_server[1] = {{
-		.name	= "LPR Server",
-		.flags	= 0,
-		.code	= 9,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd9_lpr_server, 9, 0, 4, 4, 0,
+		"LPR Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -991,22 +1007,14 @@ struct dhcpopt_descriptor dhcpoptd9_lpr_server[1] = {{
    |  10 |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd10_impress_server[1] = {{
-		.name	= "Impress Server",
-		.flags	= 0,
-		.code	= 10,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd10_impress_server, 10, 0, 4, 4, 0,
+		"Impress Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1024,22 +1032,14 @@ struct dhcpopt_descriptor dhcpoptd10_impress_server[1] = {{
    |  11 |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd11_resource_location_server[1] = {{
-		.name	= "Resource Location Server",
-		.flags	= 0,
-		.code	= 11,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd11_resource_location_server, 11, 0, 4, 4, 0,
+		"Resource Location Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1057,22 +1057,14 @@ struct dhcpopt_descriptor dhcpoptd11_resource_location_server[1] = {{
    |  12 |  n  |  h1 |  h2 |  h3 |  h4 |  h5 |  h6 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd12_host_name[1] = {{
-		.name	= "Host Name",
-		.flags	= 0,
-		.code	= 12,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd12_host_name, 12, 0, 1, 1, 0,
+		"Host Name",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1089,22 +1081,14 @@ struct dhcpopt_descriptor dhcpoptd12_host_name[1] = {{
    |  13 |  2  |  l1 |  l2 |
    +-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd13_boot_file_size[1] = {{
-		.name	= "Boot File Size",
-		.flags	= 0,
-		.code	= 13,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd13_boot_file_size, 13, 0, 1, 1, 0,
+		"Boot File Size",
 		.metric	= "512-octet blocks",
 		.decode	= dhcpopt_decode_u16,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u16,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1122,22 +1106,14 @@ struct dhcpopt_descriptor dhcpoptd13_boot_file_size[1] = {{
    |  14 |  n  |  n1 |  n2 |  n3 |  n4 | ...
    +-----+-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd14_merit_dump_file[1] = {{
-		.name	= "Merit Dump File",
-		.flags	= 0,
-		.code	= 14,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd14_merit_dump_file, 14, 0, 1, 1, 0,
+		"Merit Dump File",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1153,22 +1129,14 @@ struct dhcpopt_descriptor dhcpoptd14_merit_dump_file[1] = {{
    |  15 |  n  |  d1 |  d2 |  d3 |  d4 |  ...
    +-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd15_domain_name[1] = {{
-		.name	= "Domain Name",
-		.flags	= 0,
-		.code	= 15,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd15_domain_name, 15, 0, 1, 1, 0,
+		"Domain Name",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1183,22 +1151,14 @@ struct dhcpopt_descriptor dhcpoptd15_domain_name[1] = {{
    |  16 |  n  |  a1 |  a2 |  a3 |  a4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd16_swap_server[1] = {{
-		.name	= "Swap Server",
-		.flags	= 0,
-		.code	= 16,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd16_swap_server, 16, 0, 4, 4, 4,
+		"Swap Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1215,22 +1175,14 @@ struct dhcpopt_descriptor dhcpoptd16_swap_server[1] = {{
    |  17 |  n  |  n1 |  n2 |  n3 |  n4 | ...
    +-----+-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd17_root_path[1] = {{
-		.name	= "Root Path",
-		.flags	= 0,
-		.code	= 17,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd17_root_path, 17, 0, 1, 1, 0,
+		"Root Path",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1253,22 +1205,14 @@ struct dhcpopt_descriptor dhcpoptd17_root_path[1] = {{
    |  18 |  n  |  n1 |  n2 |  n3 |  n4 | ...
    +-----+-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd18_extensions_path[1] = {{
-		.name	= "Extensions Path",
-		.flags	= 0,
-		.code	= 18,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
-		.metric = NULL,
+DHCPOPT_DESCRIPTOR(dhcpoptd18_extensions_path, 18, 0, 1, 1, 0,
+		"Extensions Path",
+		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1285,22 +1229,14 @@ struct dhcpopt_descriptor dhcpoptd18_extensions_path[1] = {{
    |  19 |  1  | 0/1 |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd19_ip_forwarding[1] = {{
-		.name	= "IP Forwarding",
-		.flags	= 0,
-		.code	= 19,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd19_ip_forwarding, 19, 0, 1, 1, 1,
+		"IP Forwarding",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt_enumfn_u8_no_yes,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1319,22 +1255,14 @@ struct dhcpopt_descriptor dhcpoptd19_ip_forwarding[1] = {{
    |  20 |  1  | 0/1 |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd20_non_local_source_routing[1] = {{
-		.name	= "Non-Local Source Routing",
-		.flags	= 0,
-		.code	= 20,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd20_non_local_source_routing, 20, 0, 1, 1, 1,
+		"Non-Local Source Routing",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt_enumfn_u8_no_yes,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1361,22 +1289,14 @@ struct dhcpopt_descriptor dhcpoptd20_non_local_source_routing[1] = {{
    |  a1 |  a2 |  a3 |  a4 |  m1 |  m2 |  m3 |  m4 | ...
    +-----+-----+-----+-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd21_policy_filter[1] = {{
-		.name	= "Policy Filter",
-		.flags	= 0,
-		.code	= 21,
-		.elsz	= 8,
-		.min	= 8,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd21_policy_filter, 21, 0, 8, 8, 0,
+		"Policy Filter",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32x2,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32x2_ip_and_mask,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1405,22 +1325,14 @@ dhcpopt22_chkval(union dhcpopt_value *value)
 	return 0;
 }
 #endif
-struct dhcpopt_descriptor dhcpoptd22_max_datagram_reassembly_size[1] = {{
-		.name	= "Maximum Datagram Reassembly Size",
-		.flags	= 0,
-		.code	= 22,
-		.elsz	= 2,
-		.min	= 2,
-		.max	= 2,
+DHCPOPT_DESCRIPTOR(dhcpoptd22_max_datagram_reassembly_size, 22, 0, 2, 2, 2,
+		"Maximum Datagram Reassembly Size",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u16,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u16,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1437,22 +1349,14 @@ struct dhcpopt_descriptor dhcpoptd22_max_datagram_reassembly_size[1] = {{
    |  23 |  1  | ttl |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd23_default_ip_ttl[1] = {{
-		.name	= "Deafult IP TTL",
-		.flags	= 0,
-		.code	= 23,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd23_default_ip_ttl, 23, 0, 1, 1, 1,
+		"Deafult IP TTL",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1469,22 +1373,14 @@ struct dhcpopt_descriptor dhcpoptd23_default_ip_ttl[1] = {{
    |  24 |  4  |  t1 |  t2 |  t3 |  t4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd24_path_mtu_aging_timeout[1] = {{
-		.name	= "Path MTU Aging Timeout",
-		.flags	= 0,
-		.code	= 24,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd24_path_mtu_aging_timeout, 24, 0, 4, 4, 4,
+		"Path MTU Aging Timeout",
 		.metric	= "seconds",
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1542,22 +1438,14 @@ dhcpopt25_decode(uint8_t code, const uint8_t **curp, const uint8_t *endp)
 	return (struct dhcpopt *)opt;
 }
 #endif
-struct dhcpopt_descriptor dhcpoptd25_path_mtu_plateau_table[1] = {{
-		.name	= "Path MTU Plateau Table",
-		.flags	= 0,
-		.code	= 25,
-		.elsz	= 2,
-		.min	= 2,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd25_path_mtu_plateau_table, 25, 0, 2, 2, 0,
+		"Path MTU Plateau Table",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u16,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u16,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1585,22 +1473,14 @@ dhcpopt26_chkval(uint16_t value)
 			__func__, __LINE__, 26, dhcp_option(26), 2, value);
 }
 #endif
-struct dhcpopt_descriptor dhcpoptd26_interface_mtu[1] = {{
-		.name	= "Interface MTU",
-		.flags	= 0,
-		.code	= 26,
-		.elsz	= 2,
-		.min	= 2,
-		.max	= 2,
+DHCPOPT_DESCRIPTOR(dhcpoptd26_interface_mtu, 26, 0, 2, 2, 2,
+		"Interface MTU",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u16,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u16,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1620,22 +1500,14 @@ struct dhcpopt_descriptor dhcpoptd26_interface_mtu[1] = {{
    |  27 |  1  | 0/1 |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd27_all_subnets_local[1] = {{
-		.name	= "All Subnets Local",
-		.flags	= 0,
-		.code	= 27,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd27_all_subnets_local, 27, 0, 1, 1, 1,
+		"All Subnets Local",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt_enumfn_u8_no_yes,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1652,22 +1524,14 @@ struct dhcpopt_descriptor dhcpoptd27_all_subnets_local[1] = {{
    |  28 |  4  |  b1 |  b2 |  b3 |  b4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd28_broadcast_address[1] = {{
-		.name	= "Broadcast Address",
-		.flags	= 0,
-		.code	= 28,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd28_broadcast_address, 28, 0, 4, 4, 4,
+		"Broadcast Address",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1685,22 +1549,14 @@ struct dhcpopt_descriptor dhcpoptd28_broadcast_address[1] = {{
    |  29 |  1  | 0/1 |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd29_perform_mask_discovery[1] = {{
-		.name	= "Perform Mask Discovery",
-		.flags	= 0,
-		.code	= 29,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd29_perform_mask_discovery, 29, 0, 1, 1, 1,
+		"Perform Mask Discovery",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt_enumfn_u8_no_yes,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1718,22 +1574,14 @@ struct dhcpopt_descriptor dhcpoptd29_perform_mask_discovery[1] = {{
    |  30 |  1  | 0/1 |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd30_mask_supplier[1] = {{
-		.name	= "Mask Supplier",
-		.flags	= 0,
-		.code	= 30,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd30_mask_supplier, 30, 0, 1, 1, 1,
+		"Mask Supplier",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt_enumfn_u8_no_yes,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1752,22 +1600,14 @@ struct dhcpopt_descriptor dhcpoptd30_mask_supplier[1] = {{
    |  31 |  1  | 0/1 |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd31_perform_router_discovery[1] = {{
-		.name	= "Perform Router Discovery",
-		.flags	= 0,
-		.code	= 31,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd31_perform_router_discovery, 31, 0, 1, 1, 1,
+		"Perform Router Discovery",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt_enumfn_u8_no_yes,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1783,22 +1623,14 @@ struct dhcpopt_descriptor dhcpoptd31_perform_router_discovery[1] = {{
    |  32 |  4  |  a1 |  a2 |  a3 |  a4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd32_router_solicitation_address[1] = {{
-		.name	= "Router Solicitation Address",
-		.flags	= 0,
-		.code	= 32,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd32_router_solicitation_address, 32, 0, 4, 4, 4,
+		"Router Solicitation Address",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1840,39 +1672,28 @@ dhcpopt33_show(
 
 	u[0].ip = htonl(opt->u32x2[0][0]);
 	u[1].ip = htonl(opt->u32x2[0][1]);
-	fprintf(fp, "%*s %3"PRIu8" (%3"PRIu8") %-*s "
-			"%"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8" -> %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8"\n", 
-		indent, "option", opt->code, opt->length, 
-		DHCPOPTNAME_MAX, opt->optd->name, 
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "%"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8" -> %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8"\n", 
 		u[0].u8[0], u[0].u8[1], u[0].u8[2], u[0].u8[3],
 		u[1].u8[0], u[1].u8[1], u[1].u8[2], u[1].u8[3]);
 	for (int i = 1; i < n; i++) {
 		u[0].ip = htonl(opt->u32x2[i][0]);
 		u[1].ip = htonl(opt->u32x2[i][1]);
-		fprintf(fp, "%*s %3s  %3s  %*s "
-				"%"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8" -> %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8"\n", 
-			indent, "", "", "", DHCPOPTNAME_MAX, "", 
+		dhcpopt_show_cont(indent, fp);
+		fprintf(fp, "%"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8" -> %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8"\n", 
 			u[0].u8[0], u[0].u8[1], u[0].u8[2], u[0].u8[3],
 			u[1].u8[0], u[1].u8[1], u[1].u8[2], u[1].u8[3]);
 	}
 	fprintf(fp, "\n");
 }
-struct dhcpopt_descriptor dhcpoptd33_static_route[1] = {{
-		.name	= "Static Route",
-		.flags	= 0,
-		.code	= 33,
-		.elsz	= 8,
-		.min	= 8,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd33_static_route, 33, 0, 8, 8, 0,
+		"Static Route",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32x2,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt33_show,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1890,22 +1711,14 @@ struct dhcpopt_descriptor dhcpoptd33_static_route[1] = {{
    |  34 |  1  | 0/1 |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd34_trailer_encapsulation[1] = {{
-		.name	= "Trailer Encapsulation",
-		.flags	= 0,
-		.code	= 34,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd34_trailer_encapsulation, 34, 0, 1, 1, 1,
+		"Trailer Encapsulation",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt_enumfn_u8_no_yes,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1921,22 +1734,14 @@ struct dhcpopt_descriptor dhcpoptd34_trailer_encapsulation[1] = {{
    |  35 |  4  |  t1 |  t2 |  t3 |  t4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd35_arp_cache_timeout[1] = {{
-		.name	= "ARP Cache Timeout",
-		.flags	= 0,
-		.code	= 35,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd35_arp_cache_timeout, 35, 0, 4, 4, 4,
+		"ARP Cache Timeout",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -1957,7 +1762,7 @@ struct dhcpopt_descriptor dhcpoptd35_arp_cache_timeout[1] = {{
 #endif
 static
 const char *
-dhcpopt36_enumfn(struct dhcpopt_descriptor *optd, void *value)
+dhcpopt36_enumfn(const struct dhcpopt_descriptor *optd, void *value)
 {
         const char *s = NULL;
         switch (*(uint8_t *)value) {
@@ -1970,22 +1775,14 @@ dhcpopt36_enumfn(struct dhcpopt_descriptor *optd, void *value)
         }
         return s;
 }
-struct dhcpopt_descriptor dhcpoptd36_ethernet_encapsulation[1] = {{
-		.name	= "Ethernet Encapsulation",
-		.flags	= 0,
-		.code	= 36,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd36_ethernet_encapsulation, 36, 0, 1, 1, 1,
+		"Ethernet Encapsulation",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt36_enumfn,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2002,22 +1799,14 @@ struct dhcpopt_descriptor dhcpoptd36_ethernet_encapsulation[1] = {{
    |  37 |  1  |  n  |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd37_tcp_default_ttl[1] = {{
-		.name	= "TCP Default TTL",
-		.flags	= 0,
-		.code	= 37,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd37_tcp_default_ttl, 37, 0, 1, 1, 1,
+		"TCP Default TTL",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2036,22 +1825,14 @@ i7.2. TCP Keepalive Interval Option
    |  38 |  4  |  t1 |  t2 |  t3 |  t4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd38_tcp_keepalive_interval[1] = {{
-		.name	= "TCP Keepalive Interval",
-		.flags	= 0,
-		.code	= 38,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd38_tcp_keepalive_interval, 38, 0, 4, 4, 4,
+		"TCP Keepalive Interval",
 		.metric	= "seconds",
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2070,22 +1851,14 @@ struct dhcpopt_descriptor dhcpoptd38_tcp_keepalive_interval[1] = {{
    |  39 |  1  | 0/1 |
    +-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd39_tcp_keepalive_garbage[1] = {{
-		.name	= "TCP Keepalive Garbage",
-		.flags	= 0,
-		.code	= 39,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd39_tcp_keepalive_garbage, 39, 0, 1, 1, 1,
+		"TCP Keepalive Garbage",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt_enumfn_u8_no_yes,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2102,22 +1875,14 @@ struct dhcpopt_descriptor dhcpoptd39_tcp_keepalive_garbage[1] = {{
    |  40 |  n  |  n1 |  n2 |  n3 |  n4 | ...
    +-----+-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd40_nis_domain[1] = {{
-		.name	= "NIS Domain",
-		.flags	= 0,
-		.code	= 40,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd40_nis_domain, 40, 0, 1, 1, 0,
+		"NIS Domain",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2135,22 +1900,14 @@ struct dhcpopt_descriptor dhcpoptd40_nis_domain[1] = {{
    |  41 |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd41_nis_servers[1] = {{
-		.name	= "NIS Servers",
-		.flags	= 0,
-		.code	= 41,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd41_nis_servers, 41, 0, 4, 4, 0,
+		"NIS Servers",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2168,22 +1925,14 @@ struct dhcpopt_descriptor dhcpoptd41_nis_servers[1] = {{
    |  42 |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd42_ntp_servers[1] = {{
-		.name	= "NTP Servers",
-		.flags	= 0,
-		.code	= 42,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd42_ntp_servers, 42, 0, 4, 4, 0,
+		"NTP Servers",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2237,22 +1986,14 @@ struct dhcpopt_descriptor dhcpoptd42_ntp_servers[1] = {{
    +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
 #endif
 /* XXX */
-struct dhcpopt_descriptor dhcpoptd43_vendor_specific_information[1] = {{
-		.name	= "Vendor Specific Information",
-		.flags	= 0,
-		.code	= 43,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd43_vendor_specific_information, 43, 0, 1, 1, 0,
+		"Vendor Specific Information",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_x8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2269,22 +2010,14 @@ struct dhcpopt_descriptor dhcpoptd43_vendor_specific_information[1] = {{
    |  44 |  n  |  a1 |  a2 |  a3 |  a4 |  b1 |  b2 |  b3 |  b4 | ...
    +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+----
 #endif
-struct dhcpopt_descriptor dhcpoptd44_netbios_name_server[1] = {{
-		.name	= "NetBIOS Name Server",
-		.flags	= 0,
-		.code	= 44,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd44_netbios_name_server, 44, 0, 4, 4, 0,
+		"NetBIOS Name Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2300,22 +2033,14 @@ struct dhcpopt_descriptor dhcpoptd44_netbios_name_server[1] = {{
    |  45 |  n  |  a1 |  a2 |  a3 |  a4 |  b1 |  b2 |  b3 |  b4 | ...
    +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+----
 #endif
-struct dhcpopt_descriptor dhcpoptd45_netbios_dd_server[1] = {{
-		.name	= "NetBIOS Datagram Distribution Server",
-		.flags	= 0,
-		.code	= 45,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd45_netbios_dd_server, 45, 0, 4, 4, 0,
+		"NetBIOS Datagram Distribution Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2346,7 +2071,7 @@ struct dhcpopt_descriptor dhcpoptd45_netbios_dd_server[1] = {{
 #endif
 static
 const char *
-dhcpopt46_enumfn(struct dhcpopt_descriptor *optd __unused, void *value)
+dhcpopt46_enumfn(const struct dhcpopt_descriptor *optd __unused, void *value)
 {
         const char *s = NULL;
         switch (*(uint8_t *)value) {
@@ -2357,22 +2082,14 @@ dhcpopt46_enumfn(struct dhcpopt_descriptor *optd __unused, void *value)
         }
         return s;
 }
-struct dhcpopt_descriptor dhcpoptd46_netbios_node_type[1] = {{
-		.name	= "NetBIOS over TCP/IP Node Type",
-		.flags	= 0,
-		.code	= 46,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd46_netbios_node_type, 46, 0, 1, 1, 0,
+		"NetBIOS over TCP/IP Node Type",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt46_enumfn,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2390,22 +2107,14 @@ struct dhcpopt_descriptor dhcpoptd46_netbios_node_type[1] = {{
    |  47 |  n  |  s1 |  s2 |  s3 |  s4 | ...
    +-----+-----+-----+-----+-----+-----+----
 #endif
-struct dhcpopt_descriptor dhcpoptd47_netbios_scope[1] = {{
-		.name	= "NetBIOS Scope",
-		.flags	= 0,
-		.code	= 47,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd47_netbios_scope, 47, 0, 1, 1, 0,
+		"NetBIOS Scope",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2423,22 +2132,14 @@ struct dhcpopt_descriptor dhcpoptd47_netbios_scope[1] = {{
    |  48 |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |   ...
    +-----+-----+-----+-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd48_xwindow_font_server[1] = {{
-		.name	= "X Window System Font Server",
-		.flags	= 0,
-		.code	= 48,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd48_xwindow_font_server, 48, 0, 4, 4, 0,
+		"X Window System Font Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2459,22 +2160,14 @@ struct dhcpopt_descriptor dhcpoptd48_xwindow_font_server[1] = {{
    |  49 |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |   ...
    +-----+-----+-----+-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd49_xwindow_display_manager[1] = {{
-		.name	= "X Window System Display Manager",
-		.flags	= 0,
-		.code	= 49,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd49_xwindow_display_manager, 49, 0, 4, 4, 0,
+		"X Window System Display Manager",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
-		.free   = NULL,
+		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2490,22 +2183,14 @@ struct dhcpopt_descriptor dhcpoptd49_xwindow_display_manager[1] = {{
    |  50 |  4  |  a1 |  a2 |  a3 |  a4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd50_requested_ip_address[1] = {{
-		.name	= "Requested IP Address",
-		.flags	= 0,
-		.code	= 50,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
-		.metric = NULL,
+DHCPOPT_DESCRIPTOR(dhcpoptd50_requested_ip_address, 50, 0, 4, 4, 4,
+		"Requested IP Address",
+		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2526,22 +2211,14 @@ struct dhcpopt_descriptor dhcpoptd50_requested_ip_address[1] = {{
    |  51 |  4  |  t1 |  t2 |  t3 |  t4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd51_ip_address_lease_time[1] = {{
-		.name	= "IP Address Lease Time",
-		.flags	= 0,
-		.code	= 51,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd51_ip_address_lease_time, 51, 0, 4, 4, 4,
+		"IP Address Lease Time",
 		.metric	= "seconds",
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2573,7 +2250,7 @@ struct dhcpopt_descriptor dhcpoptd51_ip_address_lease_time[1] = {{
 /* XXX */
 static
 const char *
-dhcpopt52_enumfn(struct dhcpopt_descriptor *optd, void *value)
+dhcpopt52_enumfn(const struct dhcpopt_descriptor *optd, void *value)
 {
         const char *s = NULL;
         switch (*(uint8_t *)value) {
@@ -2589,22 +2266,14 @@ dhcpopt52_enumfn(struct dhcpopt_descriptor *optd, void *value)
         }
         return s;
 }
-struct dhcpopt_descriptor dhcpoptd52_option_overload[1] = {{
-		.name	= "Option Overload",
-		.flags	= 0,
-		.code	= 52,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd52_option_overload, 52, 0, 1, 1, 1,
+		"Option Overload",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt52_enumfn,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2632,7 +2301,7 @@ struct dhcpopt_descriptor dhcpoptd52_option_overload[1] = {{
 #endif
 static
 const char *
-dhcpopt53_enumfn(struct dhcpopt_descriptor *optd __unused, void *value)
+dhcpopt53_enumfn(const struct dhcpopt_descriptor *optd __unused, void *value)
 {
         const char *s = NULL;
         switch (*(uint8_t *)value) {
@@ -2663,22 +2332,14 @@ dhcpopt53_enumfn(struct dhcpopt_descriptor *optd __unused, void *value)
         }
         return s;
 }
-struct dhcpopt_descriptor dhcpoptd53_dhcp_message_type[1] = {{
-		.name	= "DHCP Message Type",
-		.flags	= 0,
-		.code	= 53,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 1,
+DHCPOPT_DESCRIPTOR(dhcpoptd53_dhcp_message_type, 53, 0, 1, 1, 1,
+		"DHCP Message Type",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt53_enumfn,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2702,22 +2363,14 @@ struct dhcpopt_descriptor dhcpoptd53_dhcp_message_type[1] = {{
    |  54 |  4  |  a1 |  a2 |  a3 |  a4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd54_server_identifier[1] = {{
-		.name	= "Server Identifier",
-		.flags	= 0,
-		.code	= 54,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd54_server_identifier, 54, 0, 4, 4, 4,
+		"Server Identifier",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2742,26 +2395,18 @@ struct dhcpopt_descriptor dhcpoptd54_server_identifier[1] = {{
 #endif
 static
 const char *
-dhcpopt55_enumfn(struct dhcpopt_descriptor *optd __unused, void *value)
+dhcpopt55_enumfn(const struct dhcpopt_descriptor *optd __unused, void *value)
 {
-	return dhcp_option(dhcpopt_dtree, *(uint8_t *)value);
+	return dhcp_option(dhcpopt_dtab, *(uint8_t *)value);
 }
-struct dhcpopt_descriptor dhcpoptd55_parameter_request_list[1] = {{
-		.name	= "Parameter Request List",
-		.flags	= 0,
-		.code	= 55,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd55_parameter_request_list, 55, 0, 1, 1, 0,
+		"Parameter Request List",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_u8,
 		.enumfn	= dhcpopt55_enumfn,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2781,22 +2426,14 @@ struct dhcpopt_descriptor dhcpoptd55_parameter_request_list[1] = {{
    |  56 |  n  |  c1 |  c2 | ...
    +-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd56_message[1] = {{
-		.name	= "Message",
-		.flags	= 0,
-		.code	= 56,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd56_message, 56, 0, 1, 1, 0,
+		"Message",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
 		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2816,22 +2453,14 @@ struct dhcpopt_descriptor dhcpoptd56_message[1] = {{
    |  57 |  2  |  l1 |  l2 |
    +-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd57_maximum_dhcp_message_size[1] = {{
-		.name	= "Maximum DHCP Message Size",
-		.flags	= 0,
-		.code	= 57,
-		.elsz	= 2,
-		.min	= 2,
-		.max	= 2,
+DHCPOPT_DESCRIPTOR(dhcpoptd57_maximum_dhcp_message_size, 57, 0, 2, 2, 2,
+		"Maximum DHCP Message Size",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u16,
 		.free	= NULL,
 		.show	= dhcpopt_show_u16,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2850,22 +2479,14 @@ struct dhcpopt_descriptor dhcpoptd57_maximum_dhcp_message_size[1] = {{
    |  58 |  4  |  t1 |  t2 |  t3 |  t4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd58_renewal_time_value[1] = {{
-		.name	= "Renewal (T1) Time Value",
-		.flags	= 0,
-		.code	= 58,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd58_renewal_time_value, 58, 0, 4, 4, 4,
+		"Renewal (T1) Time Value",
 		.metric	= "seconds",
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2884,22 +2505,14 @@ struct dhcpopt_descriptor dhcpoptd58_renewal_time_value[1] = {{
    |  59 |  4  |  t1 |  t2 |  t3 |  t4 |
    +-----+-----+-----+-----+-----+-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd59_rebinding_time_value[1] = {{
-		.name	= "Rebinding (T1) Time Value",
-		.flags	= 0,
-		.code	= 59,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 4,
+DHCPOPT_DESCRIPTOR(dhcpoptd59_rebinding_time_value, 59, 0, 4, 4, 4,
+		"Rebinding (T1) Time Value",
 		.metric	= "seconds",
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2923,22 +2536,14 @@ struct dhcpopt_descriptor dhcpoptd59_rebinding_time_value[1] = {{
    |  60 |  n  |  i1 |  i2 | ...
    +-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd60_vendor_class_identifier[1] = {{
-		.name	= "Vendor class identifier",
-		.code	= 60,
-		.flags	= 0,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd60_vendor_class_identifier, 60, 0, 1, 1, 0,
+		"Vendor class identifier",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_x8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -2972,22 +2577,14 @@ struct dhcpopt_descriptor dhcpoptd60_vendor_class_identifier[1] = {{
    |  61 |  n  |  t1 |  i1 |  i2 | ...
    +-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd61_client_identifier[1] = {{
-		.name	= "Client-identifier",
-		.flags	= 0,
-		.code	= 61,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd61_client_identifier, 61, 0, 1, 1, 0,
+		"Client-identifier",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_x8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3133,38 +2730,22 @@ RFC 2242         NetWare/IP Domain Name and Information    November 1997
 /* XXX Эти опции требуют особой обработки, поскольку влияют
  *     на интерпретацию полей 'file' и 'sname' пакета dhcp.
  */
-struct dhcpopt_descriptor dhcpoptd62_netwareip_domain_name[1] = {{
-		.name	= "The NetWare/IP Domain Name",
-		.flags	= 0,
-		.code	= 62,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd62_netwareip_domain_name, 62, 0, 1, 1, 0,
+		"The NetWare/IP Domain Name",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
 		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
-struct dhcpopt_descriptor dhcpoptd63_netwareip_information[1] = {{
-		.name	= "The NetWare/IP Information",
-		.flags	= 0,
-		.code	= 63,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+		.dtab	= NULL);
+DHCPOPT_DESCRIPTOR(dhcpoptd63_netwareip_information, 63, 0, 1, 1, 0,
+		"The NetWare/IP Information",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_x8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL	/* XXX */
-	}};
+		.dtab	= NULL);	/* XXX */
 
 
 
@@ -3182,22 +2763,14 @@ struct dhcpopt_descriptor dhcpoptd63_netwareip_information[1] = {{
    |  64 |  n  |  n1 |  n2 |  n3 |  n4 | ...
    +-----+-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd64_nisplus_domain[1] = {{
-		.name	= "Network Information Service+ Domain",
-		.flags	= 0,
-		.code	= 64,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd64_nisplus_domain, 64, 0, 1, 1, 0,
+		"Network Information Service+ Domain",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
 		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3215,22 +2788,14 @@ struct dhcpopt_descriptor dhcpoptd64_nisplus_domain[1] = {{
    |  65 |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd65_nisplus_servers[1] = {{
-		.name	= "Network Information Service+ Servers",
-		.flags	= 0,
-		.code	= 65,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd65_nisplus_servers, 65, 0, 4, 4, 0,
+		"Network Information Service+ Servers",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3246,22 +2811,14 @@ struct dhcpopt_descriptor dhcpoptd65_nisplus_servers[1] = {{
       | 66  |  n  |  c1 |  c2 |  c3 | ...
       +-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd66_tftp_server_name[1] = {{
-		.name	= "TFTP server name",
-		.flags	= 0,
-		.code	= 66,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd66_tftp_server_name, 66, 0, 1, 1, 0,
+		"TFTP server name",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
 		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3277,22 +2834,14 @@ struct dhcpopt_descriptor dhcpoptd66_tftp_server_name[1] = {{
       | 67  |  n  |  c1 |  c2 |  c3 | ...
       +-----+-----+-----+-----+-----+---
 #endif
-struct dhcpopt_descriptor dhcpoptd67_bootfile_name[1] = {{
-		.name	= "Bootfile name",
-		.flags	= 0,
-		.code	= 67,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd67_bootfile_name, 67, 0, 1, 1, 0,
+		"Bootfile name",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_s,
 		.free	= NULL,
 		.show	= dhcpopt_show_s,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3312,22 +2861,14 @@ struct dhcpopt_descriptor dhcpoptd67_bootfile_name[1] = {{
    | 68  |  n  | a1  | a2  | a3  | a4  | ...
    +-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd68_mobile_ip_home_agent[1] = {{
-		.name	= "Mobile IP Home Agent",
-		.flags	= 0,
-		.code	= 68,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd68_mobile_ip_home_agent, 68, 0, 4, 4, 0,
+		"Mobile IP Home Agent",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3345,22 +2886,14 @@ struct dhcpopt_descriptor dhcpoptd68_mobile_ip_home_agent[1] = {{
    | 69  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd69_smtp_server[1] = {{
-		.name	= "SMTP Server",
-		.flags	= 0,
-		.code	= 69,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd69_smtp_server, 69, 0, 4, 4, 0,
+		"SMTP Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3378,22 +2911,14 @@ struct dhcpopt_descriptor dhcpoptd69_smtp_server[1] = {{
    | 70  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd70_pop3_server[1] = {{
-		.name	= "POP3 Server",
-		.flags	= 0,
-		.code	= 70,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd70_pop3_server, 70, 0, 4, 4, 0,
+		"POP3 Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3411,22 +2936,14 @@ struct dhcpopt_descriptor dhcpoptd70_pop3_server[1] = {{
    | 71  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd71_nntp_server[1] = {{
-		.name	= "NNTP Server",
-		.flags	= 0,
-		.code	= 71,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd71_nntp_server, 71, 0, 4, 4, 0,
+		"NNTP Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3444,22 +2961,14 @@ struct dhcpopt_descriptor dhcpoptd71_nntp_server[1] = {{
    | 72  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd72_www_server[1] = {{
-		.name	= "WWW Server",
-		.flags	= 0,
-		.code	= 72,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd72_www_server, 72, 0, 4, 4, 0,
+		"WWW Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3477,22 +2986,14 @@ struct dhcpopt_descriptor dhcpoptd72_www_server[1] = {{
    | 73  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd73_finger_server[1] = {{
-		.name	= "Finger Server",
-		.flags	= 0,
-		.code	= 73,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd73_finger_server, 73, 0, 4, 4, 0,
+		"Finger Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3510,22 +3011,14 @@ struct dhcpopt_descriptor dhcpoptd73_finger_server[1] = {{
    | 74  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd74_irc_server[1] = {{
-		.name	= "IRC Server",
-		.flags	= 0,
-		.code	= 74,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd74_irc_server, 74, 0, 4, 4, 0,
+		"IRC Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3544,22 +3037,14 @@ struct dhcpopt_descriptor dhcpoptd74_irc_server[1] = {{
    | 75  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd75_streettalk_server[1] = {{
-		.name	= "StreetTalk Server",
-		.flags	= 0,
-		.code	= 75,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd75_streettalk_server, 75, 0, 4, 4, 0,
+		"StreetTalk Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 
@@ -3579,22 +3064,14 @@ struct dhcpopt_descriptor dhcpoptd75_streettalk_server[1] = {{
    | 76  |  n  |  a1 |  a2 |  a3 |  a4 |  a1 |  a2 |  ...
    +-----+-----+-----+-----+-----+-----+-----+-----+--
 #endif
-struct dhcpopt_descriptor dhcpoptd76_streettalk_directory_assistance_server[1] = {{
-		.name	= "StreetTalk Directory Assistance Server",
-		.flags	= 0,
-		.code	= 76,
-		.elsz	= 4,
-		.min	= 4,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd76_streettalk_directory_assistance_server, 76, 0, 4, 4, 0,
+		"StreetTalk Directory Assistance Server",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u32,
 		.free	= NULL,
 		.show	= dhcpopt_show_u32_ip,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3650,22 +3127,14 @@ struct dhcpopt_descriptor dhcpoptd76_streettalk_directory_assistance_server[1] =
    DHCP clients implementing this option SHOULD allow users to enter one
    or more user class values.
 #endif
-struct dhcpopt_descriptor dhcpoptd77_user_class[1] = {{
-		.name	= "User Class",
-		.flags	= 0,
-		.code	= 77,
-		.elsz	= 1,
-		.min	= 1,	/* XXX: rfc require 2 bytes */
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd77_user_class, 77, 0, 1, 1 /* XXX: rfc require 2 bytes */, 0,
+		"User Class",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_x8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3710,7 +3179,7 @@ struct dhcpopt_descriptor dhcpoptd77_user_class[1] = {{
 #endif
 static 
 struct dhcpopt *
-dhcpopt78_decode(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp) 
+dhcpopt78_decode(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp) 
 {
 	struct dhcpopt *opt;
 	uint8_t length, n;
@@ -3745,39 +3214,25 @@ dhcpopt78_show(struct dhcpopt *opt, int indent, FILE *fp)
 	union { uint8_t u8[4]; uint32_t ip; } u;
 
 	u.ip = htonl(opt->opt78[0].u32[0]);
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s "
-				"mandatory: %" PRIu8 "\n"
-		    "%*s       %3s  %3s  %*s "
-				"     addr: %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8, 
-		indent, "", opt->code, opt->length, DHCPOPTNAME_MAX, opt->optd->name, 
-			opt->opt78[0].mandatory, 
-		indent, "", "", "", DHCPOPTNAME_MAX, "", 
-			u.u8[0], u.u8[1], u.u8[2], u.u8[3]);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "mandatory: %" PRIu8 "\n", opt->opt78[0].mandatory);
+	dhcpopt_show_cont(indent, fp);
+	fprintf(fp, "     addr: %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8, u.u8[0], u.u8[1], u.u8[2], u.u8[3]);
 	for (int i = 1; i < n; i++) {
 		u.ip = htonl(opt->opt78[0].u32[i]);
-		fprintf(fp, "%*s       %3s  %3s  %*s "
-				"     addr: %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8, 
-			indent, "", "", "", DHCPOPTNAME_MAX, "", 
-				u.u8[0], u.u8[1], u.u8[2], u.u8[3]);
+		dhcpopt_show_cont(indent, fp);
+		fprintf(fp, "     addr: %"PRIu8".%"PRIu8".%"PRIu8".%"PRIu8, u.u8[0], u.u8[1], u.u8[2], u.u8[3]);
 	}
 	fprintf(fp, "\n");
 }
-struct dhcpopt_descriptor dhcpoptd78_slp_directory_agent[1] = {{
-		.name	= "SLP Directory Agent",
-		.flags	= 0,
-		.code	= 78,
-		.elsz	= 1,
-		.min	= 5,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd78_slp_directory_agent, 78, 0, 1, 5, 0,
+		"SLP Directory Agent",
 		.metric	= NULL,
 		.decode	= dhcpopt78_decode,
 		.free	= NULL,
 		.show	= dhcpopt78_show,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -3829,29 +3284,19 @@ static
 void
 dhcpopt79_show(struct dhcpopt *opt, int indent, FILE *fp)
 {
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s mandatory: %" PRIu8 "\n"
-		    "%*s       %3s  %3s  %*s "               "    scope: %s\n",
-		indent, "", opt->code, opt->length, DHCPOPTNAME_MAX, opt->optd->name, 
-			opt->opt79[0].mandatory, 
-		indent, "", "", "", DHCPOPTNAME_MAX, "", 
-			opt->opt79[0].s);
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, "mandatory: %" PRIu8 "\n", opt->opt79[0].mandatory);
+	dhcpopt_show_cont(indent, fp);
+	fprintf(fp, "    scope: %s\n", opt->opt79[0].s);
 }
-struct dhcpopt_descriptor dhcpoptd79_slp_service_scope[1] = {{
-		.name	= "SLP Service Scope",
-		.flags	= 0,
-		.code	= 79,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd79_slp_service_scope, 79, 0, 1, 1, 0,
+		"SLP Service Scope",
 		.metric	= NULL,
-		.decode	= dhcpopt_decode_s, /* XXX как ни странно */
+		.decode	= dhcpopt_decode_s,	/* XXX как ни странно */
 		.free	= NULL,
 		.show	= dhcpopt79_show,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 #if 0
 4.  Rapid Commit Option Format
@@ -3873,22 +3318,14 @@ struct dhcpopt_descriptor dhcpoptd79_slp_service_scope[1] = {{
    response to a DHCPDISCOVER message when completing the DHCPDISCOVER-
    DHCPACK message exchange.
 #endif
-struct dhcpopt_descriptor dhcpoptd80_rapid_commit[1] = {{
-		.name	= "Rapid Commit",
-		.flags	= DHCPOPT_F_NOVALUE,
-		.code	= 80,
-		.elsz	= 0,
-		.min	= 0,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd80_rapid_commit, 80, DHCPOPT_F_NOVALUE, 0, 0, 0,
+		"Rapid Commit",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_novalue,
 		.free	= NULL,
 		.show	= dhcpopt_show_novalue,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -4068,22 +3505,16 @@ void
 dhcpopt81_show(struct dhcpopt *opt, int indent, FILE *fp)
 {
 	int n = opt->length - 3;
-	fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s "
-				" flags: %02" PRIx8 " [S:%u O:%u E:%u N:%u MBZ:%u]\n"
-		    "%*s       %3s  %3s  %*s "
-				"rcode1: %" PRIu8 "\n"
-		    "%*s       %3s  %3s  %*s "
-				"rcode2: %" PRIu8 "\n" 
-		    "%*s       %3s  %3s  %*s ",
-		indent, "", opt->code, opt->length, DHCPOPTNAME_MAX, opt->optd->name, 
-			opt->opt81[0].flags, opt->opt81[0].S, opt->opt81[0].O, 
-					     opt->opt81[0].E, opt->opt81[0].N, 
-					     opt->opt81[0].MBZ,
-		indent, "", "", "", DHCPOPTNAME_MAX, "", 
-			opt->opt81[0].rcode1, 
-		indent, "", "", "", DHCPOPTNAME_MAX, "", 
-			opt->opt81[0].rcode2,
-		indent, "", "", "", DHCPOPTNAME_MAX, "");
+	dhcpopt_show_hdr(opt, indent, ' ', fp);
+	fprintf(fp, " flags: %02" PRIx8 " [S:%u O:%u E:%u N:%u MBZ:%u]\n",
+		opt->opt81[0].flags, opt->opt81[0].S, opt->opt81[0].O, 
+				     opt->opt81[0].E, opt->opt81[0].N, 
+				     opt->opt81[0].MBZ);
+	dhcpopt_show_cont(indent, fp);
+	fprintf(fp, "rcode1: %" PRIu8 "\n", opt->opt81[0].rcode1);
+	dhcpopt_show_cont(indent, fp);
+	fprintf(fp, "rcode2: %" PRIu8 "\n", opt->opt81[0].rcode2);
+	dhcpopt_show_cont(indent, fp);
 	if (opt->opt81[0].E) {
 		for (int j, i = 0; i < n; i += j) {
 			int len = opt->opt81[0].u8[i++];
@@ -4093,31 +3524,23 @@ dhcpopt81_show(struct dhcpopt *opt, int indent, FILE *fp)
 				break;
 			for (j = 0; j < len; j++) {
 				int c = opt->opt81[0].u8[i + j];
-				printf("%c", (isascii(c) && isprint(c)) ? c : '.');
+				fputc((isascii(c) && isprint(c)) ? c : '.', fp);
 			}
-			printf(".");
+			fputc('.', fp);
 		}
 	} else {
-		fprintf(fp, "%s", (char *)opt->opt81[0].u8);
+		fprintf(fp, "%.*s", n, (char *)opt->opt81[0].u8);
 	}
 	fprintf(fp, "\n");
 }
-struct dhcpopt_descriptor dhcpoptd81_client_fqdn[1] = {{
-		.name	= "Client FQDN",
-		.flags	= 0,
-		.code	= 81,
-		.elsz	= 1,
-		.min	= 3,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd81_client_fqdn, 81, 0, 1, 3, 0,
+		"Client FQDN",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,	/* XXX */
 		.free	= NULL,
 		.show	= dhcpopt81_show,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -4166,73 +3589,34 @@ RFC 3046          DHCP Relay Agent Information Option       January 2001
                      1                   Agent Circuit ID Sub-option
                      2                   Agent Remote ID Sub-option
 #endif
-struct dhcpopt_descriptor dhcpoptd82_1_circuit_id[1] = {{
-		.name	= "Circuit-ID",
-		.flags	= 0,
-		.code	= 1,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+DHCPOPT_DESCRIPTOR(dhcpoptd82_1_circuit_id, 1, 0, 1, 1, 0,
+		"Circuit-ID",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_x8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-}};
-struct dhcpopt_descriptor dhcpoptd82_2_remote_id[1] = {{
-		.name	= "Remote-ID",
-		.flags	= 0,
-		.code	= 2,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+		.dtab	= NULL);
+DHCPOPT_DESCRIPTOR(dhcpoptd82_2_remote_id, 2, 0, 1, 1, 0,
+		"Remote-ID",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_u8,
 		.free	= NULL,
 		.show	= dhcpopt_show_x8,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-}};
-static
-int
-dhcpoptd82_init(struct dhcpopt_descriptor *optd)
-{
-	struct dhcpopt_descriptor *ddtab[] = {
-		dhcpoptd82_1_circuit_id,
-		dhcpoptd82_2_remote_id
-	};
-	optd->dtree = dhcpopt_dtree_create(ddtab, sizeof ddtab/sizeof ddtab[0]);
-	return optd->dtree ? 0 : 1;
-	
-}
-static
-void
-dhcpoptd_fini(struct dhcpopt_descriptor *optd)
-{
-	dhcpopt_dtree_destroy(optd->dtree);
-	optd->dtree = NULL;
-}
-struct dhcpopt_descriptor dhcpoptd82_relay_agent_information[1] = {{
-		.name	= "Relay Agent Information",
-		.flags	= 0,
-		.code	= 82,
-		.elsz	= 1,
-		.min	= 1,
-		.max	= 0,
+		.dtab	= NULL);
+#define DHCPOPT82_DTAB(X)		\
+	X(dhcpoptd82_1_circuit_id)	\
+	X(dhcpoptd82_2_remote_id)
+DHCPOPT_DTAB(dhcpopt82_dtab, DHCPOPT82_DTAB);
+DHCPOPT_DESCRIPTOR(dhcpoptd82_relay_agent_information, 82, 0, 1, 1, 0,
+		"Relay Agent Information",
 		.metric	= NULL,
 		.decode	= dhcpopt_decode_lst,
 		.free	= dhcpopt_free_lst,
 		.show	= dhcpopt_show_lst,
 		.enumfn	= NULL,
-		.init	= dhcpoptd82_init,
-		.fini	= dhcpoptd_fini,
-		.dtree	= NULL
-	}};
+		.dtab	= dhcpopt82_dtab);
 
 
 #if 0
@@ -4504,22 +3888,14 @@ Requirements to Avoid Sizing Constraints
    | 255 |
    +-----+
 #endif
-struct dhcpopt_descriptor dhcpoptd255_end[1] = {{
-		.name	= "End",
-		.flags	= DHCPOPT_F_NOLENGTH|DHCPOPT_F_NOVALUE|DHCPOPT_F_END,
-		.code	= 255,
-		.elsz	= 0,
-		.min	= 0,
-		.max	= 0,
-		.metric = NULL,
-		.decode = dhcpopt_decode_novalue,
-		.free   = NULL,
+DHCPOPT_DESCRIPTOR(dhcpoptd255_end, 255, DHCPOPT_F_NOLENGTH|DHCPOPT_F_NOVALUE|DHCPOPT_F_END, 0, 0, 0,
+		"End",
+		.metric	= NULL,
+		.decode	= dhcpopt_decode_novalue,
+		.free	= NULL,
 		.show	= dhcpopt_show_novalue,
 		.enumfn	= NULL,
-		.init	= NULL,
-		.fini	= NULL,
-		.dtree	= NULL
-	}};
+		.dtab	= NULL);
 
 
 #if 0
@@ -4563,7 +3939,7 @@ struct dhcpopt_descriptor dhcpoptd255_end[1] = {{
 
 static
 void
-dhcpopt_chktlv(struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8_t *endp)
+dhcpopt_chktlv(const struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8_t *endp)
 {
 	uint8_t code, length;
 	const uint8_t *p;
@@ -4572,6 +3948,7 @@ dhcpopt_chktlv(struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8
 		ectlno_seterror(E_DHCPENDOFDATA);
 		ectlno_printf("%s(),%d: {%s} %s.\n", __func__, __LINE__, 
 			error_name(ectlno_error), error_desc(ectlno_error));
+		USDT_PROBE(DECODE_ERROR, (char *)error_name(ectlno_error), 0, 0);
 		ectlfr_trap();
 	}
 	p = begp;
@@ -4586,6 +3963,7 @@ dhcpopt_chktlv(struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8
 			ectlno_printf("%s(),%d: {%s} Unable to determine the length of dhcp option %" 
 				PRIu8 " (%s) because the received data have ended.\n",
 				__func__, __LINE__, error_name(ectlno_error), code, optd ? optd->name : "???");
+			USDT_PROBE(DECODE_ERROR, (char *)error_name(ectlno_error), code, 0);
 			ectlfr_trap();
 		}
 		length = *p++;
@@ -4596,6 +3974,7 @@ dhcpopt_chktlv(struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8
 			" which oversteps the bounds of the received data.\n", 
 			__func__, __LINE__, error_name(ectlno_error), 
 			code, optd ? optd->name : "???", length);
+		USDT_PROBE(DECODE_ERROR, (char *)error_name(ectlno_error), code, length);
 		ectlfr_trap();
 	}
 	if (optd) {
@@ -4605,6 +3984,7 @@ dhcpopt_chktlv(struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8
 				" less than expected minimum (%" PRIu8 " octets).\n",
 				__func__, __LINE__, error_name(ectlno_error), 
 				code, optd->name, length, optd->min);
+			USDT_PROBE(DECODE_ERROR, (char *)error_name(ectlno_error), code, length);
 			ectlfr_trap();
 		}
 		if (optd->max && length > optd->max) {
@@ -4613,6 +3993,7 @@ dhcpopt_chktlv(struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8
 				" more than expected miximum (%" PRIu8 " octets).\n",
 				__func__, __LINE__, error_name(ectlno_error), 
 				code, optd->name, length, optd->max);
+			USDT_PROBE(DECODE_ERROR, (char *)error_name(ectlno_error), code, length);
 			ectlfr_trap();
 		}
 		if (optd->elsz && (length % optd->elsz)) {
@@ -4621,29 +4002,32 @@ dhcpopt_chktlv(struct dhcpopt_descriptor *optd, const uint8_t *begp, const uint8
 				" isn't multiple %" PRIu8 ".\n",
 				__func__, __LINE__, error_name(ectlno_error), 
 				code, optd->name, length, optd->elsz);
+			USDT_PROBE(DECODE_ERROR, (char *)error_name(ectlno_error), code, length);
 			ectlfr_trap();
 		}
 	}
 }
 
 struct dhcpopt *
-dhcpopt_decode(struct rbtree *dtree, const uint8_t **curp, const uint8_t *endp)
+dhcpopt_decode(const struct dhcpopt_descriptor *const *dtab, const uint8_t **curp, const uint8_t *endp)
 {
 	struct dhcpopt *opt = NULL;
-	struct dhcpopt_descriptor *optd;
+	const struct dhcpopt_descriptor *optd;
 	uint8_t code, length;
 
 	code = **curp;
-	optd = dhcp_getoptdescriptor(dtree, code);
+	optd = dhcp_getoptdescriptor(dtab, code);
 	dhcpopt_chktlv(optd, *curp, endp);
-	if (optd)
+	if (optd) {
 		opt = optd->decode(optd, curp, endp);
-	else {
+		opt->raw = NULL;
+	} else {
 		length = (*curp)[1];
 		opt = MALLOC(offsetof(struct dhcpopt, u8) + length);
 		opt->optd = NULL;
 		opt->code = code;
 		opt->length = length;
+		opt->raw = NULL;
 		memcpy(opt->u8, *curp + 2, length);
 		*curp += 2 + length;
 	}
@@ -4653,7 +4037,7 @@ dhcpopt_decode(struct rbtree *dtree, const uint8_t **curp, const uint8_t *endp)
 void
 dhcpopt_free(struct dhcpopt *opt)
 {
-	if (opt->optd && opt->optd->free)
+	if (dhcpopt_isdecoded(opt) && opt->optd && opt->optd->free)
 		opt->optd->free(opt);
 	else
 		free(opt);
@@ -4662,12 +4046,32 @@ dhcpopt_free(struct dhcpopt *opt)
 void
 dhcpopt_show(struct dhcpopt *opt, int indent, FILE *fp)
 {
+	if (!dhcpopt_isdecoded(opt)) {
+		struct ectlfr fr[1];
+		struct dhcpopt *volatile tmp;
+
+		/* показ не меняет список опций: декодируем во временную копию */
+		ectlfr_begin(fr, L_0);
+		tmp = dhcpopt_undefer(opt);
+		ectlfr_ontrap(fr, L_1);
+		dhcpopt_show(tmp, indent, fp);
+		ectlfr_end(fr);
+		dhcpopt_free(tmp);
+		return;
+
+	L_1:	ectlfr_ontrap(fr, L_0);
+		dhcpopt_free(tmp);
+	L_0:	ectlfr_end(fr);
+		ectlfr_trap();
+	}
 	if (opt->optd && opt->optd->show)
 		opt->optd->show(opt, indent, fp);
 	else {
-		fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s ", 
-			indent, "", opt->code, opt->length, 
-			DHCPOPTNAME_MAX, opt->optd ? opt->optd->name : "???");
+		if (opt->optd)
+			dhcpopt_show_hdr(opt, indent, ' ', fp);
+		else
+			fprintf(fp, "%*soption %3" PRIu8 " (%3" PRIu8 ") %-*s ", 
+				indent, "", opt->code, opt->length, DHCPOPTNAME_MAX, "???");
 		for (const char *p = opt->s; p < opt->s + opt->length; p++)
 			fprintf(fp, "%c", (isascii(*p) && isprint(*p)) ? *p : '.');
 		fprintf(fp, "\n");
@@ -4675,7 +4079,7 @@ dhcpopt_show(struct dhcpopt *opt, int indent, FILE *fp)
 }
 
 const char *
-dhcpoptval_enum(struct dhcpopt_descriptor *optd, void *value)
+dhcpopt_enum(const struct dhcpopt_descriptor *optd, void *value)
 {
 	const char *s = NULL;
 	if (optd && optd->enumfn)
@@ -4683,129 +4087,98 @@ dhcpoptval_enum(struct dhcpopt_descriptor *optd, void *value)
 	return s;
 }
 
-static 
-void __attribute__((__constructor__)) 
-dhcp_module_init()
-{
-	struct ectlfr fr[1];
-	struct ectlno ex[1];
-	struct dhcpopt_descriptor *ddtab[] = {
-		dhcpoptd1_subnet_mask,
-		dhcpoptd2_time_offset,
-		dhcpoptd3_routers,
-		dhcpoptd4_time_server,
-		dhcpoptd5_name_server,
-		dhcpoptd6_dns_server,
-		dhcpoptd7_log_server,
-		dhcpoptd8_cookie_server,
-		dhcpoptd9_lpr_server,
-		dhcpoptd10_impress_server,
-		dhcpoptd11_resource_location_server,
-		dhcpoptd12_host_name,
-		dhcpoptd13_boot_file_size,
-		dhcpoptd14_merit_dump_file,
-		dhcpoptd15_domain_name,
-		dhcpoptd16_swap_server,
-		dhcpoptd17_root_path,
-		dhcpoptd18_extensions_path,
-		dhcpoptd19_ip_forwarding,
-		dhcpoptd20_non_local_source_routing,
-		dhcpoptd21_policy_filter,
-		dhcpoptd22_max_datagram_reassembly_size,
-		dhcpoptd23_default_ip_ttl,
-		dhcpoptd24_path_mtu_aging_timeout,
-		dhcpoptd25_path_mtu_plateau_table,
-		dhcpoptd26_interface_mtu,
-		dhcpoptd27_all_subnets_local,
-		dhcpoptd28_broadcast_address,
-		dhcpoptd29_perform_mask_discovery,
-		dhcpoptd30_mask_supplier,
-		dhcpoptd31_perform_router_discovery,
-		dhcpoptd32_router_solicitation_address,
-		dhcpoptd33_static_route,
-		dhcpoptd34_trailer_encapsulation,
-		dhcpoptd35_arp_cache_timeout,
-		dhcpoptd36_ethernet_encapsulation,
-		dhcpoptd37_tcp_default_ttl,
-		dhcpoptd38_tcp_keepalive_interval,
-		dhcpoptd39_tcp_keepalive_garbage,
-		dhcpoptd40_nis_domain,
-		dhcpoptd41_nis_servers,
-		dhcpoptd42_ntp_servers,
-		dhcpoptd43_vendor_specific_information,
-		dhcpoptd44_netbios_name_server,
-		dhcpoptd45_netbios_dd_server,
-		dhcpoptd46_netbios_node_type,
-		dhcpoptd47_netbios_scope,
-		dhcpoptd48_xwindow_font_server,
-		dhcpoptd49_xwindow_display_manager,
-		dhcpoptd50_requested_ip_address,
-		dhcpoptd51_ip_address_lease_time,
-		dhcpoptd52_option_overload,
-		dhcpoptd53_dhcp_message_type,
-		dhcpoptd54_server_identifier,
-		dhcpoptd55_parameter_request_list,
-		dhcpoptd56_message,
-		dhcpoptd57_maximum_dhcp_message_size,
-		dhcpoptd58_renewal_time_value,
-		dhcpoptd59_rebinding_time_value,
-		dhcpoptd60_vendor_class_identifier,
-		dhcpoptd61_client_identifier,
-		dhcpoptd62_netwareip_domain_name,
-		dhcpoptd63_netwareip_information,
-		dhcpoptd64_nisplus_domain,
-		dhcpoptd65_nisplus_servers,
-		dhcpoptd66_tftp_server_name,
-		dhcpoptd67_bootfile_name,
-		dhcpoptd68_mobile_ip_home_agent,
-		dhcpoptd69_smtp_server,
-		dhcpoptd70_pop3_server,
-		dhcpoptd71_nntp_server,
-		dhcpoptd72_www_server,
-		dhcpoptd73_finger_server,
-		dhcpoptd74_irc_server,
-		dhcpoptd75_streettalk_server,
-		dhcpoptd76_streettalk_directory_assistance_server,
-		dhcpoptd77_user_class,
-		dhcpoptd78_slp_directory_agent,
-		dhcpoptd79_slp_service_scope,
-		dhcpoptd81_client_fqdn,
-		dhcpoptd82_relay_agent_information,
-		dhcpoptd255_end
-	};
-
-	ectlfr_begin(fr, L_0);
-	ectlno_begin(ex);
-	dhcpopt_dtree = dhcpopt_dtree_create(ddtab, sizeof ddtab/sizeof ddtab[0]);
-	ectlno_end(ex);
-	ectlfr_end(fr);
-	return;
-
-L_0:	ectlno_log();
-	ectlno_clearmessage();
-	ectlno_end(ex);
-	ectlfr_end(fr);
-	exit(1);
-}
-
-static
-void __attribute__((__destructor__))
-dhcp_module_fini()
-{
-	if (dhcpopt_dtree) {
-		dhcpopt_dtree_destroy(dhcpopt_dtree);
-		dhcpopt_dtree = NULL;
-	}
-}
+#define DHCPOPT_MAIN_DTAB(X)				\
+	X(dhcpoptd1_subnet_mask)			\
+	X(dhcpoptd2_time_offset)			\
+	X(dhcpoptd3_routers)				\
+	X(dhcpoptd4_time_server)			\
+	X(dhcpoptd5_name_server)			\
+	X(dhcpoptd6_dns_server)				\
+	X(dhcpoptd7_log_server)				\
+	X(dhcpoptd8_cookie_server)			\
+	X(dhcpoptd9_lpr_server)				\
+	X(dhcpoptd10_impress_server)			\
+	X(dhcpoptd11_resource_location_server)		\
+	X(dhcpoptd12_host_name)				\
+	X(dhcpoptd13_boot_file_size)			\
+	X(dhcpoptd14_merit_dump_file)			\
+	X(dhcpoptd15_domain_name)			\
+	X(dhcpoptd16_swap_server)			\
+	X(dhcpoptd17_root_path)				\
+	X(dhcpoptd18_extensions_path)			\
+	X(dhcpoptd19_ip_forwarding)			\
+	X(dhcpoptd20_non_local_source_routing)		\
+	X(dhcpoptd21_policy_filter)			\
+	X(dhcpoptd22_max_datagram_reassembly_size)	\
+	X(dhcpoptd23_default_ip_ttl)			\
+	X(dhcpoptd24_path_mtu_aging_timeout)		\
+	X(dhcpoptd25_path_mtu_plateau_table)		\
+	X(dhcpoptd26_interface_mtu)			\
+	X(dhcpoptd27_all_subnets_local)			\
+	X(dhcpoptd28_broadcast_address)			\
+	X(dhcpoptd29_perform_mask_discovery)		\
+	X(dhcpoptd30_mask_supplier)			\
+	X(dhcpoptd31_perform_router_discovery)		\
+	X(dhcpoptd32_router_solicitation_address)	\
+	X(dhcpoptd33_static_route)			\
+	X(dhcpoptd34_trailer_encapsulation)		\
+	X(dhcpoptd35_arp_cache_timeout)			\
+	X(dhcpoptd36_ethernet_encapsulation)		\
+	X(dhcpoptd37_tcp_default_ttl)			\
+	X(dhcpoptd38_tcp_keepalive_interval)		\
+	X(dhcpoptd39_tcp_keepalive_garbage)		\
+	X(dhcpoptd40_nis_domain)			\
+	X(dhcpoptd41_nis_servers)			\
+	X(dhcpoptd42_ntp_servers)			\
+	X(dhcpoptd43_vendor_specific_information)	\
+	X(dhcpoptd44_netbios_name_server)		\
+	X(dhcpoptd45_netbios_dd_server)			\
+	X(dhcpoptd46_netbios_node_type)			\
+	X(dhcpoptd47_netbios_scope)			\
+	X(dhcpoptd48_xwindow_font_server)		\
+	X(dhcpoptd49_xwindow_display_manager)		\
+	X(dhcpoptd50_requested_ip_address)		\
+	X(dhcpoptd51_ip_address_lease_time)		\
+	X(dhcpoptd52_option_overload)			\
+	X(dhcpoptd53_dhcp_message_type)			\
+	X(dhcpoptd54_server_identifier)			\
+	X(dhcpoptd55_parameter_request_list)		\
+	X(dhcpoptd56_message)				\
+	X(dhcpoptd57_maximum_dhcp_message_size)		\
+	X(dhcpoptd58_renewal_time_value)		\
+	X(dhcpoptd59_rebinding_time_value)		\
+	X(dhcpoptd60_vendor_class_identifier)		\
+	X(dhcpoptd61_client_identifier)			\
+	X(dhcpoptd62_netwareip_domain_name)		\
+	X(dhcpoptd63_netwareip_information)		\
+	X(dhcpoptd64_nisplus_domain)			\
+	X(dhcpoptd65_nisplus_servers)			\
+	X(dhcpoptd66_tftp_server_name)			\
+	X(dhcpoptd67_bootfile_name)			\
+	X(dhcpoptd68_mobile_ip_home_agent)		\
+	X(dhcpoptd69_smtp_server)			\
+	X(dhcpoptd70_pop3_server)			\
+	X(dhcpoptd71_nntp_server)			\
+	X(dhcpoptd72_www_server)			\
+	X(dhcpoptd73_finger_server)			\
+	X(dhcpoptd74_irc_server)			\
+	X(dhcpoptd75_streettalk_server)			\
+	X(dhcpoptd76_streettalk_directory_assistance_server)	\
+	X(dhcpoptd77_user_class)			\
+	X(dhcpoptd78_slp_directory_agent)		\
+	X(dhcpoptd79_slp_service_scope)			\
+	X(dhcpoptd81_client_fqdn)			\
+	X(dhcpoptd82_relay_agent_information)		\
+	X(dhcpoptd255_end)
+DHCPOPT_DTAB(dhcpopt_dtab, DHCPOPT_MAIN_DTAB);
 
 
 struct dhcp *
-dhcp_decode(const uint8_t **curp, const uint8_t *endp)
+dhcp_decode(const uint8_t **curp, const uint8_t *endp, const struct dhcpoptset *demand)
 {
 	struct dhcp *volatile dp;
 	struct dhcphdr *dhp;
 	const uint8_t *cp;
-        struct dhcpopt *opt;
 	struct ectlfr fr[1];
 
 	dp = NULL;
@@ -4819,7 +4192,8 @@ dhcp_decode(const uint8_t **curp, const uint8_t *endp)
 		ectlfr_trap();
 	}
 
-	dp = MALLOC(sizeof(struct dhcp));
+	cp = dhp->options + 4; /* skip cookie 63:82:53:63 */
+	dp = MALLOC(sizeof(struct dhcp) + DHCPOPTLST_IDXMAX(endp > cp ? endp - cp : 0) * sizeof(struct dhcpopt *));
 	dp->op = dhp->op;
 	dp->htype = dhp->htype;
 	dp->hlen = dhp->hlen;
@@ -4834,13 +4208,32 @@ dhcp_decode(const uint8_t **curp, const uint8_t *endp)
 	memcpy(dp->chaddr, dhp->chaddr, dhp->hlen);
 	memcpy(dp->sname, dhp->sname, DHCPHDR_SNAME_LEN);
 	strlcpy(dp->file, dhp->file, DHCPHDR_FILE_LEN);
-	STAILQ_INIT(dp->opts);
+	dhcpoptlst_init(dp->opts, dp->optidx);
 	ectlfr_begin(fr, L_1);
 
-	cp = dhp->options + 4; /* skip cookie 63:82:53:63 */
-	dhcp_decode_opts(dp->opts, dhcpopt_dtree, &cp, endp);
+	dhcp_decode_opts(dp->opts, dhcpopt_dtab, demand, &cp, endp);
 	*curp = cp;
 
+#ifdef USDT
+	/* тип сообщения - сырым байтом: проба не должна декодировать опции */
+	if (USDT_ENABLED(DECODE_DONE)) {
+		struct dhcpopt *opt;
+		const uint8_t *raw;
+		uint8_t len, type = 0;
+		uint32_t n = 0;
+
+		DHCPOPTLST_FOREACH(opt, dp->opts)
+			n++;
+		if ((raw = dhcpoptlst_peekraw(dp->opts, DHCPOPT53_DHCP_MESSAGE_TYPE, &len)))
+			type = len ? raw[0] : 0;
+		else if (dhcpoptlst_has(dp->opts, DHCPOPT53_DHCP_MESSAGE_TYPE)) {
+			opt = *dhcpoptlst_slot(dp->opts, DHCPOPT53_DHCP_MESSAGE_TYPE);
+			type = opt->length ? opt->u8[0] : 0;
+		}
+		USDT_PROBE(DECODE_DONE, type, n, dp->xid);
+	}
+#endif
+
 	ectlfr_end(fr);
 	return dp;
 
@@ -4858,142 +4251,17 @@ dhcp_free(struct dhcp *dp)
 	}
 }
 
-static inline
-int
-hexchar2number(int c)
-{
-	int n = -1;
-	if (isdigit(c))
-		n = tolower(c) - '0';
-	else if (isxdigit(c))
-		n = tolower(c) - 'a' + 10;
-	return n;
-}
-
-struct dhcpopt82_value *
-dhcpopt82_research(struct dhcpopt *opt)
+void
+dhcp_rebase(struct dhcp *dp, const uint8_t *from, const uint8_t *to)
 {
-#if 0
-        option  82 ( 18) Relay Agent Information
-          option   1 (  6) Circuit-ID       00:04:0a:42:00:0e
-          option   2 (  8) Remote-ID        00:06:00:26:5a:96:52:e0
-#endif
-        struct dhcpopt82_value *optval;
-        struct dhcpopt *circuit_id, *remote_id;
-	uint16_t vlanid;
-	uint8_t module, port;
-	struct ether_addr ether;
-	uint8_t slen;
-	char *str;
-
-        circuit_id = dhcpoptlst_find(opt->lst, DHCPOPT82_SUBOPT1_CIRCUITID);
-        remote_id = dhcpoptlst_find(opt->lst, DHCPOPT82_SUBOPT2_REMOTEID);
-
-        if (dhcpopt_length(opt) == 18 &&
-                circuit_id && dhcpopt_length(circuit_id) == 6 &&
-                        circuit_id->u8[0] == 0 && circuit_id->u8[1] == 4 &&
-                remote_id && dhcpopt_length(remote_id) == 8 &&
-                        remote_id->u8[0] == 0 && remote_id->u8[1] == 6)
-        {
-                vlanid = ntohs(*(uint16_t *)(circuit_id->u8 + 2));
-                if (vlanid < 1 || vlanid > 4094)
-                        goto L_not_default;
-                module = circuit_id->u8[4];
-                port = circuit_id->u8[5];
-                ether = *(struct ether_addr *)(remote_id->u8 + 2);
-
-                optval = MALLOC(offsetof(struct dhcpopt82_value, u8) + sizeof(optval->def[0]));
-		optval->type = DHCPOPT82_T_DEFAULT;
-		optval->def[0].vlanid = vlanid;
-		optval->def[0].module = module;
-		optval->def[0].port = port;
-		optval->def[0].ether = ether;
-                return optval;
-        }
-L_not_default:
-
-#if 0
-	option  82 ( 38) Relay Agent Information
-          option   1 (  8) Circuit-ID   00 /*slot*/ : 26 /*port*/ : 0f:ad /*vid*/ : 70:6f:72:74 /*port*/
-          option   2 ( 26) Remote-ID    33:38 : 2f : 30:30:31:39:63:62:38:65:61:35:63:34 : 2f : 32:32:31:30:30:34:30:31:37 : 2f
-	26 00:19:cb:8e:a5:c4 
-#endif
-	if (circuit_id && dhcpopt_length(circuit_id) == 8 && !memcmp(circuit_id->u8 + 4, "port", 4) && 
-		remote_id && dhcpopt_length(remote_id) >= 15 && remote_id->u8[2] == '/') {
-		vlanid = ntohs(*(uint16_t *)(circuit_id->u8 + 2));
-                if (vlanid < 1 || vlanid > 4094)
-                        goto L_not_zyxel;
-		module = circuit_id->u8[0];
-		port = circuit_id->u8[1];
-		for (int i = 0; i < ETHER_ADDR_LEN; i++)
-			ether.octet[i] = hexchar2number(remote_id->u8[3+2*i]) * 16 + 
-				hexchar2number(remote_id->u8[4+2*i]);
-		optval = MALLOC(offsetof(struct dhcpopt82_value, u8) + sizeof(optval->def[0]));
-		optval->type = DHCPOPT82_T_IES1248;
-		optval->def[0].vlanid = vlanid;
-		optval->def[0].module = module;
-		optval->def[0].port = port;
-		optval->def[0].ether = ether;
-		return optval;
-	}
-L_not_zyxel:
-
-#if 0
-	agent.circuit-id = 9(slot) : 36(port) : 7:d0(vlanid) : 30:30:31:39:63:62:32:64:62:31:31:30(mac ascii string)
-#endif
-	if (dhcpopt_length(opt) == 18 && circuit_id && dhcpopt_length(circuit_id) == 16 && !remote_id) {
-		vlanid = ntohs(*(uint16_t *)(circuit_id->u8 + 2));
-                if (vlanid < 1 || vlanid > 4094)
-                        goto L_not_zyxel_ies5000;
-		module = circuit_id->u8[0];
-		port = circuit_id->u8[1];
-		for (int i = 0; i < ETHER_ADDR_LEN; i++)
-			ether.octet[i] = hexchar2number(circuit_id->u8[4 + 2*i]) * 16 + 
-				hexchar2number(circuit_id->u8[5 + 2*i]);
-		optval = MALLOC(offsetof(struct dhcpopt82_value, u8) + sizeof(optval->def[0]));
-		optval->type = DHCPOPT82_T_IES5000;
-		optval->def[0].vlanid = vlanid;
-		optval->def[0].module = module;
-		optval->def[0].port = port;
-		optval->def[0].ether = ether;
-		return optval;
-	}
-L_not_zyxel_ies5000:
-
-#if 0
-	  option  82 ( 22) Relay Agent Information
-	    option   1 (  6) Circuit-ID     00:04:0b:58:00:01
-	    option   2 ( 12) Remote-ID      01: 0a(длина строки) : 31:30:2e:32:2e:34:34:2e:32:33(сама строка)
-#endif
-        if (circuit_id && dhcpopt_length(circuit_id) == 6 && circuit_id->u8[0] == 0 && circuit_id->u8[1] == 4 &&
-			remote_id && remote_id->u8[0] == 1 && dhcpopt_length(remote_id)-2 == remote_id->u8[1]) {
-                vlanid = ntohs(*(uint16_t *)(circuit_id->u8 + 2));
-                if (vlanid < 1 || vlanid > 4094)
-                        goto L_not_cdru;
-                module = circuit_id->u8[4];
-                port = circuit_id->u8[5];
-                slen = remote_id->u8[1];
-		str = (char *)remote_id->u8 + 2;
-		for (size_t i = 0; i < slen; i++)
-			if (!isprint(str[i]))
-				goto L_not_cdru;
-
-                optval = MALLOC(offsetof(struct dhcpopt82_value, u8) + sizeof(optval->cdru[0]) + slen + 1);
-		optval->type = DHCPOPT82_T_CDRU;
-		optval->cdru[0].vlanid = vlanid;
-		optval->cdru[0].module = module;
-		optval->cdru[0].port = port;
-		optval->cdru[0].slen = slen;
-		memcpy(optval->cdru[0].str, str, slen);
-		optval->cdru[0].str[slen] = 0;
-                return optval;
-        }
-L_not_cdru:
+	struct dhcpopt *opt;
 
-        return NULL;
+	/* откладываются только опции верхнего уровня */
+	DHCPOPTLST_FOREACH(opt, dp->opts)
+		if (!dhcpopt_isdecoded(opt))
+			opt->raw = to + (opt->raw - from);
 }
 
-
 void
 dhcp_show(struct dhcp *dp, int indent, FILE *fp)
 {
@@ -5021,6 +4289,6 @@ dhcp_show(struct dhcp *dp, int indent, FILE *fp)
 		"%*sfile: %s\n",
 		indent, "", dp->sname, 
 		indent, "", dp->file);
-        STAILQ_FOREACH(opt, dp->opts, ent)
-                dhcpopt_show(opt, indent, stdout);
+        DHCPOPTLST_FOREACH(opt, dp->opts)
+                dhcpopt_show(opt, indent, fp);
 }
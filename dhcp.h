@@ -8,23 +8,18 @@
 #include <net/ethernet.h>
 #include <netinet/in.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/queue.h>
 
-DECL_ERROR(E_DHCPOPTDESC)
-DECL_ERROR(E_DHCPOPTDESCDUP)
-DECL_ERROR(E_DHCPOPTDESCADD)
 DECL_ERROR(E_DHCPOPTDECODE)
 DECL_ERROR(E_DHCPENDOFDATA)
 DECL_ERROR(E_DHCPDATAINCOMPLETE)
 DECL_ERROR(E_DHCPWRONGCOOKIE)
 #if 0
-#define E_DHCPOPTDESC		1
-#define E_DHCPOPTDESCDUP	2
-#define E_DHCPOPTDESCADD	3
-#define	E_DHCPOPTDECODE		4
-#define E_DHCPENDOFDATA		5	/* закончились данные в dhcp пакете */
-#define E_DHCPDATAINCOMPLETE	6	/* опция требует данных, а их нет */
-#define E_DHCPWRONGCOOKIE	7
+#define	E_DHCPOPTDECODE		1
+#define E_DHCPENDOFDATA		2	/* закончились данные в dhcp пакете */
+#define E_DHCPDATAINCOMPLETE	3	/* опция требует данных, а их нет */
+#define E_DHCPWRONGCOOKIE	4
 #endif
 
 __BEGIN_DECLS
@@ -40,6 +35,11 @@ __END_DECLS
 #define DHCPHDR_SNAME_LEN	64
 #define DHCPHDR_FILE_LEN	128
 #define DHCPHDR_VEND_LEN	64
+/* Версия описаний опций: растёт, когда меняется разбор или показ какой-нибудь
+ * опции. Журнал событий (evlog.h) хранит опции сырыми и помечает их ею.
+ */
+#define DHCPOPT_DTAB_VERSION	1
+
 /* Overhead to fit a bootp message into an Ethernet packet. */
 #define DHCPPDU_OVERHEAD	(14 + 20 + 8)   /* Ethernet + IP + UDP headers */
 
@@ -112,6 +112,8 @@ struct pdu_dhcpopt {
 #define	DHCPOPT_F_PAD		4
 #define	DHCPOPT_F_END		8
 
+struct dhcpopt_hdr;
+
 struct dhcpopt_descriptor {
         const char *    name;   /* option name */
 	int		flags;	/* DHCPOPT_F_NOLENGTH, DHCPOPT_F_NOVALUE */
@@ -120,24 +122,76 @@ struct dhcpopt_descriptor {
         uint8_t         min;    /* minimal length in bytes */
         uint8_t         max;    /* maximal length in bytes */
         const char *    metric;
-        struct dhcpopt *(*decode)(struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp);
+        struct dhcpopt *(*decode)(const struct dhcpopt_descriptor *optd, const uint8_t **curp, const uint8_t *endp);
         void            (*free)(struct dhcpopt *opt);
         void            (*show)(struct dhcpopt *opt, int indent, FILE *fp);
-        const char *    (*enumfn)(struct dhcpopt_descriptor *optd, void *value);
+        const char *    (*enumfn)(const struct dhcpopt_descriptor *optd, void *value);
+
+	/* suboptions: table of descriptors indexed by code */
+	const struct dhcpopt_descriptor *const *dtab;
 
-	/* suboptions */
-	int		(*init)(struct dhcpopt_descriptor *optd);
-	void		(*fini)(struct dhcpopt_descriptor *optd);
-        struct rbtree * dtree;
+	const struct dhcpopt_hdr *hdr;	/* заголовок строки вывода, см. dhcp.c */
 };
 
+/* Множество кодов опций: битовая карта на все 256 возможных кодов. */
+struct dhcpoptset {
+	uint64_t	bits[256 / 64];
+};
+#define DHCPOPTSET_INITIALIZER	{ .bits = { 0 } }
+
+static inline
+void
+dhcpoptset_add(struct dhcpoptset *set, uint8_t code)
+{
+	set->bits[code >> 6] |= (uint64_t)1 << (code & 63);
+}
+
+static inline
+int
+dhcpoptset_isset(const struct dhcpoptset *set, uint8_t code)
+{
+	return (set->bits[code >> 6] >> (code & 63)) & 1;
+}
+
+/* сколько кодов множества меньше code */
+static inline
+unsigned
+dhcpoptset_rank(const struct dhcpoptset *set, uint8_t code)
+{
+	unsigned i = code >> 6;
+	unsigned r = __builtin_popcountll(set->bits[i] & (((uint64_t)1 << (code & 63)) - 1));
+
+	while (i--)
+		r += __builtin_popcountll(set->bits[i]);
+	return r;
+}
+
+/* Список опций пакета (или вложенных опций). Вместе со списком при декодировании
+ * строятся карта присутствия кодов и индекс первых опций каждого кода, так что
+ * поиск опции и проверка "есть ли опция X" не требуют прохода по списку.
+ * Индекс плотный: первые опции по возрастанию кода, место опции с кодом code -
+ * dhcpoptset_rank(set, code). Память под него - в том же блоке, что и список:
+ * каждая опция занимает не меньше 2 байт, так что кодов не больше DHCPOPTLST_IDXMAX()
+ * от длины данных - вложенному списку опции 82 хватает нескольких указателей.
+ */
 struct dhcpopt;
-STAILQ_HEAD(dhcpoptlst, dhcpopt); 
+TAILQ_HEAD(dhcpopthead, dhcpopt); 
+struct dhcpoptlst {
+	struct dhcpopthead	head[1];
+	struct dhcpoptset	set;
+	int			n;	/* кодов в set */
+	struct dhcpopt **	idx;	/* [n] */
+};
+#define DHCPOPTLST_IDXMAX(len)	((len) / 2 + 1 < 256 ? (len) / 2 + 1 : 256)
+#define DHCPOPTLST_FOREACH(opt, lst)	TAILQ_FOREACH(opt, (lst)->head, ent)
+
 struct dhcpopt {
-        STAILQ_ENTRY(dhcpopt)		ent;
-	struct dhcpopt_descriptor *	optd;
+        TAILQ_ENTRY(dhcpopt)		ent;
+	const struct dhcpopt_descriptor *	optd;
 	uint8_t				code;
         uint8_t				length;
+	const uint8_t *			raw;	/* != NULL: the option isn't decoded yet, 
+						 * raw points to its TLV in the source buffer */
 	union {
 		uint8_t		value[0];
 
@@ -196,35 +250,13 @@ struct dhcp {
     char		sname[DHCPHDR_SNAME_LEN];   /* server host name */
     char		file[DHCPHDR_FILE_LEN];     /* boot file name */
     struct dhcpoptlst	opts[1];                    /* dhcp options */
-};
-
-enum dhcpopt82_type {
-        DHCPOPT82_T_UNKNOWN,
-        DHCPOPT82_T_DEFAULT,
-        DHCPOPT82_T_IES1248,
-        DHCPOPT82_T_IES5000,
-	DHCPOPT82_T_CDRU	/* Circuit-ID: default, Remote-ID: userString */
-};
-struct dhcpopt82_value {
-        enum dhcpopt82_type type;
-        union {
-                uint8_t u8[0];
-                struct {
-                        uint16_t vlanid;
-                        uint8_t module, port;
-                        struct ether_addr ether;
-                } def[0];
-                struct {
-                        uint16_t vlanid;
-                        uint8_t module, port;
-			uint8_t slen;
-                        char str[];
-                } cdru[0];
-        };
+    struct dhcpopt *	optidx[];                   /* opts->idx */
 };
 
 __BEGIN_DECLS
-const char *		dhcp_option(struct rbtree *dtree, uint8_t option);
+const char *		dhcp_option(const struct dhcpopt_descriptor *const *dtab, uint8_t option);
+/* название значения перечислимой опции (тип сообщения и т.п.) или NULL */
+const char *		dhcp_option_enum(const struct dhcpopt_descriptor *const *dtab, uint8_t option, void *value);
 
 static inline 
 uint8_t	
@@ -255,12 +287,19 @@ dhcpopt_value(struct dhcpopt *opt)
 }
 
 static inline 
-struct dhcpopt_descriptor *
+const struct dhcpopt_descriptor *
 dhcpopt_descriptor(struct dhcpopt *opt) 
 {
 	return opt->optd;
 }
 
+static inline 
+int
+dhcpopt_isdecoded(struct dhcpopt *opt) 
+{
+	return opt->raw == NULL;
+}
+
 static inline 
 int
 dhcpopt_ispad(struct dhcpopt *opt) 
@@ -275,32 +314,76 @@ dhcpopt_isend(struct dhcpopt *opt)
 	return opt->optd ? (opt->optd->flags & DHCPOPT_F_END) : 0; 
 }
 
-struct dhcpopt *dhcpopt_decode(struct rbtree *dtree, const uint8_t **curp, const uint8_t *endp);
+struct dhcpopt *dhcpopt_decode(const struct dhcpopt_descriptor *const *dtab, const uint8_t **curp, const uint8_t *endp);
 void		dhcpopt_free(struct dhcpopt *opt);
 void		dhcpopt_show(struct dhcpopt *opt, int indent, FILE *fp);
-const char *	dhcpopt_enum(struct dhcpopt_descriptor *optd, void *value);
+const char *	dhcpopt_enum(const struct dhcpopt_descriptor *optd, void *value);
+
+/* idx - место под DHCPOPTLST_IDXMAX() указателей */
+static inline
+void
+dhcpoptlst_init(struct dhcpoptlst *lst, struct dhcpopt **idx)
+{
+	TAILQ_INIT(lst->head);
+	memset(&lst->set, 0, sizeof lst->set);
+	lst->n = 0;
+	lst->idx = idx;
+}
+
+/* первая опция с кодом optcode; code должен быть в set */
+static inline
+struct dhcpopt **
+dhcpoptlst_slot(struct dhcpoptlst *lst, uint8_t optcode)
+{
+	return lst->idx + dhcpoptset_rank(&lst->set, optcode);
+}
+
+static inline
+int
+dhcpoptlst_has(struct dhcpoptlst *lst, uint8_t optcode)
+{
+	return dhcpoptset_isset(&lst->set, optcode);
+}
 
-/* XXX: подразумеваем, что опций в пакете мало и линейный поиск по списку не сожрёт процессор */
+/* Значение ещё не декодированной опции в исходном буфере, без декодирования;
+ * NULL - опции нет или она уже декодирована.
+ */
 static inline
-struct dhcpopt *
-dhcpoptlst_find(struct dhcpoptlst *lst, uint8_t optcode)
+const uint8_t *
+dhcpoptlst_peekraw(struct dhcpoptlst *lst, uint8_t optcode, uint8_t *length)
 {
 	struct dhcpopt *opt;
 
-	STAILQ_FOREACH(opt, lst, ent)
-		if (dhcpopt_code(opt) == optcode)
-			break;
-	return opt;
+	if (!dhcpoptset_isset(&lst->set, optcode))
+		return NULL;
+	opt = *dhcpoptlst_slot(lst, optcode);
+	if (dhcpopt_isdecoded(opt))
+		return NULL;
+	*length = opt->length;
+	return opt->raw + 2;
 }
 
-/* пробует угадать, что за данные спрятаны в dhcp option 82 */
-struct dhcpopt82_value *dhcpopt82_research(struct dhcpopt *opt);
+/* Найденная, но ещё не декодированная опция декодируется на месте. */
+struct dhcpopt *dhcpoptlst_find(struct dhcpoptlst *lst, uint8_t optcode);
+void		dhcpoptlst_resolve(struct dhcpoptlst *lst);
+
 
-void		dhcp_decode_opts(struct dhcpoptlst *lst, struct rbtree *dtree, const uint8_t **curp, const uint8_t *endp);
+/* demand - множество опций, которые декодируются сразу. Остальные опции проверяются
+ * (dhcpopt_chktlv), но остаются ссылками на исходный буфер и декодируются при первом
+ * обращении (dhcpoptlst_find(), dhcpoptlst_resolve(), dhcpopt_show()). Поэтому исходный
+ * буфер должен жить не меньше, чем результат декодирования. demand == NULL - декодировать всё.
+ */
+void		dhcp_decode_opts(struct dhcpoptlst *lst, const struct dhcpopt_descriptor *const *dtab, const struct dhcpoptset *demand,
+			const uint8_t **curp, const uint8_t *endp);
 void		dhcp_free_opts(struct dhcpoptlst *lst);
-struct dhcp *	dhcp_decode(const uint8_t **curp, const uint8_t *endp);
+struct dhcp *	dhcp_decode(const uint8_t **curp, const uint8_t *endp, const struct dhcpoptset *demand);
 void		dhcp_free(struct dhcp *dp);
 void		dhcp_show(struct dhcp *dp, int indent, FILE *fp);
+/* Пакет, из которого декодирован dp, скопирован с from в to: отложенные опции
+ * переводятся на копию, и dp можно показывать после того, как исходный буфер
+ * освобождён.
+ */
+void		dhcp_rebase(struct dhcp *dp, const uint8_t *from, const uint8_t *to);
 __END_DECLS
 
 #define DHCPOPT0_PAD				0	/* no value */
@@ -374,6 +457,13 @@ __END_DECLS
 #define	DHCPNAK		6
 #define	DHCPRELEASE	7
 #define	DHCPINFORM	8
+static inline
+uint8_t
+dhcp_msgtype(struct dhcp *dp)
+{
+	struct dhcpopt *opt = dhcpoptlst_find(dp->opts, DHCPOPT53_DHCP_MESSAGE_TYPE);
+	return opt && opt->length ? opt->u8[0] : 0;
+}
 #define	DHCPOPT54_SERVER_IDENTIFIER		54	/* u32[0] */
 #define	DHCPOPT55_PARAMETER_REQUEST_LIST	55	/* u8[] */
 #define	DHCPOPT56_MESSAGE			56	/* s[] */
@@ -0,0 +1,509 @@
+/* Микро-бенчмарки конвейера декодирования/вывода и ipmap.
+ *
+ * Собирается целью `make bench`. Для каждого теста печатается ns/op и число
+ * выделений памяти на операцию; результат - JSON на stdout.
+ *
+ * Выделения считаются через обёртки __wrap_malloc() и др., которые подключает
+ * компоновщик (-Wl,--wrap=..., см. Makefile). Учитываются только вызовы из
+ * нашего кода; выделения внутри libc (например, буфер stdio) не видны.
+ */
+#include <inttypes.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <syslog.h>
+
+#include "foo.h"
+#include "ip.h"
+#include "dhcp.h"
+#include "opt82.h"
+#include "watch.h"
+#include "filter.h"
+#include "sample.h"
+#include "topn.h"
+#include "hll.h"
+#include "hexdump.h"
+#include "synth.h"
+
+/* Счётчики выделений памяти */
+static uint64_t nallocs, nfrees;
+
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+void __real_free(void *);
+char *__real_strdup(const char *);
+
+void *__wrap_malloc(size_t n) { nallocs++; return __real_malloc(n); }
+void *__wrap_calloc(size_t m, size_t n) { nallocs++; return __real_calloc(m, n); }
+void *__wrap_realloc(void *p, size_t n) { nallocs++; return __real_realloc(p, n); }
+void __wrap_free(void *p) { if (p) nfrees++; __real_free(p); }
+char *__wrap_strdup(const char *s) { nallocs++; return __real_strdup(s); }
+
+/* Детерминированный генератор: одинаковые наборы данных от запуска к запуску. */
+static uint64_t rnd_state = 0x9e3779b97f4a7c15ULL;
+
+static inline
+uint32_t
+rnd32()
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state >> 32;
+}
+
+static inline
+uint64_t
+now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Минимальное время измерения одного теста; набор данных прогоняется целиком,
+ * пока суммарное время не превысит этот порог.
+ */
+static uint64_t mintime_ns = 200 * 1000000ULL;
+static int nresults = 0;
+
+static
+void
+report(const char *name, const char *dataset, size_t items, uint64_t ops, uint64_t ns,
+	uint64_t allocs, uint64_t frees)
+{
+	printf("%s\n    {\"name\": \"%s\", \"dataset\": \"%s\", \"items\": %zu, \"ops\": %" PRIu64 ", "
+		"\"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, \"frees_per_op\": %.3f}",
+		nresults++ ? "," : "", name, dataset, items, ops, (double)ns / ops,
+		(double)allocs / ops, (double)frees / ops);
+	fflush(stdout);
+}
+
+/* Замер: body выполняется для всего набора за один проход, время и выделения
+ * учитываются только внутри body; prep/post - подготовка и уборка вне замера.
+ * Первый проход не учитывается: он прогревает кэши и аллокатор.
+ */
+#define BENCH(name, dataset, items, nops, prep, body, post) do {			\
+	uint64_t ns_ = 0, ops_ = 0, a_ = 0, f_ = 0;					\
+	prep;										\
+	body;										\
+	post;										\
+	do {										\
+		uint64_t t_, a0_, f0_;							\
+		prep;									\
+		a0_ = nallocs, f0_ = nfrees;						\
+		t_ = now_ns();								\
+		body;									\
+		ns_ += now_ns() - t_;							\
+		a_ += nallocs - a0_, f_ += nfrees - f0_;				\
+		ops_ += (nops);								\
+		post;									\
+	} while (ns_ < mintime_ns);							\
+	report(name, dataset, items, ops_, ns_, a_, f_);				\
+} while (0)
+
+/*
+ * Синтетические DHCP пакеты (payload UDP, см. synth.h). Пакеты чередуют
+ * форматы опции 82, включая нераспознаваемый, и запросы без relay.
+ */
+struct pkt {
+	uint16_t	len;
+	uint8_t		data[SYNTH_DHCP_MAX];
+};
+
+static
+void
+mkpkt(struct pkt *pkt, uint32_t seq)
+{
+	struct synth_client cl;
+	struct synth_msg m;
+
+	for (int i = 0; i < 6; i++)
+		cl.mac[i] = rnd32(), cl.swmac[i] = rnd32();
+	cl.vlan = 1 + seq % 4094;
+	cl.module = seq % 4;
+	cl.port = 1 + seq % 48;
+	cl.opt82 = seq % SYNTH_OPT82_MAX;
+	cl.fp = seq % synth_nfingerprints();
+	cl.ip = 0x0a020000 | (rnd32() & 0xffff);
+	cl.giaddr = cl.opt82 == SYNTH_OPT82_NONE ? 0 : 0x0a000001 | (seq % 256) << 8;
+
+	m.cl = &cl;
+	m.xid = rnd32();
+	m.server = 0x0a000001;
+	m.ciaddr = 0;
+	m.type = 1 + seq % 8;
+	m.relayed = 1;
+	m.bad = SYNTH_BAD_NONE;
+	pkt->len = synth_dhcp(pkt->data, &m);
+}
+
+static
+struct pkt *
+mkpkts(size_t n)
+{
+	struct pkt *pkts = MALLOC(n * sizeof pkts[0]);
+	for (size_t i = 0; i < n; i++)
+		mkpkt(pkts + i, i);
+	return pkts;
+}
+
+static
+struct dhcp *
+decode_pkt(struct pkt *pkt, const struct dhcpoptset *demand)
+{
+	const uint8_t *cp = pkt->data;
+	return dhcp_decode(&cp, pkt->data + pkt->len, demand);
+}
+
+static
+void
+bench_dhcp(size_t n, FILE *devnull)
+{
+	/* Опции, которые dhcpdump декодирует сразу (см. decode_demand) */
+	static struct dhcpoptset demand[1] = { DHCPOPTSET_INITIALIZER };
+	/* опция 82 отложена, её находит в кэше dhcpopt82_lookup() */
+	static struct dhcpoptset lazy[1] = { DHCPOPTSET_INITIALIZER };
+	struct pkt *pkts;
+	struct dhcp **dps;
+	struct dhcpopt82_value *vals;
+	struct dhcpopt82_cache *cache;
+	char dataset[32];
+
+	dhcpoptset_add(demand, DHCPOPT82_RELAYAGENTINFORMATION);
+	cache = dhcpopt82_cache_create(DHCPOPT82_CACHE_SIZE);
+	snprintf(dataset, sizeof dataset, "dhcp-%zu", n);
+	pkts = mkpkts(n);
+	dps = MALLOC(n * sizeof dps[0]);
+	vals = MALLOC(n * sizeof vals[0]);
+
+	BENCH("dhcp_decode", dataset, n, n, ,
+		for (size_t i = 0; i < n; i++) dps[i] = decode_pkt(pkts + i, demand),
+		for (size_t i = 0; i < n; i++) dhcp_free(dps[i]));
+	BENCH("dhcp_decode_full", dataset, n, n, ,
+		for (size_t i = 0; i < n; i++) dps[i] = decode_pkt(pkts + i, NULL),
+		for (size_t i = 0; i < n; i++) dhcp_free(dps[i]));
+	BENCH("dhcp_free", dataset, n, n,
+		for (size_t i = 0; i < n; i++) dps[i] = decode_pkt(pkts + i, demand),
+		for (size_t i = 0; i < n; i++) dhcp_free(dps[i]), );
+	BENCH("dhcp_show", dataset, n, n,
+		for (size_t i = 0; i < n; i++) dps[i] = decode_pkt(pkts + i, demand),
+		for (size_t i = 0; i < n; i++) dhcp_show(dps[i], 2, devnull),
+		for (size_t i = 0; i < n; i++) dhcp_free(dps[i]));
+	BENCH("hexdump", dataset, n, n, ,
+		for (size_t i = 0; i < n; i++) hexdump(devnull, pkts[i].data, pkts[i].len, 2), );
+	BENCH("dhcpopt82_research", dataset, n, n,
+		for (size_t i = 0; i < n; i++) dps[i] = decode_pkt(pkts + i, demand),
+		for (size_t i = 0; i < n; i++) {
+			struct dhcpopt *opt = dhcpoptlst_find(dps[i]->opts, DHCPOPT82_RELAYAGENTINFORMATION);
+			if (opt)
+				dhcpopt82_research(opt, vals + i);
+		},
+		for (size_t i = 0; i < n; i++) dhcp_free(dps[i]));
+	BENCH("dhcpopt82_lookup", dataset, n, n,
+		for (size_t i = 0; i < n; i++) dps[i] = decode_pkt(pkts + i, lazy),
+		for (size_t i = 0; i < n; i++) dhcpopt82_lookup(cache, dps[i]->opts, vals + i),
+		for (size_t i = 0; i < n; i++) dhcp_free(dps[i]));
+
+	dhcpopt82_cache_free(cache);
+	free(vals);
+	free(dps);
+	free(pkts);
+}
+
+/* Карта из n случайных сегментов длиной до 256 адресов в пределах 10.0.0.0/8 */
+static
+struct rbtree *
+mkipmap(size_t n)
+{
+	struct rbtree *map = ipmap_create();
+	for (size_t i = 0; i < n; i++) {
+		uint32_t a = 0x0a000000 | (rnd32() & 0xffffff);
+		ipmap_map(map, a, a + (rnd32() & 0xff));
+	}
+	return map;
+}
+
+static
+void
+bench_ipmap(size_t n)
+{
+	struct rbtree *m, *m1, *m2, *r;
+	uint32_t *ips;
+	char dataset[32];
+	volatile int hits = 0;
+
+	snprintf(dataset, sizeof dataset, "ipmap-%zu", n);
+	ips = MALLOC(n * sizeof ips[0]);
+	for (size_t i = 0; i < n; i++)
+		ips[i] = 0x0a000000 | (rnd32() & 0xffffff);
+
+	BENCH("ipmap_map", dataset, n, n, m = ipmap_create(),
+		for (size_t i = 0; i < n; i++) ipmap_map(m, ips[i], ips[i] + (ips[i] & 0xff)),
+		ipmap_destroy(m));
+
+	m = mkipmap(n);
+	BENCH("ipmap_isset", dataset, n, n, ,
+		for (size_t i = 0; i < n; i++) hits += ipmap_isset(m, ips[i]), );
+	do {
+		struct ipmap_frozen *f = ipmap_freeze(m);
+
+		BENCH("ipmap_frozen_isset", dataset, n, n, ,
+			for (size_t i = 0; i < n; i++) hits += ipmap_frozen_isset(f, ips[i]), );
+		ipmap_frozen_free(f);
+	} while (0);
+	ipmap_destroy(m);
+
+	m1 = mkipmap(n);
+	m2 = mkipmap(n);
+	BENCH("ipmap_union", dataset, n, 1, , r = ipmap_union(m1, m2), ipmap_destroy(r));
+	BENCH("ipmap_cross", dataset, n, 1, , r = ipmap_cross(m1, m2), ipmap_destroy(r));
+	BENCH("ipmap_subtr", dataset, n, 1, , r = ipmap_subtr(m1, m2), ipmap_destroy(r));
+	ipmap_destroy(m2);
+	ipmap_destroy(m1);
+
+	free(ips);
+}
+
+/* Множество из n MAC; проверяются n MAC, половина из них - в множестве */
+static
+void
+bench_watch(size_t n)
+{
+	struct watchset *ws;
+	struct watchkey *keys;
+	char dataset[32];
+	volatile int hits = 0;
+
+	snprintf(dataset, sizeof dataset, "watch-%zu", n);
+	keys = MALLOC(2 * n * sizeof keys[0]);
+	for (size_t i = 0; i < 2 * n; i++) {
+		uint8_t mac[6];
+		uint32_t r = rnd32();
+
+		mac[0] = 0, mac[1] = 0x16;
+		memcpy(mac + 2, &r, 4);
+		keys[i] = watchkey_mac(mac);
+	}
+
+	BENCH("watchset_add", dataset, n, n, ws = watchset_create(0),
+		for (size_t i = 0; i < n; i++) watchset_add(ws, keys[i]),
+		watchset_free(ws));
+
+	ws = watchset_create(n);
+	for (size_t i = 0; i < n; i++)
+		watchset_add(ws, keys[i]);
+	BENCH("watchset_has", dataset, n, n, ,
+		for (size_t i = 0; i < n; i++) hits += watchset_has(ws, keys[2 * i]), );
+	watchset_free(ws);
+
+	free(keys);
+}
+
+/* Прореживание вывода всеми способами: n разных chaddr, пакеты через 1 мкс,
+ * то есть шторм в миллион пакетов в секунду; каждый следующий проход -
+ * повторы предыдущего.
+ */
+static
+void
+bench_sample(size_t n)
+{
+	struct sampler *s;
+	struct dhcphdr *pkts;
+	char dataset[32];
+	volatile int shown = 0;
+	uint64_t t = 0;
+
+	snprintf(dataset, sizeof dataset, "sample-%zu", n);
+	pkts = MALLOC(n * sizeof pkts[0]);
+	memset(pkts, 0, n * sizeof pkts[0]);
+	for (size_t i = 0; i < n; i++) {
+		uint32_t r = rnd32();
+
+		pkts[i].op = BOOTREQUEST;
+		pkts[i].xid = r;
+		pkts[i].chaddr[1] = 0x16;
+		memcpy(pkts[i].chaddr + 2, &r, 4);
+	}
+	s = sampler_create(stdout);
+	sampler_dedup(s, "2");
+	sampler_every(s, "10");
+	sampler_rate(s, "1000");
+	sampler_client(s, "5/10");
+	sampler_interval(s, "0");
+	BENCH("sampler_pass", dataset, n, n, ,
+		for (size_t i = 0; i < n; i++) shown += sampler_pass(s, t += 1000, pkts + i, sizeof pkts[0]) == SAMPLE_PASS, );
+	sampler_free(s);
+	free(pkts);
+}
+
+/* Top-N при шторме: половина пакетов - от 16 клиентов, остальные - от n
+ * разных; слияние - двух таблиц по n пакетов
+ */
+static
+void
+bench_topn(size_t n)
+{
+	struct topn_sketch *s, *s2;
+	uint64_t *keys;
+	char dataset[32];
+
+	snprintf(dataset, sizeof dataset, "topn-%zu", n);
+	keys = MALLOC(n * sizeof keys[0]);
+	for (size_t i = 0; i < n; i++)
+		keys[i] = 0x001600000000ULL | (i & 1 ? rnd32() % 16 : rnd32());
+	/* таблица своя на размер и очищается перед каждым проходом */
+	s = topn_sketch_create(TOPN_SLOTS(10));
+	BENCH("topn_sketch_add", dataset, n, n, topn_sketch_clear(s),
+		for (size_t i = 0; i < n; i++) topn_sketch_add(s, keys[i]), );
+
+	s2 = topn_sketch_create(TOPN_SLOTS(10));
+	for (size_t i = 0; i < n; i++)
+		topn_sketch_add(s2, keys[n - 1 - i]);
+	BENCH("topn_sketch_merge", dataset, n, 1, topn_sketch_clear(s);
+			for (size_t i = 0; i < n; i++) topn_sketch_add(s, keys[i]),
+		topn_sketch_merge(s, s2), );
+	topn_sketch_free(s2);
+	topn_sketch_free(s);
+	free(keys);
+}
+
+/* Окно HyperLogLog из отрезков: слияние регистров отрезка (2^p байт) и оценка */
+static
+void
+bench_hll(int p)
+{
+	size_t m = (size_t)1 << p;
+	uint8_t *a, *b;
+	char dataset[32];
+	volatile double est = 0.;
+
+	snprintf(dataset, sizeof dataset, "hll-p%d", p);
+	a = MALLOC(m);
+	b = MALLOC(m);
+	for (size_t i = 0; i < m; i++) {
+		a[i] = rnd32() % 8;
+		b[i] = rnd32() % 8;
+	}
+	BENCH("hll_merge", dataset, m, 1, , hll_merge(a, b, m), );
+	BENCH("hll_estimate", dataset, m, 1, , est += hll_estimate(a, p), );
+	free(a);
+	free(b);
+}
+
+/* Фильтр целиком: с декодированием пакета и опцией 82, если фильтр до них
+ * доходит. Условия записаны от дорогих к дешёвым: порядок - дело компилятора.
+ */
+static
+void
+bench_filter(size_t n)
+{
+	static const struct {
+		const char *name, *text;
+	} exprs[] = {
+		{ "filter_header", "chaddr = 00:16:01:02:03:04" },
+		{ "filter_mixed", "relay.vlan = 100 and msgtype = discover and giaddr = 10.0.5.1" },
+		{ "filter_or", "relay.port = 7 or option 60 or vlans > 0" },
+	};
+	static struct dhcpoptset demand[1] = { DHCPOPTSET_INITIALIZER };
+	struct dhcpopt82_cache *cache;
+	struct pkt *pkts;
+	char dataset[32];
+	volatile int hits = 0;
+
+	cache = dhcpopt82_cache_create(DHCPOPT82_CACHE_SIZE);
+	snprintf(dataset, sizeof dataset, "dhcp-%zu", n);
+	pkts = mkpkts(n);
+	for (size_t e = 0; e < sizeof exprs/sizeof exprs[0]; e++) {
+		struct filter *f = filter_compile(exprs[e].text);
+
+		BENCH(exprs[e].name, dataset, n, n, ,
+			for (size_t i = 0; i < n; i++) {
+				struct filterctx ctx;
+
+				filterctx_init(&ctx, (struct dhcphdr *)pkts[i].data, (struct in_addr){ 0 }, NULL, 0,
+					pkts[i].data, pkts[i].data + pkts[i].len, demand, cache);
+				hits += filter_match(f, &ctx);
+				dhcp_free(ctx.dp);
+			}, );
+		filter_free(f);
+	}
+	dhcpopt82_cache_free(cache);
+	free(pkts);
+}
+
+static
+void __attribute__((__noreturn__))
+usage()
+{
+	printf("Usage: dhcpbench [-t mintime_ms]\n");
+	exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const size_t dhcp_sizes[] = { 1024, 16384, 131072 };
+	static const size_t ipmap_sizes[] = { 64, 1024, 16384, 131072 };
+	static const size_t watch_sizes[] = { 1024, 65536 };
+	static struct ectlfr fr[1];
+	static struct ectlno ex[1];
+	FILE *devnull;
+
+	openlog("dhcpbench", LOG_PID|LOG_PERROR|LOG_NDELAY, LOG_USER);
+	ectlfr_begin(fr, L_0);
+	ectlno_begin(ex);
+
+	for (int c; (c = getopt(argc, argv, "t:")) != -1; ) {
+		switch (c) {
+		case 't':
+			mintime_ns = strtoull(optarg, NULL, 0) * 1000000;
+			break;
+		case '?':
+		default:
+			usage();
+		}
+	}
+
+	if ((devnull = fopen("/dev/null", "w")) == NULL) {
+		ectlno_setposixerror(errno);
+		ectlno_printf("%s(),%d: fopen(\"/dev/null\"): %s\n", __func__, __LINE__, strerror(errno));
+		ectlfr_goto(fr);
+	}
+
+	printf("{\"timestamp\": %ld, \"mintime_ms\": %" PRIu64 ", \"results\": [",
+		(long)time(NULL), mintime_ns / 1000000);
+	for (size_t i = 0; i < sizeof dhcp_sizes/sizeof dhcp_sizes[0]; i++)
+		bench_dhcp(dhcp_sizes[i], devnull);
+	for (size_t i = 0; i < sizeof ipmap_sizes/sizeof ipmap_sizes[0]; i++)
+		bench_ipmap(ipmap_sizes[i]);
+	for (size_t i = 0; i < sizeof dhcp_sizes/sizeof dhcp_sizes[0]; i++)
+		bench_filter(dhcp_sizes[i]);
+	for (size_t i = 0; i < sizeof watch_sizes/sizeof watch_sizes[0]; i++)
+		bench_watch(watch_sizes[i]);
+	for (size_t i = 0; i < sizeof watch_sizes/sizeof watch_sizes[0]; i++)
+		bench_sample(watch_sizes[i]);
+	for (size_t i = 0; i < sizeof watch_sizes/sizeof watch_sizes[0]; i++)
+		bench_topn(watch_sizes[i]);
+	bench_hll(HLL_P_GROUP);
+	bench_hll(HLL_P_ALL);
+	printf("\n]}\n");
+
+	fclose(devnull);
+	ectlno_end(ex);
+	ectlfr_end(fr);
+	return EXIT_SUCCESS;
+
+L_0:	ectlno_log();
+	ectlno_clearmessage();
+	ectlno_end(ex);
+	ectlfr_end(fr);
+	return EXIT_FAILURE;
+}
@@ -2,6 +2,8 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
 #include <net/ethernet.h>
 #include <netinet/in_systm.h>
 #include <netinet/in.h>
@@ -18,10 +20,28 @@
 #include <pcap.h>
 #include <err.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
 #include <syslog.h>
+#include <signal.h>
 
 #include "foo.h"
 #include "dhcp.h"
+#include "opt82.h"
+#include "watch.h"
+#include "filter.h"
+#include "sample.h"
+#include "hexdump.h"
+#include "outq.h"
+#include "evlog.h"
+#include "evstore.h"
+#include "pcapidx.h"
+#include "zout.h"
+#include "topn.h"
+#include "hll.h"
+#include "hist.h"
+#include "stagetime.h"
+#include "usdt.h"
 
 #ifdef linux
 #include <time.h>
@@ -44,27 +64,434 @@ DEFN_ERROR(E_PCAPLOOP, "pcap loop error occured.")
 char	errbuf[PCAP_ERRBUF_SIZE];
 
 static void pcap_callback(u_char *user, const struct pcap_pkthdr *h, const u_char *sp);
+struct outrec;
+static void outrec_show(void *arg);
+static void outrec_release(void *arg);
+static void outrec_summary(struct outrec *r, struct dhcp *dp);
 
-static void dumphexascii(const u_char *data, int len, int indent);
-static void dumphex(const u_char *data, int len, int indent);
 
 static
 void __attribute__((__noreturn__))
 usage() 
 {
-	printf("Usage: $0 -x {-i <interface>|-r <pcapfile>} [-t vllst] [-c chaddr] [-s swmac] [-U remote-id-user-string] [-p cport] [-v cvlan]\n");
+	printf("Usage: $0 -x -S -P -d {-i <interface>|-r <pcapfile>} [-F opt82-formats] [-t vllst] [-e expression] [-c chaddr] [-C chaddr-file] [-s swmac] [-U remote-id-user-string] [-p cport] [-v cvlan] [-R relay-file]\n"
+	       "\t[--ciaddr-in ranges|file] [--yiaddr-in ranges|file] [--giaddr-in ranges|file] [--src-in ranges|file]\n"
+	       "\t[--hex-dhcp] [--dedup sec] [--sample N] [--rate N[/sec]] [--client-rate N[/sec]] [--sample-report sec]\n"
+	       "\t[--top N[/sec]] [--distinct sec]\n"
+	       "\t[--async block|drop-newest|drop-verbose] [--write-log file] [--store dir] [--xid xid] [--since time] [--until time]\n"
+	       "\t[--output file] [--compress level] [--threads N]\n"
+	       "   or: $0 --index pcapfile\n"
+	       "   or: $0 --read-log file [--json] [--since time] [--until time] [-S] [-x] [--output file] [--compress level]\n"
+	       "   or: $0 query [--mac chaddr] [--ip addr] [--xid xid] [--circuit swmac[/module]/port] [--remote-id string]\n"
+	       "\t[--since time] [--until time] [--threads N] [--json] [-S] [-x] [--output file] [--compress level] dir\n");
 	exit(0);
 }
 
-static int f_hexdump = 0;
+#define HEXDUMP_FRAME	1
+#define HEXDUMP_DHCP	2
+static int f_hexdump = 0;	/* -x: дамп кадра, --hex-dhcp: только пакета DHCP */
+static int f_summary = 0;	/* одна строка на пакет вместо dhcp_show() */
+static int f_perfstat = 0;	/* -P: статистика производительности в stderr по завершении */
+static int f_dumpfilter = 0;	/* -d: напечатать программу фильтра и выйти */
+static struct dhcpoptset decode_demand[1] = { DHCPOPTSET_INITIALIZER };
 static char *iface = NULL;
 static char *ifile_name = NULL;
+static char *opt82_fname = NULL;	/* -F: форматы опции 82 вместо встроенных (см. opt82.h) */
+static struct dhcpopt82_cache *opt82_cache = NULL;
+static char *chaddr_fname = NULL, *ra_fname = NULL;
+static char *filter_text = NULL;	/* -e: выражение фильтра (см. filter.h) */
+/* --ciaddr-in, --yiaddr-in, --giaddr-in, --src-in: аргумент с цифры - сегменты
+ * через запятую (10.20.0.0/14,10.30.0.1-10.30.0.9), иначе файл сегментов.
+ * Повторы одной опции объединяются.
+ */
+enum { OPT_CIADDR_IN = 256, OPT_YIADDR_IN, OPT_GIADDR_IN, OPT_SRC_IN,
+	OPT_HEX_DHCP, OPT_DEDUP, OPT_SAMPLE, OPT_RATE, OPT_CLIENT_RATE, OPT_SAMPLE_REPORT, OPT_ASYNC,
+	OPT_WRITE_LOG, OPT_READ_LOG, OPT_JSON, OPT_SINCE, OPT_UNTIL,
+	OPT_STORE, OPT_MAC, OPT_IP, OPT_XID, OPT_CIRCUIT, OPT_REMOTE_ID, OPT_THREADS, OPT_INDEX,
+	OPT_OUTPUT, OPT_COMPRESS, OPT_TOP, OPT_DISTINCT };
+static const char *const ipin_fields[] = { "ciaddr", "yiaddr", "giaddr", "src" };
+static struct {
+	int		field;
+	const char	*arg;
+} ipin[32];
+static int nipin = 0;
+static char *flt_text = NULL;		/* собранное выражение, до компиляции */
+static struct filter *flt = NULL;
+static struct sampler *smp = NULL;	/* --dedup, --sample, --rate, --client-rate (см. sample.h) */
+static struct topn *top = NULL;		/* --top: самые активные клиенты, порты, relay, серверы (см. topn.h) */
+static struct hll *hll = NULL;		/* --distinct: число разных chaddr по vlan, relay, коммутаторам (см. hll.h) */
+static int f_async = 0, async_policy;	/* --async: печать в отдельном потоке (см. outq.h) */
+static struct outq *oq = NULL;
+/* --write-log: журнал событий вместо текста; --read-log: печать журнала текстом
+ * или JSON (--json), --since/--until - окно времени по меткам пакетов, и для
+ * журнала, и для захвата (см. evlog.h)
+ */
+static char *wlog_name = NULL, *rlog_name = NULL;
+static struct evlog *wlog = NULL;
+static int f_json = 0;
+static uint64_t log_since = 0, log_until = 0;
+/* --store: журналы по часам с индексами; dhcpdump query ищет в них по ключам
+ * --mac, --ip, --xid, --circuit, --remote-id (см. evstore.h)
+ */
+static char *store_name = NULL;
+static struct evstore *store = NULL;
+static int f_query = 0;
+static struct evstore_key qkeys[16];
+static int nqkeys = 0;
+/* --index: индекс pcap рядом с файлом; -r с -c, --xid, --since/--until читает
+ * по нему только нужные записи (см. pcapidx.h)
+ */
+static char *index_name = NULL;
+static struct pcapidx *px = NULL;
+static int defined_xid = 0;
+static uint32_t xid_value;
+/* --output: вывод в файл вместо stdout; --compress: gzip блоками, которые
+ * сжимают отдельные потоки (см. zout.h). --threads - потоки поиска и сжатия.
+ */
+static char *out_name = NULL;
+static int out_level = 0;
+static int nthreads = 0;
+static FILE *out;
+static struct zout *zo = NULL;
 static int defined_chaddr = 0, defined_ra_etheraddr = 0, defined_ra_cvlan = 0, defined_ra_cport = 0, defined_ra_ru = 0;
 static struct ether_addr chaddr, ra_etheraddr;
 static uint16_t ra_cvlan, ra_cport;
 static char *ra_ru;
 static int vltags[8], nvltags = 0;
 
+/* Запись вывода: всё, что печатается о пакете, без ссылок на буфер pcap - после
+ * pcap_callback() он уже не наш. Синхронный вывод печатает запись сразу, --async
+ * кладёт её в кольцо потоку вывода, и тогда кадр копируется в buf (захват в 1500
+ * байт помещается, длиннее - в кучу), а отложенные опции dp переводятся на
+ * копию. Краткая запись dp не держит.
+ */
+#define OUTREC_FRAME	1536
+struct outrec {
+	struct timeval		tv;
+	struct ether_addr	smac, dmac;
+	int			tags[8], ntags;
+	struct in_addr		sip, dip;
+	uint16_t		sport, dport;
+	int			verbose;	/* 0 - одна строка: -S или разжалована */
+	const char		*msgtype;	/* для одной строки; NULL - неизвестен */
+	uint32_t		xid;
+	struct ether_addr	chaddr;
+	struct dhcp		*dp;		/* для подробной */
+	int			has_optval;
+	struct dhcpopt82_value	optval;
+	const uint8_t		*hex;		/* -x, --hex-dhcp; NULL - дампа нет */
+	size_t			hexlen;
+	uint8_t			*frame;		/* копия кадра в куче или NULL */
+	uint8_t			buf[OUTREC_FRAME];
+};
+
+/* Статистика производительности (-P): время обработки каждого пакета */
+static uint64_t perf_start;
+static struct hist perf_hist[1];
+
+static inline
+uint64_t
+perf_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static
+void
+perf_report(FILE *fp, uint64_t ns)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	fprintf(fp, "perf: packets %" PRIu64 " seconds %.3f pps %.0f p50_ns %" PRIu64 " p99_ns %" PRIu64 
+			" maxrss_kb %ld opt82_hits %" PRIu64 " opt82_misses %" PRIu64 "\n",
+		perf_hist->n, ns / 1e9, ns ? perf_hist->n * 1e9 / ns : 0., 
+		hist_percentile(perf_hist, 0.50), hist_percentile(perf_hist, 0.99), (long)ru.ru_maxrss,
+		opt82_cache->hits, opt82_cache->misses);
+}
+
+/* строка в кавычках для выражения фильтра */
+static
+void
+filter_quote(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fputc('\\', fp);
+		fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+/* Выражение фильтра из -e и старых опций: -c/-C - любое из chaddr, -s/-p/-v/-U -
+ * все заданные поля relay, -R - или relay из списка. Части соединяются через and.
+ */
+static
+char *
+filter_build()
+{
+	char *text = NULL;
+	size_t size;
+	FILE *fp;
+	const char *and = "";
+
+	if (!(fp = open_memstream(&text, &size)))
+		ECTL_PTRAP(errno, "open_memstream(): %s.\n", strerror(errno));
+	if (defined_chaddr || chaddr_fname) {
+		fprintf(fp, "(");
+		if (defined_chaddr)
+			fprintf(fp, "chaddr = %s%s", ether_ntoa(&chaddr), chaddr_fname ? " or " : "");
+		if (chaddr_fname) {
+			fprintf(fp, "chaddr in @");
+			filter_quote(fp, chaddr_fname);
+		}
+		fprintf(fp, ")");
+		and = " and ";
+	}
+	if (defined_ra_etheraddr || defined_ra_cport || defined_ra_cvlan || defined_ra_ru || ra_fname) {
+		const char *sep = "";
+
+		fprintf(fp, "%s((", and);
+		if (defined_ra_etheraddr) {
+			fprintf(fp, "relay.mac = %s", ether_ntoa(&ra_etheraddr));
+			sep = " and ";
+		}
+		if (defined_ra_ru) {
+			fprintf(fp, "%srelay.str = ", sep);
+			filter_quote(fp, ra_ru);
+			sep = " and ";
+		}
+		if (defined_ra_cport) {
+			fprintf(fp, "%srelay.port = %" PRIu16, sep, ra_cport);
+			sep = " and ";
+		}
+		if (defined_ra_cvlan) {
+			fprintf(fp, "%srelay.vlan = %" PRIu16, sep, ra_cvlan);
+			sep = " and ";
+		}
+		if (ra_fname) {
+			fprintf(fp, "%srelay in @", *sep ? ") or (" : "");
+			filter_quote(fp, ra_fname);
+		}
+		fprintf(fp, "))");
+		and = " and ";
+	}
+	for (int f = 0; f < (int)(sizeof ipin_fields/sizeof ipin_fields[0]); f++) {
+		const char *sep = "";
+
+		for (int i = 0; i < nipin; i++) {
+			if (ipin[i].field != f)
+				continue;
+			if (!*sep)
+				fprintf(fp, "%s%s in ", and, ipin_fields[f]);
+			fprintf(fp, "%s", sep);
+			if (isdigit((unsigned char)ipin[i].arg[0]))
+				fprintf(fp, "%s", ipin[i].arg);
+			else {
+				fprintf(fp, "@");
+				filter_quote(fp, ipin[i].arg);
+			}
+			sep = ", ";
+			and = " and ";
+		}
+	}
+	if (defined_xid) {
+		fprintf(fp, "%sxid = %" PRIu32, and, xid_value);
+		and = " and ";
+	}
+	if (filter_text && *filter_text)
+		fprintf(fp, *and ? "%s(%s)" : "%s%s", and, filter_text);
+	fclose(fp);
+	return text;
+}
+
+/* --since, --until: "20240131 12:00:00" (местное время, как в выводе) или
+ * секунды от эпохи; результат - мкс
+ */
+static
+uint64_t
+log_time(const char *arg)
+{
+	struct tm tm;
+	char *end;
+	time_t t;
+
+	memset(&tm, 0, sizeof tm);
+	tm.tm_isdst = -1;
+	if ((end = strptime(arg, "%Y%m%d %H:%M:%S", &tm)) && !*end)
+		t = mktime(&tm);
+	else {
+		errno = 0;
+		t = strtoll(arg, &end, 10);
+		if (errno || end == arg || *end)
+			ECTL_PTRAP(EINVAL, "\"%s\": expected \"YYYYmmdd HH:MM:SS\" or seconds since epoch.\n", arg);
+	}
+	return (uint64_t)t * 1000000;
+}
+
+static
+void
+out_open(void)
+{
+	struct ectlfr fr[1];
+	volatile int fd = STDOUT_FILENO;
+
+	if (!out_level) {
+		if (out_name && !(out = fopen(out_name, "w")))
+			ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", out_name, strerror(errno));
+		return;
+	}
+	ectlfr_begin(fr, L_0);
+	if (out_name && (fd = open(out_name, O_WRONLY|O_CREAT|O_TRUNC, 0666)) == -1)
+		ECTL_PTRAP(errno, "open(\"%s\"): %s.\n", out_name, strerror(errno));
+	ectlfr_ontrap(fr, L_1);
+	zo = zout_create(fd, !!out_name, out_level, nthreads);
+	out = zout_file(zo);
+	ectlfr_end(fr);
+	return;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	if (out_name)
+		close(fd);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+/* вывод дописан: ошибка записи в файл - ловушка */
+static
+void
+out_close(void)
+{
+	FILE *fp = out;
+
+	if (zo) {
+		zout_close(zo);
+		return;
+	}
+	if (fp == stdout)
+		return;
+	out = stdout;
+	if (fclose(fp) == EOF)
+		ECTL_PTRAP(errno, "fclose(\"%s\"): %s.\n", out_name, strerror(errno));
+}
+
+/* без ловушек; после out_close() и без неё */
+static
+void
+out_free(void)
+{
+	if (zo) {
+		zout_free(zo);
+		zo = NULL;
+	} else if (out != stdout)
+		fclose(out);
+	out = stdout;
+}
+
+/* Запись журнала событий тем же текстом, что при захвате (время - метка pcap,
+ * -x - дамп пакета DHCP: кадра в журнале нет), или JSON. Фильтры и
+ * прореживание работали при записи журнала.
+ */
+static
+void
+log_show(const struct evrec *e, void *arg __unused)
+{
+	struct ectlfr fr[1];
+	struct outrec r[1];
+	const uint8_t *cp = (const uint8_t *)e->dh;
+
+	if (f_json) {
+		evlog_json(out, e);
+		return;
+	}
+	ectlfr_begin(fr, L_0);
+	r->dp = NULL;
+	r->tv.tv_sec = e->time / 1000000;
+	r->tv.tv_usec = e->time % 1000000;
+	r->smac = e->smac;
+	r->dmac = e->dmac;
+	r->ntags = e->ntags;
+	memcpy(r->tags, e->tags, sizeof r->tags);
+	r->sip = e->sip;
+	r->dip = e->dip;
+	r->sport = e->sport;
+	r->dport = e->dport;
+	r->verbose = !f_summary;
+	r->dp = dhcp_decode(&cp, e->opts + e->optlen, decode_demand);
+	ectlfr_ontrap(fr, L_1);
+	if (!r->verbose)
+		outrec_summary(r, r->dp);
+	if ((r->has_optval = e->optval != NULL))
+		r->optval = *e->optval;
+	r->hex = NULL;
+	if (f_hexdump) {
+		r->hex = (const uint8_t *)e->dh;
+		r->hexlen = e->opts + e->optlen - r->hex;
+	}
+	outrec_show(r);
+	dhcp_free(r->dp);
+	ectlfr_end(fr);
+	return;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	dhcp_free(r->dp);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+/* --read-log */
+static
+void
+log_render(const char *path)
+{
+	struct ectlfr fr[1];
+	struct evlog *volatile evl;
+	struct evrec e[1];
+
+	ectlfr_begin(fr, L_0);
+	evl = evlog_open(path);
+	ectlfr_ontrap(fr, L_1);
+	evlog_range(evl, log_since, log_until);
+	while (evlog_read(evl, e))
+		log_show(e, NULL);
+	evlog_free(evl);
+	ectlfr_end(fr);
+	return;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	evlog_free(evl);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+/* опция поиска -> вид ключа хранилища */
+static
+int
+query_kind(int opt)
+{
+	switch (opt) {
+	case OPT_MAC:		return EVSTORE_MAC;
+	case OPT_IP:		return EVSTORE_IP;
+	case OPT_XID:		return EVSTORE_XID;
+	case OPT_CIRCUIT:	return EVSTORE_CIRCUIT;
+	case OPT_REMOTE_ID:	return EVSTORE_REMOTE;
+	}
+	return -1;
+}
+
+static
+void
+perf_callback(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	uint64_t t = perf_now();
+
+	pcap_callback(user, h, sp);
+	hist_add(perf_hist, perf_now() - t);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -76,9 +503,138 @@ main(int argc, char *argv[])
 	openlog("dhcpdump", LOG_PID|LOG_PERROR|LOG_NDELAY, LOG_USER);
 	ectlfr_begin(fr, L_0);
 	ectlno_begin(ex);
+	out = stdout;
 
-	for (int c; (c = getopt(argc, argv, "c:i:p:r:s:t:U:v:x")) != -1; ) {
+	static const struct option longopts[] = {
+		{ "ciaddr-in",	required_argument,	NULL,	OPT_CIADDR_IN },
+		{ "yiaddr-in",	required_argument,	NULL,	OPT_YIADDR_IN },
+		{ "giaddr-in",	required_argument,	NULL,	OPT_GIADDR_IN },
+		{ "src-in",	required_argument,	NULL,	OPT_SRC_IN },
+		{ "hex-dhcp",	no_argument,		NULL,	OPT_HEX_DHCP },
+		{ "dedup",	required_argument,	NULL,	OPT_DEDUP },
+		{ "sample",	required_argument,	NULL,	OPT_SAMPLE },
+		{ "rate",	required_argument,	NULL,	OPT_RATE },
+		{ "client-rate", required_argument,	NULL,	OPT_CLIENT_RATE },
+		{ "sample-report", required_argument,	NULL,	OPT_SAMPLE_REPORT },
+		{ "async",	required_argument,	NULL,	OPT_ASYNC },
+		{ "write-log",	required_argument,	NULL,	OPT_WRITE_LOG },
+		{ "read-log",	required_argument,	NULL,	OPT_READ_LOG },
+		{ "json",	no_argument,		NULL,	OPT_JSON },
+		{ "since",	required_argument,	NULL,	OPT_SINCE },
+		{ "until",	required_argument,	NULL,	OPT_UNTIL },
+		{ "store",	required_argument,	NULL,	OPT_STORE },
+		{ "mac",	required_argument,	NULL,	OPT_MAC },
+		{ "ip",		required_argument,	NULL,	OPT_IP },
+		{ "xid",	required_argument,	NULL,	OPT_XID },
+		{ "circuit",	required_argument,	NULL,	OPT_CIRCUIT },
+		{ "remote-id",	required_argument,	NULL,	OPT_REMOTE_ID },
+		{ "threads",	required_argument,	NULL,	OPT_THREADS },
+		{ "index",	required_argument,	NULL,	OPT_INDEX },
+		{ "output",	required_argument,	NULL,	OPT_OUTPUT },
+		{ "compress",	required_argument,	NULL,	OPT_COMPRESS },
+		{ "top",	required_argument,	NULL,	OPT_TOP },
+		{ "distinct",	required_argument,	NULL,	OPT_DISTINCT },
+		{ NULL,		0,			NULL,	0 }
+	};
+	/* dhcpdump query: дальше - опции поиска и каталог хранилища */
+	if (argc > 1 && !strcmp(argv[1], "query")) {
+		f_query = 1;
+		argv[1] = argv[0];
+		argc--;
+		argv++;
+	}
+	for (int c; (c = getopt_long(argc, argv, "C:c:de:F:i:Pp:R:r:Ss:t:U:v:x", longopts, NULL)) != -1; ) {
 		switch (c) {
+		case OPT_CIADDR_IN:
+		case OPT_YIADDR_IN:
+		case OPT_GIADDR_IN:
+		case OPT_SRC_IN:
+			if (nipin == sizeof ipin/sizeof ipin[0]) {
+				ectlno_setposixerror(EINVAL);
+				ectlno_printf("%s(),%d: too many --*-in options.\n", __func__, __LINE__);
+				ectlfr_goto(fr);
+			}
+			ipin[nipin].field = c - OPT_CIADDR_IN;
+			ipin[nipin].arg = optarg;
+			nipin++;
+			break;
+		case OPT_DEDUP:
+		case OPT_SAMPLE:
+		case OPT_RATE:
+		case OPT_CLIENT_RATE:
+		case OPT_SAMPLE_REPORT:
+			if (!smp)
+				smp = sampler_create(stderr);
+			if (c == OPT_DEDUP)
+				sampler_dedup(smp, optarg);
+			else if (c == OPT_SAMPLE)
+				sampler_every(smp, optarg);
+			else if (c == OPT_RATE)
+				sampler_rate(smp, optarg);
+			else if (c == OPT_CLIENT_RATE)
+				sampler_client(smp, optarg);
+			else
+				sampler_interval(smp, optarg);
+			break;
+		case OPT_ASYNC:
+			async_policy = outq_policy(optarg);
+			f_async = 1;
+			break;
+		case OPT_WRITE_LOG:
+			wlog_name = optarg;
+			break;
+		case OPT_READ_LOG:
+			rlog_name = optarg;
+			break;
+		case OPT_JSON:
+			f_json = 1;
+			break;
+		case OPT_SINCE:
+			log_since = log_time(optarg);
+			break;
+		case OPT_UNTIL:
+			log_until = log_time(optarg);
+			break;
+		case OPT_STORE:
+			store_name = optarg;
+			break;
+		case OPT_MAC:
+		case OPT_IP:
+		case OPT_XID:
+		case OPT_CIRCUIT:
+		case OPT_REMOTE_ID:
+			/* что это - ключ поиска или фильтр (--xid), решается после разбора */
+			if (nqkeys == sizeof qkeys/sizeof qkeys[0]) {
+				ectlno_setposixerror(EINVAL);
+				ectlno_printf("%s(),%d: too many query keys.\n", __func__, __LINE__);
+				ectlfr_goto(fr);
+			}
+			evstore_key_parse(qkeys + nqkeys++, query_kind(c), optarg);
+			break;
+		case OPT_THREADS:
+			if ((nthreads = atoi(optarg)) < 1)
+				usage();
+			break;
+		case OPT_OUTPUT:
+			out_name = optarg;
+			break;
+		case OPT_TOP:
+			topn_free(top);
+			top = NULL;
+			top = topn_create(stderr, optarg);
+			break;
+		case OPT_DISTINCT:
+			hll_free(hll);
+			hll = NULL;
+			hll = hll_create(stderr, optarg);
+			break;
+		case OPT_COMPRESS:
+			if ((out_level = atoi(optarg)) < 1 || out_level > 9)
+				usage();
+			break;
+		case OPT_INDEX:
+			index_name = optarg;
+			break;
 		case 'c': {
 				struct ether_addr *p;
 				if ((p = ether_aton(optarg)) == NULL)
@@ -87,6 +643,21 @@ main(int argc, char *argv[])
 				defined_chaddr = 1;
 			}
 			break;
+		case 'C':
+			chaddr_fname = optarg;
+			break;
+		case 'd':
+			f_dumpfilter = 1;
+			break;
+		case 'e':
+			filter_text = optarg;
+			break;
+		case 'F':
+			opt82_fname = optarg;
+			break;
+		case 'R':
+			ra_fname = optarg;
+			break;
 		case 'i':
 			if (ifile_name) {
 				ectlno_setposixerror(EINVAL);
@@ -118,6 +689,12 @@ main(int argc, char *argv[])
 			}
 			ifile_name = optarg;
 			break;
+		case 'P':
+			f_perfstat = 1;
+			break;
+		case 'S':
+			f_summary = 1;
+			break;
 		case 's': {
 				struct ether_addr *p;
 				if ((p = ether_aton(optarg)) == NULL) {
@@ -219,13 +796,73 @@ main(int argc, char *argv[])
 			defined_ra_ru = 1;
 			break;
 		case 'x':
-			f_hexdump = 1;
+			f_hexdump = HEXDUMP_FRAME;
+			break;
+		case OPT_HEX_DHCP:
+			f_hexdump = HEXDUMP_DHCP;
 			break;
 		case '?':
 		default:
 			usage();
 		}
 	}
+	/* без query --xid - фильтр пакетов (и ключ индекса -r), последний действует */
+	if (!f_query) {
+		int n = 0;
+
+		for (int i = 0; i < nqkeys; i++)
+			if (qkeys[i].kind == EVSTORE_XID) {
+				xid_value = qkeys[i].key;
+				defined_xid = 1;
+			} else
+				qkeys[n++] = qkeys[i];
+		nqkeys = n;
+	}
+	if (f_query ? optind != argc - 1 || !nqkeys : nqkeys != 0)
+		usage();
+	if (!nthreads)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	out_open();
+
+	/* Опции, которые читаются фильтрами и выводом для каждого пакета, декодируются
+	 * сразу. Остальные декодируются, только если пакет дошёл до dhcp_show().
+	 * Опция 82 тоже откладывается: dhcpopt82_lookup() находит её в кэше по сырым
+	 * байтам и декодирует только при промахе. Опции, которые фильтр сравнивает
+	 * побайтно, не декодируются до фильтра.
+	 */
+	if (f_summary)
+		dhcpoptset_add(decode_demand, DHCPOPT53_DHCP_MESSAGE_TYPE);
+
+	if (opt82_fname)
+		dhcpopt82_setformats(dhcpopt82_formats_load(opt82_fname));
+	opt82_cache = dhcpopt82_cache_create(DHCPOPT82_CACHE_SIZE);
+	flt_text = filter_build();
+	flt = filter_compile(flt_text);
+	free(flt_text);
+	flt_text = NULL;
+	for (size_t i = 0; i < sizeof decode_demand->bits/sizeof decode_demand->bits[0]; i++)
+		decode_demand->bits[i] &= ~flt->raw.bits[i];
+	if (f_dumpfilter || rlog_name || f_query || index_name) {
+		if (f_dumpfilter)
+			filter_dump(flt, out);
+		else if (index_name)
+			pcapidx_build(index_name, stderr);
+		else if (rlog_name)
+			log_render(rlog_name);
+		else
+			evstore_query(argv[optind], qkeys, nqkeys, log_since, log_until,
+				nthreads, log_show, NULL);
+		out_close();
+		out_free();
+		filter_free(flt);
+		dhcpopt82_cache_free(opt82_cache);
+		sampler_free(smp);
+		topn_free(top);
+		hll_free(hll);
+		ectlno_end(ex);
+		ectlfr_end(fr);
+		return EXIT_SUCCESS;
+	}
 
 #if 0
 	if (iface)
@@ -257,6 +894,9 @@ main(int argc, char *argv[])
 			ectlfr_goto(fr);
 		}
 		ectlfr_ontrap(fr, L_1);
+		/* -C и -c вместе - "или": по chaddr индекс тогда не сужает */
+		if ((defined_chaddr && !chaddr_fname) || defined_xid || log_since || log_until)
+			px = pcapidx_open(ifile_name);
 	} else {
 		ectlno_setposixerror(EINVAL);
 		ectlno_printf("%s(),%d: Option -i or -r is mandatory.\n", __func__, __LINE__);
@@ -277,7 +917,7 @@ main(int argc, char *argv[])
 			/* printf("[%s]\n", fltr); */
 		}
 		p += sprintf(p, FMT_FLTR_DHCP);
-		printf("pcap filter: %s\n", fltr);
+		fprintf(out, "pcap filter: %s\n", fltr);
 
 #if 0
 		printf("fltr: %p, fltr_end: %p, p: %p\n", fltr, fltr + sizeof fltr, p);
@@ -297,28 +937,224 @@ main(int argc, char *argv[])
 		}
 	} while (0);
 
-	if (pcap_loop(cap, -1, pcap_callback, (u_char *)cap) == -1) {
+#ifdef STAGETIME
+	stagetime_init(SIGUSR1);
+#endif
+	if (wlog_name)
+		wlog = evlog_create(wlog_name);
+	if (store_name)
+		store = evstore_create(store_name);
+	if (!wlog && !store && f_async)
+		oq = outq_create(OUTQ_NREC, sizeof(struct outrec), async_policy, out, outrec_show, outrec_release);
+	perf_start = perf_now();
+	if (px)
+		pcapidx_loop(px, defined_chaddr && !chaddr_fname ? &chaddr : NULL, defined_xid ? &xid_value : NULL,
+			log_since, log_until, &fp, f_perfstat ? perf_callback : pcap_callback, (u_char *)cap);
+	else if (pcap_loop(cap, -1, f_perfstat ? perf_callback : pcap_callback, (u_char *)cap) == -1) {
 		ectlno_seterror(E_PCAPLOOP);
 		ectlno_printf("%s(),%d: pcap_loop(%s): %s", __func__, __LINE__, iface, pcap_geterr(cap));
 		ectlfr_goto(fr);
 	}
 	if (ectlno_iserror())
 		ectlfr_goto(fr);
+	if (wlog)
+		evlog_finish(wlog);
+	if (store)
+		evstore_finish(store);
+	if (oq) {
+		outq_flush(oq);
+		if (outq_failed(oq)) {
+			ectlno_seterror(E_OUTQFAILED);
+			ectlno_printf("%s(),%d: output thread failed.\n", __func__, __LINE__);
+			ectlfr_goto(fr);
+		}
+	}
+	out_close();
+	if (f_perfstat) {
+		perf_report(stderr, perf_now() - perf_start);
+#ifdef STAGETIME
+		stagetime_dump(stderr);
+#endif
+	}
+	if (smp)
+		sampler_report(smp);
+	if (top)
+		topn_report(top);
+	if (hll)
+		hll_report(hll);
+	if (oq)
+		outq_report(oq, stderr);
+	if (zo && f_perfstat)
+		zout_report(zo, stderr);
 
 	pcap_close(cap);
+	pcapidx_free(px);
+	outq_free(oq);
+	out_free();
+	evlog_free(wlog);
+	evstore_free(store);
+	dhcpopt82_cache_free(opt82_cache);
+	filter_free(flt);
+	sampler_free(smp);
+	topn_free(top);
+	hll_free(hll);
 	ectlno_end(ex);
 	ectlfr_end(fr);
 	return EXIT_SUCCESS;
 
 L_1:	ectlfr_ontrap(fr, L_0);
+	outq_free(oq);
+	out_free();
+	/* записанное до ошибки остаётся в журнале */
+	if (wlog)
+		ECTL_CALL_NO_EXCEPTIONS(evlog_finish(wlog));
+	if (store)
+		ECTL_CALL_NO_EXCEPTIONS(evstore_finish(store));
+	evlog_free(wlog);
+	evstore_free(store);
+	pcapidx_free(px);
 	pcap_close(cap);
-L_0:	ectlno_log();
+L_0:	out_free();
+	dhcpopt82_cache_free(opt82_cache);
+	free(flt_text);
+	filter_free(flt);
+	sampler_free(smp);
+	topn_free(top);
+	hll_free(hll);
+	ectlno_log();
 	ectlno_clearmessage();
 	ectlno_end(ex);
 	ectlfr_end(fr);
 	return EXIT_FAILURE;
 }
 
+static
+const char *
+port_name(uint16_t port, char *buf, size_t size)
+{
+	if (port == IPPORT_BOOTPS)
+		return "bootps";
+	if (port == IPPORT_BOOTPC)
+		return "bootpc";
+	snprintf(buf, size, "%u", port);
+	return buf;
+}
+
+/* Печатает и синхронный вывод, и поток вывода --async: только *_r и inet_ntop() */
+static
+void
+outrec_show(void *arg)
+{
+	struct outrec *r = arg;
+	char timestamp[40];	// timestamp on header
+	char smac[20];		// mac address of origin
+	char dmac[20];		// mac address of destination
+	char sip[16];		// ip address of origin
+	char dip[16];		// ip address of destination
+	char sport[8], dport[8], ebuf[20];
+	struct tm tm;
+	size_t len;
+
+	len = strftime(timestamp, sizeof(timestamp), "%Y%m%d %H:%M:%S.", localtime_r(&r->tv.tv_sec, &tm));
+	snprintf(timestamp + len, sizeof(timestamp) - len, "%03ld", (long)r->tv.tv_usec / 1000);
+	ether_ntoa_r(&r->smac, smac);
+	ether_ntoa_r(&r->dmac, dmac);
+	inet_ntop(AF_INET, &r->sip, sip, sizeof sip);
+	inet_ntop(AF_INET, &r->dip, dip, sizeof dip);
+
+	fprintf(out, "%s %s > %s", timestamp, smac, dmac);
+	if (r->ntags) {
+		fprintf(out, " [%d", r->tags[0]);
+		for (int i = 1; i < r->ntags; i++) {
+			if (i == sizeof r->tags/sizeof r->tags[0]) {
+				fprintf(out, ".[...]");
+				break;
+			}
+			fprintf(out, ".%d", r->tags[i]);
+		}
+		fprintf(out, "]");
+	}
+	fprintf(out, " %s:%s > %s:%s", sip, port_name(r->sport, sport, sizeof sport),
+		dip, port_name(r->dport, dport, sizeof dport));
+	if (!r->verbose) {
+		fprintf(out, " %s xid 0x%08" PRIx32 " chaddr %s", r->msgtype ? r->msgtype : "???", r->xid,
+			ether_ntoa_r(&r->chaddr, ebuf));
+		if (r->has_optval) {
+			fprintf(out, " vlanid %" PRIu16 " module %" PRIu8 " port %" PRIu8, 
+				r->optval.vlanid, r->optval.module, r->optval.port);
+			if (r->optval.flags & DHCPOPT82_V_ETHER)
+				fprintf(out, " ether %s", ether_ntoa_r(&r->optval.ether, ebuf));
+			if (r->optval.flags & DHCPOPT82_V_STR)
+				fprintf(out, " remote-id \"%s\"", r->optval.str);
+		}
+		fprintf(out, "\n");
+		if (r->hex)
+			hexdump(out, r->hex, r->hexlen, 2);
+		USDT_PROBE(OUTPUT_FLUSH, 1);
+		return;
+	}
+	fprintf(out, "\n");
+	dhcp_show(r->dp, 2, out);
+	if (r->has_optval) {
+		fprintf(out, "\tvlanid: %" PRIu16 ", module: %" PRIu8 ", port: %" PRIu8, 
+			r->optval.vlanid, r->optval.module, r->optval.port);
+		if (r->optval.flags & DHCPOPT82_V_ETHER)
+			fprintf(out, ", ether: %s", ether_ntoa_r(&r->optval.ether, ebuf));
+		if (r->optval.flags & DHCPOPT82_V_STR)
+			fprintf(out, ", remote-id user: [%" PRIu8 "] \"%s\"", r->optval.slen, r->optval.str);
+		fprintf(out, "\n");
+	}
+	if (r->hex)
+		hexdump(out, r->hex, r->hexlen, 2);
+	fprintf(out, "\n");
+	USDT_PROBE(OUTPUT_FLUSH, 0);
+}
+
+static
+void
+outrec_release(void *arg)
+{
+	struct outrec *r = arg;
+
+	dhcp_free(r->dp);
+	free(r->frame);
+}
+
+/* поля одной строки: после них dp записи не нужен */
+static
+void
+outrec_summary(struct outrec *r, struct dhcp *dp)
+{
+	struct dhcpopt *opt53 = dhcpoptlst_find(dp->opts, DHCPOPT53_DHCP_MESSAGE_TYPE);
+
+	r->msgtype = NULL;
+	if (opt53 && dhcpopt_length(opt53))
+		r->msgtype = dhcpopt_enum(dhcpopt_descriptor(opt53), opt53->u8);
+	r->xid = dp->xid;
+	memcpy(&r->chaddr, dp->chaddr, sizeof r->chaddr);
+}
+
+/* Запись в кольце должна пережить буфер pcap: кадр копируется, и dp с дампом
+ * переводятся на копию. Краткой записи без дампа копия не нужна.
+ */
+static
+void
+outrec_own(struct outrec *r, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	uint8_t *copy = r->buf;
+
+	r->frame = NULL;
+	if (!r->verbose && !r->hex)
+		return;
+	if (h->caplen > sizeof r->buf)
+		copy = r->frame = MALLOC(h->caplen);
+	memcpy(copy, sp, h->caplen);
+	if (r->dp)
+		dhcp_rebase(r->dp, sp, copy);
+	if (r->hex)
+		r->hex = copy + (r->hex - sp);
+}
+
 static 
 void 
 pcap_callback(u_char *user, const struct pcap_pkthdr *h, const u_char *sp) 
@@ -334,22 +1170,29 @@ pcap_callback(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 	struct udphdr *udp;
 	struct dhcphdr *dh;
 	int dh_len;
-	uint16_t sport, dport;
-	struct servent *se;
-	char *sport_name, sport_namebuf[8], *dport_name, dport_namebuf[8];
-	char timestamp[40];	// timestamp on header
-	char smac[20];		// mac address of origin
-	char dmac[20];		// mac address of destination
-	char sip[16];		// ip address of origin
-	char dip[16];		// ip address of destination
-	u_char optnum, optlen;
-	const u_char *optdat, *optdat_end;
-	struct dhcp *volatile dp = NULL;
-	struct dhcpopt *opt82 = NULL;
-	struct dhcpopt82_value *volatile optval = NULL;
+	struct dhcp *dp;
+	const struct dhcpopt82_value *optval;
+	struct filterctx fctx[1];
+	struct outrec rec[1], *r;
+	int verbose;
+	STAGETIME_DECL;
 
 	ectlfr_begin(fr, L_0);
 	ectlno_begin(ex);
+	STAGETIME_START();
+	USDT_PROBE(PACKET_ARRIVE, h->caplen, h->len);
+
+	if (oq && outq_failed(oq)) {
+		ectlno_seterror(E_OUTQFAILED);
+		ectlno_printf("%s(),%d: output thread failed.\n", __func__, __LINE__);
+		ectlfr_goto(fr);
+	}
+	if (log_since || log_until) {
+		uint64_t t = (uint64_t)h->ts.tv_sec * 1000000 + h->ts.tv_usec;
+
+		if ((log_since && t < log_since) || (log_until && t > log_until))
+			goto L_0;
+	}
 
 	if (h->caplen < ETHER_HDR_LEN) {
 		ectlno_printf("%s(),%d: Short ethernet packet: %d bytes.\n", 
@@ -378,6 +1221,7 @@ pcap_callback(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 		ectlfr_goto(fr);
 	}
 
+	STAGETIME_STAGE(STAGE_IPUDP);
 	if (h->caplen < cp - sp + sizeof(struct ip)) {
 		ectlno_printf("%s(),%d: Short IPv4 packet: %d bytes.\n", 
 			__func__, __LINE__, h->caplen);
@@ -405,21 +1249,7 @@ pcap_callback(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 	udp = (struct udphdr *)cp;
 	cp += sizeof(struct udphdr);
 
-	do {
-		struct timeval tp;
-		size_t len;
-
-		gettimeofday(&tp, NULL);
-		len = strftime(timestamp, sizeof(timestamp), "%Y%m%d %H:%M:%S.", localtime(&tp.tv_sec));
-		snprintf(timestamp + len, sizeof(timestamp) - len, "%03ld", tp.tv_usec / 1000);
-	} while (0);
-
-	strcpy(smac, ether_ntoa((struct ether_addr *)eh->ether_shost));
-	strcpy(dmac, ether_ntoa((struct ether_addr *)eh->ether_dhost));
-
-	strcpy(sip, inet_ntoa(ip->ip_src));
-	strcpy(dip, inet_ntoa(ip->ip_dst));
-
+	STAGETIME_STAGE(STAGE_COOKIE);
 	dh_len = ntohs(udp->uh_ulen);
 	if (dh_len < sizeof(struct dhcphdr) + 4) {
 		ectlno_printf("%s(),%d: Short UDPv4 header: %d bytes\n", 
@@ -427,6 +1257,17 @@ pcap_callback(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 		ectlfr_goto(fr);
 	}
 	dh = (struct dhcphdr *)cp;
+	/* Дальше пакет не читается за захваченным: и сразу, и потом при ленивом
+	 * разборе опций из копии кадра в потоке вывода (outrec_own).
+	 */
+	cp_end = (u_char *)udp + dh_len;
+	if (cp_end > sp + h->caplen)
+		cp_end = sp + h->caplen;
+	if ((size_t)(cp_end - cp) < sizeof(struct dhcphdr) + 4) {
+		ectlno_printf("%s(),%d: Short DHCP packet: %d bytes captured\n", 
+			__func__, __LINE__, (int)(cp_end - cp));
+		ectlfr_goto(fr);
+	}
 
 	/* cookie 63:82:53:63 */
 	if (*(uint32_t *)dh->options != htonl(0x63825363)) {
@@ -435,106 +1276,111 @@ pcap_callback(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 		ectlfr_goto(fr);
 	}
 
-	sport = ntohs(udp->uh_sport);
-	if (sport == IPPORT_BOOTPS)
-		sport_name = "bootps";
-	else if (sport == IPPORT_BOOTPC)
-		sport_name = "bootpc";
-	else {
-		snprintf(sport_namebuf, sizeof sport_namebuf, "%u", sport);
-		sport_name = sport_namebuf;
-	}
-	dport = ntohs(udp->uh_dport);
-	if (dport == IPPORT_BOOTPS)
-		dport_name = "bootps";
-	else if (dport == IPPORT_BOOTPC)
-		dport_name = "bootpc";
-	else {
-		snprintf(dport_namebuf, sizeof dport_namebuf, "%u", dport);
-		dport_name = dport_namebuf;
+	/* Фильтр сам декодирует пакет и распознаёт опцию 82, если до них дойдёт:
+	 * пакет, отброшенный по полям заголовка, не декодируется вовсе. Время
+	 * этой работы filterctx относит к STAGE_DECODE и STAGE_OPT82.
+	 */
+	STAGETIME_STAGE(STAGE_FILTER);
+	filterctx_init(fctx, dh, ip->ip_src, tags, ntags, cp, cp_end, decode_demand, opt82_cache);
+#ifdef STAGETIME
+	fctx->st = STAGETIME_SELF;
+#endif
+	ectlfr_ontrap(fr, L_1);
+	if (!filter_match(flt, fctx)) {
+		USDT_PROBE(FILTER_REJECT, (char *)filter_reason(fctx));
+		goto L_skip_show;
 	}
 
-	if (defined_chaddr && (dh->htype != HTYPE_ETHERNET || dh->hlen != ETHER_ADDR_LEN ||
-					memcmp(&chaddr, dh->chaddr, ETHER_ADDR_LEN)))
-		ectlfr_goto(fr);
+	dp = filterctx_dhcp(fctx);
+	optval = filterctx_opt82(fctx);
 
-	cp_end = (u_char *)udp + udp->uh_ulen;
+	if (top)
+		topn_add(top, (uint64_t)h->ts.tv_sec * TOPN_NS + h->ts.tv_usec * 1000, dh, ip->ip_src, optval);
+	if (hll)
+		hll_add(hll, (uint64_t)h->ts.tv_sec * HLL_NS + h->ts.tv_usec * 1000, dh, tags, ntags, optval);
 
-	dp = dhcp_decode(&cp, cp_end);
-	ectlfr_ontrap(fr, L_1);
+	/* Прореживается только вывод: до этого места пакет дошёл целиком */
+	if (smp) {
+		int r = sampler_pass(smp, (uint64_t)h->ts.tv_sec * SAMPLE_NS + h->ts.tv_usec * 1000,
+			dh, cp_end - cp);
 
-	opt82 = dhcpoptlst_find(dp->opts, DHCPOPT82_RELAYAGENTINFORMATION);
-	if (opt82)
-		optval = dhcpopt82_research(opt82);
-
-	if (optval)
-		switch (optval->type) {
-			case DHCPOPT82_T_DEFAULT:
-			case DHCPOPT82_T_IES1248:
-			case DHCPOPT82_T_IES5000:
-				if (!defined_ra_etheraddr && !defined_ra_cport && !defined_ra_cvlan)
-					break;
-				if ((defined_ra_etheraddr && !memcmp(&optval->def[0].ether, &ra_etheraddr, ETHER_ADDR_LEN)) &&
-				    (defined_ra_cport && ra_cport == optval->def[0].port) &&
-				    (defined_ra_cvlan && ra_cvlan == optval->def[0].vlanid))
-					break;
-				goto L_skip_show;
-			case DHCPOPT82_T_CDRU:
-				if (!defined_ra_ru && !defined_ra_cport && !defined_ra_cvlan)
-					break;
-				if ((defined_ra_ru && !strcmp(optval->cdru[0].str, ra_ru)) &&
-				    (defined_ra_cport && ra_cport == optval->def[0].port) &&
-				    (defined_ra_cvlan && ra_cvlan == optval->def[0].vlanid))
-					break;
-				goto L_skip_show;
-			case DHCPOPT82_T_UNKNOWN:
-				fputs("[!] UNKNOWN DHCP RA OPTION (option 82) FORMAT IN PACKET:\n", stdout);
-				break;
-		}
-	else
-		if (defined_ra_etheraddr || defined_ra_cvlan || defined_ra_cport || defined_ra_ru)
+		if (r != SAMPLE_PASS) {
+			USDT_PROBE(SAMPLE_SUPPRESS, r);
 			goto L_skip_show;
+		}
+	}
 
 L_show:
-	fprintf(stdout, "%s %s > %s", timestamp, smac, dmac);
-	if (ntags) {
-		fprintf(stdout, " [%d", tags[0]);
-		for (int i = 1; i < ntags; i++) {
-			if (i == sizeof tags/sizeof tags[0]) {
-				fprintf(stdout, ".[...]");
-				break;
-			}
-			fprintf(stdout, ".%d", tags[i]);
-		}
-		fprintf(stdout, "]");
-	}
-	fprintf(stdout, " %s:%s > %s:%s\n", sip, sport_name, dip, dport_name);
-	dhcp_show(dp, 2, stdout);
-	if (optval) {
-		switch (optval->type) {
-			case DHCPOPT82_T_DEFAULT:
-			case DHCPOPT82_T_IES1248:
-			case DHCPOPT82_T_IES5000:
-				fprintf(stdout, "\tvlanid: %" PRIu16 ", module: %" PRIu8 ", port: %" PRIu8 ", ether: %s\n", 
-					optval->def[0].vlanid, optval->def[0].module, optval->def[0].port,
-					ether_ntoa(&optval->def[0].ether));
-				break;
-			case DHCPOPT82_T_CDRU:
-				fprintf(stdout, "\tvlanid: %" PRIu16 ", module: %" PRIu8 ", port: %" PRIu8 ", remote-id user: [%" PRIu8 "] \"%s\"\n", 
-					optval->cdru[0].vlanid, optval->cdru[0].module, optval->cdru[0].port,
-					optval->cdru[0].slen, optval->cdru[0].str);
-				break;
-			case DHCPOPT82_T_UNKNOWN:
-				break;
-		}
+	STAGETIME_STAGE(STAGE_OUTPUT);
+	USDT_PROBE(FILTER_ACCEPT, dp->xid);
+	if (wlog || store) {
+		struct evrec e[1];
+
+		e->time = (uint64_t)h->ts.tv_sec * 1000000 + h->ts.tv_usec;
+		memcpy(&e->smac, eh->ether_shost, sizeof e->smac);
+		memcpy(&e->dmac, eh->ether_dhost, sizeof e->dmac);
+		e->ntags = ntags;
+		memcpy(e->tags, tags, (ntags < (int)(sizeof tags/sizeof tags[0]) ? ntags : (int)(sizeof tags/sizeof tags[0])) * sizeof tags[0]);
+		e->sip = ip->ip_src;
+		e->dip = ip->ip_dst;
+		e->sport = ntohs(udp->uh_sport);
+		e->dport = ntohs(udp->uh_dport);
+		e->dh = dh;
+		e->opts = dh->options + 4;
+		e->optlen = cp_end - e->opts;
+		e->optval = optval;
+		if (wlog)
+			evlog_write(wlog, e);
+		if (store)
+			evstore_write(store, e);
+		goto L_skip_show;
 	}
-	fprintf(stdout, "\n");
+	verbose = !f_summary;
+	r = rec;
+	if (oq && !(r = outq_reserve(oq, &verbose))) {
+		USDT_PROBE(OUTPUT_DROP, dp->xid);
+		goto L_skip_show;
+	}
+	r->verbose = verbose;
+	gettimeofday(&r->tv, NULL);
+	memcpy(&r->smac, eh->ether_shost, sizeof r->smac);
+	memcpy(&r->dmac, eh->ether_dhost, sizeof r->dmac);
+	r->ntags = ntags;
+	memcpy(r->tags, tags, (ntags < (int)(sizeof tags/sizeof tags[0]) ? ntags : (int)(sizeof tags/sizeof tags[0])) * sizeof tags[0]);
+	r->sip = ip->ip_src;
+	r->dip = ip->ip_dst;
+	r->sport = ntohs(udp->uh_sport);
+	r->dport = ntohs(udp->uh_dport);
+	r->dp = NULL;
+	if (!r->verbose)
+		outrec_summary(r, dp);
+	if ((r->has_optval = optval != NULL))
+		r->optval = *optval;
+	/* -x: кадр целиком, как его отдал pcap; --hex-dhcp: пакет DHCP по длине UDP,
+	 * но не дальше захваченного. Разжалованной записи дамп не положен.
+	 */
+	r->hex = NULL;
+	if (f_hexdump == HEXDUMP_FRAME && (r->verbose || f_summary)) {
+		r->hex = sp;
+		r->hexlen = h->caplen;
+	} else if (f_hexdump == HEXDUMP_DHCP && (r->verbose || f_summary)) {
+		r->hex = (const uint8_t *)dh;
+		r->hexlen = cp_end - r->hex;
+	}
+	if (!oq) {
+		r->dp = dp;
+		outrec_show(r);
+		goto L_skip_show;
+	}
+	if (r->verbose)
+		r->dp = dp;
+	outrec_own(r, h, sp);
+	if (r->dp)
+		fctx->dp = NULL;
+	outq_commit(oq);
 L_skip_show:
-	if (optval)
-		free(optval);
-
 L_1:	ectlfr_ontrap(fr, L_0);
-	dhcp_free(dp);
+	dhcp_free(fctx->dp);
 L_0:	if (ectlno_iserror()) {
 		ectlno_setparenterror(ex);
 		pcap_breakloop(cap);
@@ -544,75 +1390,5 @@ L_0:	if (ectlno_iserror()) {
 	}
 	ectlno_end(ex);
 	ectlfr_end(fr);
+	STAGETIME_END();
 }
-
-/* 00|72 65 71 75 65 73 74 65 64 20 61 64 64 72 65 73| requested addres
- * 10|73 20 6e 6f 74 20 61 76 61 69 6c 61 62 6c 65   | s not available
- */
-static
-void 
-dumphexascii(const u_char *data, int len, int indent) 
-{
-	int nrows, nlastcols;
-
-	if (!len)
-		return;
-
-	nrows = len / 16;
-	nlastcols = len % 16;
-	/* printf("len: %d, nrows: %d, nlastcols: %d\n", len, nrows, nlastcols); */
-
-	for (int row = 0; row < nrows; row++) {
-		printf("%*s%02x|%02x", indent, "", row * 16, *data);
-		for (int col = 1; col < 16; col++)
-			printf(" %02x", data[col]);
-		printf("| ");
-		for (int col = 0; col < 16; col++)
-			printf("%c", isprint(data[col]) ? data[col] : '.');
-		printf("\n");
-		data += 16;
-	}
-	if (nlastcols) { 
-		int col;
-
-		printf("%*s%02x|%02x", indent, "", nrows * 16, *data);
-		for (col = 1; col < nlastcols; col++)
-			printf(" %02x", data[col]);
-		for (; col < 16; col++)
-			printf(" %2s", "");
-		printf("| ");
-		for (int col = 0; col < nlastcols; col++)
-			printf("%c", isprint(data[col]) ? data[col] : '.');
-		printf("\n");
-	}
-}
-
-static
-void 
-dumphex(const u_char *data, int len, int indent) 
-{
-	int nrows, nlastcols;
-
-	if (!len)
-		return;
-
-	nrows = len / 16;
-	nlastcols = len % 16;
-
-	for (int row = 0; row < nrows; row++) {
-		printf("%*s%02x|%02x", indent, "", row * 16, *data);
-		for (int col = 1; col < 16; col++)
-			printf(" %02x", data[col]);
-		printf("\n");
-		data += 16;
-	}
-	if (nlastcols) { 
-		printf("%*s%02x|%02x", indent, "", nrows * 16, *data);
-		for (int col = 1; col < nlastcols; col++)
-			printf(" %02x", data[col]);
-		printf("\n");
-	}
-}
-
-
-
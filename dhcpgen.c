@@ -0,0 +1,436 @@
+/* Генератор синтетического DHCP трафика в pcap файл.
+ *
+ * dhcpgen -w file [-n packets] [-c clients] [-m mix] [-f formats] [-t vllst]
+ *         [-e fraction] [-r pps] [-s seed]
+ *
+ * Трафик - транзакции случайно выбранных клиентов: DORA (4 пакета),
+ * продление (REQUEST/ACK unicast) и освобождение (RELEASE). Клиенты за relay
+ * получают опцию 82 одного из форматов SYNTH_OPT82_*, каждому клиенту назначен
+ * отпечаток опции 55. Доля -e пакетов повреждается по кругу всеми видами
+ * SYNTH_BAD_*, так что каждая ошибка E_DHCP* встречается равномерно.
+ *
+ * Кадры собираются прямо в большой буфер вывода, libpcap не нужен.
+ */
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <net/ethernet.h>
+#include <netinet/in_systm.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syslog.h>
+
+#include "foo.h"
+#include "dhcp.h"
+#include "synth.h"
+
+#define TRANS_DORA	0
+#define TRANS_RENEW	1
+#define TRANS_RELEASE	2
+#define TRANS_MAX	3
+
+static const char *const trans_names[TRANS_MAX] = { "dora", "renew", "release" };
+
+#define SERVER_IP	0x0a000001		/* 10.0.0.1 */
+static const uint8_t server_mac[6] = { 0x02, 0x00, 0x5e, 0x00, 0x00, 0x01 };
+static const uint8_t relay_mac[6] = { 0x02, 0x00, 0x5e, 0x00, 0x00, 0x02 };
+static const uint8_t bcast_mac[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+/* Кадр: ethernet, до 8 тегов 802.1Q, IPv4, UDP, DHCP */
+#define FRAME_MAX	(ETHER_HDR_LEN + 8 * 4 + 20 + 8 + SYNTH_DHCP_MAX)
+
+struct pcap_filehdr {
+	uint32_t	magic;
+	uint16_t	version_major;
+	uint16_t	version_minor;
+	int32_t		thiszone;
+	uint32_t	sigfigs;
+	uint32_t	snaplen;
+	uint32_t	linktype;
+};
+struct pcap_rechdr {
+	uint32_t	ts_sec;
+	uint32_t	ts_usec;
+	uint32_t	caplen;
+	uint32_t	len;
+};
+
+static struct {
+	int		fd;
+	size_t		n;
+	uint8_t		buf[1 << 20];
+} out[1];
+
+static uint64_t rnd_state;
+
+static inline
+uint32_t
+rnd32()
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state >> 32;
+}
+
+/* Выбор по весам: w[] - накопленные суммы */
+static inline
+int
+rnd_pick(const uint32_t *w, int n)
+{
+	uint32_t x = rnd32() % w[n - 1];
+	int i = 0;
+	while (x >= w[i])
+		i++;
+	return i;
+}
+
+static
+void
+out_flush()
+{
+	for (size_t off = 0; off < out->n; ) {
+		ssize_t n = write(out->fd, out->buf + off, out->n - off);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			ECTL_PTRAP(errno, "write(): %s.\n", strerror(errno));
+		}
+		off += n;
+	}
+	out->n = 0;
+}
+
+static inline
+uint8_t *
+out_reserve(size_t n)
+{
+	if (out->n + n > sizeof out->buf)
+		out_flush();
+	return out->buf + out->n;
+}
+
+static inline
+uint16_t
+ip_cksum(const void *data, int len)
+{
+	const uint16_t *p = data;
+	uint32_t sum = 0;
+	for (; len > 1; len -= 2)
+		sum += *p++;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+static int vltags[8], nvltags = 0;
+static uint64_t ts_usec, ts_step;
+
+/* Собирает кадр с сообщением m прямо в буфере вывода */
+static
+void
+emit(const struct synth_msg *m)
+{
+	const struct synth_client *cl = m->cl;
+	int request = m->type != DHCPOFFER && m->type != DHCPACK && m->type != DHCPNAK;
+	int relayed = m->relayed && cl->giaddr;
+	struct pcap_rechdr *rh;
+	struct ip *ip;
+	struct udphdr *udp;
+	uint8_t *frame, *p;
+	size_t dlen, flen;
+	uint32_t src, dst;
+
+	rh = (struct pcap_rechdr *)out_reserve(sizeof *rh + FRAME_MAX);
+	frame = p = (uint8_t *)(rh + 1);
+
+	/* L2: у relay свой MAC, без relay - клиент шлёт broadcast, сервер отвечает ему */
+	if (relayed) {
+		memcpy(p, request ? server_mac : relay_mac, 6);
+		memcpy(p + 6, request ? relay_mac : server_mac, 6);
+	} else if (m->ciaddr) {
+		memcpy(p, request ? server_mac : cl->mac, 6);
+		memcpy(p + 6, request ? cl->mac : server_mac, 6);
+	} else {
+		memcpy(p, request ? bcast_mac : cl->mac, 6);
+		memcpy(p + 6, request ? cl->mac : server_mac, 6);
+	}
+	p += 12;
+	for (int i = 0; i < nvltags; i++) {
+		uint16_t tag = htons(vltags[i] ? vltags[i] : cl->vlan);
+		*p++ = 0x81; *p++ = 0x00;
+		memcpy(p, &tag, 2), p += 2;
+	}
+	*p++ = 0x08; *p++ = 0x00;
+
+	ip = (struct ip *)p;
+	udp = (struct udphdr *)(p + 20);
+	dlen = synth_dhcp((uint8_t *)(udp + 1), m);
+
+	if (relayed) {
+		src = request ? cl->giaddr : SERVER_IP;
+		dst = request ? SERVER_IP : cl->giaddr;
+	} else if (m->ciaddr) {
+		src = request ? m->ciaddr : SERVER_IP;
+		dst = request ? SERVER_IP : m->ciaddr;
+	} else {
+		src = request ? INADDR_ANY : SERVER_IP;
+		dst = INADDR_BROADCAST;
+	}
+	memset(ip, 0, 20);
+	ip->ip_v = IPVERSION;
+	ip->ip_hl = 5;
+	ip->ip_len = htons(20 + 8 + dlen);
+	ip->ip_ttl = 64;
+	ip->ip_p = IPPROTO_UDP;
+	ip->ip_src.s_addr = htonl(src);
+	ip->ip_dst.s_addr = htonl(dst);
+	ip->ip_sum = ip_cksum(ip, 20);
+
+	udp->uh_sport = htons(request && !relayed ? IPPORT_BOOTPC : IPPORT_BOOTPS);
+	udp->uh_dport = htons(request || relayed ? IPPORT_BOOTPS : IPPORT_BOOTPC);
+	udp->uh_ulen = htons(8 + dlen);
+	udp->uh_sum = 0;
+
+	flen = (uint8_t *)(udp + 1) + dlen - frame;
+	rh->ts_sec = ts_usec / 1000000;
+	rh->ts_usec = ts_usec % 1000000;
+	rh->caplen = rh->len = flen;
+	out->n += sizeof *rh + flen;
+	ts_usec += ts_step;
+}
+
+/* "name=weight,..." -> накопленные веса по таблице имён; имена без веса - 0 */
+static
+int
+parse_weights(const char *s, const char *const *names, int n, uint32_t *w)
+{
+	memset(w, 0, n * sizeof w[0]);
+	while (*s) {
+		const char *e = strchr(s, '=');
+		char *endp;
+		int i;
+
+		if (!e)
+			return -1;
+		for (i = 0; i < n; i++)
+			if (strlen(names[i]) == (size_t)(e - s) && !memcmp(names[i], s, e - s))
+				break;
+		if (i == n)
+			return -1;
+		w[i] = strtoul(e + 1, &endp, 10);
+		if (endp == e + 1 || (*endp && *endp != ','))
+			return -1;
+		s = *endp ? endp + 1 : endp;
+	}
+	for (int i = 1; i < n; i++)
+		w[i] += w[i - 1];
+	return w[n - 1] ? 0 : -1;
+}
+
+static
+void __attribute__((__noreturn__))
+usage()
+{
+	printf("Usage: dhcpgen -w <pcapfile|-> [-n packets] [-c clients] [-m dora=N,renew=N,release=N]\n"
+		"\t[-f none=N,default=N,ies1248=N,ies5000=N,cdru=N,unknown=N] [-t vllst]\n"
+		"\t[-e malformed-fraction] [-r pps] [-s seed]\n");
+	exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct ectlfr fr[1];
+	static struct ectlno ex[1];
+	static const char *opt82names[SYNTH_OPT82_MAX];
+	const char *ofile_name = NULL, *mix = "dora=60,renew=35,release=5",
+		*formats = "none=1,default=1,ies1248=1,ies5000=1,cdru=1,unknown=1";
+	uint64_t npackets = 1000000, nbad = 0, pps = 100000;
+	uint32_t nclients = 10000, wtrans[TRANS_MAX], wopt82[SYNTH_OPT82_MAX];
+	double badfrac = 0;
+	struct synth_client *clients = NULL;
+	struct pcap_filehdr fh;
+
+	openlog("dhcpgen", LOG_PID|LOG_PERROR|LOG_NDELAY, LOG_USER);
+	ectlfr_begin(fr, L_0);
+	ectlno_begin(ex);
+
+	rnd_state = 0x9e3779b97f4a7c15ULL;
+	for (int i = 0; i < SYNTH_OPT82_MAX; i++)
+		opt82names[i] = synth_opt82name(i);
+
+	for (int c; (c = getopt(argc, argv, "c:e:f:m:n:r:s:t:w:")) != -1; ) {
+		switch (c) {
+		case 'c':
+			nclients = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			badfrac = strtod(optarg, NULL);
+			break;
+		case 'f':
+			formats = optarg;
+			break;
+		case 'm':
+			mix = optarg;
+			break;
+		case 'n':
+			npackets = strtoull(optarg, NULL, 0);
+			break;
+		case 'r':
+			pps = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			rnd_state = strtoull(optarg, NULL, 0) * 0x9e3779b97f4a7c15ULL | 1;
+			break;
+		case 't':
+			nvltags = 0;
+			for (char *p = optarg, *endp; *p; p = endp) {
+				if (nvltags == sizeof vltags/sizeof vltags[0]) {
+					ectlno_setposixerror(EINVAL);
+					ectlno_printf("%s(),%d: too many vlans: %s\n", __func__, __LINE__, optarg);
+					ectlfr_goto(fr);
+				}
+				vltags[nvltags] = strtoul(p, &endp, 10);
+				if (endp == p || vltags[nvltags] > 4094 || (*endp && *endp != '.' && *endp != ',')) {
+					ectlno_setposixerror(EINVAL);
+					ectlno_printf("%s(),%d: illegal vlan list: %s\n", __func__, __LINE__, optarg);
+					ectlfr_goto(fr);
+				}
+				nvltags++;
+				if (*endp)
+					endp++;
+			}
+			break;
+		case 'w':
+			ofile_name = optarg;
+			break;
+		case '?':
+		default:
+			usage();
+		}
+	}
+	if (!ofile_name)
+		usage();
+	if (!nclients || !pps || badfrac < 0 || badfrac > 1) {
+		ectlno_setposixerror(EINVAL);
+		ectlno_printf("%s(),%d: -c and -r shall be positive, -e shall be in [0, 1].\n",
+			__func__, __LINE__);
+		ectlfr_goto(fr);
+	}
+	if (parse_weights(mix, trans_names, TRANS_MAX, wtrans) < 0) {
+		ectlno_setposixerror(EINVAL);
+		ectlno_printf("%s(),%d: wrong transaction mix: %s\n", __func__, __LINE__, mix);
+		ectlfr_goto(fr);
+	}
+	if (parse_weights(formats, opt82names, SYNTH_OPT82_MAX, wopt82) < 0) {
+		ectlno_setposixerror(EINVAL);
+		ectlno_printf("%s(),%d: wrong option 82 formats: %s\n", __func__, __LINE__, formats);
+		ectlfr_goto(fr);
+	}
+
+	if (!strcmp(ofile_name, "-"))
+		out->fd = STDOUT_FILENO;
+	else if ((out->fd = open(ofile_name, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
+		ectlno_setposixerror(errno);
+		ectlno_printf("%s(),%d: open(%s): %s\n", __func__, __LINE__, ofile_name, strerror(errno));
+		ectlfr_goto(fr);
+	}
+	ectlfr_ontrap(fr, L_1);
+
+	/* Клиенты: relay (giaddr) на каждые 256 клиентов, 48 портов на модуль */
+	clients = MALLOC(nclients * sizeof clients[0]);
+	for (uint32_t i = 0; i < nclients; i++) {
+		struct synth_client *cl = clients + i;
+		uint32_t sw = i / 256;
+
+		cl->mac[0] = 0x00; cl->mac[1] = 0x16;
+		cl->mac[2] = i >> 24; cl->mac[3] = i >> 16; cl->mac[4] = i >> 8; cl->mac[5] = i;
+		cl->swmac[0] = 0x00; cl->swmac[1] = 0x26; cl->swmac[2] = 0x5a;
+		cl->swmac[3] = sw >> 16; cl->swmac[4] = sw >> 8; cl->swmac[5] = sw;
+		cl->vlan = 1 + i % 4094;
+		cl->module = i % 256 / 48;
+		cl->port = 1 + i % 48;
+		cl->opt82 = rnd_pick(wopt82, SYNTH_OPT82_MAX);
+		cl->fp = rnd32() % synth_nfingerprints();
+		cl->ip = 0x0a400000 + i + 1;
+		cl->giaddr = cl->opt82 == SYNTH_OPT82_NONE ? 0 : 0x0a010001 + (sw << 8);
+	}
+
+	fh.magic = 0xa1b2c3d4;
+	fh.version_major = 2;
+	fh.version_minor = 4;
+	fh.thiszone = 0;
+	fh.sigfigs = 0;
+	fh.snaplen = 65535;
+	fh.linktype = 1;	/* DLT_EN10MB */
+	memcpy(out_reserve(sizeof fh), &fh, sizeof fh);
+	out->n += sizeof fh;
+
+	ts_usec = 1700000000ULL * 1000000;
+	ts_step = 1000000 / pps ? 1000000 / pps : 1;
+	for (uint64_t n = 0; n < npackets; ) {
+		static const uint8_t dora[] = { DHCPDISCOVER, DHCPOFFER, DHCPREQUEST, DHCPACK };
+		static const uint8_t renew[] = { DHCPREQUEST, DHCPACK };
+		static const uint8_t release[] = { DHCPRELEASE };
+		const uint8_t *types;
+		struct synth_msg m;
+		int ntypes;
+
+		m.cl = clients + rnd32() % nclients;
+		m.xid = rnd32();
+		m.server = SERVER_IP;
+		m.ciaddr = 0;
+		m.relayed = 1;
+		switch (rnd_pick(wtrans, TRANS_MAX)) {
+		case TRANS_DORA:
+			types = dora, ntypes = sizeof dora;
+			break;
+		case TRANS_RENEW:
+			types = renew, ntypes = sizeof renew;
+			m.ciaddr = m.cl->ip;
+			m.relayed = 0;
+			break;
+		default:
+			types = release, ntypes = sizeof release;
+			m.ciaddr = m.cl->ip;
+			m.relayed = 0;
+			break;
+		}
+		for (int i = 0; i < ntypes && n < npackets; i++, n++) {
+			m.type = types[i];
+			m.bad = SYNTH_BAD_NONE;
+			/* Повреждённых пакетов ровно badfrac от выданных */
+			if (badfrac && nbad < (uint64_t)(badfrac * (n + 1)))
+				m.bad = 1 + nbad++ % (SYNTH_BAD_MAX - 1);
+			emit(&m);
+		}
+	}
+	out_flush();
+
+	free(clients);
+	if (out->fd != STDOUT_FILENO)
+		close(out->fd);
+	ectlno_end(ex);
+	ectlfr_end(fr);
+	return EXIT_SUCCESS;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	free(clients);
+	if (out->fd != STDOUT_FILENO)
+		close(out->fd);
+L_0:	ectlno_log();
+	ectlno_clearmessage();
+	ectlno_end(ex);
+	ectlfr_end(fr);
+	return EXIT_FAILURE;
+}
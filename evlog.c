@@ -0,0 +1,646 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#ifdef linux
+#include <netinet/ether.h>
+#endif
+
+#include "foo.h"
+#include "dhcp.h"
+#include "opt82.h"
+#include "evlog.h"
+
+DEFN_ERROR(E_EVLOGFORMAT,	"Broken event log.")
+
+/* заголовок BOOTP от op до chaddr включительно */
+#define EVREC_BOOTP	offsetof(struct dhcphdr, sname)
+
+struct evlog {
+	FILE			*fp;
+	uint8_t			*buf;		/* записи текущего блока */
+	size_t			size, len;	/* выделено, занято */
+	struct evlog_blockhdr	bh;
+	struct evlog_index	*idx;
+	size_t			nidx, maxidx;
+	uint64_t		off;		/* следующего блока */
+	int			finished;
+	/* только чтение */
+	uint64_t		end;		/* конец блоков: индекс или конец файла */
+	size_t			pos;		/* следующей записи в buf */
+	uint32_t		left;		/* записей блока ещё не прочитано */
+	size_t			nextblk;	/* по индексу; idx == NULL - подряд */
+	uint64_t		since, until;
+	int			warned;		/* о версии описаний опций */
+	uint8_t			*pkt;		/* dhcphdr, cookie и опции записи */
+	struct dhcpopt82_value	optval;
+	uint8_t			*map;		/* evlog_map(): весь файл */
+	size_t			maplen;
+};
+
+void
+evlog_free(struct evlog *evl)
+{
+	if (evl) {
+		if (evl->fp)
+			fclose(evl->fp);
+		if (evl->map)
+			munmap(evl->map, evl->maplen);
+		free(evl->buf);
+		free(evl->idx);
+		free(evl->pkt);
+		free(evl);
+	}
+}
+
+static
+void
+evlog_fwrite(struct evlog *evl, const void *p, size_t n)
+{
+	if (fwrite(p, 1, n, evl->fp) != n)
+		ECTL_PTRAP(errno, "fwrite(): %s.\n", strerror(errno));
+}
+
+struct evlog *
+evlog_create(const char *path)
+{
+	struct ectlfr fr[1];
+	struct evlog *volatile evl;
+	struct evlog_filehdr fh = { .magic = EVLOG_MAGIC, .bom = EVLOG_BOM, .version = EVLOG_VERSION };
+
+	ectlfr_begin(fr, L_0);
+	evl = MALLOC(sizeof *evl);
+	memset(evl, 0, sizeof *evl);
+	ectlfr_ontrap(fr, L_1);
+	evl->size = EVLOG_BLOCK;
+	evl->buf = MALLOC(evl->size);
+	if (!(evl->fp = fopen(path, "w")))
+		ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", path, strerror(errno));
+	evlog_fwrite(evl, &fh, sizeof fh);
+	evl->off = sizeof fh;
+	ectlfr_end(fr);
+	return evl;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	evlog_free(evl);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+static
+void
+evlog_flush(struct evlog *evl)
+{
+	struct evlog_index *ie;
+
+	if (!evl->bh.nrec)
+		return;
+	if (evl->nidx == evl->maxidx) {
+		evl->maxidx = evl->maxidx ? 2 * evl->maxidx : 256;
+		evl->idx = REALLOC(evl->idx, evl->maxidx * sizeof evl->idx[0]);
+	}
+	ie = evl->idx + evl->nidx++;
+	memset(ie, 0, sizeof *ie);
+	ie->off = evl->off;
+	ie->first = evl->bh.first;
+	ie->last = evl->bh.last;
+	ie->nrec = evl->bh.nrec;
+	evl->bh.len = evl->len;
+	evl->bh.dtab_version = DHCPOPT_DTAB_VERSION;
+	evlog_fwrite(evl, &evl->bh, sizeof evl->bh);
+	evlog_fwrite(evl, evl->buf, evl->len);
+	evl->off += sizeof evl->bh + evl->len;
+	evl->len = 0;
+	memset(&evl->bh, 0, sizeof evl->bh);
+}
+
+/* длина без нулей в конце: sname и file обычно пусты */
+static inline
+size_t
+evlog_trimlen(const char *s, size_t n)
+{
+	while (n && !s[n - 1])
+		n--;
+	return n;
+}
+
+#define EVPUT(p, v)	((p) = (uint8_t *)memcpy((p), &(v), sizeof(v)) + sizeof(v))
+#define EVPUTN(p, s, n)	((p) = (uint8_t *)memcpy((p), (s), (n)) + (n))
+
+uint64_t
+evlog_write(struct evlog *evl, const struct evrec *e)
+{
+	const uint8_t *opt = e->opts, *end = e->opts + e->optlen;
+	uint8_t ntags = e->ntags > UINT8_MAX ? UINT8_MAX : e->ntags, nst = ntags > 8 ? 8 : ntags;
+	uint8_t flags = e->optval ? EVREC_F_OPT82 : 0, snamelen, filelen;
+	uint16_t optlen, reclen;
+	size_t need;
+	uint64_t loc;
+	uint8_t *p;
+
+	/* опции до END включительно: добивка BOOTP до 300 байт не пишется */
+	while (opt < end && *opt != DHCPOPT255_END)
+		opt += *opt == DHCPOPT0_PAD || end - opt < 2 ? 1 : 2 + opt[1];
+	if (opt < end)
+		opt++;
+	if (opt > end)
+		opt = end;
+	snamelen = evlog_trimlen(e->dh->sname, DHCPHDR_SNAME_LEN);
+	filelen = evlog_trimlen(e->dh->file, DHCPHDR_FILE_LEN);
+	need = 2 + 8 + 12 + 1 + 2 * nst + 12 + 3 + EVREC_BOOTP + snamelen + filelen + 2;
+	if (flags & EVREC_F_OPT82)
+		need += 12 + e->optval->slen;
+	/* запись не длиннее UINT16_MAX: в Ethernet такого пакета не бывает */
+	optlen = (size_t)(opt - e->opts) > UINT16_MAX - need ? UINT16_MAX - need : (size_t)(opt - e->opts);
+	need += optlen;
+
+	if (evl->len + need > evl->size) {
+		evlog_flush(evl);
+		if (need > evl->size) {
+			evl->size = need;
+			evl->buf = REALLOC(evl->buf, evl->size);
+		}
+	}
+	loc = evl->off << EVLOG_LOC_SHIFT | evl->len;
+	p = evl->buf + evl->len;
+	reclen = need;
+	EVPUT(p, reclen);
+	EVPUT(p, e->time);
+	EVPUTN(p, &e->smac, 6);
+	EVPUTN(p, &e->dmac, 6);
+	EVPUT(p, ntags);
+	for (int i = 0; i < nst; i++) {
+		uint16_t tag = e->tags[i];
+		EVPUT(p, tag);
+	}
+	EVPUT(p, e->sip);
+	EVPUT(p, e->dip);
+	EVPUT(p, e->sport);
+	EVPUT(p, e->dport);
+	EVPUT(p, flags);
+	EVPUT(p, snamelen);
+	EVPUT(p, filelen);
+	EVPUTN(p, e->dh, EVREC_BOOTP);
+	EVPUTN(p, e->dh->sname, snamelen);
+	EVPUTN(p, e->dh->file, filelen);
+	EVPUT(p, optlen);
+	EVPUTN(p, e->opts, optlen);
+	if (flags & EVREC_F_OPT82) {
+		EVPUT(p, e->optval->flags);
+		EVPUT(p, e->optval->vlanid);
+		EVPUT(p, e->optval->module);
+		EVPUT(p, e->optval->port);
+		EVPUTN(p, &e->optval->ether, 6);
+		EVPUT(p, e->optval->slen);
+		EVPUTN(p, e->optval->str, e->optval->slen);
+	}
+	evl->len += need;
+	if (!evl->bh.nrec++)
+		evl->bh.first = evl->bh.last = e->time;
+	else if (e->time > evl->bh.last)
+		evl->bh.last = e->time;
+	return loc;
+}
+
+void
+evlog_finish(struct evlog *evl)
+{
+	struct evlog_trailer tr = { .magic = EVLOG_TRAILER_MAGIC };
+
+	if (evl->finished)
+		return;
+	evl->finished = 1;
+	evlog_flush(evl);
+	tr.index_off = evl->off;
+	tr.nblocks = evl->nidx;
+	evlog_fwrite(evl, evl->idx, evl->nidx * sizeof evl->idx[0]);
+	evlog_fwrite(evl, &tr, sizeof tr);
+	if (fflush(evl->fp))
+		ECTL_PTRAP(errno, "fflush(): %s.\n", strerror(errno));
+}
+
+static
+void
+evlog_fread(struct evlog *evl, void *p, size_t n)
+{
+	if (fread(p, 1, n, evl->fp) != n) {
+		if (ferror(evl->fp))
+			ECTL_PTRAP(errno, "fread(): %s.\n", strerror(errno));
+		ECTL_TRAP(E_EVLOGFORMAT, "unexpected end of file.\n");
+	}
+}
+
+static
+void
+evlog_seek(struct evlog *evl, uint64_t off)
+{
+	if (fseeko(evl->fp, off, SEEK_SET))
+		ECTL_PTRAP(errno, "fseeko(): %s.\n", strerror(errno));
+}
+
+static
+void
+evlog_checkhdr(const char *path, const struct evlog_filehdr *fh)
+{
+	if (memcmp(fh->magic, EVLOG_MAGIC, sizeof fh->magic))
+		ECTL_TRAP(E_EVLOGFORMAT, "\"%s\": not a dhcpdump event log.\n", path);
+	if (fh->bom != EVLOG_BOM)
+		ECTL_TRAP(E_EVLOGFORMAT, "\"%s\": written on a machine with another byte order.\n", path);
+	if (fh->version != EVLOG_VERSION)
+		ECTL_TRAP(E_EVLOGFORMAT, "\"%s\": format version %" PRIu16 ", expected %d.\n",
+			path, fh->version, EVLOG_VERSION);
+}
+
+struct evlog *
+evlog_open(const char *path)
+{
+	struct ectlfr fr[1];
+	struct evlog *volatile evl;
+	struct evlog_filehdr fh;
+	struct evlog_trailer tr;
+	off_t size;
+
+	ectlfr_begin(fr, L_0);
+	evl = MALLOC(sizeof *evl);
+	memset(evl, 0, sizeof *evl);
+	ectlfr_ontrap(fr, L_1);
+	evl->pkt = MALLOC(sizeof(struct dhcphdr) + 4 + UINT16_MAX);
+	if (!(evl->fp = fopen(path, "r")))
+		ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", path, strerror(errno));
+	if (fread(&fh, 1, sizeof fh, evl->fp) != sizeof fh)
+		ECTL_TRAP(E_EVLOGFORMAT, "\"%s\": not a dhcpdump event log.\n", path);
+	evlog_checkhdr(path, &fh);
+	if (fseeko(evl->fp, 0, SEEK_END) || (size = ftello(evl->fp)) < 0)
+		ECTL_PTRAP(errno, "\"%s\": %s.\n", path, strerror(errno));
+	evl->end = size;
+	/* хвоста нет или он не сходится с размером - блоки читаются подряд */
+	if ((uint64_t)size >= sizeof fh + sizeof tr) {
+		evlog_seek(evl, size - sizeof tr);
+		evlog_fread(evl, &tr, sizeof tr);
+		if (!memcmp(tr.magic, EVLOG_TRAILER_MAGIC, sizeof tr.magic) && tr.index_off >= sizeof fh &&
+				tr.index_off + (uint64_t)tr.nblocks * sizeof evl->idx[0] + sizeof tr == (uint64_t)size) {
+			evl->nidx = tr.nblocks;
+			evl->idx = MALLOC(evl->nidx * sizeof evl->idx[0] + 1);
+			evlog_seek(evl, tr.index_off);
+			evlog_fread(evl, evl->idx, evl->nidx * sizeof evl->idx[0]);
+			evl->end = tr.index_off;
+		}
+	}
+	evl->off = sizeof fh;
+	evlog_seek(evl, evl->off);
+	ectlfr_end(fr);
+	return evl;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	evlog_free(evl);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+void
+evlog_range(struct evlog *evl, uint64_t since, uint64_t until)
+{
+	evl->since = since;
+	evl->until = until;
+}
+
+static inline
+int
+evlog_outside(struct evlog *evl, uint64_t first, uint64_t last)
+{
+	return (evl->since && last < evl->since) || (evl->until && first > evl->until);
+}
+
+/* 0 - блоков больше нет */
+static
+int
+evlog_nextblock(struct evlog *evl)
+{
+	struct evlog_blockhdr *bh = &evl->bh;
+
+	for (;;) {
+		if (evl->idx) {
+			const struct evlog_index *ie;
+
+			if (evl->nextblk == evl->nidx)
+				return 0;
+			ie = evl->idx + evl->nextblk++;
+			if (evlog_outside(evl, ie->first, ie->last))
+				continue;
+			evl->off = ie->off;
+			evlog_seek(evl, evl->off);
+		} else if (evl->off >= evl->end)
+			return 0;
+		/* без индекса недописанный последний блок - конец журнала */
+		if (fread(bh, 1, sizeof *bh, evl->fp) != sizeof *bh) {
+			if (!evl->idx && !ferror(evl->fp))
+				return 0;
+			ECTL_TRAP(E_EVLOGFORMAT, "block at %" PRIu64 ": short header.\n", evl->off);
+		}
+		if (bh->len > EVLOG_BLOCK_MAX || evl->off + sizeof *bh + bh->len > evl->end)
+			ECTL_TRAP(E_EVLOGFORMAT, "block at %" PRIu64 ": wrong length %" PRIu32 ".\n", evl->off, bh->len);
+		evl->off += sizeof *bh + bh->len;
+		if (!evl->idx && evlog_outside(evl, bh->first, bh->last)) {
+			evlog_seek(evl, evl->off);
+			continue;
+		}
+		if (bh->len > evl->size) {
+			evl->size = bh->len;
+			evl->buf = REALLOC(evl->buf, evl->size);
+		}
+		evlog_fread(evl, evl->buf, bh->len);
+		if (bh->dtab_version != DHCPOPT_DTAB_VERSION && !evl->warned) {
+			fprintf(stderr, "evlog: options were written with descriptors version %" PRIu16
+				", decoding with version %d.\n", bh->dtab_version, DHCPOPT_DTAB_VERSION);
+			evl->warned = 1;
+		}
+		evl->len = bh->len;
+		evl->pos = 0;
+		evl->left = bh->nrec;
+		return 1;
+	}
+}
+
+#define EVGET(p, end, v) do {							\
+		if ((size_t)((end) - (p)) < sizeof(v))				\
+			goto L_broken;						\
+		memcpy(&(v), (p), sizeof(v));					\
+		(p) += sizeof(v);						\
+	} while (0)
+#define EVGETN(p, end, d, n) do {						\
+		if ((size_t)((end) - (p)) < (size_t)(n))			\
+			goto L_broken;						\
+		memcpy((d), (p), (n));						\
+		(p) += (n);							\
+	} while (0)
+
+/* запись с p, не дальше end; длина записи, 0 - запись испорчена */
+static
+size_t
+evlog_decode(struct evlog *evl, const uint8_t *p, const uint8_t *end, struct evrec *e)
+{
+	struct dhcphdr *dh = (struct dhcphdr *)evl->pkt;
+	uint16_t reclen, optlen;
+	uint8_t ntags, flags, snamelen, filelen;
+
+	EVGET(p, end, reclen);
+	if (reclen < sizeof reclen || reclen > end - p + sizeof reclen)
+		goto L_broken;
+	end = p - sizeof reclen + reclen;
+	EVGET(p, end, e->time);
+	EVGETN(p, end, &e->smac, 6);
+	EVGETN(p, end, &e->dmac, 6);
+	EVGET(p, end, ntags);
+	e->ntags = ntags;
+	for (int i = 0; i < ntags && i < 8; i++) {
+		uint16_t tag;
+		EVGET(p, end, tag);
+		e->tags[i] = tag;
+	}
+	EVGET(p, end, e->sip);
+	EVGET(p, end, e->dip);
+	EVGET(p, end, e->sport);
+	EVGET(p, end, e->dport);
+	EVGET(p, end, flags);
+	EVGET(p, end, snamelen);
+	EVGET(p, end, filelen);
+	if (snamelen > DHCPHDR_SNAME_LEN || filelen > DHCPHDR_FILE_LEN)
+		goto L_broken;
+	memset(dh, 0, sizeof *dh);
+	EVGETN(p, end, dh, EVREC_BOOTP);
+	EVGETN(p, end, dh->sname, snamelen);
+	EVGETN(p, end, dh->file, filelen);
+	EVGET(p, end, optlen);
+	dh->options[0] = 0x63;
+	dh->options[1] = 0x82;
+	dh->options[2] = 0x53;
+	dh->options[3] = 0x63;
+	EVGETN(p, end, dh->options + 4, optlen);
+	e->dh = dh;
+	e->opts = dh->options + 4;
+	e->optlen = optlen;
+	e->optval = NULL;
+	if (flags & EVREC_F_OPT82) {
+		struct dhcpopt82_value *v = &evl->optval;
+
+		memset(v, 0, sizeof *v);
+		EVGET(p, end, v->flags);
+		EVGET(p, end, v->vlanid);
+		EVGET(p, end, v->module);
+		EVGET(p, end, v->port);
+		EVGETN(p, end, &v->ether, 6);
+		EVGET(p, end, v->slen);
+		_Static_assert(1ULL << 8 * sizeof v->slen <= sizeof v->str,
+			"str must hold any slen and the terminating NUL");
+		EVGETN(p, end, v->str, v->slen);
+		v->str[v->slen] = '\0';
+		e->optval = v;
+	}
+	return reclen;
+
+L_broken:
+	return 0;
+}
+
+int
+evlog_read(struct evlog *evl, struct evrec *e)
+{
+	size_t n;
+
+	for (;;) {
+		while (!evl->left)
+			if (!evlog_nextblock(evl))
+				return 0;
+		evl->left--;
+		if (!(n = evlog_decode(evl, evl->buf + evl->pos, evl->buf + evl->len, e)))
+			ECTL_TRAP(E_EVLOGFORMAT, "block at %" PRIu64 ", record %" PRIu32 ": broken.\n",
+				evl->off - sizeof evl->bh - evl->len, evl->bh.nrec - evl->left - 1);
+		evl->pos += n;
+		e->dtab_version = evl->bh.dtab_version;
+		if (!evlog_outside(evl, e->time, e->time))
+			return 1;
+	}
+}
+
+struct evlog *
+evlog_map(const char *path)
+{
+	struct ectlfr fr[1];
+	struct evlog *volatile evl;
+	struct stat st;
+	void *map;
+	int fd;
+
+	ectlfr_begin(fr, L_0);
+	evl = MALLOC(sizeof *evl);
+	memset(evl, 0, sizeof *evl);
+	ectlfr_ontrap(fr, L_1);
+	evl->pkt = MALLOC(sizeof(struct dhcphdr) + 4 + UINT16_MAX);
+	if ((fd = open(path, O_RDONLY)) == -1)
+		ECTL_PTRAP(errno, "open(\"%s\"): %s.\n", path, strerror(errno));
+	if (fstat(fd, &st) == -1 || (uint64_t)st.st_size < sizeof(struct evlog_filehdr)) {
+		close(fd);
+		ECTL_TRAP(E_EVLOGFORMAT, "\"%s\": not a dhcpdump event log.\n", path);
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		ECTL_PTRAP(errno, "mmap(\"%s\"): %s.\n", path, strerror(errno));
+	evl->map = map;
+	evl->maplen = st.st_size;
+	evlog_checkhdr(path, (const struct evlog_filehdr *)evl->map);
+	ectlfr_end(fr);
+	return evl;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	evlog_free(evl);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+void
+evlog_at(struct evlog *evl, uint64_t loc, struct evrec *e)
+{
+	uint64_t off = loc >> EVLOG_LOC_SHIFT;
+	uint32_t pos = loc & ((1 << EVLOG_LOC_SHIFT) - 1);
+	struct evlog_blockhdr bh;
+	const uint8_t *blk;
+
+	if (off < sizeof(struct evlog_filehdr) || off + sizeof bh > evl->maplen)
+		ECTL_TRAP(E_EVLOGFORMAT, "record %#" PRIx64 ": no block at %" PRIu64 ".\n", loc, off);
+	memcpy(&bh, evl->map + off, sizeof bh);
+	blk = evl->map + off + sizeof bh;
+	if (bh.len > evl->maplen - off - sizeof bh || pos >= bh.len ||
+			!evlog_decode(evl, blk + pos, blk + bh.len, e))
+		ECTL_TRAP(E_EVLOGFORMAT, "record %#" PRIx64 ": broken.\n", loc);
+	e->dtab_version = bh.dtab_version;
+}
+
+/* строка JSON: байты вне ASCII и управляющие - \u00XX */
+static
+void
+evlog_json_str(FILE *fp, const char *s, size_t n)
+{
+	fputc('"', fp);
+	for (size_t i = 0; i < n; i++) {
+		unsigned char c = s[i];
+
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+static
+void
+evlog_json_hex(FILE *fp, const uint8_t *p, size_t n)
+{
+	static const char digits[] = "0123456789abcdef";
+	char buf[2 * UINT8_MAX + 2];
+
+	for (size_t i = 0; i < n; i++) {
+		buf[2 * i] = digits[p[i] >> 4];
+		buf[2 * i + 1] = digits[p[i] & 0xf];
+	}
+	buf[2 * n] = '"';
+	fputc('"', fp);
+	fwrite(buf, 1, 2 * n + 1, fp);
+}
+
+void
+evlog_json(FILE *fp, const struct evrec *e)
+{
+	const struct dhcphdr *dh = e->dh;
+	const uint8_t *opt, *end = e->opts + e->optlen;
+	char s[INET_ADDRSTRLEN + 32], d[INET_ADDRSTRLEN];
+	time_t t = e->time / 1000000;
+	struct tm tm;
+	const char *sep = "";
+
+	strftime(s, sizeof s, "%Y-%m-%dT%H:%M:%S", gmtime_r(&t, &tm));
+	fprintf(fp, "{\"time\":\"%s.%06uZ\"", s, (unsigned)(e->time % 1000000));
+	fprintf(fp, ",\"smac\":\"%s\"", ether_ntoa_r(&e->smac, s));
+	fprintf(fp, ",\"dmac\":\"%s\"", ether_ntoa_r(&e->dmac, s));
+	if (e->ntags) {
+		fprintf(fp, ",\"vlan\":[");
+		for (int i = 0; i < e->ntags && i < 8; i++)
+			fprintf(fp, "%s%d", i ? "," : "", e->tags[i]);
+		fprintf(fp, "]");
+	}
+	fprintf(fp, ",\"src\":\"%s\",\"sport\":%" PRIu16 ",\"dst\":\"%s\",\"dport\":%" PRIu16,
+		inet_ntop(AF_INET, &e->sip, s, sizeof s), e->sport, inet_ntop(AF_INET, &e->dip, d, sizeof d), e->dport);
+	fprintf(fp, ",\"op\":%" PRIu8 ",\"htype\":%" PRIu8 ",\"hlen\":%" PRIu8 ",\"hops\":%" PRIu8
+			",\"xid\":\"0x%08" PRIx32 "\",\"secs\":%" PRIu16 ",\"flags\":%" PRIu16,
+		dh->op, dh->htype, dh->hlen, dh->hops, ntohl(dh->xid), ntohs(dh->secs), ntohs(dh->flags));
+	fprintf(fp, ",\"ciaddr\":\"%s\"", inet_ntop(AF_INET, &dh->ciaddr, s, sizeof s));
+	fprintf(fp, ",\"yiaddr\":\"%s\"", inet_ntop(AF_INET, &dh->yiaddr, s, sizeof s));
+	fprintf(fp, ",\"siaddr\":\"%s\"", inet_ntop(AF_INET, &dh->siaddr, s, sizeof s));
+	fprintf(fp, ",\"giaddr\":\"%s\"", inet_ntop(AF_INET, &dh->giaddr, s, sizeof s));
+	fprintf(fp, ",\"chaddr\":\"");
+	for (int i = 0; i < dh->hlen && i < DHCPHDR_CHADDR_LEN; i++)
+		fprintf(fp, "%s%02x", i ? ":" : "", dh->chaddr[i]);
+	fprintf(fp, "\"");
+	if (dh->sname[0]) {
+		fprintf(fp, ",\"sname\":");
+		evlog_json_str(fp, dh->sname, strnlen(dh->sname, DHCPHDR_SNAME_LEN));
+	}
+	if (dh->file[0]) {
+		fprintf(fp, ",\"file\":");
+		evlog_json_str(fp, dh->file, strnlen(dh->file, DHCPHDR_FILE_LEN));
+	}
+	fprintf(fp, ",\"options\":[");
+	for (opt = e->opts; opt < end && *opt != DHCPOPT255_END; ) {
+		const char *name, *en;
+
+		if (*opt == DHCPOPT0_PAD) {
+			opt++;
+			continue;
+		}
+		if (end - opt < 2 || end - opt < 2 + opt[1])
+			break;
+		fprintf(fp, "%s{\"code\":%" PRIu8, sep, opt[0]);
+		if ((name = dhcp_option(NULL, opt[0]))) {
+			fprintf(fp, ",\"name\":");
+			evlog_json_str(fp, name, strlen(name));
+		}
+		if (opt[0] == DHCPOPT53_DHCP_MESSAGE_TYPE && opt[1] &&
+				(en = dhcp_option_enum(NULL, opt[0], (void *)(opt + 2)))) {
+			fprintf(fp, ",\"enum\":");
+			evlog_json_str(fp, en, strlen(en));
+		}
+		fprintf(fp, ",\"value\":");
+		evlog_json_hex(fp, opt + 2, opt[1]);
+		fprintf(fp, "}");
+		sep = ",";
+		opt += 2 + opt[1];
+	}
+	fprintf(fp, "]");
+	if (e->optval) {
+		const struct dhcpopt82_value *v = e->optval;
+
+		fprintf(fp, ",\"opt82\":{\"vlanid\":%" PRIu16 ",\"module\":%" PRIu8 ",\"port\":%" PRIu8,
+			v->vlanid, v->module, v->port);
+		if (v->flags & DHCPOPT82_V_ETHER)
+			fprintf(fp, ",\"ether\":\"%s\"", ether_ntoa_r(&v->ether, s));
+		if (v->flags & DHCPOPT82_V_STR) {
+			fprintf(fp, ",\"remote_id\":");
+			evlog_json_str(fp, v->str, v->slen);
+		}
+		fprintf(fp, "}");
+	}
+	fprintf(fp, "}\n");
+}
@@ -0,0 +1,134 @@
+#ifndef __evlog_h__
+#define __evlog_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+
+#include "foo.h"
+#include "dhcp.h"
+#include "opt82.h"
+
+DECL_ERROR(E_EVLOGFORMAT)
+
+/* Журнал событий: пакеты, прошедшие фильтры и прореживание, в компактном
+ * двоичном виде (--write-log) - 100-300 байт на пакет против 1-2 Кб текста
+ * dhcp_show() - и печать его текстом или JSON (--read-log) без pcap.
+ *
+ * Файл:
+ *	struct evlog_filehdr
+ *	блоки: struct evlog_blockhdr и за ним len байт записей, блок - около
+ *	EVLOG_BLOCK байт
+ *	индекс блоков: struct evlog_index[nblocks]
+ *	struct evlog_trailer
+ * Файл без хвоста (писатель упал) читается подряд по длинам блоков, иначе
+ * индекс позволяет сразу перейти к нужному времени.
+ *
+ * Запись - u16 длина и поля:
+ *	u64	время пакета от pcap, мкс
+ *	u8[6]	smac, dmac
+ *	u8	число меток vlan, затем min(n, 8) u16 меток
+ *	u32	ip src, dst; u16 порты src, dst
+ *	u8	флаги EVREC_F_*, длины sname и file без нулей в конце
+ *	u8[44]	заголовок BOOTP от op до chaddr, как в пакете
+ *		sname, file
+ *	u16	длина опций; опции - сырые TLV после cookie до END включительно
+ *		значение опции 82 при EVREC_F_OPT82: u8 flags, u16 vlanid,
+ *		u8 module, port, u8[6] ether, u8 slen, slen байт строки
+ *
+ * Числа - в порядке байт писателя (метка в заголовке файла), адреса и поля
+ * BOOTP - как в пакете. Опции при чтении разбираются текущими описаниями;
+ * блок помечен версией DHCPOPT_DTAB_VERSION писателя, и при расхождении
+ * читатель предупреждает. Значение опции 82 хранится готовым: при чтении не
+ * нужны форматы -F, с которыми писался журнал.
+ */
+#define EVLOG_MAGIC		"DHCPEVL"
+#define EVLOG_TRAILER_MAGIC	"DHCPEVX"
+#define EVLOG_VERSION		1
+#define EVLOG_BOM		0x01020304
+#define EVLOG_BLOCK		65536
+#define EVLOG_BLOCK_MAX		(16 << 20)	/* больше - файл испорчен */
+
+#define EVREC_F_OPT82		0x01
+
+/* Место записи в файле (для внешних индексов): смещение заголовка блока,
+ * сдвинутое на EVLOG_LOC_SHIFT, и смещение записи в блоке - блок не больше
+ * EVLOG_BLOCK_MAX.
+ */
+#define EVLOG_LOC_SHIFT		24
+
+struct evlog_filehdr {
+	char		magic[8];
+	uint32_t	bom;
+	uint16_t	version, reserved;
+};
+
+struct evlog_blockhdr {
+	uint32_t	len, nrec;
+	uint16_t	dtab_version, reserved[3];
+	uint64_t	first, last;	/* время первой и последней записи */
+};
+
+struct evlog_index {
+	uint64_t	off;		/* заголовка блока от начала файла */
+	uint64_t	first, last;
+	uint32_t	nrec, reserved;
+};
+
+struct evlog_trailer {
+	uint64_t	index_off;
+	uint32_t	nblocks, reserved;
+	char		magic[8];
+};
+
+/* Событие. При записи указатели смотрят в пакет; при чтении - во внутренние
+ * буферы журнала до следующего evlog_read(), dh тогда собран заново вместе
+ * с cookie и опциями, и его можно отдать dhcp_decode() до opts + optlen.
+ */
+struct evrec {
+	uint64_t			time;
+	struct ether_addr		smac, dmac;
+	int				ntags;		/* может быть больше 8 */
+	int				tags[8];
+	struct in_addr			sip, dip;
+	uint16_t			sport, dport;
+	const struct dhcphdr		*dh;
+	const uint8_t			*opts;
+	size_t				optlen;
+	const struct dhcpopt82_value	*optval;	/* NULL - нет */
+	uint16_t			dtab_version;	/* при чтении */
+};
+
+struct evlog;
+
+__BEGIN_DECLS
+struct evlog *	evlog_create(const char *path);
+/* место записи, см. EVLOG_LOC_SHIFT */
+uint64_t	evlog_write(struct evlog *evl, const struct evrec *e);
+/* последний блок, индекс и хвост; после неё - только evlog_free(), повторный
+ * вызов ничего не делает
+ */
+void		evlog_finish(struct evlog *evl);
+
+struct evlog *	evlog_open(const char *path);
+/* только записи со временем в [since, until] (мкс; 0 - без границы) */
+void		evlog_range(struct evlog *evl, uint64_t since, uint64_t until);
+/* 1 - в *e следующая запись, 0 - конец */
+int		evlog_read(struct evlog *evl, struct evrec *e);
+void		evlog_json(FILE *fp, const struct evrec *e);
+
+/* Чтение вразбивку: файл отображается в память целиком, evlog_at() разбирает
+ * запись по месту из evlog_write(). Журнал должен быть дописан. Запись в *e -
+ * до следующего evlog_at() с тем же evl.
+ */
+struct evlog *	evlog_map(const char *path);
+void		evlog_at(struct evlog *evl, uint64_t loc, struct evrec *e);
+
+/* и для писателя, и для читателя; без ловушек */
+void		evlog_free(struct evlog *evl);
+__END_DECLS
+
+#endif
@@ -0,0 +1,668 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#ifdef linux
+#include <netinet/ether.h>
+#endif
+
+#include "foo.h"
+#include "dhcp.h"
+#include "opt82.h"
+#include "evlog.h"
+#include "evstore.h"
+
+DEFN_ERROR(E_EVSTOREFORMAT,	"Broken event store index.")
+DEFN_ERROR(E_EVSTORESYNTAX,	"Syntax error in query key.")
+DEFN_ERROR(E_EVSTOREFAILED,	"Some hours of event store are unreadable.")
+
+#define EVSTORE_RKEYS		6	/* ключей у одной записи, не больше */
+#define EVSTORE_THREADS_MAX	64
+
+/* ключ записи */
+struct evstore_rkey {
+	int		kind;
+	uint64_t	key;
+};
+
+struct evstore_keys {
+	struct evstore_ent	*ent;
+	size_t			n, max;
+};
+
+struct evstore {
+	char			*dir;
+	char			path[PATH_MAX - 8];	/* текущего часа, без расширения */
+	struct evlog		*evl;			/* NULL - час не начат */
+	uint64_t		hour;
+	uint64_t		nrec, first, last;
+	struct evstore_keys	keys[EVSTORE_NKEYS];
+};
+
+/* FNV-1a, как у кэша опции 82 */
+static inline
+uint64_t
+evstore_hash(const char *s, size_t len)
+{
+	uint64_t h = 0xcbf29ce484222325ULL ^ len;
+
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ (uint8_t)s[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static inline
+uint64_t
+evstore_ether(const uint8_t *p)
+{
+	uint64_t key = 0;
+
+	for (int i = 0; i < ETHER_ADDR_LEN; i++)
+		key = key << 8 | p[i];
+	return key;
+}
+
+static
+int
+evstore_reckeys(const struct evrec *e, struct evstore_rkey *k)
+{
+	const struct dhcphdr *dh = e->dh;
+	int n = 0;
+
+	if (dh->hlen == ETHER_ADDR_LEN)
+		k[n++] = (struct evstore_rkey){ EVSTORE_MAC, evstore_ether(dh->chaddr) };
+	if (dh->ciaddr.s_addr)
+		k[n++] = (struct evstore_rkey){ EVSTORE_IP, ntohl(dh->ciaddr.s_addr) };
+	if (dh->yiaddr.s_addr && dh->yiaddr.s_addr != dh->ciaddr.s_addr)
+		k[n++] = (struct evstore_rkey){ EVSTORE_IP, ntohl(dh->yiaddr.s_addr) };
+	k[n++] = (struct evstore_rkey){ EVSTORE_XID, ntohl(dh->xid) };
+	if (e->optval && (e->optval->flags & DHCPOPT82_V_ETHER))
+		k[n++] = (struct evstore_rkey){ EVSTORE_CIRCUIT, evstore_ether(e->optval->ether.octet) << 16 |
+			e->optval->module << 8 | e->optval->port };
+	if (e->optval && (e->optval->flags & DHCPOPT82_V_STR))
+		k[n++] = (struct evstore_rkey){ EVSTORE_REMOTE, evstore_hash(e->optval->str, e->optval->slen) };
+	return n;
+}
+
+void
+evstore_free(struct evstore *st)
+{
+	if (st) {
+		evlog_free(st->evl);
+		for (int i = 0; i < EVSTORE_NKEYS; i++)
+			free(st->keys[i].ent);
+		free(st->dir);
+		free(st);
+	}
+}
+
+struct evstore *
+evstore_create(const char *dir)
+{
+	struct ectlfr fr[1];
+	struct evstore *volatile st;
+
+	ectlfr_begin(fr, L_0);
+	st = MALLOC(sizeof *st);
+	memset(st, 0, sizeof *st);
+	ectlfr_ontrap(fr, L_1);
+	st->dir = STRDUP((char *)dir);
+	if (mkdir(dir, 0777) == -1 && errno != EEXIST)
+		ECTL_PTRAP(errno, "mkdir(\"%s\"): %s.\n", dir, strerror(errno));
+	ectlfr_end(fr);
+	return st;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	evstore_free(st);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+static
+int
+evstore_entcmp(const void *a, const void *b)
+{
+	const struct evstore_ent *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return x->loc < y->loc ? -1 : x->loc > y->loc;
+}
+
+/* дописать журнал часа и положить рядом индекс */
+static
+void
+evstore_close(struct evstore *st)
+{
+	struct evstore_idxhdr hdr = { .magic = EVSTORE_IDX_MAGIC, .bom = EVLOG_BOM, .version = EVSTORE_IDX_VERSION };
+	char tmp[PATH_MAX], idx[PATH_MAX];
+	FILE *fp;
+	int err = 0;
+
+	if (!st->evl)
+		return;
+	evlog_finish(st->evl);
+	hdr.first = st->first;
+	hdr.last = st->last;
+	for (int i = 0; i < EVSTORE_NKEYS; i++) {
+		qsort(st->keys[i].ent, st->keys[i].n, sizeof st->keys[i].ent[0], evstore_entcmp);
+		hdr.count[i] = st->keys[i].n;
+	}
+	snprintf(tmp, sizeof tmp, "%s.idx.tmp", st->path);
+	snprintf(idx, sizeof idx, "%s.idx", st->path);
+	if (!(fp = fopen(tmp, "w")))
+		ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", tmp, strerror(errno));
+	if (fwrite(&hdr, sizeof hdr, 1, fp) != 1)
+		err = errno;
+	for (int i = 0; i < EVSTORE_NKEYS && !err; i++)
+		if (fwrite(st->keys[i].ent, sizeof st->keys[i].ent[0], st->keys[i].n, fp) != st->keys[i].n)
+			err = errno;
+	if (fclose(fp) && !err)
+		err = errno;
+	if (err) {
+		unlink(tmp);
+		ECTL_PTRAP(err, "\"%s\": %s.\n", tmp, strerror(err));
+	}
+	if (rename(tmp, idx) == -1)
+		ECTL_PTRAP(errno, "rename(\"%s\"): %s.\n", tmp, strerror(errno));
+	evlog_free(st->evl);
+	st->evl = NULL;
+	st->nrec = 0;
+	for (int i = 0; i < EVSTORE_NKEYS; i++)
+		st->keys[i].n = 0;
+}
+
+static
+void
+evstore_open(struct evstore *st, uint64_t hour)
+{
+	time_t t = hour * 3600;
+	char stamp[16], path[PATH_MAX];
+	struct stat sb;
+	struct tm tm;
+
+	strftime(stamp, sizeof stamp, "%Y%m%d%H", gmtime_r(&t, &tm));
+	/* час уже есть - dhcpdump перезапускали */
+	for (int i = 0; ; i++) {
+		int n = i ? snprintf(st->path, sizeof st->path, "%s/%s-%d", st->dir, stamp, i) :
+			snprintf(st->path, sizeof st->path, "%s/%s", st->dir, stamp);
+
+		if (n < 0 || (size_t)n >= sizeof st->path)
+			ECTL_PTRAP(ENAMETOOLONG, "\"%s\": %s.\n", st->dir, strerror(ENAMETOOLONG));
+		snprintf(path, sizeof path, "%s.evl", st->path);
+		if (stat(path, &sb) == -1) {
+			if (errno != ENOENT)
+				ECTL_PTRAP(errno, "stat(\"%s\"): %s.\n", path, strerror(errno));
+			break;
+		}
+	}
+	st->evl = evlog_create(path);
+	st->hour = hour;
+}
+
+static inline
+void
+evstore_add(struct evstore_keys *ks, uint64_t key, uint64_t loc)
+{
+	if (ks->n == ks->max) {
+		ks->max = ks->max ? 2 * ks->max : 4096;
+		ks->ent = REALLOC(ks->ent, ks->max * sizeof ks->ent[0]);
+	}
+	ks->ent[ks->n].key = key;
+	ks->ent[ks->n].loc = loc;
+	ks->n++;
+}
+
+void
+evstore_write(struct evstore *st, const struct evrec *e)
+{
+	uint64_t hour = e->time / EVSTORE_HOUR, loc;
+	struct evstore_rkey k[EVSTORE_RKEYS];
+	int n;
+
+	/* время pcap может немного вернуться назад: такая запись остаётся в
+	 * текущем часе, индекс знает настоящие first и last
+	 */
+	if (!st->evl || hour > st->hour) {
+		evstore_close(st);
+		evstore_open(st, hour);
+	}
+	loc = evlog_write(st->evl, e);
+	if (!st->nrec++)
+		st->first = st->last = e->time;
+	else if (e->time < st->first)
+		st->first = e->time;
+	else if (e->time > st->last)
+		st->last = e->time;
+	n = evstore_reckeys(e, k);
+	for (int i = 0; i < n; i++)
+		evstore_add(st->keys + k[i].kind, k[i].key, loc);
+}
+
+void
+evstore_finish(struct evstore *st)
+{
+	evstore_close(st);
+}
+
+void
+evstore_key_parse(struct evstore_key *k, int kind, const char *arg)
+{
+	struct ether_addr *ea;
+	struct in_addr in;
+	unsigned long v, module = 0, port;
+	char buf[32], *end;
+	const char *sl;
+
+	k->kind = kind;
+	k->str = NULL;
+	switch (kind) {
+	case EVSTORE_MAC:
+		if (!(ea = ether_aton(arg)))
+			ECTL_TRAP(E_EVSTORESYNTAX, "\"%s\": expected MAC address.\n", arg);
+		k->key = evstore_ether(ea->octet);
+		break;
+	case EVSTORE_IP:
+		if (inet_pton(AF_INET, arg, &in) != 1)
+			ECTL_TRAP(E_EVSTORESYNTAX, "\"%s\": expected IPv4 address.\n", arg);
+		k->key = ntohl(in.s_addr);
+		break;
+	case EVSTORE_XID:
+		errno = 0;
+		v = strtoul(arg, &end, 0);
+		if (errno || end == arg || *end || v > UINT32_MAX)
+			ECTL_TRAP(E_EVSTORESYNTAX, "\"%s\": expected xid.\n", arg);
+		k->key = v;
+		break;
+	case EVSTORE_CIRCUIT:
+		/* MAC/port или MAC/module/port */
+		if (!(sl = strchr(arg, '/')) || (size_t)(sl - arg) >= sizeof buf)
+			goto L_circuit;
+		memcpy(buf, arg, sl - arg);
+		buf[sl - arg] = '\0';
+		if (!(ea = ether_aton(buf)))
+			goto L_circuit;
+		errno = 0;
+		port = strtoul(sl + 1, &end, 10);
+		if (*end == '/') {
+			module = port;
+			sl = end;
+			port = strtoul(sl + 1, &end, 10);
+		}
+		if (errno || end == sl + 1 || *end || module > UINT8_MAX || port > UINT8_MAX)
+			goto L_circuit;
+		k->key = evstore_ether(ea->octet) << 16 | module << 8 | port;
+		break;
+	L_circuit:
+		ECTL_TRAP(E_EVSTORESYNTAX, "\"%s\": expected MAC[/module]/port.\n", arg);
+	case EVSTORE_REMOTE:
+		if (strlen(arg) > DHCPOPT82_STR_MAX)
+			ECTL_TRAP(E_EVSTORESYNTAX, "\"%s\": remote-id longer than %d.\n", arg, DHCPOPT82_STR_MAX);
+		k->key = evstore_hash(arg, strlen(arg));
+		k->str = arg;
+		break;
+	}
+}
+
+/* Поиск */
+
+#define EVSTORE_SEG_PENDING	0
+#define EVSTORE_SEG_DONE	1
+#define EVSTORE_SEG_FAILED	2
+
+struct evstore_seg {
+	char		*name;		/* путь без расширения */
+	struct evlog	*evl;		/* NULL - ничего не найдено */
+	uint64_t	*locs;		/* найденные записи по порядку */
+	size_t		n;
+	atomic_int	state;		/* EVSTORE_SEG_* */
+};
+
+struct evstore_search {
+	const struct evstore_key	*k;
+	int				nk;
+	uint64_t			since, until;
+	struct evstore_seg		*segs;
+	size_t				nsegs;
+	atomic_size_t			next;	/* следующий час для потоков */
+	atomic_int			stop;
+	pthread_mutex_t			mtx;
+	pthread_cond_t			done;	/* какой-то час готов */
+};
+
+static inline
+int
+evstore_outside(const struct evstore_search *s, uint64_t first, uint64_t last)
+{
+	return (s->since && last < s->since) || (s->until && first > s->until);
+}
+
+static
+int
+evstore_match(const struct evstore_search *s, const struct evrec *e)
+{
+	struct evstore_rkey rk[EVSTORE_RKEYS];
+	int n = evstore_reckeys(e, rk);
+
+	for (int i = 0; i < s->nk; i++) {
+		const struct evstore_key *k = s->k + i;
+		int j;
+
+		for (j = 0; j < n; j++)
+			if (rk[j].kind == k->kind && rk[j].key == k->key && (!k->str ||
+					(strlen(k->str) == e->optval->slen && !memcmp(k->str, e->optval->str, e->optval->slen))))
+				break;
+		if (j == n)
+			return 0;
+	}
+	return 1;
+}
+
+static
+void
+evstore_seg_free(struct evstore_seg *seg)
+{
+	evlog_free(seg->evl);
+	seg->evl = NULL;
+	free(seg->locs);
+	seg->locs = NULL;
+	seg->n = 0;
+}
+
+/* индекс часа целиком в память; проверен заголовок и длина */
+static
+const struct evstore_idxhdr *
+evstore_mapidx(const char *path, size_t *len)
+{
+	const struct evstore_idxhdr *hdr;
+	struct stat sb;
+	uint64_t need;
+	void *map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		ECTL_PTRAP(errno, "open(\"%s\"): %s.\n", path, strerror(errno));
+	if (fstat(fd, &sb) == -1 || (uint64_t)sb.st_size < sizeof *hdr) {
+		close(fd);
+		ECTL_TRAP(E_EVSTOREFORMAT, "\"%s\": short index.\n", path);
+	}
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		ECTL_PTRAP(errno, "mmap(\"%s\"): %s.\n", path, strerror(errno));
+	hdr = map;
+	need = sizeof *hdr;
+	for (int i = 0; i < EVSTORE_NKEYS; i++)
+		need += (uint64_t)hdr->count[i] * sizeof(struct evstore_ent);
+	if (memcmp(hdr->magic, EVSTORE_IDX_MAGIC, sizeof hdr->magic) || hdr->bom != EVLOG_BOM ||
+			hdr->version != EVSTORE_IDX_VERSION || need != (uint64_t)sb.st_size) {
+		munmap(map, sb.st_size);
+		ECTL_TRAP(E_EVSTOREFORMAT, "\"%s\": not an event store index or broken.\n", path);
+	}
+	*len = sb.st_size;
+	return hdr;
+}
+
+/* первый элемент с ключом не меньше key */
+static
+size_t
+evstore_lower(const struct evstore_ent *ent, size_t n, uint64_t key)
+{
+	size_t lo = 0;
+
+	while (n) {
+		size_t half = n / 2;
+
+		if (ent[lo + half].key < key) {
+			lo += half + 1;
+			n -= half + 1;
+		} else
+			n = half;
+	}
+	return lo;
+}
+
+static
+void
+evstore_seg_search(struct evstore_search *s, struct evstore_seg *seg)
+{
+	struct ectlfr fr[1];
+	const struct evstore_idxhdr *volatile hdr;
+	volatile size_t maplen;
+	size_t len, off[EVSTORE_NKEYS], lo = 0, n = SIZE_MAX;
+	const struct evstore_ent *ent = NULL;
+	char path[PATH_MAX];
+	struct evrec e[1];
+
+	ectlfr_begin(fr, L_0);
+	snprintf(path, sizeof path, "%s.idx", seg->name);
+	hdr = evstore_mapidx(path, &len);
+	maplen = len;
+	ectlfr_ontrap(fr, L_1);
+	if (evstore_outside(s, hdr->first, hdr->last))
+		goto L_done;
+	off[0] = 0;
+	for (int i = 1; i < EVSTORE_NKEYS; i++)
+		off[i] = off[i - 1] + hdr->count[i - 1];
+	/* самый редкий ключ: его записи проверяются по журналу */
+	for (int i = 0; i < s->nk; i++) {
+		const struct evstore_ent *ke = (const struct evstore_ent *)(hdr + 1) + off[s->k[i].kind];
+		size_t cnt = hdr->count[s->k[i].kind], klo = evstore_lower(ke, cnt, s->k[i].key), kn;
+
+		kn = s->k[i].key == UINT64_MAX ? cnt - klo : evstore_lower(ke, cnt, s->k[i].key + 1) - klo;
+		if (kn < n) {
+			ent = ke;
+			lo = klo;
+			n = kn;
+		}
+	}
+	if (!n)
+		goto L_done;
+	seg->locs = MALLOC(n * sizeof seg->locs[0]);
+	snprintf(path, sizeof path, "%s.evl", seg->name);
+	seg->evl = evlog_map(path);
+	/* записи одного ключа отсортированы по месту, то есть по порядку записи */
+	for (size_t i = lo; i < lo + n; i++) {
+		evlog_at(seg->evl, ent[i].loc, e);
+		if (!evstore_outside(s, e->time, e->time) && evstore_match(s, e))
+			seg->locs[seg->n++] = ent[i].loc;
+	}
+	if (!seg->n)
+		evstore_seg_free(seg);
+L_done:
+	munmap((void *)hdr, maplen);
+	ectlfr_end(fr);
+	return;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	munmap((void *)hdr, maplen);
+	evstore_seg_free(seg);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+/* Поиск в часе со своим кадром ошибок: испорченный час пишется в лог и
+ * пропускается, остальные печатаются
+ */
+static
+int
+evstore_seg_try(struct evstore_search *s, struct evstore_seg *seg)
+{
+	struct ectlfr fr[1];
+	struct ectlno ex[1];
+	volatile int state = EVSTORE_SEG_FAILED;
+
+	ectlfr_begin(fr, L_0);
+	ectlno_begin(ex);
+	evstore_seg_search(s, seg);
+	state = EVSTORE_SEG_DONE;
+	goto L_1;
+
+L_0:	ectlno_log();
+	ectlno_clearmessage();
+L_1:	ectlno_end(ex);
+	ectlfr_end(fr);
+	return state;
+}
+
+static
+void *
+evstore_thread(void *arg)
+{
+	struct evstore_search *s = arg;
+	size_t i;
+
+	while (!atomic_load(&s->stop) && (i = atomic_fetch_add(&s->next, 1)) < s->nsegs) {
+		int state = evstore_seg_try(s, s->segs + i);
+
+		pthread_mutex_lock(&s->mtx);
+		atomic_store(&s->segs[i].state, state);
+		pthread_cond_signal(&s->done);
+		pthread_mutex_unlock(&s->mtx);
+	}
+	return NULL;
+}
+
+/* "YYYYmmddHH.idx" или "YYYYmmddHH-N.idx" после перезапуска: час и номер */
+static
+int
+evstore_segname(const char *name, uint64_t *hour, unsigned long *seq)
+{
+	char *end;
+
+	if (!isdigit((unsigned char)*name))
+		return 0;
+	*hour = strtoull(name, &end, 10);
+	*seq = 0;
+	if (end - name != 10)
+		return 0;
+	if (*end == '-') {
+		if (!isdigit((unsigned char)end[1]))
+			return 0;
+		*seq = strtoul(end + 1, &end, 10);
+	}
+	return !strcmp(end, ".idx");
+}
+
+static
+int
+evstore_isidx(const struct dirent *d)
+{
+	uint64_t hour;
+	unsigned long seq;
+
+	return evstore_segname(d->d_name, &hour, &seq);
+}
+
+/* alphasort ставит "-1" раньше самого часа и "-10" раньше "-2" */
+static
+int
+evstore_segcmp(const struct dirent **a, const struct dirent **b)
+{
+	uint64_t ha, hb;
+	unsigned long sa, sb;
+
+	evstore_segname((*a)->d_name, &ha, &sa);
+	evstore_segname((*b)->d_name, &hb, &sb);
+	if (ha != hb)
+		return ha < hb ? -1 : 1;
+	return sa < sb ? -1 : sa > sb;
+}
+
+void
+evstore_query(const char *dir, const struct evstore_key *k, int nk,
+	uint64_t since, uint64_t until, int nthreads,
+	void (*emit)(const struct evrec *e, void *arg), void *arg)
+{
+	struct ectlfr fr[1];
+	struct evstore_search s[1];
+	struct dirent **volatile names = NULL;
+	volatile int nnames = 0, nthr = 0, ok = 0;
+	volatile size_t failed = 0;
+	pthread_t thr[EVSTORE_THREADS_MAX];
+	struct evrec e[1];
+	int n;
+
+	ectlfr_begin(fr, L_0);
+	memset(s, 0, sizeof *s);
+	s->k = k;
+	s->nk = nk;
+	s->since = since;
+	s->until = until;
+	if ((n = scandir(dir, (struct dirent ***)&names, evstore_isidx, evstore_segcmp)) == -1)
+		ECTL_PTRAP(errno, "scandir(\"%s\"): %s.\n", dir, strerror(errno));
+	nnames = n;
+	ectlfr_ontrap(fr, L_1);
+	s->segs = MALLOC((nnames ? nnames : 1) * sizeof s->segs[0]);
+	memset(s->segs, 0, (nnames ? nnames : 1) * sizeof s->segs[0]);
+	for (int i = 0; i < nnames; i++) {
+		size_t len = strlen(names[i]->d_name) - 4;
+
+		s->segs[i].name = MALLOC(strlen(dir) + 1 + len + 1);
+		sprintf(s->segs[i].name, "%s/%.*s", dir, (int)len, names[i]->d_name);
+		s->nsegs++;
+	}
+	PTHREAD_MUTEX_INIT(&s->mtx, NULL);
+	ectlfr_ontrap(fr, L_2);
+	PTHREAD_COND_INIT(&s->done, NULL);
+	ectlfr_ontrap(fr, L_3);
+	if (nthreads > EVSTORE_THREADS_MAX)
+		nthreads = EVSTORE_THREADS_MAX;
+	while (nthr < nthreads && (size_t)nthr < s->nsegs) {
+		PTHREAD_CREATE(thr + nthr, NULL, evstore_thread, s);
+		nthr++;
+	}
+	/* часы печатаются по порядку, как только их поток закончил */
+	for (size_t i = 0; i < s->nsegs; i++) {
+		struct evstore_seg *seg = s->segs + i;
+
+		PTHREAD_MUTEX_LOCK(&s->mtx);
+		while (atomic_load(&seg->state) == EVSTORE_SEG_PENDING)
+			PTHREAD_COND_WAIT(&s->done, &s->mtx);
+		PTHREAD_MUTEX_UNLOCK(&s->mtx);
+		if (atomic_load(&seg->state) == EVSTORE_SEG_FAILED)
+			failed++;
+		for (size_t j = 0; j < seg->n; j++) {
+			evlog_at(seg->evl, seg->locs[j], e);
+			emit(e, arg);
+		}
+		evstore_seg_free(seg);
+	}
+	if (failed)
+		ECTL_TRAP(E_EVSTOREFAILED, "%zu of %zu hours skipped.\n", failed, s->nsegs);
+	ok = 1;
+
+L_3:	ectlfr_ontrap(fr, L_2);
+	atomic_store(&s->stop, 1);
+	for (int i = 0; i < nthr; i++)
+		pthread_join(thr[i], NULL);
+	pthread_cond_destroy(&s->done);
+L_2:	ectlfr_ontrap(fr, L_1);
+	pthread_mutex_destroy(&s->mtx);
+L_1:	ectlfr_ontrap(fr, L_0);
+	for (size_t i = 0; i < s->nsegs; i++) {
+		evstore_seg_free(s->segs + i);
+		free(s->segs[i].name);
+	}
+	free(s->segs);
+	for (int i = 0; i < nnames; i++)
+		free(names[i]);
+	free(names);
+L_0:	ectlfr_end(fr);
+	if (!ok)
+		ectlfr_trap();
+}
@@ -0,0 +1,92 @@
+#ifndef __evstore_h__
+#define __evstore_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "foo.h"
+#include "evlog.h"
+
+DECL_ERROR(E_EVSTOREFORMAT)
+DECL_ERROR(E_EVSTORESYNTAX)
+DECL_ERROR(E_EVSTOREFAILED)
+
+/* Хранилище событий (--store dir): журналы событий (evlog.h), нарезанные по
+ * часам UTC, и к каждому - отсортированный индекс ключей:
+ *
+ *	dir/YYYYmmddHH.evl	журнал часа; повторный запуск в тот же час
+ *				начинает YYYYmmddHH-1.evl и т.д.
+ *	dir/YYYYmmddHH.idx	индекс, пишется при закрытии часа (через
+ *				переименование) - есть индекс, значит журнал
+ *				дописан
+ *
+ * Индекс: struct evstore_idxhdr и за ним EVSTORE_NKEYS массивов struct
+ * evstore_ent по count[k] элементов, каждый отсортирован по (key, loc); loc -
+ * место записи в журнале (EVLOG_LOC_SHIFT). Ключи записи:
+ *	mac		chaddr (hlen 6), 48 бит
+ *	ip		ciaddr и yiaddr, кроме 0.0.0.0, в порядке хоста
+ *	xid
+ *	circuit		опция 82 с ether: ether << 16 | module << 8 | port
+ *	remote-id	опция 82 со строкой: FNV-1a строки, строка сверяется
+ *			при поиске
+ * Индекс читается через mmap, поиск - двоичный, запись с ключом - сразу по
+ * месту в журнале без чтения соседних.
+ *
+ * dhcpdump query: часы перебирают несколько потоков, каждый ищет в своём часе
+ * самый редкий из заданных ключей и проверяет по журналу остальные ключи и
+ * окно времени; печать идёт по порядку часов, по мере готовности.
+ */
+#define EVSTORE_IDX_MAGIC	"DHCPEVI"
+#define EVSTORE_IDX_VERSION	1
+#define EVSTORE_HOUR		(3600 * (uint64_t)1000000)	/* мкс */
+
+#define EVSTORE_MAC		0
+#define EVSTORE_IP		1
+#define EVSTORE_XID		2
+#define EVSTORE_CIRCUIT		3
+#define EVSTORE_REMOTE		4
+#define EVSTORE_NKEYS		5
+
+struct evstore_idxhdr {
+	char		magic[8];
+	uint32_t	bom;			/* EVLOG_BOM */
+	uint16_t	version, reserved;
+	uint64_t	first, last;		/* время записей часа */
+	uint32_t	count[EVSTORE_NKEYS], reserved2;
+};
+
+struct evstore_ent {
+	uint64_t	key, loc;
+};
+
+/* Ключ запроса; str - для remote-id */
+struct evstore_key {
+	int		kind;
+	uint64_t	key;
+	const char	*str;
+};
+
+struct evstore;
+
+__BEGIN_DECLS
+struct evstore *	evstore_create(const char *dir);
+void			evstore_write(struct evstore *st, const struct evrec *e);
+/* дописать текущий час с индексом; повторный вызов ничего не делает */
+void			evstore_finish(struct evstore *st);
+/* без ловушек */
+void			evstore_free(struct evstore *st);
+
+/* kind EVSTORE_*, аргумент: MAC; IPv4; xid (0x... или десятичный);
+ * MAC[/module]/port; строка remote-id
+ */
+void			evstore_key_parse(struct evstore_key *k, int kind, const char *arg);
+/* Записи со всеми ключами k во времени [since, until] (мкс, 0 - без границы)
+ * по порядку; emit() зовётся из вызывающего потока, запись - до возврата
+ */
+void			evstore_query(const char *dir, const struct evstore_key *k, int nk,
+				uint64_t since, uint64_t until, int nthreads,
+				void (*emit)(const struct evrec *e, void *arg), void *arg);
+__END_DECLS
+
+#endif
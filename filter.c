@@ -0,0 +1,1050 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef linux
+#include <netinet/ether.h>
+#endif
+
+#include "foo.h"
+#include "ip.h"
+#include "dhcp.h"
+#include "opt82.h"
+#include "watch.h"
+#include "filter.h"
+
+DEFN_ERROR(E_FILTERSYNTAX,	"Syntax error in filter expression.")
+
+enum {
+	FOP_OP,
+	FOP_MSGTYPE,
+	FOP_OPTION,		/* option N */
+	FOP_OPTVAL,		/* option N = байты */
+	FOP_CHADDR,
+	FOP_CHADDR_IN,
+	FOP_IP,			/* arg: FIP_* */
+	FOP_IP_IN,
+	FOP_XID,
+	FOP_HOPS,
+	FOP_VLAN,		/* любая метка */
+	FOP_VLANI,		/* arg-я метка */
+	FOP_VLANS,
+	FOP_RELAY,
+	FOP_RELAY_VLAN,
+	FOP_RELAY_MODULE,
+	FOP_RELAY_PORT,
+	FOP_RELAY_MAC,
+	FOP_RELAY_STR,
+	FOP_RELAY_FORMAT,
+	FOP_RELAY_IN,
+	FOP_MAX
+};
+
+enum { FCMP_EQ, FCMP_NE, FCMP_LT, FCMP_LE, FCMP_GT, FCMP_GE };
+static const char *const fcmp_names[] = { "=", "!=", "<", "<=", ">", ">=" };
+
+enum { FIP_CIADDR, FIP_YIADDR, FIP_SIADDR, FIP_GIADDR, FIP_SRC };
+static const char *const fip_names[] = { "ciaddr", "yiaddr", "siaddr", "giaddr", "src" };
+
+/* Оценки условий: prob - доля пакетов, для которых "=" истинно, cost - цена
+ * проверки в условных единицах. Поля заголовка и vlan - 1, опции требуют
+ * декодирования пакета - 4, опция 82 ещё и распознавания - 8. Оценки грубые:
+ * важен только порядок, в котором они расставляют условия.
+ */
+static const struct {
+	const char	*name;
+	double		prob, cost;
+} fops[FOP_MAX] = {
+	[FOP_OP]		= { "op",		0.5,	1 },
+	[FOP_MSGTYPE]		= { "msgtype",		0.25,	4 },
+	[FOP_OPTION]		= { "option",		0.5,	4 },
+	[FOP_OPTVAL]		= { "option",		0.05,	4 },
+	[FOP_CHADDR]		= { "chaddr",		0.001,	1 },
+	[FOP_CHADDR_IN]		= { "chaddr in",	0.01,	2 },
+	[FOP_IP]		= { "ip",		0.01,	1 },
+	[FOP_IP_IN]		= { "ip in",		0.1,	2 },
+	[FOP_XID]		= { "xid",		0.0001,	1 },
+	[FOP_HOPS]		= { "hops",		0.5,	1 },
+	[FOP_VLAN]		= { "vlan",		0.05,	1 },
+	[FOP_VLANI]		= { "vlan[]",		0.05,	1 },
+	[FOP_VLANS]		= { "vlans",		0.5,	1 },
+	[FOP_RELAY]		= { "relay",		0.8,	8 },
+	[FOP_RELAY_VLAN]	= { "relay.vlan",	0.05,	8 },
+	[FOP_RELAY_MODULE]	= { "relay.module",	0.3,	8 },
+	[FOP_RELAY_PORT]	= { "relay.port",	0.05,	8 },
+	[FOP_RELAY_MAC]		= { "relay.mac",	0.01,	8 },
+	[FOP_RELAY_STR]		= { "relay.str",	0.01,	8 },
+	[FOP_RELAY_FORMAT]	= { "relay.format",	0.3,	8 },
+	[FOP_RELAY_IN]		= { "relay in",		0.01,	9 },
+};
+
+static const char *const msgtype_names[] = {
+	[DHCPDISCOVER] = "discover", [DHCPOFFER] = "offer", [DHCPREQUEST] = "request",
+	[DHCPDECLINE] = "decline", [DHCPACK] = "ack", [DHCPNAK] = "nak",
+	[DHCPRELEASE] = "release", [DHCPINFORM] = "inform",
+};
+
+/* время декодирования и распознавания достаётся их стадиям, а не той, что
+ * их потребовала
+ */
+struct dhcp *
+filterctx_dhcp(struct filterctx *ctx)
+{
+	if (!ctx->dp) {
+		STAGETIME_ENTER(ctx->st, STAGE_DECODE);
+		ctx->dp = dhcp_decode(&ctx->cp, ctx->cp_end, ctx->demand);
+		STAGETIME_LEAVE(ctx->st);
+	}
+	return ctx->dp;
+}
+
+const struct dhcpopt82_value *
+filterctx_opt82(struct filterctx *ctx)
+{
+	struct dhcp *dp;
+
+	if (!ctx->opt82_state) {
+		dp = filterctx_dhcp(ctx);
+		STAGETIME_ENTER(ctx->st, STAGE_OPT82);
+		ctx->opt82_state = dhcpopt82_lookup(ctx->opt82_cache, dp->opts, &ctx->opt82val) ? 2 : 1;
+		STAGETIME_LEAVE(ctx->st);
+	}
+	return ctx->opt82_state == 2 ? &ctx->opt82val : NULL;
+}
+
+/*
+ * Разбор
+ */
+enum { T_END, T_WORD, T_STR, T_LP, T_RP, T_LB, T_RB, T_COMMA, T_CMP };
+
+enum { N_PRED, N_NOT, N_AND, N_OR };
+
+/* Узлы дерева лежат в одном массиве и ссылаются друг на друга индексами:
+ * при ошибке всё освобождается одним проходом.
+ */
+struct fnode {
+	int			type;		/* N_* */
+	int			first, next;	/* первый ребёнок, следующий брат; -1 - нет */
+	double			prob, cost;
+	struct filter_insn	insn;		/* N_PRED */
+};
+
+struct fparser {
+	const char	*text, *cur;
+	int		tok, tokpos, cmp;
+	int		len;
+	char		buf[256];	/* T_WORD, T_STR */
+	struct fnode	*nodes;
+	int		nnodes, size;
+	struct dhcpoptset raw;
+};
+
+static
+void __attribute__((__noreturn__, __format__(__printf__, 2, 3)))
+fparser_error(struct fparser *ps, const char *fmt, ...)
+{
+	char msg[128];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof msg, fmt, ap);
+	va_end(ap);
+	ECTL_TRAP(E_FILTERSYNTAX, "\"%s\": offset %d: %s.\n", ps->text, ps->tokpos, msg);
+}
+
+static
+void
+fparser_next(struct fparser *ps)
+{
+	const char *p = ps->cur;
+
+	while (isspace((unsigned char)*p))
+		p++;
+	ps->tokpos = p - ps->text;
+	ps->len = 0;
+	switch (*p) {
+	case 0:
+		ps->tok = T_END;
+		break;
+	case '(': ps->tok = T_LP; p++; break;
+	case ')': ps->tok = T_RP; p++; break;
+	case '[': ps->tok = T_LB; p++; break;
+	case ']': ps->tok = T_RB; p++; break;
+	case ',': ps->tok = T_COMMA; p++; break;
+	case '=':
+		ps->tok = T_CMP;
+		ps->cmp = FCMP_EQ;
+		p += p[1] == '=' ? 2 : 1;
+		break;
+	case '!':
+		if (p[1] != '=') {
+			ps->cur = p;
+			fparser_error(ps, "expected \"!=\"");
+		}
+		ps->tok = T_CMP;
+		ps->cmp = FCMP_NE;
+		p += 2;
+		break;
+	case '<':
+	case '>':
+		ps->tok = T_CMP;
+		ps->cmp = *p == '<' ? (p[1] == '=' ? FCMP_LE : FCMP_LT) : (p[1] == '=' ? FCMP_GE : FCMP_GT);
+		p += p[1] == '=' ? 2 : 1;
+		break;
+	case '"':
+		ps->tok = T_STR;
+		for (p++; *p != '"'; p++) {
+			if (!*p)
+				fparser_error(ps, "unterminated string");
+			if (*p == '\\' && p[1])
+				p++;
+			if (ps->len == sizeof ps->buf - 1)
+				fparser_error(ps, "string is too long");
+			ps->buf[ps->len++] = *p;
+		}
+		p++;
+		break;
+	default:
+		ps->tok = T_WORD;
+		for (; *p && !isspace((unsigned char)*p) && !strchr("()[],=!<>\"", *p); p++) {
+			if (ps->len == sizeof ps->buf - 1)
+				fparser_error(ps, "word is too long");
+			ps->buf[ps->len++] = *p;
+		}
+		break;
+	}
+	ps->buf[ps->len] = 0;
+	ps->cur = p;
+}
+
+static inline
+int
+fparser_isword(struct fparser *ps, const char *word)
+{
+	return ps->tok == T_WORD && !strcmp(ps->buf, word);
+}
+
+static
+int
+fnode_new(struct fparser *ps, int type)
+{
+	struct fnode *n;
+
+	if (ps->nnodes == ps->size) {
+		ps->size = ps->size ? 2 * ps->size : 16;
+		ps->nodes = REALLOC(ps->nodes, ps->size * sizeof ps->nodes[0]);
+	}
+	n = ps->nodes + ps->nnodes;
+	memset(n, 0, sizeof *n);
+	n->type = type;
+	n->first = n->next = -1;
+	return ps->nnodes++;
+}
+
+/* ребёнок добавляется в конец; однотипный and/or раскрывается: a and (b and c) */
+static
+void
+fnode_append(struct fparser *ps, int parent, int *tail, int child)
+{
+	if (ps->nodes[child].type == ps->nodes[parent].type && ps->nodes[child].type != N_NOT) {
+		for (int c = ps->nodes[child].first, next; c >= 0; c = next) {
+			next = ps->nodes[c].next;
+			ps->nodes[c].next = -1;
+			fnode_append(ps, parent, tail, c);
+		}
+		return;
+	}
+	if (*tail < 0)
+		ps->nodes[parent].first = child;
+	else
+		ps->nodes[*tail].next = child;
+	*tail = child;
+}
+
+static
+void
+fparser_expect(struct fparser *ps, int tok, const char *what)
+{
+	if (ps->tok != tok)
+		fparser_error(ps, "expected %s", what);
+	fparser_next(ps);
+}
+
+/* Сравнение; пропущенное - "=". eqonly - допустимы только = и != */
+static
+int
+fparser_cmp(struct fparser *ps, int eqonly)
+{
+	int cmp = FCMP_EQ;
+
+	if (ps->tok == T_CMP) {
+		cmp = ps->cmp;
+		if (eqonly && cmp != FCMP_EQ && cmp != FCMP_NE)
+			fparser_error(ps, "only \"=\" and \"!=\" are allowed here");
+		fparser_next(ps);
+	}
+	return cmp;
+}
+
+static
+uint32_t
+fparser_number(struct fparser *ps, uint32_t max)
+{
+	unsigned long n;
+	char *end;
+
+	if (ps->tok != T_WORD)
+		fparser_error(ps, "expected number");
+	errno = 0;
+	n = strtoul(ps->buf, &end, 0);
+	if (errno || *end || !isdigit((unsigned char)ps->buf[0]) || n > max)
+		fparser_error(ps, "\"%s\": expected number 0..%" PRIu32, ps->buf, max);
+	fparser_next(ps);
+	return n;
+}
+
+static
+void
+fparser_mac(struct fparser *ps, uint8_t *mac)
+{
+	struct ether_addr *ea;
+
+	if (ps->tok != T_WORD || !(ea = ether_aton(ps->buf)))
+		fparser_error(ps, "expected MAC address");
+	memcpy(mac, ea, ETHER_ADDR_LEN);
+	fparser_next(ps);
+}
+
+static
+char *
+fparser_string(struct fparser *ps)
+{
+	char *s;
+
+	if (ps->tok != T_STR && ps->tok != T_WORD)
+		fparser_error(ps, "expected string");
+	s = STRDUP(ps->buf);
+	fparser_next(ps);
+	return s;
+}
+
+/* "строка" или байты в hex: 0a0b0c */
+static
+uint8_t *
+fparser_bytes(struct fparser *ps, uint8_t *len)
+{
+	uint8_t *b;
+
+	if (ps->tok == T_STR) {
+		*len = ps->len;
+		b = MALLOC(ps->len + 1);
+		memcpy(b, ps->buf, ps->len);
+	} else {
+		if (ps->tok != T_WORD || (ps->len & 1))
+			fparser_error(ps, "expected hex bytes or string");
+		for (int i = 0; i < ps->len; i++)
+			if (!isxdigit((unsigned char)ps->buf[i]))
+				fparser_error(ps, "expected hex bytes or string");
+		*len = ps->len / 2;
+		b = MALLOC(*len + 1);
+		for (int i = 0; i < *len; i++) {
+			char x[3] = { ps->buf[2 * i], ps->buf[2 * i + 1], 0 };
+			b[i] = strtoul(x, NULL, 16);
+		}
+	}
+	fparser_next(ps);
+	return b;
+}
+
+/* @файл или @"файл" */
+static
+const char *
+fparser_file(struct fparser *ps)
+{
+	if (fparser_isword(ps, "@")) {
+		fparser_next(ps);
+		if (ps->tok != T_STR)
+			fparser_error(ps, "expected file name");
+		return ps->buf;
+	}
+	if (ps->tok != T_WORD || ps->buf[0] != '@' || !ps->buf[1])
+		fparser_error(ps, "expected @file");
+	return ps->buf + 1;
+}
+
+/* Сегменты IP и @файлы (см. ipmap_load()) через запятую; результат заморожен */
+static
+struct ipmap_frozen *
+fparser_ipmap(struct fparser *ps)
+{
+	struct rbtree *volatile map;
+	struct ipmap_frozen *f;
+	struct ectlfr fr[1];
+
+	map = ipmap_create();
+	ectlfr_begin(fr, L_1);
+	do {
+		struct ipseg seg;
+		const char *ep;
+
+		if (ps->tok == T_WORD && ps->buf[0] == '@')
+			ipmap_load(map, fparser_file(ps));
+		else if (ps->tok != T_WORD || !cstr_to_ipseg(&seg, ps->buf, &ep) || *ep)
+			fparser_error(ps, "expected IP, IP-IP, IP/N or @file");
+		else
+			ipmap_map(map, seg.a, seg.b);
+		fparser_next(ps);
+		if (ps->tok != T_COMMA)
+			break;
+		fparser_next(ps);
+	} while (1);
+	f = ipmap_freeze(map);
+	ipmap_destroy(map);
+	ectlfr_end(fr);
+	return f;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	ipmap_destroy(map);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+static
+int
+fparser_pred(struct fparser *ps)
+{
+	int idx = fnode_new(ps, N_PRED);
+	/* ресурсы условия сразу в узле: при ошибке их освободит filter_compile() */
+	struct filter_insn *insn = &ps->nodes[idx].insn;
+
+	if (ps->tok != T_WORD)
+		fparser_error(ps, "expected condition");
+
+	if (fparser_isword(ps, "op")) {
+		insn->op = FOP_OP;
+		fparser_next(ps);
+		insn->cmp = fparser_cmp(ps, 1);
+		if (fparser_isword(ps, "request"))
+			insn->k = BOOTREQUEST;
+		else if (fparser_isword(ps, "reply"))
+			insn->k = BOOTREPLY;
+		else
+			fparser_error(ps, "expected request or reply");
+		fparser_next(ps);
+	} else if (fparser_isword(ps, "msgtype")) {
+		insn->op = FOP_MSGTYPE;
+		fparser_next(ps);
+		insn->cmp = fparser_cmp(ps, 0);
+		for (size_t i = 0; i < sizeof msgtype_names/sizeof msgtype_names[0]; i++)
+			if (msgtype_names[i] && fparser_isword(ps, msgtype_names[i])) {
+				insn->k = i;
+				fparser_next(ps);
+				goto L_done;
+			}
+		insn->k = fparser_number(ps, 255);
+	} else if (fparser_isword(ps, "option")) {
+		fparser_next(ps);
+		insn->arg = fparser_number(ps, 255);
+		insn->op = FOP_OPTION;
+		if (ps->tok == T_CMP) {
+			insn->op = FOP_OPTVAL;
+			insn->cmp = fparser_cmp(ps, 1);
+			insn->p = fparser_bytes(ps, &insn->len);
+			dhcpoptset_add(&ps->raw, insn->arg);
+		}
+	} else if (fparser_isword(ps, "chaddr")) {
+		fparser_next(ps);
+		if (fparser_isword(ps, "in")) {
+			insn->op = FOP_CHADDR_IN;
+			fparser_next(ps);
+			insn->p = watchset_load(fparser_file(ps), WATCH_MAC);
+			fparser_next(ps);
+		} else {
+			insn->op = FOP_CHADDR;
+			insn->cmp = fparser_cmp(ps, 1);
+			fparser_mac(ps, insn->mac);
+		}
+	} else if (fparser_isword(ps, "ciaddr") || fparser_isword(ps, "yiaddr") ||
+		   fparser_isword(ps, "siaddr") || fparser_isword(ps, "giaddr") || fparser_isword(ps, "src")) {
+		for (size_t i = 0; i < sizeof fip_names/sizeof fip_names[0]; i++)
+			if (fparser_isword(ps, fip_names[i]))
+				insn->arg = i;
+		fparser_next(ps);
+		if (fparser_isword(ps, "in")) {
+			insn->op = FOP_IP_IN;
+			fparser_next(ps);
+			insn->p = fparser_ipmap(ps);
+		} else {
+			const char *ep;
+
+			insn->op = FOP_IP;
+			insn->cmp = fparser_cmp(ps, 1);
+			if (ps->tok != T_WORD || !cstr_to_ip(&insn->k, ps->buf, &ep) || *ep)
+				fparser_error(ps, "expected IP address");
+			fparser_next(ps);
+		}
+	} else if (fparser_isword(ps, "xid")) {
+		insn->op = FOP_XID;
+		fparser_next(ps);
+		insn->cmp = fparser_cmp(ps, 0);
+		insn->k = fparser_number(ps, UINT32_MAX);
+	} else if (fparser_isword(ps, "hops")) {
+		insn->op = FOP_HOPS;
+		fparser_next(ps);
+		insn->cmp = fparser_cmp(ps, 0);
+		insn->k = fparser_number(ps, 255);
+	} else if (fparser_isword(ps, "vlan")) {
+		insn->op = FOP_VLAN;
+		fparser_next(ps);
+		if (ps->tok == T_LB) {
+			insn->op = FOP_VLANI;
+			fparser_next(ps);
+			insn->arg = fparser_number(ps, 7);
+			fparser_expect(ps, T_RB, "\"]\"");
+		}
+		insn->cmp = fparser_cmp(ps, 0);
+		insn->k = fparser_number(ps, 4095);
+	} else if (fparser_isword(ps, "vlans")) {
+		insn->op = FOP_VLANS;
+		fparser_next(ps);
+		insn->cmp = fparser_cmp(ps, 0);
+		insn->k = fparser_number(ps, 255);
+	} else if (fparser_isword(ps, "relay")) {
+		insn->op = FOP_RELAY;
+		fparser_next(ps);
+		if (fparser_isword(ps, "in")) {
+			insn->op = FOP_RELAY_IN;
+			fparser_next(ps);
+			insn->p = watchset_load(fparser_file(ps), WATCH_RELAY);
+			fparser_next(ps);
+		}
+	} else if (fparser_isword(ps, "relay.vlan") || fparser_isword(ps, "relay.module") ||
+		   fparser_isword(ps, "relay.port")) {
+		insn->op = ps->buf[6] == 'v' ? FOP_RELAY_VLAN : ps->buf[6] == 'm' ? FOP_RELAY_MODULE : FOP_RELAY_PORT;
+		fparser_next(ps);
+		insn->cmp = fparser_cmp(ps, 0);
+		insn->k = fparser_number(ps, 65535);
+	} else if (fparser_isword(ps, "relay.mac")) {
+		insn->op = FOP_RELAY_MAC;
+		fparser_next(ps);
+		insn->cmp = fparser_cmp(ps, 1);
+		fparser_mac(ps, insn->mac);
+	} else if (fparser_isword(ps, "relay.str") || fparser_isword(ps, "relay.format")) {
+		insn->op = ps->buf[6] == 's' ? FOP_RELAY_STR : FOP_RELAY_FORMAT;
+		fparser_next(ps);
+		insn->cmp = fparser_cmp(ps, 1);
+		insn->p = fparser_string(ps);
+	} else
+		fparser_error(ps, "\"%s\": unknown condition", ps->buf);
+
+L_done:
+	switch (insn->cmp) {
+	case FCMP_EQ:
+		insn->prob = fops[insn->op].prob;
+		break;
+	case FCMP_NE:
+		insn->prob = 1. - fops[insn->op].prob;
+		break;
+	default:
+		insn->prob = 0.5;
+		break;
+	}
+	insn->cost = fops[insn->op].cost;
+	return idx;
+}
+
+static int fparser_expr(struct fparser *ps);
+
+static
+int
+fparser_factor(struct fparser *ps)
+{
+	int idx, tail = -1;
+
+	if (fparser_isword(ps, "not")) {
+		fparser_next(ps);
+		idx = fnode_new(ps, N_NOT);
+		fnode_append(ps, idx, &tail, fparser_factor(ps));
+		return idx;
+	}
+	if (ps->tok == T_LP) {
+		fparser_next(ps);
+		idx = fparser_expr(ps);
+		fparser_expect(ps, T_RP, "\")\"");
+		return idx;
+	}
+	return fparser_pred(ps);
+}
+
+static
+int
+fparser_term(struct fparser *ps)
+{
+	int idx, tail = -1, first;
+
+	first = fparser_factor(ps);
+	if (!fparser_isword(ps, "and"))
+		return first;
+	idx = fnode_new(ps, N_AND);
+	fnode_append(ps, idx, &tail, first);
+	while (fparser_isword(ps, "and")) {
+		fparser_next(ps);
+		fnode_append(ps, idx, &tail, fparser_factor(ps));
+	}
+	return idx;
+}
+
+static
+int
+fparser_expr(struct fparser *ps)
+{
+	int idx, tail = -1, first;
+
+	first = fparser_term(ps);
+	if (!fparser_isword(ps, "or"))
+		return first;
+	idx = fnode_new(ps, N_OR);
+	fnode_append(ps, idx, &tail, first);
+	while (fparser_isword(ps, "or")) {
+		fparser_next(ps);
+		fnode_append(ps, idx, &tail, fparser_term(ps));
+	}
+	return idx;
+}
+
+/*
+ * Упорядочивание и генерация
+ */
+
+/* Порядок детей and: по возрастанию cost / P(ложь) - первым идёт условие,
+ * которое дешевле всего отбрасывает пакет; or - по cost / P(истина).
+ * Ожидаемая цена узла - сумма цен детей с вероятностями до них дойти.
+ */
+static
+double
+fnode_rank(const struct fnode *n, int type)
+{
+	double p = type == N_AND ? 1. - n->prob : n->prob;
+
+	return n->cost / (p > 1e-9 ? p : 1e-9);
+}
+
+static
+void
+fnode_estimate(struct fparser *ps, int idx)
+{
+	struct fnode *n = ps->nodes + idx;
+	int nch = 0, *ch;
+	double reach = 1., p = 1.;
+
+	switch (n->type) {
+	case N_PRED:
+		n->prob = n->insn.prob;
+		n->cost = n->insn.cost;
+		return;
+	case N_NOT:
+		fnode_estimate(ps, n->first);
+		n->prob = 1. - ps->nodes[n->first].prob;
+		n->cost = ps->nodes[n->first].cost;
+		return;
+	}
+
+	for (int c = n->first; c >= 0; c = ps->nodes[c].next) {
+		fnode_estimate(ps, c);
+		nch++;
+	}
+	ch = MALLOC(nch * sizeof ch[0]);
+	nch = 0;
+	for (int c = n->first; c >= 0; c = ps->nodes[c].next)
+		ch[nch++] = c;
+	/* сортировка вставками, устойчивая: при равных оценках порядок записи */
+	for (int i = 1; i < nch; i++) {
+		int c = ch[i], j;
+
+		for (j = i; j > 0 && fnode_rank(ps->nodes + ch[j - 1], n->type) >
+				fnode_rank(ps->nodes + c, n->type); j--)
+			ch[j] = ch[j - 1];
+		ch[j] = c;
+	}
+	n->first = ch[0];
+	n->cost = 0.;
+	for (int i = 0; i < nch; i++) {
+		struct fnode *c = ps->nodes + ch[i];
+
+		c->next = i + 1 < nch ? ch[i + 1] : -1;
+		n->cost += reach * c->cost;
+		if (n->type == N_AND) {
+			reach *= c->prob;
+			p *= c->prob;
+		} else {
+			reach *= 1. - c->prob;
+			p *= 1. - c->prob;
+		}
+	}
+	n->prob = n->type == N_AND ? p : 1. - p;
+	free(ch);
+}
+
+/* Генерация с конца: к моменту генерации условия его переходы уже известны.
+ * Возвращает номер первой команды узла в порядке генерации.
+ */
+static
+int
+fnode_gen(struct fparser *ps, int idx, struct filter *f, int jt, int jf)
+{
+	struct fnode *n = ps->nodes + idx;
+	int entry, nch = 0, *ch;
+
+	switch (n->type) {
+	case N_PRED:
+		f->insns[f->n] = n->insn;
+		f->insns[f->n].jt = jt;
+		f->insns[f->n].jf = jf;
+		n->insn.p = NULL;	/* теперь принадлежит программе */
+		return f->n++;
+	case N_NOT:
+		return fnode_gen(ps, n->first, f, jf, jt);
+	}
+
+	for (int c = n->first; c >= 0; c = ps->nodes[c].next)
+		nch++;
+	ch = MALLOC(nch * sizeof ch[0]);
+	nch = 0;
+	for (int c = n->first; c >= 0; c = ps->nodes[c].next)
+		ch[nch++] = c;
+	entry = fnode_gen(ps, ch[nch - 1], f, jt, jf);
+	for (int i = nch - 2; i >= 0; i--)
+		entry = n->type == N_AND ?
+			fnode_gen(ps, ch[i], f, entry, jf) :
+			fnode_gen(ps, ch[i], f, jt, entry);
+	free(ch);
+	return entry;
+}
+
+static
+void
+filter_insn_free(struct filter_insn *insn)
+{
+	switch (insn->op) {
+	case FOP_CHADDR_IN:
+	case FOP_RELAY_IN:
+		watchset_free(insn->p);
+		break;
+	case FOP_IP_IN:
+		ipmap_frozen_free(insn->p);
+		break;
+	default:
+		free(insn->p);
+		break;
+	}
+	insn->p = NULL;
+}
+
+struct filter *
+filter_compile(const char *text)
+{
+	struct fparser *volatile ps;
+	struct filter *volatile f = NULL;
+	struct ectlfr fr[1];
+	int root, npred = 0;
+
+	ps = MALLOC(sizeof *ps);
+	memset(ps, 0, sizeof *ps);
+	ps->text = ps->cur = text ? text : "";
+	ectlfr_begin(fr, L_1);
+	f = MALLOC(sizeof *f);
+	memset(f, 0, sizeof *f);
+	fparser_next(ps);
+	if (ps->tok != T_END) {
+		root = fparser_expr(ps);
+		if (ps->tok != T_END)
+			fparser_error(ps, "expected and, or or end of expression");
+		fnode_estimate(ps, root);
+		for (int i = 0; i < ps->nnodes; i++)
+			npred += ps->nodes[i].type == N_PRED;
+		f->insns = MALLOC(npred * sizeof f->insns[0]);
+		fnode_gen(ps, root, f, FILTER_ACCEPT, FILTER_REJECT);
+		/* генерация шла с конца: разворачиваем, переходы - вперёд */
+		for (int i = 0, j = f->n - 1; i < j; i++, j--) {
+			struct filter_insn t = f->insns[i];
+
+			f->insns[i] = f->insns[j];
+			f->insns[j] = t;
+		}
+		for (int i = 0; i < f->n; i++) {
+			if (f->insns[i].jt >= 0)
+				f->insns[i].jt = f->n - 1 - f->insns[i].jt;
+			if (f->insns[i].jf >= 0)
+				f->insns[i].jf = f->n - 1 - f->insns[i].jf;
+		}
+	}
+	f->raw = ps->raw;
+	free(ps->nodes);
+	free(ps);
+	ectlfr_end(fr);
+	return f;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	for (int i = 0; i < ps->nnodes; i++)
+		if (ps->nodes[i].type == N_PRED)
+			filter_insn_free(&ps->nodes[i].insn);
+	free(ps->nodes);
+	free(ps);
+	filter_free(f);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+void
+filter_free(struct filter *f)
+{
+	if (f) {
+		for (int i = 0; i < f->n; i++)
+			filter_insn_free(f->insns + i);
+		free(f->insns);
+		free(f);
+	}
+}
+
+/*
+ * Исполнение
+ */
+static inline
+int
+fcmp(int cmp, uint32_t a, uint32_t b)
+{
+	switch (cmp) {
+	case FCMP_LT: return a < b;
+	case FCMP_LE: return a <= b;
+	case FCMP_GT: return a > b;
+	case FCMP_GE: return a >= b;
+	}
+	return a == b;
+}
+
+/* Значение опции побайтно. Опции, сравниваемые побайтно, не входят в demand,
+ * так что обычно они ещё не декодированы; декодированная опция сравнивается,
+ * только если её значение хранится как есть (байты, строка).
+ */
+static
+const uint8_t *
+filter_optbytes(struct dhcpoptlst *lst, uint8_t code, uint8_t *len)
+{
+	const uint8_t *raw;
+	struct dhcpopt *opt;
+
+	if ((raw = dhcpoptlst_peekraw(lst, code, len)))
+		return raw;
+	if (!dhcpoptlst_has(lst, code))
+		return NULL;
+	opt = *dhcpoptlst_slot(lst, code);
+	if (opt->optd && (opt->optd->elsz > 1 || opt->optd->dtab))
+		return NULL;
+	*len = opt->length;
+	return opt->value;
+}
+
+static
+uint8_t
+filter_msgtype(struct dhcp *dp)
+{
+	const uint8_t *raw;
+	uint8_t len;
+
+	if ((raw = dhcpoptlst_peekraw(dp->opts, DHCPOPT53_DHCP_MESSAGE_TYPE, &len)))
+		return len ? raw[0] : 0;
+	return dhcp_msgtype(dp);
+}
+
+/* "!=" - всегда отрицание "=": проверяется "=" и результат переворачивается */
+static
+int
+filter_test(const struct filter_insn *i, struct filterctx *ctx)
+{
+	const struct dhcphdr *dh = ctx->dh;
+	const struct dhcpopt82_value *v;
+	int cmp = i->cmp == FCMP_NE ? FCMP_EQ : i->cmp, r = 0;
+	const uint8_t *b;
+	uint8_t len;
+
+	switch (i->op) {
+	case FOP_OP:
+		r = dh->op == i->k;
+		break;
+	case FOP_MSGTYPE:
+		r = fcmp(cmp, filter_msgtype(filterctx_dhcp(ctx)), i->k);
+		break;
+	case FOP_OPTION:
+		r = dhcpoptlst_has(filterctx_dhcp(ctx)->opts, i->arg);
+		break;
+	case FOP_OPTVAL:
+		b = filter_optbytes(filterctx_dhcp(ctx)->opts, i->arg, &len);
+		r = b && len == i->len && !memcmp(b, i->p, len);
+		break;
+	case FOP_CHADDR:
+		r = dh->htype == HTYPE_ETHERNET && dh->hlen == ETHER_ADDR_LEN &&
+			!memcmp(dh->chaddr, i->mac, ETHER_ADDR_LEN);
+		break;
+	case FOP_CHADDR_IN:
+		r = dh->htype == HTYPE_ETHERNET && dh->hlen == ETHER_ADDR_LEN &&
+			watchset_has(i->p, watchkey_mac(dh->chaddr));
+		break;
+	case FOP_IP:
+	case FOP_IP_IN: {
+			struct in_addr a;
+
+			switch (i->arg) {
+			case FIP_CIADDR: a = dh->ciaddr; break;
+			case FIP_YIADDR: a = dh->yiaddr; break;
+			case FIP_SIADDR: a = dh->siaddr; break;
+			case FIP_GIADDR: a = dh->giaddr; break;
+			default:	 a = ctx->ipsrc; break;
+			}
+			r = i->op == FOP_IP ? ntohl(a.s_addr) == i->k : ipmap_frozen_isset(i->p, ntohl(a.s_addr));
+		}
+		break;
+	case FOP_XID:
+		r = fcmp(cmp, ntohl(dh->xid), i->k);
+		break;
+	case FOP_HOPS:
+		r = fcmp(cmp, dh->hops, i->k);
+		break;
+	case FOP_VLAN:
+		for (int t = 0; !r && t < ctx->ntags && t < 8; t++)
+			r = fcmp(cmp, ctx->tags[t], i->k);
+		break;
+	case FOP_VLANI:
+		r = i->arg < ctx->ntags && fcmp(cmp, ctx->tags[i->arg], i->k);
+		break;
+	case FOP_VLANS:
+		r = fcmp(cmp, ctx->ntags, i->k);
+		break;
+	case FOP_RELAY:
+		r = filterctx_opt82(ctx) != NULL;
+		break;
+	case FOP_RELAY_IN:
+		r = (v = filterctx_opt82(ctx)) && (v->flags & DHCPOPT82_V_ETHER) &&
+			watchset_has(i->p, watchkey_relay(v->ether.octet, v->vlanid, v->port));
+		break;
+	case FOP_RELAY_VLAN:
+		r = (v = filterctx_opt82(ctx)) && fcmp(cmp, v->vlanid, i->k);
+		break;
+	case FOP_RELAY_MODULE:
+		r = (v = filterctx_opt82(ctx)) && fcmp(cmp, v->module, i->k);
+		break;
+	case FOP_RELAY_PORT:
+		r = (v = filterctx_opt82(ctx)) && fcmp(cmp, v->port, i->k);
+		break;
+	case FOP_RELAY_MAC:
+		r = (v = filterctx_opt82(ctx)) && (v->flags & DHCPOPT82_V_ETHER) &&
+			!memcmp(&v->ether, i->mac, ETHER_ADDR_LEN);
+		break;
+	case FOP_RELAY_STR:
+		r = (v = filterctx_opt82(ctx)) && (v->flags & DHCPOPT82_V_STR) && !strcmp(v->str, i->p);
+		break;
+	case FOP_RELAY_FORMAT:
+		r = (v = filterctx_opt82(ctx)) && !strcmp(v->name, i->p);
+		break;
+	}
+	return i->cmp == FCMP_NE ? !r : r;
+}
+
+int
+filter_match(const struct filter *f, struct filterctx *ctx)
+{
+	int pc = 0;
+
+	if (!f->n)
+		return 1;
+	while (pc >= 0) {
+		const struct filter_insn *i = f->insns + pc;
+
+		ctx->last = i;
+		pc = filter_test(i, ctx) ? i->jt : i->jf;
+	}
+	return pc == FILTER_ACCEPT;
+}
+
+const char *
+filter_reason(const struct filterctx *ctx)
+{
+	return ctx->last ? fops[ctx->last->op].name : "filter";
+}
+
+static
+void
+filter_target(int j, FILE *fp)
+{
+	if (j == FILTER_ACCEPT)
+		fprintf(fp, "accept");
+	else if (j == FILTER_REJECT)
+		fprintf(fp, "reject");
+	else
+		fprintf(fp, "%d", j);
+}
+
+void
+filter_dump(const struct filter *f, FILE *fp)
+{
+	char ipbuf[MAX_IP_CSTR];
+
+	if (!f->n)
+		fprintf(fp, "(000) accept\n");
+	for (int n = 0; n < f->n; n++) {
+		const struct filter_insn *i = f->insns + n;
+
+		fprintf(fp, "(%03d) ", n);
+		switch (i->op) {
+		case FOP_OPTION:
+			fprintf(fp, "option %u", i->arg);
+			break;
+		case FOP_OPTVAL:
+			fprintf(fp, "option %u %s ", i->arg, fcmp_names[i->cmp]);
+			for (int k = 0; k < i->len; k++)
+				fprintf(fp, "%02x", ((uint8_t *)i->p)[k]);
+			break;
+		case FOP_CHADDR_IN:
+		case FOP_RELAY_IN:
+			fprintf(fp, "%s @set", fops[i->op].name);
+			break;
+		case FOP_IP:
+			ip_to_cstr(i->k, ipbuf, sizeof ipbuf);
+			fprintf(fp, "%s %s %s", fip_names[i->arg], fcmp_names[i->cmp], ipbuf);
+			break;
+		case FOP_IP_IN:
+			fprintf(fp, "%s in ipmap[%zu]", fip_names[i->arg],
+				((struct ipmap_frozen *)i->p)->n);
+			break;
+		case FOP_VLANI:
+			fprintf(fp, "vlan[%u] %s %" PRIu32, i->arg, fcmp_names[i->cmp], i->k);
+			break;
+		case FOP_RELAY:
+			fprintf(fp, "relay");
+			break;
+		case FOP_CHADDR:
+		case FOP_RELAY_MAC:
+			fprintf(fp, "%s %s %s", fops[i->op].name, fcmp_names[i->cmp],
+				ether_ntoa((const struct ether_addr *)i->mac));
+			break;
+		case FOP_RELAY_STR:
+		case FOP_RELAY_FORMAT:
+			fprintf(fp, "%s %s \"%s\"", fops[i->op].name, fcmp_names[i->cmp], (char *)i->p);
+			break;
+		default:
+			fprintf(fp, "%s %s %" PRIu32, fops[i->op].name, fcmp_names[i->cmp], i->k);
+			break;
+		}
+		fprintf(fp, " jt ");
+		filter_target(i->jt, fp);
+		fprintf(fp, " jf ");
+		filter_target(i->jf, fp);
+		fprintf(fp, "\tp %.4f cost %g\n", i->prob, i->cost);
+	}
+}
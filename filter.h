@@ -0,0 +1,128 @@
+#ifndef __filter_h__
+#define __filter_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+
+#include "foo.h"
+#include "dhcp.h"
+#include "opt82.h"
+#include "stagetime.h"
+
+DECL_ERROR(E_FILTERSYNTAX)
+
+/* Выражение фильтра dhcpdump (-e). Разбирается один раз в байт-код: линейный
+ * список проверок, у каждой два перехода - по истине и по лжи, только вперёд.
+ *
+ *	выражение:	терм { or терм }
+ *	терм:		множитель { and множитель }
+ *	множитель:	not множитель | ( выражение ) | условие
+ *
+ * Условия (сравнение - = != < <= > >=, для адресов и строк только = !=;
+ * пропущенное сравнение - "=", "a != b" - всегда то же, что "not a = b"):
+ *	op request|reply		BOOTREQUEST/BOOTREPLY
+ *	msgtype сравнение discover|offer|request|decline|ack|nak|release|inform|N
+ *	option N			опция N есть в пакете
+ *	option N = 0a0b0c | "str"	значение опции N побайтно
+ *	chaddr = MAC			Ethernet chaddr
+ *	chaddr in @файл			MAC из файла (см. watch.h)
+ *	ciaddr|yiaddr|siaddr|giaddr|src = IP	src - IP отправителя пакета
+ *	ciaddr|... in сегмент[,сегмент...]	IP, IP-IP, IP/N или @файл сегментов
+ *	xid сравнение N, hops сравнение N
+ *	vlan сравнение N		любая метка в стеке vlan
+ *	vlan[i] сравнение N		i-я метка, 0 - внешняя; метки нет - ложь
+ *	vlans сравнение N		число меток
+ *	relay				опция 82 распознана (см. opt82.h)
+ *	relay.vlan|relay.module|relay.port сравнение N
+ *	relay.mac = MAC, relay.str = "str", relay.format = имя
+ *					опция 82 не распознана - ложь
+ *	relay in @файл			(MAC коммутатора, vlan, порт) из файла
+ *
+ * Имя файла с пробелами и скобками - в кавычках: @"файл".
+ *
+ * Дети and/or переставляются по оценке избирательности и стоимости каждого
+ * условия: первым проверяется то, что дешевле всего решает исход. Поля
+ * заголовка не требуют декодирования пакета, опции - требуют, опция 82 - ещё
+ * и распознавания; контекст делает и то, и другое только по первому запросу.
+ */
+#define FILTER_ACCEPT	(-1)	/* переходы на конец программы */
+#define FILTER_REJECT	(-2)
+
+struct filter_insn {
+	uint8_t		op;		/* FOP_* */
+	uint8_t		cmp;		/* FCMP_* */
+	uint8_t		arg;		/* код опции, номер метки vlan */
+	uint8_t		len;		/* байт в p (option N = ...) */
+	int32_t		jt, jf;		/* переходы по истине и лжи */
+	uint32_t	k;		/* число, IP */
+	uint8_t		mac[ETHER_ADDR_LEN];
+	void		*p;		/* байты, строка, ipmap, watchset */
+	double		prob, cost;	/* оценки, по которым упорядочена программа */
+};
+
+struct filter {
+	int			n;
+	struct filter_insn	*insns;
+	struct dhcpoptset	raw;	/* опции, сравниваемые побайтно: не декодировать заранее */
+};
+
+/* Пакет в процессе фильтрации. dhcp декодируется и опция 82 распознаётся
+ * только по первому запросу; после фильтра ими пользуется и вывод.
+ */
+struct filterctx {
+	const struct dhcphdr		*dh;
+	struct in_addr			ipsrc;
+	const int			*tags;		/* метки vlan, ntags может быть больше 8 */
+	int				ntags;
+	const uint8_t			*cp, *cp_end;	/* dhcp для dhcp_decode() */
+	const struct dhcpoptset		*demand;
+	struct dhcp			*dp;		/* NULL - ещё не декодирован */
+	struct dhcpopt82_cache		*opt82_cache;
+	int				opt82_state;	/* 0 - не искали, 1 - нет, 2 - есть */
+	struct dhcpopt82_value		opt82val;
+	const struct filter_insn	*last;		/* последняя проверка: причина отказа */
+#ifdef STAGETIME
+	volatile struct stagetime_pkt	*st;		/* стадии пакета, NULL - не считать */
+#endif
+};
+
+__BEGIN_DECLS
+static inline
+void
+filterctx_init(struct filterctx *ctx, const struct dhcphdr *dh, struct in_addr ipsrc, const int *tags, int ntags,
+	const uint8_t *cp, const uint8_t *cp_end, const struct dhcpoptset *demand,
+	struct dhcpopt82_cache *opt82_cache)
+{
+	ctx->dh = dh;
+	ctx->ipsrc = ipsrc;
+	ctx->tags = tags;
+	ctx->ntags = ntags;
+	ctx->cp = cp;
+	ctx->cp_end = cp_end;
+	ctx->demand = demand;
+	ctx->dp = NULL;
+	ctx->opt82_cache = opt82_cache;
+	ctx->opt82_state = 0;
+	ctx->last = NULL;
+#ifdef STAGETIME
+	ctx->st = NULL;
+#endif
+}
+
+struct dhcp *			filterctx_dhcp(struct filterctx *ctx);
+/* NULL - опции 82 нет или она не распознана */
+const struct dhcpopt82_value *	filterctx_opt82(struct filterctx *ctx);
+
+/* text == NULL или пустая строка - фильтр пропускает всё */
+struct filter *			filter_compile(const char *text);
+void				filter_free(struct filter *f);
+int				filter_match(const struct filter *f, struct filterctx *ctx);
+/* имя условия, на котором остановилась последняя filter_match() */
+const char *			filter_reason(const struct filterctx *ctx);
+void				filter_dump(const struct filter *f, FILE *fp);
+__END_DECLS
+
+#endif
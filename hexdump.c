@@ -0,0 +1,57 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hexdump.h"
+
+/* "000102...feff": две цифры байта b - hexdump_digits + 2 * b */
+#define HD_C(a, b)	#a #b
+#define HD_R(a)		HD_C(a, 0) HD_C(a, 1) HD_C(a, 2) HD_C(a, 3) HD_C(a, 4) HD_C(a, 5) \
+			HD_C(a, 6) HD_C(a, 7) HD_C(a, 8) HD_C(a, 9) HD_C(a, a) HD_C(a, b) \
+			HD_C(a, c) HD_C(a, d) HD_C(a, e) HD_C(a, f)
+static const char hexdump_digits[513] =
+	HD_R(0) HD_R(1) HD_R(2) HD_R(3) HD_R(4) HD_R(5) HD_R(6) HD_R(7)
+	HD_R(8) HD_R(9) HD_R(a) HD_R(b) HD_R(c) HD_R(d) HD_R(e) HD_R(f);
+#undef HD_R
+#undef HD_C
+
+/* отступ, "0000|", 16 по "xx ", "| ", 16 символов, "\n" */
+#define HEXDUMP_LINE	(HEXDUMP_MAXINDENT + 5 + 48 + 1 + 16 + 1)
+
+void
+hexdump(FILE *fp, const uint8_t *data, size_t len, int indent)
+{
+	char buf[64 * HEXDUMP_LINE], *p = buf;
+
+	if (indent > HEXDUMP_MAXINDENT)
+		indent = HEXDUMP_MAXINDENT;
+	for (size_t off = 0; off < len; off += 16) {
+		size_t n = len - off < 16 ? len - off : 16;
+		const uint8_t *d = data + off;
+		char *hex, *asc;
+
+		if ((size_t)(p - buf) > sizeof buf - HEXDUMP_LINE) {
+			fwrite(buf, 1, p - buf, fp);
+			p = buf;
+		}
+		memset(p, ' ', indent);
+		p += indent;
+		memcpy(p, hexdump_digits + 2 * (off >> 8 & 0xff), 2);
+		memcpy(p + 2, hexdump_digits + 2 * (off & 0xff), 2);
+		p[4] = '|';
+		hex = p + 5;
+		/* неполная строка: пробелы на месте недостающих байт, ASCII на месте */
+		memset(hex, ' ', 48);
+		for (size_t i = 0; i < n; i++)
+			memcpy(hex + 3 * i, hexdump_digits + 2 * d[i], 2);
+		hex[47] = '|';
+		asc = hex + 48;
+		*asc++ = ' ';
+		for (size_t i = 0; i < n; i++)
+			asc[i] = d[i] >= 0x20 && d[i] < 0x7f ? d[i] : '.';
+		asc[n] = '\n';
+		p = asc + n + 1;
+	}
+	fwrite(buf, 1, p - buf, fp);
+}
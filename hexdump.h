@@ -0,0 +1,26 @@
+#ifndef __hexdump_h__
+#define __hexdump_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Шестнадцатеричный дамп с ASCII, по 16 байт в строке:
+ *
+ *	0110|00 00 00 00 00 00 63 82 53 63 35 01 03 3d 07 01| ......c.Sc5..=..
+ *	0120|00 16 00 00 09 18 39 02 05 dc 0c 0b 68 6f 73 74| ......9.....host
+ *	0130|2d 30 30 30 39 31 38 3c 08 4d 53 46 54 20 35 2e| -000918<.MSFT 5.
+ *	0140|30 37 07 01 42 06 03 0f 96 23 ff               | 07..B....#.
+ *
+ * Строки собираются в буфере по таблице пар шестнадцатеричных цифр и уходят
+ * в fp одним fwrite() на несколько строк, без printf() на каждый байт.
+ * indent - пробелов перед строкой, не больше HEXDUMP_MAXINDENT.
+ */
+#define HEXDUMP_MAXINDENT	16
+
+__BEGIN_DECLS
+void	hexdump(FILE *fp, const uint8_t *data, size_t len, int indent);
+__END_DECLS
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __hist_h__
+#define __hist_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <string.h>
+
+/* Гистограмма времён (нс, такты TSC и т.п.) с логарифмическими корзинами:
+ * 16 корзин на каждую степень двойки, погрешность перцентилей - не больше 1/16.
+ * Запись - одно сложение, без выделения памяти.
+ */
+#define HIST_SUBBITS	4
+#define HIST_NBUCKETS	(64 << HIST_SUBBITS)
+
+struct hist {
+	uint64_t	n;
+	uint64_t	sum;
+	uint64_t	max;
+	uint64_t	buckets[HIST_NBUCKETS];
+};
+
+static inline
+void
+hist_init(struct hist *h)
+{
+	memset(h, 0, sizeof *h);
+}
+
+static inline
+int
+hist_bucket(uint64_t v)
+{
+	int e;
+
+	if (v < (1 << HIST_SUBBITS))
+		return v;
+	e = 63 - __builtin_clzll(v);
+	return ((e - HIST_SUBBITS + 1) << HIST_SUBBITS) |
+		((v >> (e - HIST_SUBBITS)) & ((1 << HIST_SUBBITS) - 1));
+}
+
+/* нижняя граница корзины */
+static inline
+uint64_t
+hist_bucket_value(int b)
+{
+	int e = b >> HIST_SUBBITS;
+
+	if (!e)
+		return b;
+	return (uint64_t)((1 << HIST_SUBBITS) | (b & ((1 << HIST_SUBBITS) - 1))) << (e - 1);
+}
+
+static inline
+void
+hist_add(struct hist *h, uint64_t v)
+{
+	h->buckets[hist_bucket(v)]++;
+	h->n++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+}
+
+static inline
+uint64_t
+hist_percentile(const struct hist *h, double p)
+{
+	uint64_t n = 0, rank = p * h->n;
+
+	for (int b = 0; b < HIST_NBUCKETS; b++)
+		if ((n += h->buckets[b]) > rank)
+			return hist_bucket_value(b);
+	return 0;
+}
+
+#endif
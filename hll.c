@@ -0,0 +1,327 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <arpa/inet.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "foo.h"
+#include "watch.h"
+#include "hll.h"
+
+DEFN_ERROR(E_HLLSYNTAX,		"Syntax error in --distinct option.")
+
+static const char *const hll_kinds[HLL_KINDS] = { "all", "vlan", "relay", "switch" };
+
+/* окна: первый отрезок в hll_group.slice, число отрезков, длина отрезка */
+static const struct {
+	const char	*name;
+	int		base, n;
+	uint64_t	len;
+} hll_windows[HLL_WINDOWS] = {
+	{ "minute",	0,			HLL_MINUTE_SLICES,	10 * HLL_NS },
+	{ "hour",	HLL_MINUTE_SLICES,	HLL_HOUR_SLICES,	300 * HLL_NS },
+};
+
+/* 2^-r для рангов регистров: ранг не больше 64 - p + 1 */
+#define HLL_POW2(r)	(1. / ((uint64_t)1 << (r)))
+#define HLL_POW2x4(r)	HLL_POW2(r), HLL_POW2(r + 1), HLL_POW2(r + 2), HLL_POW2(r + 3)
+#define HLL_POW2x16(r)	HLL_POW2x4(r), HLL_POW2x4(r + 4), HLL_POW2x4(r + 8), HLL_POW2x4(r + 12)
+static const double hll_pow2[64] = {
+	HLL_POW2x16(0), HLL_POW2x16(16), HLL_POW2x16(32), HLL_POW2x16(48)
+};
+
+void
+hll_merge(uint8_t *dst, const uint8_t *src, size_t m)
+{
+#ifdef __AVX2__
+	for (size_t i = 0; i < m; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_max_epu8(a, b));
+	}
+#elif defined(__SSE2__)
+	for (size_t i = 0; i < m; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_max_epu8(a, b));
+	}
+#else
+	for (size_t i = 0; i < m; i++)
+		if (dst[i] < src[i])
+			dst[i] = src[i];
+#endif
+}
+
+/* Оценка HyperLogLog с поправкой для малых чисел: пока пустых регистров
+ * много, точнее считать по их доле (linear counting)
+ */
+double
+hll_estimate(const uint8_t *reg, int p)
+{
+	size_t m = (size_t)1 << p, zeros = 0;
+	double sum = 0., e;
+
+	for (size_t i = 0; i < m; i++) {
+		sum += hll_pow2[reg[i]];
+		zeros += !reg[i];
+	}
+	e = 0.7213 / (1. + 1.079 / m) * m * m / sum;
+	if (e <= 2.5 * m && zeros)
+		e = m * log((double)m / zeros);
+	return e;
+}
+
+struct hll *
+hll_create(FILE *fp, const char *arg)
+{
+	struct ectlfr fr[1];
+	struct hll *volatile h;
+	char *end;
+	double sec;
+
+	errno = 0;
+	sec = strtod(arg, &end);
+	if (errno || end == arg || *end || !(sec >= 0.) || sec > 86400. * 366)
+		ECTL_TRAP(E_HLLSYNTAX, "\"%s\": expected seconds >= 0.\n", arg);
+
+	ectlfr_begin(fr, L_0);
+	h = MALLOC(sizeof *h);
+	memset(h, 0, sizeof *h);
+	ectlfr_ontrap(fr, L_1);
+	h->fp = fp;
+	h->report_interval = sec * HLL_NS;
+	for (int k = 0; k < HLL_KINDS; k++) {
+		struct hll_kind *kp = h->kinds + k;
+		uint32_t max = k == HLL_ALL ? 1 : HLL_GROUPS_MAX;
+
+		kp->p = k == HLL_ALL ? HLL_P_ALL : HLL_P_GROUP;
+		kp->hmask = 2 * max - 1;
+		kp->hash = MALLOC(2 * max * sizeof kp->hash[0]);
+		memset(kp->hash, 0xff, 2 * max * sizeof kp->hash[0]);
+		kp->groups = MALLOC(max * sizeof kp->groups[0]);
+	}
+	h->tmp = MALLOC((size_t)1 << HLL_P_ALL);
+	ectlfr_end(fr);
+	return h;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	hll_free(h);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+void
+hll_free(struct hll *h)
+{
+	if (!h)
+		return;
+	for (int k = 0; k < HLL_KINDS; k++) {
+		struct hll_kind *kp = h->kinds + k;
+
+		for (uint32_t i = 0; i < kp->n; i++)
+			free(kp->groups[i].reg);
+		free(kp->groups);
+		free(kp->hash);
+	}
+	free(h->tmp);
+	free(h);
+}
+
+/* группа key; NULL - групп уже HLL_GROUPS_MAX */
+static
+struct hll_group *
+hll_group(struct hll_kind *kp, uint64_t key)
+{
+	uint64_t x = key * 0x9e3779b97f4a7c15ULL;
+	struct hll_group *g;
+	uint32_t i;
+
+	for (i = (x ^ x >> 32) & kp->hmask; kp->hash[i] != -1; i = (i + 1) & kp->hmask)
+		if (kp->groups[kp->hash[i]].key == key)
+			return kp->groups + kp->hash[i];
+	if (kp->n == (kp->hmask + 1) / 2)
+		return NULL;
+	g = kp->groups + kp->n;
+	g->reg = MALLOC((size_t)HLL_SLICES << kp->p);
+	g->key = key;
+	memset(g->slice, 0, sizeof g->slice);
+	kp->hash[i] = kp->n++;
+	return g;
+}
+
+/* x - хэш chaddr */
+static inline
+void
+hll_group_add(struct hll_kind *kp, struct hll_group *g, uint64_t now, uint64_t x)
+{
+	size_t m = (size_t)1 << kp->p, idx = x >> (64 - kp->p);
+	/* единица снизу ограничивает ранг, если остальные биты - нули */
+	uint8_t rank = __builtin_clzll(x << kp->p | (uint64_t)1 << (kp->p - 1)) + 1;
+
+	for (int w = 0; w < HLL_WINDOWS; w++) {
+		uint64_t e = now / hll_windows[w].len + 1;
+		int s = hll_windows[w].base + e % hll_windows[w].n;
+		uint8_t *r = g->reg + s * m;
+
+		if (g->slice[s] != e) {
+			memset(r, 0, m);
+			g->slice[s] = e;
+		}
+		if (r[idx] < rank)
+			r[idx] = rank;
+	}
+}
+
+/* оценка окна w, кончающегося в now; 0 - в окне пакетов не было */
+static
+double
+hll_window(struct hll *h, struct hll_kind *kp, struct hll_group *g, int w, uint64_t now)
+{
+	size_t m = (size_t)1 << kp->p;
+	uint64_t e = now / hll_windows[w].len + 1;
+	int any = 0;
+
+	memset(h->tmp, 0, m);
+	for (int i = 0; i < hll_windows[w].n; i++) {
+		int s = hll_windows[w].base + i;
+
+		if (g->slice[s] && g->slice[s] <= e && g->slice[s] + hll_windows[w].n > e) {
+			hll_merge(h->tmp, g->reg + s * m, m);
+			any = 1;
+		}
+	}
+	return any ? hll_estimate(h->tmp, kp->p) : 0.;
+}
+
+static
+const char *
+hll_key_text(int kind, uint64_t key, char *buf, size_t size)
+{
+	struct in_addr a;
+
+	switch (kind) {
+	case HLL_ALL:
+		buf[0] = '\0';
+		break;
+	case HLL_VLAN:
+		if (key >> 24)
+			snprintf(buf, size, " %u.%u", (unsigned)(key >> 12) & 0xfff, (unsigned)key & 0xfff);
+		else
+			snprintf(buf, size, " %u", (unsigned)(key >> 12) & 0xfff);
+		break;
+	case HLL_RELAY:
+		a.s_addr = htonl(key);
+		buf[0] = ' ';
+		inet_ntop(AF_INET, &a, buf + 1, size - 1);
+		break;
+	default:
+		snprintf(buf, size, " %02x:%02x:%02x:%02x:%02x:%02x", (unsigned)(key >> 40) & 0xff, (unsigned)(key >> 32) & 0xff,
+			(unsigned)(key >> 24) & 0xff, (unsigned)(key >> 16) & 0xff, (unsigned)(key >> 8) & 0xff,
+			(unsigned)key & 0xff);
+		break;
+	}
+	return buf;
+}
+
+static
+int
+hll_key_cmp(const void *a, const void *b)
+{
+	const struct hll_group *x = *(const struct hll_group *const *)a, *y = *(const struct hll_group *const *)b;
+
+	return x->key < y->key ? -1 : x->key > y->key;
+}
+
+/* группы по порядку ключей, кроме тех, у кого за час пакетов не было */
+static
+void
+hll_print(struct hll *h, uint64_t now)
+{
+	struct hll_group **order = MALLOC(HLL_GROUPS_MAX * sizeof order[0]);
+	char when[32];
+	time_t sec = now / HLL_NS;
+
+	strftime(when, sizeof when, "%Y%m%d %H:%M:%S", localtime(&sec));
+	fflush(stdout);
+	for (int k = 0; k < HLL_KINDS; k++) {
+		struct hll_kind *kp = h->kinds + k;
+
+		for (uint32_t i = 0; i < kp->n; i++)
+			order[i] = kp->groups + i;
+		qsort(order, kp->n, sizeof order[0], hll_key_cmp);
+		for (uint32_t i = 0; i < kp->n; i++) {
+			double est[HLL_WINDOWS];
+			char buf[64];
+
+			for (int w = 0; w < HLL_WINDOWS; w++)
+				est[w] = hll_window(h, kp, order[i], w, now);
+			if (!est[HLL_HOUR])
+				continue;
+			fprintf(h->fp, "distinct: %s %s%s", when, hll_kinds[k], hll_key_text(k, order[i]->key, buf, sizeof buf));
+			for (int w = 0; w < HLL_WINDOWS; w++)
+				fprintf(h->fp, " %s %.0f", hll_windows[w].name, est[w]);
+			fprintf(h->fp, "\n");
+		}
+		if (kp->over)
+			fprintf(h->fp, "distinct: %s %s over %" PRIu64 "\n", when, hll_kinds[k], kp->over);
+	}
+	free(order);
+}
+
+void
+hll_add(struct hll *h, uint64_t now, const struct dhcphdr *dh, const int *tags, int ntags,
+	const struct dhcpopt82_value *v)
+{
+	uint64_t keys[HLL_KINDS], x;
+	int has[HLL_KINDS];
+
+	if (h->report_interval && now >= h->report_next) {
+		if (h->report_next)
+			hll_print(h, now);
+		h->report_next = now + h->report_interval;
+	}
+	h->last = now;
+	if (dh->hlen != ETHER_ADDR_LEN)
+		return;
+	x = watchkey_hash(watchkey_mac(dh->chaddr));
+	keys[HLL_ALL] = 0;
+	has[HLL_ALL] = 1;
+	/* внешняя метка - биты 12-23, внутренняя - 0-11, бит 24 - есть внутренняя */
+	keys[HLL_VLAN] = 0;
+	if ((has[HLL_VLAN] = ntags > 0))
+		keys[HLL_VLAN] = ntags > 1 ? (uint64_t)1 << 24 | tags[0] << 12 | tags[1] : (uint64_t)tags[0] << 12;
+	keys[HLL_RELAY] = ntohl(dh->giaddr.s_addr);
+	has[HLL_RELAY] = dh->giaddr.s_addr != 0;
+	keys[HLL_SWITCH] = 0;
+	if ((has[HLL_SWITCH] = v && (v->flags & DHCPOPT82_V_ETHER)))
+		for (int i = 0; i < ETHER_ADDR_LEN; i++)
+			keys[HLL_SWITCH] = keys[HLL_SWITCH] << 8 | v->ether.octet[i];
+	for (int k = 0; k < HLL_KINDS; k++) {
+		struct hll_kind *kp = h->kinds + k;
+		struct hll_group *g;
+
+		if (!has[k])
+			continue;
+		if ((g = hll_group(kp, keys[k])))
+			hll_group_add(kp, g, now, x);
+		else
+			kp->over++;
+	}
+}
+
+void
+hll_report(struct hll *h)
+{
+	hll_print(h, h->last);
+}
@@ -0,0 +1,98 @@
+#ifndef __hll_h__
+#define __hll_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "foo.h"
+#include "dhcp.h"
+#include "opt82.h"
+
+DECL_ERROR(E_HLLSYNTAX)
+
+/* Число разных chaddr (--distinct сек): раз в сек секунд (0 - только в конце)
+ * в stderr - сколько разных клиентов было за последнюю минуту и за последний
+ * час:
+ *	all		всего
+ *	vlan		по меткам vlan кадра: внешняя или внешняя.внутренняя
+ *	relay		по giaddr, кроме 0.0.0.0
+ *	switch		по MAC коммутатора из опции 82
+ * Считаются пакеты с hlen 6, прошедшие фильтры, до прореживания вывода. Время
+ * - метка пакета.
+ *
+ * Счёт - HyperLogLog: 2^p байтовых регистров, регистр выбирают старшие p бит
+ * хэша chaddr, в нём - наибольший ранг (номер первой единицы) остальных бит.
+ * Ошибка около 1.04 / sqrt(2^p): 0.8% у all (HLL_P_ALL), 3% у групп
+ * (HLL_P_GROUP, 1 Кб регистров). Повторы пакетов оценку не меняют.
+ *
+ * Окно - кольцо отрезков, у каждого свои регистры: минута - 6 отрезков по
+ * 10 с, час - 12 по 5 мин, последний отрезок неполный. Пакет пишется в текущий
+ * отрезок обоих окон; отрезок, вышедший из окна, обнуляется при следующей
+ * записи в него. Оценка окна - по поэлементному максимуму регистров его
+ * отрезков (hll_merge(): 32 регистра за инструкцию AVX2, 16 - SSE2). На группу
+ * - 18 Кб, групп каждого вида не больше HLL_GROUPS_MAX, пакеты сверх - в счёт
+ * "over".
+ */
+#define HLL_P_ALL		14
+#define HLL_P_GROUP		10
+
+#define HLL_ALL			0
+#define HLL_VLAN		1
+#define HLL_RELAY		2
+#define HLL_SWITCH		3
+#define HLL_KINDS		4
+
+#define HLL_MINUTE		0
+#define HLL_HOUR		1
+#define HLL_WINDOWS		2
+#define HLL_MINUTE_SLICES	6
+#define HLL_HOUR_SLICES		12
+#define HLL_SLICES		(HLL_MINUTE_SLICES + HLL_HOUR_SLICES)
+
+#define HLL_GROUPS_MAX		4096
+
+#define HLL_NS			1000000000ULL
+
+struct hll_group {
+	uint64_t	key;
+	uint64_t	slice[HLL_SLICES];	/* номер отрезка + 1, чьи регистры; 0 - пусто */
+	uint8_t		*reg;			/* [HLL_SLICES][2^p] */
+};
+
+struct hll_kind {
+	int		p;
+	uint32_t	n, hmask;
+	int32_t		*hash;			/* номера групп, -1 - пусто */
+	struct hll_group *groups;
+	uint64_t	over;			/* пакетов сверх HLL_GROUPS_MAX групп */
+};
+
+struct hll {
+	FILE		*fp;
+	uint64_t	report_interval, report_next;
+	uint64_t	last;			/* время последнего пакета */
+	struct hll_kind	kinds[HLL_KINDS];
+	uint8_t		*tmp;			/* 2^HLL_P_ALL: регистры окна */
+};
+
+__BEGIN_DECLS
+/* dst[i] = max(dst[i], src[i]); m - кратно 32 */
+void		hll_merge(uint8_t *dst, const uint8_t *src, size_t m);
+/* оценка числа разных по m = 2^p регистрам */
+double		hll_estimate(const uint8_t *reg, int p);
+
+/* arg - аргумент --distinct; отчёты в fp */
+struct hll *	hll_create(FILE *fp, const char *arg);
+void		hll_free(struct hll *h);
+/* now - время пакета в нс, tags - метки vlan кадра (нужны две первые), v -
+ * опция 82 или NULL; заодно печатает отчёт, если пора
+ */
+void		hll_add(struct hll *h, uint64_t now, const struct dhcphdr *dh, const int *tags, int ntags,
+			const struct dhcpopt82_value *v);
+/* итоговый отчёт: окна, кончающиеся последним пакетом */
+void		hll_report(struct hll *h);
+__END_DECLS
+
+#endif
@@ -108,6 +108,45 @@ struct rbtree *	ipmap_subtr(struct rbtree *, struct rbtree *);
 
 int		ipmap_isequal(struct rbtree *, struct rbtree *);
 
+void		ipmap_load(struct rbtree *, const char *path);
+
+/* Замороженная ipmap для проверок на каждый пакет: начала и концы сегментов
+ * в отсортированных массивах и каталог корзин по старшим битам адреса, который
+ * сужает поиск до нескольких сегментов; внутри - поиск без ветвлений (cmov).
+ * Не меняется; строится из ipmap функцией ipmap_freeze().
+ */
+struct ipmap_frozen {
+	size_t		n;
+	uint32_t	*a, *b;
+	uint32_t	min, max;	/* a[0], b[n - 1] */
+	int		shift;		/* корзина - 2^shift адресов */
+	uint32_t	*dir;		/* по корзинам: номер сегмента, с которого искать */
+};
+
+struct ipmap_frozen *	ipmap_freeze(struct rbtree *);
+void			ipmap_frozen_free(struct ipmap_frozen *);
+
+static inline
+int
+ipmap_frozen_isset(const struct ipmap_frozen *f, uint32_t ip)
+{
+	const uint32_t *base;
+	size_t j, n;
+
+	if (ip - f->min > f->max - f->min || !f->n)
+		return 0;
+	j = (uint64_t)(ip - f->min) >> f->shift;
+	base = f->a + f->dir[j];
+	n = f->dir[j + 1] - f->dir[j] + 1;
+	while (n > 1) {
+		size_t half = n / 2;
+
+		base = base[half] <= ip ? base + half : base;
+		n -= half;
+	}
+	return ip <= f->b[base - f->a];
+}
+
 /* ip_subnets()
  *
  * для указанного диапазона ip адресов [start, end] будет произведено
@@ -4,6 +4,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <inttypes.h>
+#include <errno.h>
 #include <sys/types.h>
 
 #include "foo.h"
@@ -642,6 +643,105 @@ ipmap_dump(FILE *fp, struct rbtree *map, const char *fmt, ...)
 	fprintf(fp, "}\n");
 }
 
+/* Сегменты по возрастанию в два массива (смежные ipmap_map() уже слил) и
+ * каталог: диапазон [a[0], b[n-1]] делится на корзины по 2^shift адресов,
+ * примерно две корзины на сегмент; dir[j] - последний сегмент, начинающийся
+ * не позже начала корзины j. Сегмент адреса ищется между dir[j] и dir[j+1].
+ */
+struct ipmap_frozen *
+ipmap_freeze(struct rbtree *map)
+{
+	struct ipmap_frozen *f;
+	struct rbglue *p;
+	size_t n = 0, nbuckets, i;
+
+	RBTREE_FOREACH(p, map)
+		n++;
+	f = MALLOC(sizeof *f);
+	f->n = 0;
+	f->a = MALLOC((n ? n : 1) * sizeof f->a[0]);
+	f->b = MALLOC((n ? n : 1) * sizeof f->b[0]);
+	RBTREE_FOREACH(p, map) {
+		getab(p, f->a + f->n, f->b + f->n);
+		f->n++;
+	}
+	f->min = n ? f->a[0] : 1;
+	f->max = n ? f->b[n - 1] : 0;
+	for (f->shift = 0; f->shift < 32 && ((uint64_t)(f->max - f->min) >> f->shift) + 1 > 2 * n + 1; f->shift++)
+		;
+	nbuckets = n ? ((f->max - f->min) >> f->shift) + 1 : 0;
+	f->dir = MALLOC((nbuckets + 1) * sizeof f->dir[0]);
+	i = 0;
+	for (size_t j = 0; j <= nbuckets; j++) {
+		uint64_t start = f->min + ((uint64_t)j << f->shift);
+
+		while (i < n && f->a[i] <= start)
+			i++;
+		f->dir[j] = i ? i - 1 : 0;
+	}
+	return f;
+}
+
+void
+ipmap_frozen_free(struct ipmap_frozen *f)
+{
+	if (f) {
+		free(f->a);
+		free(f->b);
+		free(f->dir);
+		free(f);
+	}
+}
+
+/* Файл: по сегменту в строке (IP, IP-IP, IP/N, IP/маска), '#' - комментарий */
+void
+ipmap_load(struct rbtree *map, const char *path)
+{
+	FILE *volatile fp;
+	char *volatile line = NULL;
+	size_t size = 0;
+	volatile int lineno = 0;
+	struct ectlfr fr[1];
+
+	if (!(fp = fopen(path, "r")))
+		ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", path, strerror(errno));
+	ectlfr_begin(fr, L_1);
+	while (getline((char **)&line, &size, fp) >= 0) {
+		struct ipseg seg;
+		const char *ep;
+		char *p;
+
+		lineno++;
+		if ((p = strchr(line, '#')))
+			*p = 0;
+		for (p = line; isspace(*p); p++)
+			;
+		if (!*p)
+			continue;
+		for (ep = p + strlen(p); isspace(ep[-1]); ep--)
+			;
+		*(char *)ep = 0;
+		if (!cstr_to_ipseg(&seg, p, &ep))
+			ECTL_PTRAP(EINVAL, "\"%s\": expected IP, IP-IP or IP/N.\n", p);
+		if (*ep)
+			ECTL_PTRAP(EINVAL, "\"%s\": syntax error.\n", p);
+		ipmap_map(map, seg.a, seg.b);
+	}
+	if (ferror(fp))
+		ECTL_PTRAP(EIO, "getline(\"%s\"): read error.\n", path);
+	free(line);
+	fclose(fp);
+	ectlfr_end(fr);
+	return;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	ectlno_printf("%s(),%d: %s:%d.\n", __func__, __LINE__, path, lineno);
+	free(line);
+	fclose(fp);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
 #if 0
 static
 int
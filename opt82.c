@@ -0,0 +1,678 @@
+#include <stddef.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <net/ethernet.h>
+
+#include "foo.h"
+#include "dhcp.h"
+#include "opt82.h"
+
+DEFN_ERROR(E_DHCPOPT82FORMAT,	"Wrong option 82 format description.")
+
+#define O82_CID		0	/* подопция 1, Circuit-ID */
+#define O82_RID		1	/* подопция 2, Remote-ID */
+#define O82_ABSENT	256	/* индекс в масках длин подопций: подопции нет */
+
+#define O82_ENC_BIN	0
+#define O82_ENC_HEX	1
+#define O82_ENC_DEC	2
+#define O82_ENC_LP	3	/* str: байт длины, затем строка */
+#define O82_ENC_REST	4	/* str: до конца подопции */
+
+struct o82_field {
+	uint8_t		set;
+	uint8_t		sub;	/* O82_CID, O82_RID */
+	uint8_t		off;
+	uint8_t		enc;	/* O82_ENC_* */
+	uint8_t		width;	/* байт во входных данных (для LP/REST - 1/0) */
+};
+
+struct o82_match {
+	uint8_t		sub;
+	uint8_t		off;
+	uint8_t		len;
+	uint8_t		bytes[DHCPOPT82_MATCHLEN_MAX];
+};
+
+struct o82_format {
+	char		name[DHCPOPT82_NAME_MAX + 1];
+	int		nmatch;
+	struct o82_match match[DHCPOPT82_MATCH_MAX];
+	struct o82_field vlan, module, port, mac, str;
+};
+
+struct dhcpopt82_formats {
+	int		n;
+	uint64_t	tot[256];		/* длина опции 82 -> форматы */
+	uint64_t	sub[2][O82_ABSENT + 1];	/* длина подопции (или O82_ABSENT) -> форматы */
+	struct o82_format fmt[DHCPOPT82_FORMATS_MAX];
+};
+
+/* Встроенные форматы: то, что dhcpdump распознавал всегда */
+static const char dhcpopt82_builtin_text[] =
+	/*
+	 * option 82 (18): Circuit-ID (6) 00:04:0a:42:00:0e, Remote-ID (8) 00:06:00:26:5a:96:52:e0
+	 */
+	"default  18  6  8       cid:0=0004 rid:0=0006 vlan=cid:2 module=cid:4 port=cid:5 mac=rid:2\n"
+	/*
+	 * Circuit-ID (8): 00(slot) 26(port) 0f:ad(vid) "port",
+	 * Remote-ID (26): "38/0019cb8ea5c4/221004017/"
+	 */
+	"ies1248  *   8  15-255  cid:4=\"port\" rid:2=\"/\" vlan=cid:2 module=cid:0 port=cid:1 mac=rid:3:hex\n"
+	/*
+	 * Circuit-ID (16): 09(slot) 24(port) 07:d0(vid) "0019cb2db110"
+	 */
+	"ies5000  18  16 -       vlan=cid:2 module=cid:0 port=cid:1 mac=cid:4:hex\n"
+	/*
+	 * Circuit-ID (6): как default, Remote-ID (12): 01 0a(длина) "10.2.44.23"
+	 */
+	"cdru     *   6  2-255   cid:0=0004 rid:0=01 vlan=cid:2 module=cid:4 port=cid:5 str=rid:1:lp\n";
+
+static struct dhcpopt82_formats dhcpopt82_builtin[1];
+static pthread_once_t dhcpopt82_builtin_once = PTHREAD_ONCE_INIT;
+static const struct dhcpopt82_formats *dhcpopt82_formats = NULL;
+
+static inline
+int
+hexchar2number(int c)
+{
+	int n = -1;
+	if (isdigit(c))
+		n = tolower(c) - '0';
+	else if (isxdigit(c))
+		n = tolower(c) - 'a' + 10;
+	return n;
+}
+
+/*
+ * Разбор описаний
+ */
+struct o82_parser {
+	const char	*origin;
+	int		lineno;
+	const char	*tok;
+};
+
+#define O82_SYNTAX(ps, fmt, ...)					\
+	ECTL_TRAP(E_DHCPOPT82FORMAT, "%s:%d: \"%s\": " fmt "\n",	\
+		(ps)->origin, (ps)->lineno, (ps)->tok, ##__VA_ARGS__)
+
+static
+unsigned
+o82_number(struct o82_parser *ps, const char **sp, unsigned max)
+{
+	const char *s = *sp;
+	unsigned v = 0;
+
+	if (!isdigit(*s))
+		O82_SYNTAX(ps, "number expected");
+	for (; isdigit(*s); s++)
+		if ((v = v * 10 + (*s - '0')) > max)
+			O82_SYNTAX(ps, "number is greater than %u", max);
+	*sp = s;
+	return v;
+}
+
+/* N, N-M, *, - ; sub != 0 - длина подопции, она может и отсутствовать */
+static
+void
+o82_parse_len(struct o82_parser *ps, const char *s, uint64_t *mask, uint64_t bit, int sub)
+{
+	unsigned lo, hi;
+
+	if (!strcmp(s, "*")) {
+		for (int i = 0; i <= (sub ? O82_ABSENT : 255); i++)
+			mask[i] |= bit;
+		return;
+	}
+	if (!strcmp(s, "-")) {
+		if (!sub)
+			O82_SYNTAX(ps, "option 82 can't be absent");
+		mask[O82_ABSENT] |= bit;
+		return;
+	}
+	lo = hi = o82_number(ps, &s, 255);
+	if (*s == '-') {
+		s++;
+		hi = o82_number(ps, &s, 255);
+	}
+	if (*s || hi < lo)
+		O82_SYNTAX(ps, "length, range, \"*\" or \"-\" expected");
+	for (unsigned i = lo; i <= hi; i++)
+		mask[i] |= bit;
+}
+
+static
+int
+o82_parse_sub(struct o82_parser *ps, const char **sp)
+{
+	const char *s = *sp;
+	int sub;
+
+	if (!strncmp(s, "cid:", 4))
+		sub = O82_CID;
+	else if (!strncmp(s, "rid:", 4))
+		sub = O82_RID;
+	else
+		O82_SYNTAX(ps, "\"cid:\" or \"rid:\" expected");
+	*sp = s + 4;
+	return sub;
+}
+
+/* Наименьшая длина подопции, с которой совместим формат; -1 - подопция может отсутствовать */
+static
+int
+o82_minlen(const struct dhcpopt82_formats *fs, int sub, uint64_t bit)
+{
+	if (fs->sub[sub][O82_ABSENT] & bit)
+		return -1;
+	for (int i = 0; i < O82_ABSENT; i++)
+		if (fs->sub[sub][i] & bit)
+			return i;
+	return -1;
+}
+
+static
+void
+o82_check_bounds(struct o82_parser *ps, const struct dhcpopt82_formats *fs, uint64_t bit,
+		int sub, unsigned end)
+{
+	int min = o82_minlen(fs, sub, bit);
+
+	if (min < 0)
+		O82_SYNTAX(ps, "%s may be absent, give its length", sub == O82_CID ? "cid" : "rid");
+	if (end > (unsigned)min)
+		O82_SYNTAX(ps, "beyond %s of length %d", sub == O82_CID ? "cid" : "rid", min);
+}
+
+/* sub:off=0004 или sub:off="port" */
+static
+void
+o82_parse_match(struct o82_parser *ps, struct dhcpopt82_formats *fs, struct o82_format *f,
+		uint64_t bit, const char *s)
+{
+	struct o82_match *m;
+
+	if (f->nmatch == DHCPOPT82_MATCH_MAX)
+		O82_SYNTAX(ps, "too many conditions");
+	m = f->match + f->nmatch++;
+	m->sub = o82_parse_sub(ps, &s);
+	m->off = o82_number(ps, &s, 255);
+	if (*s++ != '=')
+		O82_SYNTAX(ps, "\"=\" expected");
+	m->len = 0;
+	if (*s == '"') {
+		for (s++; *s && *s != '"'; s++) {
+			if (m->len == DHCPOPT82_MATCHLEN_MAX)
+				O82_SYNTAX(ps, "value is longer than %d bytes", DHCPOPT82_MATCHLEN_MAX);
+			m->bytes[m->len++] = *s;
+		}
+		if (*s++ != '"' || *s)
+			O82_SYNTAX(ps, "unterminated string");
+	} else
+		for (; *s; s += 2) {
+			int hi = hexchar2number(s[0]), lo = hexchar2number(s[1]);
+
+			if (hi < 0 || lo < 0)
+				O82_SYNTAX(ps, "hex bytes expected");
+			if (m->len == DHCPOPT82_MATCHLEN_MAX)
+				O82_SYNTAX(ps, "value is longer than %d bytes", DHCPOPT82_MATCHLEN_MAX);
+			m->bytes[m->len++] = hi << 4 | lo;
+		}
+	if (!m->len)
+		O82_SYNTAX(ps, "empty value");
+	o82_check_bounds(ps, fs, bit, m->sub, m->off + m->len);
+}
+
+/* vlan|module|port|mac|str=sub:off[:enc] */
+static
+void
+o82_parse_field(struct o82_parser *ps, struct dhcpopt82_formats *fs, struct o82_format *f,
+		uint64_t bit, const char *s)
+{
+	static const struct {
+		const char	*name;
+		size_t		off;
+		uint8_t		bin, hex;	/* ширина двоичного и hex представлений */
+	} fields[] = {
+		{ "vlan=",	offsetof(struct o82_format, vlan),	2, 4 },
+		{ "module=",	offsetof(struct o82_format, module),	1, 2 },
+		{ "port=",	offsetof(struct o82_format, port),	1, 2 },
+		{ "mac=",	offsetof(struct o82_format, mac),	6, 12 },
+		{ "str=",	offsetof(struct o82_format, str),	0, 0 },
+	};
+	struct o82_field *fld = NULL;
+	size_t i;
+
+	for (i = 0; i < sizeof fields/sizeof fields[0]; i++)
+		if (!strncmp(s, fields[i].name, strlen(fields[i].name))) {
+			fld = (struct o82_field *)((char *)f + fields[i].off);
+			s += strlen(fields[i].name);
+			break;
+		}
+	if (!fld)
+		O82_SYNTAX(ps, "condition or vlan=, module=, port=, mac=, str= expected");
+	if (fld->set)
+		O82_SYNTAX(ps, "field is already defined");
+	fld->set = 1;
+	fld->sub = o82_parse_sub(ps, &s);
+	fld->off = o82_number(ps, &s, 255);
+	if (fld == &f->str) {
+		fld->enc = O82_ENC_REST;
+		fld->width = 0;
+		if (!strcmp(s, ":lp")) {
+			fld->enc = O82_ENC_LP;
+			fld->width = 1;
+		} else if (*s)
+			O82_SYNTAX(ps, "\":lp\" or nothing expected");
+	} else if (!*s) {
+		fld->enc = O82_ENC_BIN;
+		fld->width = fields[i].bin;
+	} else if (!strcmp(s, ":hex")) {
+		fld->enc = O82_ENC_HEX;
+		fld->width = fields[i].hex;
+	} else if (!strncmp(s, ":dec", 4) && fld != &f->mac) {
+		s += 4;
+		fld->enc = O82_ENC_DEC;
+		fld->width = o82_number(ps, &s, 5);
+		if (*s || !fld->width)
+			O82_SYNTAX(ps, "number of digits 1..5 expected");
+	} else
+		O82_SYNTAX(ps, "\":hex\", \":decN\" or nothing expected");
+	o82_check_bounds(ps, fs, bit, fld->sub, fld->off + fld->width);
+}
+
+/* Делит строку на слова по пробелам (кроме строк в кавычках), '#' - комментарий */
+static
+int
+o82_split(char *line, char **tok, int maxtok)
+{
+	int n = 0, quoted = 0;
+	char *p = line;
+
+	for (;;) {
+		while (isspace(*p))
+			p++;
+		if (!*p || *p == '#')
+			break;
+		if (n == maxtok)
+			return -1;
+		tok[n++] = p;
+		for (; *p; p++) {
+			if (*p == '"')
+				quoted = !quoted;
+			else if (!quoted && (isspace(*p) || *p == '#'))
+				break;
+		}
+		if (!*p)
+			break;
+		if (*p == '#') {
+			*p = 0;
+			break;
+		}
+		*p++ = 0;
+	}
+	return n;
+}
+
+static
+void
+o82_parse_line(struct o82_parser *ps, struct dhcpopt82_formats *fs, char *line)
+{
+	char *tok[4 + DHCPOPT82_MATCH_MAX + 5];
+	struct o82_format *f;
+	uint64_t bit;
+	int n;
+
+	ps->tok = line;
+	if ((n = o82_split(line, tok, sizeof tok/sizeof tok[0])) < 0)
+		O82_SYNTAX(ps, "too many words");
+	if (!n)
+		return;
+	if (n < 4)
+		O82_SYNTAX(ps, "name and three lengths expected");
+	if (fs->n == DHCPOPT82_FORMATS_MAX)
+		O82_SYNTAX(ps, "too many formats, %d at most", DHCPOPT82_FORMATS_MAX);
+	f = fs->fmt + fs->n;
+	bit = 1ULL << fs->n;
+
+	ps->tok = tok[0];
+	if (strlen(tok[0]) > DHCPOPT82_NAME_MAX)
+		O82_SYNTAX(ps, "name is longer than %d", DHCPOPT82_NAME_MAX);
+	for (int i = 0; i < fs->n; i++)
+		if (!strcmp(fs->fmt[i].name, tok[0]))
+			O82_SYNTAX(ps, "duplicate name");
+	strcpy(f->name, tok[0]);
+
+	ps->tok = tok[1];
+	o82_parse_len(ps, tok[1], fs->tot, bit, 0);
+	ps->tok = tok[2];
+	o82_parse_len(ps, tok[2], fs->sub[O82_CID], bit, 1);
+	ps->tok = tok[3];
+	o82_parse_len(ps, tok[3], fs->sub[O82_RID], bit, 1);
+
+	for (int i = 4; i < n; i++) {
+		ps->tok = tok[i];
+		if (!strncmp(tok[i], "cid:", 4) || !strncmp(tok[i], "rid:", 4))
+			o82_parse_match(ps, fs, f, bit, tok[i]);
+		else
+			o82_parse_field(ps, fs, f, bit, tok[i]);
+	}
+	ps->tok = tok[0];
+	if (!f->mac.set && !f->str.set)
+		O82_SYNTAX(ps, "mac= or str= is required");
+	fs->n++;
+}
+
+/* Разбор в готовую (обнулённую) структуру, без выделения памяти */
+static
+void
+o82_compile(struct dhcpopt82_formats *fs, const char *text, const char *origin)
+{
+	struct o82_parser ps[1] = {{ .origin = origin }};
+	char line[1024];
+
+	for (const char *p = text, *e; *p; p = e) {
+		size_t len;
+
+		ps->lineno++;
+		if (!(e = strchr(p, '\n')))
+			e = p + strlen(p);
+		len = e - p;
+		if (*e)
+			e++;
+		if (len >= sizeof line) {
+			ps->tok = "";
+			O82_SYNTAX(ps, "line is too long");
+		}
+		memcpy(line, p, len);
+		line[len] = 0;
+		o82_parse_line(ps, fs, line);
+	}
+	if (!fs->n) {
+		ps->tok = "";
+		O82_SYNTAX(ps, "no formats defined");
+	}
+}
+
+struct dhcpopt82_formats *
+dhcpopt82_formats_parse(const char *text, const char *origin)
+{
+	struct dhcpopt82_formats *volatile fs;
+	struct ectlfr fr[1];
+
+	fs = MALLOC(sizeof *fs);
+	memset(fs, 0, sizeof *fs);
+	ectlfr_begin(fr, L_1);
+	o82_compile(fs, text, origin);
+	ectlfr_end(fr);
+	return fs;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	free(fs);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+struct dhcpopt82_formats *
+dhcpopt82_formats_load(const char *path)
+{
+	struct dhcpopt82_formats *fs;
+	char *volatile text = NULL;
+	FILE *volatile fp;
+	size_t n = 0, size = 0;
+	struct ectlfr fr[1];
+
+	if (!(fp = fopen(path, "r")))
+		ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", path, strerror(errno));
+	ectlfr_begin(fr, L_1);
+	for (;;) {
+		if (size - n < 4096)
+			text = REALLOC(text, size += 65536);
+		n += fread(text + n, 1, size - n - 1, fp);
+		if (ferror(fp))
+			ECTL_PTRAP(EIO, "fread(\"%s\"): read error.\n", path);
+		if (feof(fp))
+			break;
+	}
+	text[n] = 0;
+	fs = dhcpopt82_formats_parse(text, path);
+	free(text);
+	fclose(fp);
+	ectlfr_end(fr);
+	return fs;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	free(text);
+	fclose(fp);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+void
+dhcpopt82_formats_free(struct dhcpopt82_formats *fs)
+{
+	if (fs && fs != dhcpopt82_builtin)
+		free(fs);
+}
+
+static
+void
+dhcpopt82_builtin_init()
+{
+	o82_compile(dhcpopt82_builtin, dhcpopt82_builtin_text, "builtin");
+}
+
+void
+dhcpopt82_setformats(const struct dhcpopt82_formats *fs)
+{
+	dhcpopt82_formats = fs;
+}
+
+/*
+ * Распознавание
+ */
+static
+int
+o82_getnum(const struct o82_field *fld, const uint8_t *const *d, unsigned *vp)
+{
+	const uint8_t *p = d[fld->sub] + fld->off;
+	unsigned v = 0;
+
+	for (int i = 0; i < fld->width; i++)
+		switch (fld->enc) {
+			case O82_ENC_BIN:
+				v = v << 8 | p[i];
+				break;
+			case O82_ENC_HEX: {
+					int x = hexchar2number(p[i]);
+					if (x < 0)
+						return 0;
+					v = v << 4 | x;
+				}
+				break;
+			case O82_ENC_DEC:
+				if (!isdigit(p[i]))
+					return 0;
+				v = v * 10 + (p[i] - '0');
+				break;
+		}
+	*vp = v;
+	return 1;
+}
+
+/* Проверяет формат f и заполняет v; при неудаче содержимое v не определено */
+static
+int
+o82_extract(const struct o82_format *f, const uint8_t *const *d, const int *len,
+		struct dhcpopt82_value *v)
+{
+	unsigned vlanid = 0, module = 0, port = 0;
+	int slen = 0;
+
+	for (int i = 0; i < f->nmatch; i++) {
+		const struct o82_match *m = f->match + i;
+		if (memcmp(d[m->sub] + m->off, m->bytes, m->len))
+			return 0;
+	}
+	if (f->vlan.set && (!o82_getnum(&f->vlan, d, &vlanid) || vlanid < 1 || vlanid > 4094))
+		return 0;
+	if (f->module.set && (!o82_getnum(&f->module, d, &module) || module > 255))
+		return 0;
+	if (f->port.set && (!o82_getnum(&f->port, d, &port) || port > 255))
+		return 0;
+	if (f->mac.set) {
+		const uint8_t *p = d[f->mac.sub] + f->mac.off;
+
+		if (f->mac.enc == O82_ENC_BIN)
+			memcpy(&v->ether, p, ETHER_ADDR_LEN);
+		else
+			for (int i = 0; i < ETHER_ADDR_LEN; i++) {
+				int hi = hexchar2number(p[2*i]), lo = hexchar2number(p[2*i + 1]);
+				if (hi < 0 || lo < 0)
+					return 0;
+				v->ether.octet[i] = hi << 4 | lo;
+			}
+	} else
+		memset(&v->ether, 0, sizeof v->ether);
+	if (f->str.set) {
+		const uint8_t *p = d[f->str.sub] + f->str.off;
+
+		slen = len[f->str.sub] - f->str.off;
+		if (f->str.enc == O82_ENC_LP) {
+			if (*p != --slen)
+				return 0;
+			p++;
+		}
+		for (int i = 0; i < slen; i++)
+			if (!isprint(p[i]))
+				return 0;
+		memcpy(v->str, p, slen);
+	}
+	v->str[slen] = 0;
+	v->slen = slen;
+	v->name = f->name;
+	v->flags = (f->mac.set ? DHCPOPT82_V_ETHER : 0) | (f->str.set ? DHCPOPT82_V_STR : 0);
+	v->vlanid = vlanid;
+	v->module = module;
+	v->port = port;
+	return 1;
+}
+
+int
+dhcpopt82_research(struct dhcpopt *opt, struct dhcpopt82_value *v)
+{
+	const struct dhcpopt82_formats *fs = dhcpopt82_formats;
+	struct dhcpopt *sub;
+	const uint8_t *d[2];
+	int len[2];
+	uint64_t cand;
+
+	if (!fs) {
+		PTHREAD_ONCE(&dhcpopt82_builtin_once, dhcpopt82_builtin_init);
+		fs = dhcpopt82_builtin;
+	}
+	for (int i = 0; i < 2; i++) {
+		sub = dhcpoptlst_find(opt->lst, i == O82_CID ? DHCPOPT82_SUBOPT1_CIRCUITID :
+				DHCPOPT82_SUBOPT2_REMOTEID);
+		d[i] = sub ? sub->u8 : NULL;
+		len[i] = sub ? dhcpopt_length(sub) : O82_ABSENT;
+	}
+	/* кандидаты в порядке описания; границы полей проверены при разборе */
+	cand = fs->tot[dhcpopt_length(opt)] & fs->sub[O82_CID][len[O82_CID]] & fs->sub[O82_RID][len[O82_RID]];
+	for (; cand; cand &= cand - 1)
+		if (o82_extract(fs->fmt + __builtin_ctzll(cand), d, len, v))
+			return 1;
+	return 0;
+}
+
+/*
+ * Кэш
+ */
+struct dhcpopt82_cache *
+dhcpopt82_cache_create(unsigned size)
+{
+	struct dhcpopt82_cache *cache;
+
+	assert(size && !(size & (size - 1)));
+	cache = MALLOC(offsetof(struct dhcpopt82_cache, ent) + size * sizeof cache->ent[0]);
+	cache->mask = size - 1;
+	dhcpopt82_cache_clear(cache);
+	return cache;
+}
+
+void
+dhcpopt82_cache_clear(struct dhcpopt82_cache *cache)
+{
+	cache->hits = cache->misses = 0;
+	for (unsigned i = 0; i <= cache->mask; i++)
+		cache->ent[i].state = 0;
+}
+
+void
+dhcpopt82_cache_free(struct dhcpopt82_cache *cache)
+{
+	free(cache);
+}
+
+/* FNV-1a: ключи короткие (десятки байт) */
+static inline
+uint64_t
+o82_hash(const uint8_t *p, uint8_t len)
+{
+	uint64_t h = 0xcbf29ce484222325ULL ^ len;
+
+	for (int i = 0; i < len; i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static inline
+void
+o82_copy(struct dhcpopt82_value *dst, const struct dhcpopt82_value *src)
+{
+	memcpy(dst, src, offsetof(struct dhcpopt82_value, str) + src->slen + 1);
+}
+
+int
+dhcpopt82_lookup(struct dhcpopt82_cache *cache, struct dhcpoptlst *lst, struct dhcpopt82_value *v)
+{
+	struct dhcpopt82_cache_ent *e;
+	struct dhcpopt *opt;
+	const uint8_t *raw;
+	uint8_t len;
+	uint64_t h;
+	int r;
+
+	if (!cache || !(raw = dhcpoptlst_peekraw(lst, DHCPOPT82_RELAYAGENTINFORMATION, &len))) {
+		opt = dhcpoptlst_find(lst, DHCPOPT82_RELAYAGENTINFORMATION);
+		return opt ? dhcpopt82_research(opt, v) : 0;
+	}
+	h = o82_hash(raw, len);
+	e = cache->ent + (h & cache->mask);
+	if (e->state && e->hash == h && e->len == len && !memcmp(e->key, raw, len)) {
+		/* те же байты уже были декодированы без ошибок, декодировать незачем */
+		cache->hits++;
+		if (e->state == 1)
+			return 0;
+		o82_copy(v, &e->v);
+		return 1;
+	}
+	cache->misses++;
+	/* декодирование может прервать обработку пакета ошибкой, запись пишется после */
+	opt = dhcpoptlst_find(lst, DHCPOPT82_RELAYAGENTINFORMATION);
+	r = dhcpopt82_research(opt, v);
+	e->hash = h;
+	e->len = len;
+	memcpy(e->key, raw, len);
+	e->state = 1 + r;
+	if (r)
+		o82_copy(&e->v, v);
+	return r;
+}
@@ -0,0 +1,98 @@
+#ifndef __opt82_h__
+#define __opt82_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <net/ethernet.h>
+
+#include "foo.h"
+#include "dhcp.h"
+
+DECL_ERROR(E_DHCPOPT82FORMAT)
+
+/* Форматы опции 82 (relay agent information) описываются таблицей, а не кодом.
+ * Одна строка - один формат (модель коммутатора):
+ *
+ *	имя  длина-82  длина-circuit-id  длина-remote-id  [условие|поле ...]
+ *
+ * Длины: N, N-M, * (любая; для подопций - в том числе отсутствие), - (подопции
+ * нет). Условие: подопция:смещение=байты, байты - hex (0004) или строка ("port").
+ * Поля:
+ *	vlan=cid:2		двоичное big-endian (vlan - 2 байта, module/port - 1)
+ *	vlan=cid:2:hex		ASCII hex (vlan - 4 символа, module/port - 2)
+ *	port=cid:9:dec2		ASCII десятичное, N цифр
+ *	mac=rid:2		6 байт
+ *	mac=rid:3:hex		12 символов ASCII hex
+ *	str=rid:2		печатная строка до конца подопции
+ *	str=rid:1:lp		байт длины, за ним строка ровно до конца подопции
+ * Подопции: cid (1, Circuit-ID), rid (2, Remote-ID). Нужно хотя бы одно из
+ * mac/str; vlan, если задан, должен быть 1..4094.
+ *
+ * Форматы собираются в решающую таблицу по (длина 82, длина circuit-id,
+ * длина remote-id): три битовые маски форматов, их пересечение - кандидаты,
+ * проверяемые по порядку описания. Первый совпавший - результат.
+ */
+#define DHCPOPT82_FORMATS_MAX	64
+#define DHCPOPT82_NAME_MAX	31
+#define DHCPOPT82_MATCH_MAX	8
+#define DHCPOPT82_MATCHLEN_MAX	16
+
+#define DHCPOPT82_STR_MAX	255	/* строка не длиннее значения опции */
+#define DHCPOPT82_CACHE_SIZE	4096
+
+#define DHCPOPT82_V_ETHER	0x01	/* есть ether */
+#define DHCPOPT82_V_STR		0x02	/* есть str */
+
+/* Результат распознавания, память - у вызывающего */
+struct dhcpopt82_value {
+	const char		*name;		/* имя формата */
+	uint8_t			flags;		/* DHCPOPT82_V_* */
+	uint16_t		vlanid;
+	uint8_t			module, port;
+	struct ether_addr	ether;
+	uint8_t			slen;
+	char			str[DHCPOPT82_STR_MAX + 1];
+};
+
+struct dhcpopt82_formats;
+
+/* Кэш результатов dhcpopt82_lookup() по сырым байтам опции 82: у одного relay
+ * (коммутатор, порт, vlan) они одинаковы во всех пакетах. Прямое отображение
+ * по хэшу, при коллизии запись вытесняется. Хранит и отрицательные ответы.
+ */
+struct dhcpopt82_cache_ent {
+	uint64_t		hash;
+	uint8_t			state;		/* 0 - пусто, 1 - не распознано, 2 - распознано */
+	uint8_t			len;
+	uint8_t			key[255];
+	struct dhcpopt82_value	v;
+};
+struct dhcpopt82_cache {
+	unsigned		mask;
+	uint64_t		hits, misses;
+	struct dhcpopt82_cache_ent ent[];
+};
+
+__BEGIN_DECLS
+/* пробует угадать, что за данные спрятаны в dhcp option 82; 1 - распознано, результат в v */
+int				dhcpopt82_research(struct dhcpopt *opt, struct dhcpopt82_value *v);
+
+/* Опция 82 из списка опций пакета, распознанная через кэш. Пока опция не
+ * декодирована, при попадании в кэш она и не декодируется. cache == NULL - без кэша.
+ */
+int				dhcpopt82_lookup(struct dhcpopt82_cache *cache, struct dhcpoptlst *lst,
+					struct dhcpopt82_value *v);
+/* size - степень двойки */
+struct dhcpopt82_cache *	dhcpopt82_cache_create(unsigned size);
+void				dhcpopt82_cache_clear(struct dhcpopt82_cache *cache);
+void				dhcpopt82_cache_free(struct dhcpopt82_cache *cache);
+
+/* text - описания форматов, origin - откуда они (для сообщений об ошибках) */
+struct dhcpopt82_formats *	dhcpopt82_formats_parse(const char *text, const char *origin);
+struct dhcpopt82_formats *	dhcpopt82_formats_load(const char *path);
+void				dhcpopt82_formats_free(struct dhcpopt82_formats *fs);
+/* форматы для dhcpopt82_research(), NULL - встроенные; кэши после смены - очистить */
+void				dhcpopt82_setformats(const struct dhcpopt82_formats *fs);
+__END_DECLS
+
+#endif
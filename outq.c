@@ -0,0 +1,235 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+
+#include "foo.h"
+#include "outq.h"
+
+DEFN_ERROR(E_OUTQSYNTAX,	"Syntax error in --async option.")
+DEFN_ERROR(E_OUTQFAILED,	"Output thread failed.")
+
+/* сколько раз читатель уступает процессор, прежде чем уснуть на пустом
+ * кольце: под нагрузкой он не засыпает и писателю не нужно его будить
+ */
+#define OUTQ_SPIN	64
+
+static const char *const outq_policies[] = { "block", "drop-newest", "drop-verbose" };
+
+int
+outq_policy(const char *arg)
+{
+	for (size_t i = 0; i < sizeof outq_policies/sizeof outq_policies[0]; i++)
+		if (!strcmp(arg, outq_policies[i]))
+			return i;
+	ECTL_TRAP(E_OUTQSYNTAX, "\"%s\": expected block, drop-newest or drop-verbose.\n", arg);
+}
+
+/* Печать записи со своим кадром ошибок: ошибка не выходит за пределы потока
+ * вывода, а только взводит failed. Запись освобождается в любом случае.
+ */
+static
+void
+outq_show(struct outq *q, void *rec)
+{
+	struct ectlfr fr[1];
+	struct ectlno ex[1];
+
+	ectlfr_begin(fr, L_0);
+	ectlno_begin(ex);
+	q->show(rec);
+	goto L_1;
+
+L_0:	if (ectlno_iserror())
+		atomic_store_explicit(&q->failed, 1, memory_order_relaxed);
+	ectlno_log();
+	ectlno_clearmessage();
+L_1:	ectlno_end(ex);
+	ectlfr_end(fr);
+	q->release(rec);
+}
+
+/* 0 - кольцо пусто и больше ничего не будет */
+static
+int
+outq_wait_nonempty(struct outq *q, size_t tail)
+{
+	int more;
+
+	for (int i = 0; i < OUTQ_SPIN; i++) {
+		sched_yield();
+		if ((q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire)) != tail)
+			return 1;
+	}
+	fflush(q->fp);
+	pthread_mutex_lock(&q->mtx);
+	/* писатель сначала сдвигает голову, потом смотрит rsleep; здесь наоборот -
+	 * кто-то из двоих увидит изменение другого (оба seq_cst)
+	 */
+	atomic_store(&q->rsleep, 1);
+	while ((q->head_cache = atomic_load(&q->head)) == tail && !atomic_load(&q->stop))
+		pthread_cond_wait(&q->nonempty, &q->mtx);
+	atomic_store(&q->rsleep, 0);
+	more = q->head_cache != tail;
+	pthread_mutex_unlock(&q->mtx);
+	return more;
+}
+
+static
+void *
+outq_thread(void *arg)
+{
+	struct outq *q = arg;
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+	for (;;) {
+		void *rec;
+
+		if (tail == q->head_cache &&
+				(q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire)) == tail &&
+				!outq_wait_nonempty(q, tail))
+			break;
+		rec = q->recs + (tail & q->mask) * q->recsz;
+		if (!outq_failed(q))
+			outq_show(q, rec);
+		else
+			q->release(rec);
+		atomic_store(&q->tail, ++tail);
+		if (atomic_load(&q->wsleep) && q->head_cache - tail <= OUTQ_HIGHWAT(q->mask + 1)) {
+			pthread_mutex_lock(&q->mtx);
+			pthread_cond_signal(&q->nonfull);
+			pthread_mutex_unlock(&q->mtx);
+		}
+	}
+	fflush(q->fp);
+	return NULL;
+}
+
+struct outq *
+outq_create(size_t nrec, size_t recsz, int policy, FILE *fp,
+	void (*show)(void *rec), void (*release)(void *rec))
+{
+	struct ectlfr fr[1];
+	struct outq *volatile q;
+	void *p;
+
+	ectlfr_begin(fr, L_0);
+	if (posix_memalign(&p, _Alignof(struct outq), sizeof *q))
+		ECTL_PTRAP(ENOMEM, "posix_memalign(): %s.\n", strerror(ENOMEM));
+	q = p;
+	memset(q, 0, sizeof *q);
+	ectlfr_ontrap(fr, L_1);
+	/* запись с целой строки кэша: соседние записи пишет и читает разный поток */
+	q->recsz = (recsz + 63) & ~(size_t)63;
+	q->mask = nrec - 1;
+	if (posix_memalign(&p, 64, nrec * q->recsz))
+		ECTL_PTRAP(ENOMEM, "posix_memalign(): %s.\n", strerror(ENOMEM));
+	q->recs = p;
+	ectlfr_ontrap(fr, L_2);
+	q->policy = policy;
+	q->fp = fp;
+	q->show = show;
+	q->release = release;
+	PTHREAD_MUTEX_INIT(&q->mtx, NULL);
+	ectlfr_ontrap(fr, L_3);
+	PTHREAD_COND_INIT(&q->nonempty, NULL);
+	ectlfr_ontrap(fr, L_4);
+	PTHREAD_COND_INIT(&q->nonfull, NULL);
+	ectlfr_ontrap(fr, L_5);
+	PTHREAD_CREATE(&q->thr, NULL, outq_thread, q);
+	ectlfr_end(fr);
+	return q;
+
+L_5:	ectlfr_ontrap(fr, L_4);
+	pthread_cond_destroy(&q->nonfull);
+L_4:	ectlfr_ontrap(fr, L_3);
+	pthread_cond_destroy(&q->nonempty);
+L_3:	ectlfr_ontrap(fr, L_2);
+	pthread_mutex_destroy(&q->mtx);
+L_2:	ectlfr_ontrap(fr, L_1);
+	free(q->recs);
+L_1:	ectlfr_ontrap(fr, L_0);
+	free(q);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+/* зовутся и на путях очистки после ошибки - без ловушек */
+void
+outq_flush(struct outq *q)
+{
+	if (q->joined)
+		return;
+	pthread_mutex_lock(&q->mtx);
+	atomic_store(&q->stop, 1);
+	pthread_cond_signal(&q->nonempty);
+	pthread_mutex_unlock(&q->mtx);
+	pthread_join(q->thr, NULL);
+	q->joined = 1;
+}
+
+void
+outq_free(struct outq *q)
+{
+	if (!q)
+		return;
+	outq_flush(q);
+	pthread_cond_destroy(&q->nonfull);
+	pthread_cond_destroy(&q->nonempty);
+	pthread_mutex_destroy(&q->mtx);
+	free(q->recs);
+	free(q);
+}
+
+void *
+outq_reserve(struct outq *q, int *verbose)
+{
+	size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	size_t highwat = q->policy == OUTQ_DEMOTE ? OUTQ_HIGHWAT(q->mask + 1) : q->mask + 1;
+
+	if (head - q->tail_cache >= highwat)
+		q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+	if (head - q->tail_cache > q->mask) {
+		if (q->policy != OUTQ_BLOCK) {
+			q->dropped++;
+			return NULL;
+		}
+		/* будить писателя на каждую освободившуюся запись дорого: он ждёт,
+		 * пока кольцо не опустеет до OUTQ_HIGHWAT
+		 */
+		q->blocked++;
+		PTHREAD_MUTEX_LOCK(&q->mtx);
+		atomic_store(&q->wsleep, 1);
+		while (head - (q->tail_cache = atomic_load(&q->tail)) > OUTQ_HIGHWAT(q->mask + 1))
+			PTHREAD_COND_WAIT(&q->nonfull, &q->mtx);
+		atomic_store(&q->wsleep, 0);
+		PTHREAD_MUTEX_UNLOCK(&q->mtx);
+	}
+	if (q->policy == OUTQ_DEMOTE && *verbose && head - q->tail_cache >= highwat) {
+		*verbose = 0;
+		q->demoted++;
+	}
+	return q->recs + (head & q->mask) * q->recsz;
+}
+
+void
+outq_commit(struct outq *q)
+{
+	atomic_store(&q->head, atomic_load_explicit(&q->head, memory_order_relaxed) + 1);
+	q->records++;
+	if (atomic_load(&q->rsleep)) {
+		PTHREAD_MUTEX_LOCK(&q->mtx);
+		PTHREAD_COND_SIGNAL(&q->nonempty);
+		PTHREAD_MUTEX_UNLOCK(&q->mtx);
+	}
+}
+
+void
+outq_report(struct outq *q, FILE *fp)
+{
+	fprintf(fp, "async: records %" PRIu64 " dropped %" PRIu64 " demoted %" PRIu64 " blocked %" PRIu64 "\n",
+		q->records, q->dropped, q->demoted, q->blocked);
+}
@@ -0,0 +1,94 @@
+#ifndef __outq_h__
+#define __outq_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "foo.h"
+
+DECL_ERROR(E_OUTQSYNTAX)
+DECL_ERROR(E_OUTQFAILED)
+
+/* Асинхронный вывод: поток захвата складывает готовые к печати записи в
+ * кольцо на одного писателя и одного читателя, отдельный поток вывода
+ * печатает их и сбрасывает fp, когда кольцо опустело, - медленный терминал,
+ * pipe в grep или полный диск тормозят вывод, а не захват.
+ *
+ * Кольцо - nrec записей по recsz байт, головой двигает только писатель,
+ * хвостом - только читатель, без блокировок. Каждый держит копию чужого
+ * индекса и перечитывает его, только когда по копии места (записей) нет.
+ * Мьютекс и условные переменные - только чтобы уснуть на пустом (полном)
+ * кольце и разбудить спящего.
+ *
+ * Кольцо полно - решает политика (--async):
+ *	block		писатель ждёт места, захват стоит
+ *	drop-newest	новая запись отбрасывается
+ *	drop-verbose	выше OUTQ_HIGHWAT подробные записи заменяются краткими,
+ *			а когда места нет совсем - отбрасываются
+ *
+ * После show() поток вывода зовёт release() - запись больше не нужна. Ошибка
+ * в show(): поток вывода пишет её в лог, дальше записи только освобождает,
+ * а outq_failed() говорит писателю, что пора останавливаться.
+ */
+#define OUTQ_BLOCK	0
+#define OUTQ_DROP	1
+#define OUTQ_DEMOTE	2
+
+#define OUTQ_NREC	4096		/* степень двойки */
+#define OUTQ_HIGHWAT(nrec)	((nrec) / 4 * 3)
+
+struct outq {
+	/* писатель */
+	_Alignas(64) atomic_size_t	head;
+	size_t		tail_cache;
+	uint64_t	records, dropped, demoted, blocked;
+	/* читатель */
+	_Alignas(64) atomic_size_t	tail;
+	size_t		head_cache;
+	/* общее, не меняется */
+	_Alignas(64) size_t	mask, recsz;
+	uint8_t		*recs;
+	int		policy;
+	FILE		*fp;		/* сбрасывается, когда кольцо опустело */
+	void		(*show)(void *rec);
+	void		(*release)(void *rec);
+	pthread_t	thr;
+	int		joined;
+	pthread_mutex_t	mtx;
+	pthread_cond_t	nonempty, nonfull;
+	atomic_int	rsleep, wsleep;	/* читатель (писатель) спит или собирается */
+	atomic_int	stop, failed;
+};
+
+__BEGIN_DECLS
+/* "block", "drop-newest", "drop-verbose" */
+int		outq_policy(const char *arg);
+struct outq *	outq_create(size_t nrec, size_t recsz, int policy, FILE *fp,
+			void (*show)(void *rec), void (*release)(void *rec));
+/* дождаться, пока поток вывода напечатает всё, и остановить его; после этого
+ * outq_failed() окончательный
+ */
+void		outq_flush(struct outq *q);
+/* с outq_flush(), если её не было */
+void		outq_free(struct outq *q);
+/* Место под следующую запись; NULL - кольцо полно, запись отброшена. *verbose
+ * != 0 на входе - запись подробная; обнулён на выходе - сделать её краткой.
+ */
+void *		outq_reserve(struct outq *q, int *verbose);
+/* запись на месте из outq_reserve() заполнена - отдать потоку вывода */
+void		outq_commit(struct outq *q);
+void		outq_report(struct outq *q, FILE *fp);
+
+static inline
+int
+outq_failed(struct outq *q)
+{
+	return atomic_load_explicit(&q->failed, memory_order_relaxed);
+}
+__END_DECLS
+
+#endif
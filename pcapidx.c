@@ -0,0 +1,512 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "foo.h"
+#include "dhcp.h"
+#include "pcapidx.h"
+
+DEFN_ERROR(E_PCAPIDXFORMAT,	"Broken pcap or pcap index.")
+
+#define PCAPIDX_FILEHDR		24
+#define PCAPIDX_RECHDR		16
+#define PCAPIDX_CHUNK		(1 << 20)	/* чтение отрезков времени */
+#define PCAPIDX_PREREAD		2048		/* заголовок и пакет DHCP одним pread */
+
+/* порядок байт и точность времени pcap */
+struct pcapidx_fmt {
+	int		swap, nsec;
+};
+
+struct pcapidx {
+	int				fd;		/* pcap */
+	struct pcapidx_fmt		fmt;
+	const struct pcapidx_hdr	*hdr;		/* весь индекс */
+	size_t				maplen;
+	uint8_t				*buf;		/* PCAPIDX_CHUNK */
+};
+
+struct pcapidx_vec {
+	struct pcapidx_ent	*ent;
+	size_t			n, max;
+};
+
+static
+void
+pcapidx_getfmt(const char *path, const uint8_t *p, struct pcapidx_fmt *f)
+{
+	uint32_t magic;
+
+	memcpy(&magic, p, sizeof magic);
+	switch (magic) {
+	case 0xa1b2c3d4:
+	case 0xd4c3b2a1:
+		f->nsec = 0;
+		break;
+	case 0xa1b23c4d:
+	case 0x4d3cb2a1:
+		f->nsec = 1;
+		break;
+	case 0x0a0d0d0a:
+		ECTL_TRAP(E_PCAPIDXFORMAT, "\"%s\": pcapng is not supported.\n", path);
+	default:
+		ECTL_TRAP(E_PCAPIDXFORMAT, "\"%s\": not a pcap file.\n", path);
+	}
+	f->swap = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+}
+
+static inline
+uint32_t
+pcapidx_get32(const struct pcapidx_fmt *f, const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof v);
+	if (f->swap)
+		v = v >> 24 | (v >> 8 & 0xff00) | (v << 8 & 0xff0000) | v << 24;
+	return v;
+}
+
+static inline
+void
+pcapidx_rechdr(const struct pcapidx_fmt *f, const uint8_t *p, struct pcap_pkthdr *h)
+{
+	h->ts.tv_sec = pcapidx_get32(f, p);
+	h->ts.tv_usec = f->nsec ? pcapidx_get32(f, p + 4) / 1000 : pcapidx_get32(f, p + 4);
+	h->caplen = pcapidx_get32(f, p + 8);
+	h->len = pcapidx_get32(f, p + 12);
+}
+
+static inline
+uint64_t
+pcapidx_ether(const uint8_t *p)
+{
+	uint64_t key = 0;
+
+	for (int i = 0; i < ETHER_ADDR_LEN; i++)
+		key = key << 8 | p[i];
+	return key;
+}
+
+/* chaddr и xid пакета DHCP; 0 - не DHCP или пакет обрезан до них */
+static
+int
+pcapidx_keys(const uint8_t *p, uint32_t caplen, uint64_t *mac, uint64_t *xid)
+{
+	const uint8_t *cp = p + ETHER_HDR_LEN, *end = p + caplen;
+	const struct ip *ip;
+	const struct udphdr *udp;
+	const struct dhcphdr *dh;
+	uint16_t type, sport, dport;
+
+	if (caplen < ETHER_HDR_LEN)
+		return 0;
+	type = p[12] << 8 | p[13];
+	while (type == ETHERTYPE_VLAN) {
+		if (end - cp < 4)
+			return 0;
+		type = cp[2] << 8 | cp[3];
+		cp += 4;
+	}
+	if (type != ETHERTYPE_IP || end - cp < (ptrdiff_t)sizeof *ip)
+		return 0;
+	ip = (const struct ip *)cp;
+	if (ip->ip_v != IPVERSION || ip->ip_p != IPPROTO_UDP)
+		return 0;
+	cp += ip->ip_hl * 4;
+	if (end - cp < (ptrdiff_t)(sizeof *udp + offsetof(struct dhcphdr, sname)))
+		return 0;
+	udp = (const struct udphdr *)cp;
+	sport = ntohs(udp->uh_sport);
+	dport = ntohs(udp->uh_dport);
+	if (sport != 67 && sport != 68 && dport != 67 && dport != 68)
+		return 0;
+	dh = (const struct dhcphdr *)(cp + sizeof *udp);
+	*mac = pcapidx_ether(dh->chaddr);
+	*xid = ntohl(dh->xid);
+	return 1;
+}
+
+static inline
+void
+pcapidx_add(struct pcapidx_vec *v, uint64_t key, uint64_t off)
+{
+	if (v->n == v->max) {
+		v->max = v->max ? 2 * v->max : 4096;
+		v->ent = REALLOC(v->ent, v->max * sizeof v->ent[0]);
+	}
+	v->ent[v->n].key = key;
+	v->ent[v->n].off = off;
+	v->n++;
+}
+
+static
+int
+pcapidx_entcmp(const void *a, const void *b)
+{
+	const struct pcapidx_ent *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return x->off < y->off ? -1 : x->off > y->off;
+}
+
+static
+void
+pcapidx_write(const char *path, const struct pcapidx_hdr *hdr, const struct pcapidx_vec *v, int nv)
+{
+	char tmp[PATH_MAX], idx[PATH_MAX];
+	FILE *fp;
+	int err = 0;
+
+	snprintf(tmp, sizeof tmp, "%s.idx.tmp", path);
+	snprintf(idx, sizeof idx, "%s.idx", path);
+	if (!(fp = fopen(tmp, "w")))
+		ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", tmp, strerror(errno));
+	if (fwrite(hdr, sizeof *hdr, 1, fp) != 1)
+		err = errno;
+	for (int i = 0; i < nv && !err; i++)
+		if (fwrite(v[i].ent, sizeof v[i].ent[0], v[i].n, fp) != v[i].n)
+			err = errno;
+	if (fclose(fp) && !err)
+		err = errno;
+	if (err) {
+		unlink(tmp);
+		ECTL_PTRAP(err, "\"%s\": %s.\n", tmp, strerror(err));
+	}
+	if (rename(tmp, idx) == -1)
+		ECTL_PTRAP(errno, "rename(\"%s\"): %s.\n", tmp, strerror(errno));
+}
+
+void
+pcapidx_build(const char *path, FILE *report)
+{
+	struct ectlfr fr[1];
+	struct pcapidx_hdr hdr = { .magic = PCAPIDX_MAGIC, .bom = PCAPIDX_BOM, .version = PCAPIDX_VERSION,
+		.bucket = PCAPIDX_BUCKET };
+	struct {
+		FILE			*fp;
+		uint8_t			*buf, *iobuf;
+		struct pcapidx_vec	v[3];	/* chaddr, xid, отрезки времени */
+	} b[1];
+	struct pcapidx_fmt fmt;
+	uint8_t rh[PCAPIDX_FILEHDR];
+	struct pcap_pkthdr h;
+	struct stat sb;
+	uint64_t off, mac, xid;
+	volatile int ok = 0;
+
+	ectlfr_begin(fr, L_0);
+	memset(b, 0, sizeof *b);
+	if (!(b->fp = fopen(path, "r")))
+		ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", path, strerror(errno));
+	ectlfr_ontrap(fr, L_1);
+	if (fstat(fileno(b->fp), &sb) == -1)
+		ECTL_PTRAP(errno, "fstat(\"%s\"): %s.\n", path, strerror(errno));
+	b->buf = MALLOC(PCAPIDX_CAPLEN_MAX);
+	b->iobuf = MALLOC(PCAPIDX_CHUNK);
+	setvbuf(b->fp, (char *)b->iobuf, _IOFBF, PCAPIDX_CHUNK);
+	if (fread(rh, 1, PCAPIDX_FILEHDR, b->fp) != PCAPIDX_FILEHDR)
+		ECTL_TRAP(E_PCAPIDXFORMAT, "\"%s\": not a pcap file.\n", path);
+	pcapidx_getfmt(path, rh, &fmt);
+	/* обрезанная последняя запись (захват прервали) - конец файла */
+	for (off = PCAPIDX_FILEHDR; fread(rh, 1, PCAPIDX_RECHDR, b->fp) == PCAPIDX_RECHDR; ) {
+		uint64_t bucket;
+
+		pcapidx_rechdr(&fmt, rh, &h);
+		if (h.caplen > PCAPIDX_CAPLEN_MAX)
+			ECTL_TRAP(E_PCAPIDXFORMAT, "\"%s\": record at %" PRIu64 ": caplen %" PRIu32 ".\n",
+				path, off, h.caplen);
+		if (fread(b->buf, 1, h.caplen, b->fp) != h.caplen)
+			break;
+		bucket = h.ts.tv_sec / PCAPIDX_BUCKET;
+		if (!b->v[2].n || b->v[2].ent[b->v[2].n - 1].key != bucket)
+			pcapidx_add(b->v + 2, bucket, off);
+		if (pcapidx_keys(b->buf, h.caplen, &mac, &xid)) {
+			pcapidx_add(b->v, mac, off);
+			pcapidx_add(b->v + 1, xid, off);
+		}
+		off += PCAPIDX_RECHDR + h.caplen;
+		hdr.npkts++;
+	}
+	if (ferror(b->fp))
+		ECTL_PTRAP(errno, "fread(\"%s\"): %s.\n", path, strerror(errno));
+	qsort(b->v[0].ent, b->v[0].n, sizeof b->v[0].ent[0], pcapidx_entcmp);
+	qsort(b->v[1].ent, b->v[1].n, sizeof b->v[1].ent[0], pcapidx_entcmp);
+	hdr.size = sb.st_size;
+	hdr.mtime_sec = sb.st_mtim.tv_sec;
+	hdr.mtime_nsec = sb.st_mtim.tv_nsec;
+	hdr.end = off;
+	hdr.nmac = b->v[0].n;
+	hdr.nxid = b->v[1].n;
+	hdr.nruns = b->v[2].n;
+	pcapidx_write(path, &hdr, b->v, 3);
+	if (report)
+		fprintf(report, "index: packets %" PRIu64 " dhcp %" PRIu32 " runs %" PRIu32 "\n",
+			hdr.npkts, hdr.nmac, hdr.nruns);
+	ok = 1;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	fclose(b->fp);
+	free(b->iobuf);
+	free(b->buf);
+	for (int i = 0; i < 3; i++)
+		free(b->v[i].ent);
+L_0:	ectlfr_end(fr);
+	if (!ok)
+		ectlfr_trap();
+}
+
+void
+pcapidx_free(struct pcapidx *px)
+{
+	if (px) {
+		if (px->fd != -1)
+			close(px->fd);
+		if (px->hdr)
+			munmap((void *)px->hdr, px->maplen);
+		free(px->buf);
+		free(px);
+	}
+}
+
+/* ровно n байт с off */
+static
+void
+pcapidx_pread(struct pcapidx *px, void *p, size_t n, uint64_t off)
+{
+	while (n) {
+		ssize_t r = pread(px->fd, p, n, off);
+
+		if (r == -1) {
+			if (errno == EINTR)
+				continue;
+			ECTL_PTRAP(errno, "pread(): %s.\n", strerror(errno));
+		}
+		if (!r)
+			ECTL_TRAP(E_PCAPIDXFORMAT, "pcap is shorter than its index.\n");
+		p = (uint8_t *)p + r;
+		n -= r;
+		off += r;
+	}
+}
+
+struct pcapidx *
+pcapidx_open(const char *path)
+{
+	struct ectlfr fr[1];
+	struct pcapidx *volatile px;
+	const struct pcapidx_hdr *hdr;
+	char idx[PATH_MAX];
+	struct stat sb, isb;
+	uint8_t fh[PCAPIDX_FILEHDR];
+	void *map;
+	int fd;
+
+	ectlfr_begin(fr, L_0);
+	px = MALLOC(sizeof *px);
+	memset(px, 0, sizeof *px);
+	px->fd = -1;
+	ectlfr_ontrap(fr, L_1);
+	snprintf(idx, sizeof idx, "%s.idx", path);
+	if ((fd = open(idx, O_RDONLY)) == -1) {
+		if (errno != ENOENT)
+			ECTL_PTRAP(errno, "open(\"%s\"): %s.\n", idx, strerror(errno));
+		goto L_none;
+	}
+	if (fstat(fd, &isb) == -1 || (uint64_t)isb.st_size < sizeof *hdr) {
+		close(fd);
+		ECTL_TRAP(E_PCAPIDXFORMAT, "\"%s\": short index.\n", idx);
+	}
+	map = mmap(NULL, isb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		ECTL_PTRAP(errno, "mmap(\"%s\"): %s.\n", idx, strerror(errno));
+	px->hdr = hdr = map;
+	px->maplen = isb.st_size;
+	if (memcmp(hdr->magic, PCAPIDX_MAGIC, sizeof hdr->magic) || hdr->bom != PCAPIDX_BOM ||
+			hdr->version != PCAPIDX_VERSION || hdr->bucket == 0 ||
+			sizeof *hdr + ((uint64_t)hdr->nmac + hdr->nxid + hdr->nruns) * sizeof(struct pcapidx_ent) != (uint64_t)isb.st_size)
+		ECTL_TRAP(E_PCAPIDXFORMAT, "\"%s\": not a pcap index or broken.\n", idx);
+	if ((px->fd = open(path, O_RDONLY)) == -1 || fstat(px->fd, &sb) == -1)
+		ECTL_PTRAP(errno, "\"%s\": %s.\n", path, strerror(errno));
+	if (hdr->size != (uint64_t)sb.st_size || hdr->mtime_sec != sb.st_mtim.tv_sec || hdr->mtime_nsec != sb.st_mtim.tv_nsec) {
+		fprintf(stderr, "%s: pcap changed after indexing, reading the whole file.\n", idx);
+		goto L_none;
+	}
+	pcapidx_pread(px, fh, sizeof fh, 0);
+	pcapidx_getfmt(path, fh, &px->fmt);
+	px->buf = MALLOC(PCAPIDX_CHUNK);
+	ectlfr_end(fr);
+	return px;
+
+L_none:
+	pcapidx_free(px);
+	ectlfr_end(fr);
+	return NULL;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	pcapidx_free(px);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+struct pcapidx_sel {
+	uint64_t			since, until;
+	const struct bpf_program	*bpf;
+	pcap_handler			cb;
+	u_char				*user;
+};
+
+/* запись с заголовком в p - в cb(), если она во времени и прошла bpf */
+static inline
+void
+pcapidx_deliver(struct pcapidx *px, const struct pcapidx_sel *sel, const uint8_t *p)
+{
+	struct pcap_pkthdr h;
+	uint64_t t;
+
+	pcapidx_rechdr(&px->fmt, p, &h);
+	t = (uint64_t)h.ts.tv_sec * 1000000 + h.ts.tv_usec;
+	if ((sel->since && t < sel->since) || (sel->until && t > sel->until))
+		return;
+	if (sel->bpf && !pcap_offline_filter(sel->bpf, &h, p + PCAPIDX_RECHDR))
+		return;
+	sel->cb(sel->user, &h, p + PCAPIDX_RECHDR);
+}
+
+static
+void
+pcapidx_one(struct pcapidx *px, const struct pcapidx_sel *sel, uint64_t off)
+{
+	size_t n = PCAPIDX_PREREAD, need;
+
+	if (off >= px->hdr->end)
+		ECTL_TRAP(E_PCAPIDXFORMAT, "record at %" PRIu64 " is beyond the end of pcap.\n", off);
+	if (n > px->hdr->end - off)
+		n = px->hdr->end - off;
+	pcapidx_pread(px, px->buf, n, off);
+	if (n < PCAPIDX_RECHDR || (need = PCAPIDX_RECHDR + pcapidx_get32(&px->fmt, px->buf + 8)) >
+			PCAPIDX_RECHDR + PCAPIDX_CAPLEN_MAX || off + need > px->hdr->end)
+		ECTL_TRAP(E_PCAPIDXFORMAT, "record at %" PRIu64 ": broken.\n", off);
+	if (need > n)
+		pcapidx_pread(px, px->buf + n, need - n, off + n);
+	pcapidx_deliver(px, sel, px->buf);
+}
+
+/* записи с a до b подряд, большими чтениями */
+static
+void
+pcapidx_range(struct pcapidx *px, const struct pcapidx_sel *sel, uint64_t a, uint64_t b)
+{
+	while (a < b) {
+		size_t len = b - a < PCAPIDX_CHUNK ? b - a : PCAPIDX_CHUNK, used = 0;
+
+		pcapidx_pread(px, px->buf, len, a);
+		while (len - used >= PCAPIDX_RECHDR) {
+			uint32_t caplen = pcapidx_get32(&px->fmt, px->buf + used + 8);
+
+			if (caplen > PCAPIDX_CAPLEN_MAX)
+				ECTL_TRAP(E_PCAPIDXFORMAT, "record at %" PRIu64 ": broken.\n", a + used);
+			if (len - used - PCAPIDX_RECHDR < caplen)
+				break;
+			pcapidx_deliver(px, sel, px->buf + used);
+			if (ectlno_iserror())
+				return;
+			used += PCAPIDX_RECHDR + caplen;
+		}
+		if (!used)
+			ECTL_TRAP(E_PCAPIDXFORMAT, "record at %" PRIu64 ": broken.\n", a);
+		a += used;
+	}
+}
+
+/* первый элемент с ключом не меньше key */
+static
+size_t
+pcapidx_lower(const struct pcapidx_ent *ent, size_t n, uint64_t key)
+{
+	size_t lo = 0;
+
+	while (n) {
+		size_t half = n / 2;
+
+		if (ent[lo + half].key < key) {
+			lo += half + 1;
+			n -= half + 1;
+		} else
+			n = half;
+	}
+	return lo;
+}
+
+static inline
+int
+pcapidx_inwindow(const struct pcapidx *px, const struct pcapidx_sel *sel, uint64_t bucket)
+{
+	uint64_t w = (uint64_t)px->hdr->bucket * 1000000;
+
+	return (!sel->since || (bucket + 1) * w > sel->since) && (!sel->until || bucket * w <= sel->until);
+}
+
+void
+pcapidx_loop(struct pcapidx *px, const struct ether_addr *mac, const uint32_t *xid,
+	uint64_t since, uint64_t until, const struct bpf_program *bpf,
+	pcap_handler cb, u_char *user)
+{
+	const struct pcapidx_hdr *hdr = px->hdr;
+	const struct pcapidx_ent *macs = (const struct pcapidx_ent *)(hdr + 1), *xids = macs + hdr->nmac,
+		*runs = xids + hdr->nxid, *ent = NULL;
+	struct pcapidx_sel sel = { .since = since, .until = until, .bpf = bpf, .cb = cb, .user = user };
+	size_t lo = 0, n = SIZE_MAX;
+
+	/* из chaddr и xid - более редкий, второй проверит фильтр */
+	if (mac) {
+		uint64_t key = pcapidx_ether(mac->octet);
+
+		lo = pcapidx_lower(macs, hdr->nmac, key);
+		n = pcapidx_lower(macs, hdr->nmac, key + 1) - lo;
+		ent = macs;
+	}
+	if (xid) {
+		size_t xlo = pcapidx_lower(xids, hdr->nxid, *xid);
+		size_t xn = pcapidx_lower(xids, hdr->nxid, (uint64_t)*xid + 1) - xlo;
+
+		if (xn < n) {
+			lo = xlo;
+			n = xn;
+			ent = xids;
+		}
+	}
+	if (ent) {
+		/* записи одного ключа отсортированы по смещению */
+		for (size_t i = lo; i < lo + n && !ectlno_iserror(); i++)
+			pcapidx_one(px, &sel, ent[i].off);
+		return;
+	}
+	/* только время: отрезки корзин окна, соседние - одним чтением */
+	for (size_t i = 0; i < hdr->nruns && !ectlno_iserror(); ) {
+		uint64_t a;
+
+		if (!pcapidx_inwindow(px, &sel, runs[i].key)) {
+			i++;
+			continue;
+		}
+		a = runs[i].off;
+		while (i < hdr->nruns && pcapidx_inwindow(px, &sel, runs[i].key))
+			i++;
+		pcapidx_range(px, &sel, a, i < hdr->nruns ? runs[i].off : hdr->end);
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef __pcapidx_h__
+#define __pcapidx_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <net/ethernet.h>
+#include <pcap.h>
+
+#include "foo.h"
+
+DECL_ERROR(E_PCAPIDXFORMAT)
+
+/* Индекс файла pcap (--index file.pcap): рядом с ним file.pcap.idx, в котором
+ * смещения записей pcap сгруппированы по chaddr, xid и времени. Тогда -r с -c,
+ * --xid или --since/--until читает pread'ом только подходящие записи, а не
+ * весь файл через pcap_loop().
+ *
+ * Индекс:
+ *	struct pcapidx_hdr
+ *	struct pcapidx_ent[nmac]	chaddr (6 байт, как в пакете, hlen не
+ *					проверяется), по (key, off)
+ *	struct pcapidx_ent[nxid]	xid в порядке хоста, по (key, off)
+ *	struct pcapidx_ent[nruns]	отрезки в порядке файла: с off идут
+ *					пакеты корзины времени key (секунды /
+ *					bucket) до off следующего отрезка или до
+ *					end
+ * В ключи попадают только пакеты DHCP (Ethernet, vlan, IPv4, UDP 67/68), в
+ * отрезки времени - все. Ключи - необходимое условие: записи-кандидаты
+ * проходят тот же фильтр pcap и фильтр dhcpdump, что и при чтении подряд.
+ *
+ * Размер и время изменения pcap записаны в индексе: если файл изменился,
+ * индекс не используется (с предупреждением) и файл читается целиком.
+ * Поддерживается классический pcap (мкс и нс, любой порядок байт), не pcapng.
+ */
+#define PCAPIDX_MAGIC		"DHCPPCX"
+#define PCAPIDX_VERSION		1
+#define PCAPIDX_BOM		0x01020304
+#define PCAPIDX_BUCKET		60		/* секунд в корзине времени */
+#define PCAPIDX_CAPLEN_MAX	262144		/* больше - файл испорчен */
+
+struct pcapidx_hdr {
+	char		magic[8];
+	uint32_t	bom;			/* PCAPIDX_BOM */
+	uint16_t	version, reserved;
+	uint64_t	size;			/* pcap */
+	int64_t		mtime_sec, mtime_nsec;
+	uint64_t	end;			/* конец последней целой записи */
+	uint64_t	npkts;
+	uint32_t	bucket;			/* секунд */
+	uint32_t	nmac, nxid, nruns;
+};
+
+struct pcapidx_ent {
+	uint64_t	key, off;		/* off - заголовка записи pcap */
+};
+
+struct pcapidx;
+
+__BEGIN_DECLS
+/* прочитать pcap целиком и записать path.idx */
+void		pcapidx_build(const char *path, FILE *report);
+/* индекс path.idx; NULL - его нет или он устарел */
+struct pcapidx *pcapidx_open(const char *path);
+/* Записи с chaddr mac и xid (NULL - любой) во времени [since, until] (мкс,
+ * 0 - без границы), прошедшие bpf, по порядку файла - в cb(), как у
+ * pcap_loop(). Остановка - ошибка в ectlno после cb().
+ */
+void		pcapidx_loop(struct pcapidx *px, const struct ether_addr *mac, const uint32_t *xid,
+			uint64_t since, uint64_t until, const struct bpf_program *bpf,
+			pcap_handler cb, u_char *user);
+/* без ловушек */
+void		pcapidx_free(struct pcapidx *px);
+__END_DECLS
+
+#endif
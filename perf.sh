@@ -0,0 +1,106 @@
+#!/bin/sh
+#
+# Сквозной бенчмарк dhcpdump: сгенерированный dhcpgen трафик прогоняется через
+# весь конвейер (разбор заголовков, декодирование, фильтры, вывод в /dev/null)
+# во всех режимах вывода. По каждому режиму печатается pps, p50/p99 времени
+# обработки пакета и пиковый RSS (см. dhcpdump -P).
+#
+# Если есть сохранённый baseline, результат с ним сравнивается: падение pps
+# больше чем на threshold процентов - ошибка (код возврата 1).
+#
+# usage: perf.sh [-n packets] [-c clients] [-b baseline] [-o output] [-t threshold] [-u]
+#	-u	сохранить результат как baseline
+#
+
+packets=2000000
+clients=100000
+baseline=perf.baseline
+output=perf.out
+threshold=10
+update=0
+
+while getopts "b:c:n:o:t:u" c; do
+	case $c in
+	b) baseline=$OPTARG ;;
+	c) clients=$OPTARG ;;
+	n) packets=$OPTARG ;;
+	o) output=$OPTARG ;;
+	t) threshold=$OPTARG ;;
+	u) update=1 ;;
+	*) echo "usage: $0 [-n packets] [-c clients] [-b baseline] [-o output] [-t threshold] [-u]" >&2
+	   exit 2 ;;
+	esac
+done
+
+DHCPDUMP=${DHCPDUMP:-./dhcpdump}
+DHCPGEN=${DHCPGEN:-./dhcpgen}
+tmp=$(mktemp -d "${TMPDIR:-/tmp}/dhcpperf.XXXXXX") || exit 2
+trap 'rm -rf "$tmp"' EXIT INT TERM
+
+$DHCPGEN -w "$tmp/plain.pcap" -n $packets -c $clients || exit 2
+$DHCPGEN -w "$tmp/qinq.pcap" -n $packets -c $clients -t 100.0 || exit 2
+
+# режим | файл | опции dhcpdump
+# Журнал и хранилище событий меряются на записи; чтение (--read-log, query)
+# идёт мимо захвата и -P не поддерживает, поэтому здесь его нет.
+modes="
+full|plain|
+summary|plain|-S
+hexdump|plain|-x
+chaddr|plain|-c 00:16:00:00:00:01
+relay|plain|-s 00:26:5a:00:00:00 -p 1 -v 1
+ruser|plain|-U 10.2.44.23
+expr|plain|-S -e relay
+qinq|qinq|-t 100.0
+qinq-summary|qinq|-S -t 100.0
+async|plain|--async block
+async-summary|plain|-S --async block
+sample|plain|--sample 10
+dedup|plain|--dedup 1
+top|plain|-S --top 10
+distinct|plain|-S --distinct 60
+write-log|plain|--write-log $tmp/events.log
+store|plain|--store $tmp/store
+compress|plain|--output $tmp/out.gz --compress 6
+compress-summary|plain|-S --output $tmp/out.gz --compress 6
+"
+
+: > "$output"
+printf "%-16s %10s %10s %10s %10s\n" mode pps p50_ns p99_ns maxrss_kb
+echo "$modes" | while IFS='|' read mode file args; do
+	[ -n "$mode" ] || continue
+	rm -rf "$tmp/events.log" "$tmp/store" "$tmp/out.gz"
+	stat=$($DHCPDUMP -P -r "$tmp/$file.pcap" $args 2>&1 >/dev/null | grep '^perf:')
+	if [ -z "$stat" ]; then
+		echo "$mode: dhcpdump failed" >&2
+		echo "$mode 0 0 0 0" >> "$output"
+		continue
+	fi
+	set -- $stat
+	# perf: packets N seconds S pps P p50_ns X p99_ns Y maxrss_kb Z
+	printf "%-16s %10s %10s %10s %10s\n" $mode $7 $9 ${11} ${13}
+	echo "$mode $7 $9 ${11} ${13}" >> "$output"
+done
+
+if [ $update -eq 1 ]; then
+	cp "$output" "$baseline"
+	echo "baseline saved to $baseline"
+	exit 0
+fi
+if [ ! -f "$baseline" ]; then
+	echo "no baseline $baseline, run $0 -u to save one"
+	exit 0
+fi
+
+awk -v thr=$threshold '
+	NR == FNR { base[$1] = $2; next }
+	($1 in base) {
+		limit = base[$1] * (100 - thr) / 100
+		if ($2 < limit) {
+			printf("REGRESSION %s: %d pps < %d pps (baseline %d, threshold %d%%)\n",
+				$1, $2, limit, base[$1], thr)
+			fail = 1
+		}
+	}
+	END { exit fail }
+' "$baseline" "$output"
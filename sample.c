@@ -0,0 +1,288 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "foo.h"
+#include "watch.h"
+#include "sample.h"
+
+DEFN_ERROR(E_SAMPLESYNTAX,	"Syntax error in sampling option.")
+
+static const char *const sample_reasons[SAMPLE_MAX] = { NULL, "dup", "client", "every", "rate" };
+
+struct sampler *
+sampler_create(FILE *fp)
+{
+	struct sampler *s;
+
+	s = MALLOC(sizeof *s);
+	memset(s, 0, sizeof *s);
+	s->fp = fp;
+	s->report_interval = 10 * SAMPLE_NS;
+	return s;
+}
+
+void
+sampler_free(struct sampler *s)
+{
+	if (s) {
+		free(s->dedup);
+		free(s->cm);
+		free(s);
+	}
+}
+
+/* "N" или "N/секунды": *n > 0, *ns > 0 - секунды в нс (1 с по умолчанию) */
+static
+void
+sample_parse_rate(const char *arg, unsigned long max, unsigned long *n, uint64_t *ns)
+{
+	char *end;
+	double sec = 1.;
+
+	errno = 0;
+	*n = strtoul(arg, &end, 10);
+	if (errno || end == arg || !*n || *n > max)
+		ECTL_TRAP(E_SAMPLESYNTAX, "\"%s\": expected N or N/seconds, 0 < N <= %lu.\n", arg, max);
+	if (*end == '/') {
+		const char *p = end + 1;
+
+		sec = strtod(p, &end);
+		if (errno || end == p || !(sec > 0.) || sec > 86400.)
+			ECTL_TRAP(E_SAMPLESYNTAX, "\"%s\": wrong number of seconds.\n", arg);
+	}
+	if (*end)
+		ECTL_TRAP(E_SAMPLESYNTAX, "\"%s\": trailing characters.\n", arg);
+	*ns = sec * SAMPLE_NS;
+	if (!*ns)
+		*ns = 1;
+}
+
+void
+sampler_dedup(struct sampler *s, const char *arg)
+{
+	char *end;
+	double sec;
+
+	errno = 0;
+	sec = strtod(arg, &end);
+	if (errno || end == arg || *end || !(sec > 0.) || sec > 86400.)
+		ECTL_TRAP(E_SAMPLESYNTAX, "\"%s\": expected seconds > 0.\n", arg);
+	s->dedup_window = sec * SAMPLE_NS;
+	if (!s->dedup) {
+		if (posix_memalign((void **)&s->dedup, sizeof s->dedup[0], SAMPLE_DEDUP_SETS * sizeof s->dedup[0]))
+			ECTL_PTRAP(ENOMEM, "posix_memalign(): %s.\n", strerror(ENOMEM));
+		memset(s->dedup, 0, SAMPLE_DEDUP_SETS * sizeof s->dedup[0]);
+	}
+}
+
+void
+sampler_every(struct sampler *s, const char *arg)
+{
+	char *end;
+
+	errno = 0;
+	s->every = strtoull(arg, &end, 10);
+	if (errno || end == arg || *end || !s->every)
+		ECTL_TRAP(E_SAMPLESYNTAX, "\"%s\": expected N > 0.\n", arg);
+}
+
+void
+sampler_rate(struct sampler *s, const char *arg)
+{
+	unsigned long n;
+	uint64_t ns;
+
+	sample_parse_rate(arg, UINT32_MAX, &n, &ns);
+	s->rate = (double)n / ns;
+	s->burst = s->tokens = n;
+	s->last = 0;
+}
+
+void
+sampler_client(struct sampler *s, const char *arg)
+{
+	unsigned long n;
+	uint64_t ns;
+
+	sample_parse_rate(arg, UINT16_MAX, &n, &ns);
+	s->client_limit = n;
+	s->client_window = ns;
+	s->client_start = 0;
+	if (!s->cm)
+		s->cm = MALLOC(SAMPLE_CM_DEPTH * SAMPLE_CM_WIDTH * sizeof s->cm[0]);
+	memset(s->cm, 0, SAMPLE_CM_DEPTH * SAMPLE_CM_WIDTH * sizeof s->cm[0]);
+}
+
+void
+sampler_interval(struct sampler *s, const char *arg)
+{
+	char *end;
+	double sec;
+
+	errno = 0;
+	sec = strtod(arg, &end);
+	if (errno || end == arg || *end || !(sec >= 0.) || sec > 86400. * 366)
+		ECTL_TRAP(E_SAMPLESYNTAX, "\"%s\": expected seconds >= 0.\n", arg);
+	s->report_interval = sec * SAMPLE_NS;
+}
+
+/* По 8 байт: умножение и сдвиг на слово, пакет в 300-600 байт - около сотни
+ * тактов. Для отсева повторов хватает: ложное совпадение 64-битных хэшей за
+ * окно практически невозможно.
+ */
+static inline
+uint64_t
+sample_digest(uint64_t h, const uint8_t *p, size_t len)
+{
+	uint64_t w;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&w, p, 8);
+		h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+		h ^= h >> 29;
+	}
+	w = (uint64_t)len << 56;
+	memcpy(&w, p, len);
+	h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+	h ^= h >> 29;
+	return h;
+}
+
+static
+int
+sampler_dedup_pass(struct sampler *s, uint64_t now, const struct dhcphdr *dh, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)dh;
+	struct sample_dedup_set *set;
+	uint64_t h;
+	int old = 0;
+
+	if (len < offsetof(struct dhcphdr, flags))
+		return 1;
+	/* secs пропускается */
+	h = sample_digest(0xcbf29ce484222325ULL, p, offsetof(struct dhcphdr, secs));
+	h = sample_digest(h, p + offsetof(struct dhcphdr, flags), len - offsetof(struct dhcphdr, flags));
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	set = s->dedup + (h & (SAMPLE_DEDUP_SETS - 1));
+	for (int i = 0; i < SAMPLE_DEDUP_WAYS; i++) {
+		if (set->hash[i] == h && now - set->time[i] < s->dedup_window)
+			return 0;
+		if (set->time[i] < set->time[old])
+			old = i;
+	}
+	set->hash[old] = h;
+	set->time[old] = now;
+	return 1;
+}
+
+/* Норма chaddr: count-min sketch со строками по SAMPLE_CM_WIDTH счётчиков,
+ * индексы строк - h1 + i * h2 от одного хэша. Оценка числа пакетов chaddr
+ * за окно - минимум по строкам, она не меньше настоящей; коллизии только
+ * завышают её, то есть подавляют лишнее, но не пропускают шторм. Счётчики
+ * увеличиваются консервативно - только равные минимуму, - что заметно
+ * уменьшает завышение. Окно кончилось - все счётчики в ноль.
+ */
+static
+int
+sampler_client_pass(struct sampler *s, uint64_t now, const uint8_t *chaddr)
+{
+	uint64_t h = watchkey_hash(watchkey_mac(chaddr));
+	uint32_t h1 = h, h2 = (h >> 32) | 1;
+	uint16_t *c[SAMPLE_CM_DEPTH], min = UINT16_MAX;
+
+	if (now - s->client_start >= s->client_window) {
+		memset(s->cm, 0, SAMPLE_CM_DEPTH * SAMPLE_CM_WIDTH * sizeof s->cm[0]);
+		s->client_start = now;
+	}
+	for (int i = 0; i < SAMPLE_CM_DEPTH; i++) {
+		c[i] = s->cm + i * SAMPLE_CM_WIDTH + ((h1 + i * h2) & (SAMPLE_CM_WIDTH - 1));
+		if (*c[i] < min)
+			min = *c[i];
+	}
+	if (min >= s->client_limit)
+		return 0;
+	for (int i = 0; i < SAMPLE_CM_DEPTH; i++)
+		if (*c[i] == min)
+			(*c[i])++;
+	return 1;
+}
+
+static
+int
+sampler_rate_pass(struct sampler *s, uint64_t now)
+{
+	if (now > s->last) {
+		s->tokens += (now - s->last) * s->rate;
+		if (s->tokens > s->burst)
+			s->tokens = s->burst;
+		s->last = now;
+	}
+	if (s->tokens < 1.)
+		return 0;
+	s->tokens -= 1.;
+	return 1;
+}
+
+static
+void
+sampler_print(struct sampler *s, const char *when, int k)
+{
+	uint64_t total = 0;
+
+	for (int r = 1; r < SAMPLE_MAX; r++)
+		total += s->suppressed[k][r];
+	fprintf(s->fp, "sample: %s shown %" PRIu64 " suppressed %" PRIu64 " (", when, s->shown[k], total);
+	for (int r = 1; r < SAMPLE_MAX; r++)
+		fprintf(s->fp, "%s%s %" PRIu64, r > 1 ? " " : "", sample_reasons[r], s->suppressed[k][r]);
+	fprintf(s->fp, ")\n");
+}
+
+int
+sampler_pass(struct sampler *s, uint64_t now, const struct dhcphdr *dh, size_t len)
+{
+	int r = SAMPLE_PASS;
+
+	if (s->report_interval && now >= s->report_next) {
+		if (s->report_next) {
+			char when[32];
+			time_t t = now / SAMPLE_NS;
+
+			strftime(when, sizeof when, "%Y%m%d %H:%M:%S", localtime(&t));
+			fflush(stdout);
+			sampler_print(s, when, 0);
+			s->shown[0] = 0;
+			memset(s->suppressed[0], 0, sizeof s->suppressed[0]);
+		}
+		s->report_next = now + s->report_interval;
+	}
+	if (s->dedup_window && !sampler_dedup_pass(s, now, dh, len))
+		r = SAMPLE_DUP;
+	else if (s->client_limit && !sampler_client_pass(s, now, dh->chaddr))
+		r = SAMPLE_CLIENT;
+	else if (s->every && s->seq++ % s->every)
+		r = SAMPLE_EVERY;
+	else if (s->rate > 0. && !sampler_rate_pass(s, now))
+		r = SAMPLE_RATE;
+	if (r == SAMPLE_PASS) {
+		s->shown[0]++;
+		s->shown[1]++;
+	} else {
+		s->suppressed[0][r]++;
+		s->suppressed[1][r]++;
+	}
+	return r;
+}
+
+void
+sampler_report(struct sampler *s)
+{
+	fflush(stdout);
+	sampler_print(s, "total", 1);
+}
@@ -0,0 +1,94 @@
+#ifndef __sample_h__
+#define __sample_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "foo.h"
+#include "dhcp.h"
+
+DECL_ERROR(E_SAMPLESYNTAX)
+
+/* Прореживание вывода dhcpdump при шторме: пакет проходит фильтры, декодируется
+ * и попадает в статистику как обычно, прореживается только печать.
+ *
+ *	--dedup сек		не печатать повтор пакета в течение сек секунд
+ *				после первого: копии с нескольких SPAN и
+ *				повторные посылки клиента с тем же xid
+ *	--sample N		печатать каждый N-й пакет
+ *	--rate N[/сек]		ведро токенов: в среднем N пакетов за сек (1 по
+ *				умолчанию) секунд, всплеск до N подряд
+ *	--client-rate N[/сек]	не больше N (до 65535) пакетов одного chaddr за
+ *				окно в сек секунд; счётчики - count-min sketch
+ *				фиксированного размера, chaddr не хранятся
+ *	--sample-report сек	раз в сек секунд (10 по умолчанию, 0 - только в
+ *				конце) отчёт в stderr: сколько напечатано и сколько
+ *				подавлено каждым способом
+ *
+ * Способы складываются: пакет печатается, если его пропустили все включённые.
+ * Повторы отсеиваются первыми - они не тратят ни норму, ни ведро; норма
+ * chaddr проверяется до общих способов, чтобы один клиент не выбирал ведро.
+ *
+ * Повтор - пакет DHCP с тем же хэшем всех байт, кроме secs (у повторной
+ * посылки он растёт): chaddr, xid, тип сообщения, опции, giaddr и hops -
+ * пакет до и после relay повтором не считается. Хэши с временем первого
+ * появления - в таблице фиксированного размера по SAMPLE_DEDUP_WAYS записей
+ * в строке кэша; в полной строке вытесняется самая старая запись.
+ * Время - метка пакета от pcap, а не часы: чтение файла прореживается так же,
+ * как захват, на котором файл записан.
+ */
+#define SAMPLE_PASS	0
+#define SAMPLE_DUP	1	/* повтор */
+#define SAMPLE_CLIENT	2	/* chaddr превысил норму */
+#define SAMPLE_EVERY	3	/* не N-й */
+#define SAMPLE_RATE	4	/* ведро пусто */
+#define SAMPLE_MAX	5
+
+#define SAMPLE_CM_DEPTH	4
+#define SAMPLE_CM_WIDTH	65536	/* степень двойки; 512 Кб на всё */
+
+#define SAMPLE_DEDUP_SETS	16384	/* степень двойки; 1 Мб на всё */
+#define SAMPLE_DEDUP_WAYS	4
+
+#define SAMPLE_NS	1000000000ULL
+
+struct sample_dedup_set {
+	uint64_t	hash[SAMPLE_DEDUP_WAYS];
+	uint64_t	time[SAMPLE_DEDUP_WAYS];	/* первое появление */
+} __attribute__((__aligned__(64)));
+
+struct sampler {
+	FILE		*fp;		/* отчёты */
+	uint64_t	dedup_window;	/* 0 - повторы не отсеиваются */
+	struct sample_dedup_set	*dedup;
+	uint64_t	every, seq;
+	double		rate, burst;	/* пакетов в нс; rate == 0 - ведра нет */
+	double		tokens;
+	uint64_t	last;		/* время последнего пополнения ведра */
+	uint16_t	client_limit;	/* 0 - нормы chaddr нет */
+	uint64_t	client_window, client_start;
+	uint16_t	*cm;		/* [SAMPLE_CM_DEPTH][SAMPLE_CM_WIDTH] */
+	uint64_t	report_interval, report_next;
+	uint64_t	shown[2];	/* с прошлого отчёта, всего */
+	uint64_t	suppressed[2][SAMPLE_MAX];
+};
+
+__BEGIN_DECLS
+struct sampler *	sampler_create(FILE *fp);
+void			sampler_free(struct sampler *s);
+/* аргументы опций --dedup, --sample, --rate, --client-rate, --sample-report */
+void			sampler_dedup(struct sampler *s, const char *arg);
+void			sampler_every(struct sampler *s, const char *arg);
+void			sampler_rate(struct sampler *s, const char *arg);
+void			sampler_client(struct sampler *s, const char *arg);
+void			sampler_interval(struct sampler *s, const char *arg);
+/* now - время пакета в нс, dh - пакет DHCP длиной len; SAMPLE_PASS - печатать,
+ * иначе причина подавления. Заодно печатает периодический отчёт, если пора.
+ */
+int			sampler_pass(struct sampler *s, uint64_t now, const struct dhcphdr *dh, size_t len);
+/* итоговый отчёт */
+void			sampler_report(struct sampler *s);
+__END_DECLS
+
+#endif
@@ -0,0 +1,137 @@
+#ifdef STAGETIME
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/queue.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "foo.h"
+#include "hist.h"
+#include "stagetime.h"
+
+static const char *const stage_names[STAGE_MAX] = {
+	[STAGE_L2]	= "l2",
+	[STAGE_IPUDP]	= "ipudp",
+	[STAGE_COOKIE]	= "cookie",
+	[STAGE_DECODE]	= "decode",
+	[STAGE_OPT82]	= "opt82",
+	[STAGE_FILTER]	= "filter",
+	[STAGE_OUTPUT]	= "output",
+};
+
+struct stagetime {
+	SLIST_ENTRY(stagetime)	ent;
+	unsigned long		tid;	/* номер потока в порядке регистрации */
+	struct hist		hist[STAGE_MAX];
+};
+
+static SLIST_HEAD(, stagetime) stagetime_all = SLIST_HEAD_INITIALIZER(stagetime_all);
+static pthread_mutex_t stagetime_mtx = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long stagetime_ntids = 0;
+static __thread struct stagetime *stagetime_self = NULL;
+
+static volatile sig_atomic_t stagetime_dumpreq = 0;
+static double ticks_per_ns = 1.;
+
+static
+void
+stagetime_sighandler(int signo)
+{
+	stagetime_dumpreq = 1;
+}
+
+/* Частота TSC: сравнение со временем CLOCK_MONOTONIC за 20 мс */
+static
+void
+stagetime_calibrate()
+{
+	struct timespec ts0, ts1, rq = { 0, 20 * 1000000 };
+	uint64_t t0, t1, ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts0);
+	t0 = stagetime_now();
+	nanosleep(&rq, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &ts1);
+	t1 = stagetime_now();
+	ns = (ts1.tv_sec - ts0.tv_sec) * 1000000000ULL + ts1.tv_nsec - ts0.tv_nsec;
+	if (ns && t1 > t0)
+		ticks_per_ns = (double)(t1 - t0) / ns;
+}
+
+void
+stagetime_init(int signo)
+{
+	struct sigaction sa;
+
+	stagetime_calibrate();
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = stagetime_sighandler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(signo, &sa, NULL) < 0)
+		ECTL_PTRAP(errno, "sigaction(%d): %s.\n", signo, strerror(errno));
+}
+
+static
+struct stagetime *
+stagetime_register()
+{
+	struct stagetime *st;
+
+	st = MALLOC(sizeof *st);
+	for (int i = 0; i < STAGE_MAX; i++)
+		hist_init(st->hist + i);
+	PTHREAD_MUTEX_LOCK(&stagetime_mtx);
+	st->tid = stagetime_ntids++;
+	SLIST_INSERT_HEAD(&stagetime_all, st, ent);
+	PTHREAD_MUTEX_UNLOCK(&stagetime_mtx);
+	return st;
+}
+
+void
+stagetime_commit(volatile uint64_t *ticks)
+{
+	struct stagetime *st = stagetime_self;
+
+	if (!st)
+		st = stagetime_self = stagetime_register();
+	for (int i = 0; i < STAGE_MAX; i++)
+		if (ticks[i])
+			hist_add(st->hist + i, ticks[i]);
+	if (stagetime_dumpreq) {
+		stagetime_dumpreq = 0;
+		stagetime_dump(stderr);
+	}
+}
+
+/* Гистограммы читаются без блокировки: дамп - оценка, а не снимок */
+void
+stagetime_dump(FILE *fp)
+{
+	struct stagetime *st;
+
+	PTHREAD_MUTEX_LOCK(&stagetime_mtx);
+	SLIST_FOREACH(st, &stagetime_all, ent) {
+		fprintf(fp, "stagetime: thread %lu\n", st->tid);
+		for (int i = 0; i < STAGE_MAX; i++) {
+			const struct hist *h = st->hist + i;
+
+			fprintf(fp, "stagetime:   %-8s n %12" PRIu64 " mean_ns %10.0f p50_ns %10.0f"
+					" p99_ns %10.0f max_ns %10.0f\n",
+				stage_names[i], h->n, h->n ? h->sum / ticks_per_ns / h->n : 0.,
+				hist_percentile(h, 0.50) / ticks_per_ns,
+				hist_percentile(h, 0.99) / ticks_per_ns,
+				h->max / ticks_per_ns);
+		}
+	}
+	PTHREAD_MUTEX_UNLOCK(&stagetime_mtx);
+	fflush(fp);
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef __stagetime_h__
+#define __stagetime_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+/* Замер времени по стадиям обработки пакета счётчиком TSC.
+ *
+ * Включается при сборке: make STAGETIME=1 (-DSTAGETIME). Без него макросы
+ * ниже пусты и не стоят ничего.
+ *
+ * В обработчике пакета:
+ *	STAGETIME_DECL;			- среди локальных переменных
+ *	STAGETIME_START();		- в начале, текущая стадия - STAGE_L2
+ *	STAGETIME_STAGE(STAGE_XXX);	- переход к стадии: время от предыдущего
+ *					  перехода прибавляется к текущей стадии
+ *	STAGETIME_END();		- на выходе (любом); суммы по стадиям пакета
+ *					  уходят в гистограммы потока
+ *
+ * Время до выхода по goto (пакет отброшен, ошибка) достаётся стадии, на
+ * которой это случилось. Стадия может встречаться в пакете несколько раз,
+ * в гистограмму попадает сумма.
+ *
+ * Работу, которую делают по требованию (декодирование и опцию 82 - фильтр,
+ * см. filterctx_dhcp()), считают там, где она делается: STAGETIME_SELF
+ * передаётся туда, и вокруг работы стоят
+ *	STAGETIME_ENTER(st, STAGE_XXX);	- переход к стадии, прежняя запоминается
+ *	STAGETIME_LEAVE(st);		- возврат к прежней стадии
+ * st == NULL - не считать.
+ *
+ * У каждого потока свои гистограммы, дамп всех - stagetime_dump() или по
+ * сигналу, заданному в stagetime_init() (дамп делает поток, обработавший
+ * следующий пакет, а не обработчик сигнала).
+ */
+#define STAGE_L2	0	/* ethernet, 802.1Q */
+#define STAGE_IPUDP	1	/* заголовки IPv4 и UDP */
+#define STAGE_COOKIE	2	/* длина и cookie DHCP */
+#define STAGE_DECODE	3	/* dhcp_decode() */
+#define STAGE_OPT82	4	/* dhcpopt82_lookup() */
+#define STAGE_FILTER	5	/* фильтры, --top, --distinct, прореживание */
+#define STAGE_OUTPUT	6	/* вывод */
+#define STAGE_MAX	7
+
+#ifdef STAGETIME
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define stagetime_now()	__rdtsc()
+#else
+#include <time.h>
+static inline
+uint64_t
+stagetime_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+/* стадии одного пакета */
+struct stagetime_pkt {
+	uint64_t	ticks[STAGE_MAX];
+	uint64_t	last;
+	int		cur;
+};
+
+/* переход к стадии stage; возвращает прежнюю */
+static inline
+int
+stagetime_stage(volatile struct stagetime_pkt *st, int stage)
+{
+	uint64_t t = stagetime_now();
+	int prev = st->cur;
+
+	st->ticks[prev] += t - st->last;
+	st->last = t;
+	st->cur = stage;
+	return prev;
+}
+
+/* volatile: переменные переживают longjmp() из ectlfr_goto()/ectlfr_trap() */
+#define STAGETIME_DECL		volatile struct stagetime_pkt stagetime_[1] = {{ .cur = STAGE_L2 }}
+#define STAGETIME_SELF		stagetime_
+#define STAGETIME_START()	(stagetime_->last = stagetime_now(), stagetime_->cur = STAGE_L2)
+#define STAGETIME_STAGE(stage)	((void)stagetime_stage(stagetime_, (stage)))
+#define STAGETIME_END() do {						\
+		STAGETIME_STAGE(stagetime_->cur);			\
+		stagetime_commit(stagetime_->ticks);			\
+	} while (0)
+#define STAGETIME_ENTER(st, stage)					\
+	int stagetime_prev_ = (st) ? stagetime_stage((st), (stage)) : 0
+#define STAGETIME_LEAVE(st)						\
+	((st) ? (void)stagetime_stage((st), stagetime_prev_) : (void)0)
+
+__BEGIN_DECLS
+void	stagetime_init(int signo);
+void	stagetime_commit(volatile uint64_t *ticks);
+void	stagetime_dump(FILE *fp);
+__END_DECLS
+
+#else
+
+#define STAGETIME_DECL		struct stagetime_unused_
+#define STAGETIME_START()	((void)0)
+#define STAGETIME_STAGE(stage)	((void)0)
+#define STAGETIME_END()		((void)0)
+#define STAGETIME_ENTER(st, stage) struct stagetime_unused_
+#define STAGETIME_LEAVE(st)	((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,240 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "foo.h"
+#include "dhcp.h"
+#include "synth.h"
+
+/* Отпечатки опции 55 (Parameter Request List) распространённых клиентов */
+static const struct {
+	const char *	name;
+	uint8_t		n;
+	uint8_t		codes[16];
+} fingerprints[] = {
+	{ "windows",	14, { 1, 3, 6, 15, 31, 33, 43, 44, 46, 47, 119, 121, 249, 252 } },
+	{ "android",	10, { 1, 3, 6, 15, 26, 28, 51, 58, 59, 43 } },
+	{ "apple",	10, { 1, 121, 3, 6, 15, 119, 252, 95, 44, 46 } },
+	{ "dhclient",	13, { 1, 28, 2, 3, 15, 6, 119, 12, 44, 47, 26, 121, 42 } },
+	{ "udhcpc",	 7, { 1, 3, 6, 12, 15, 28, 42 } },
+	{ "printer",	 9, { 1, 3, 6, 15, 44, 47, 12, 81, 252 } },
+	{ "voip",	 7, { 1, 66, 6, 3, 15, 150, 35 } },
+};
+
+static const char *const opt82names[SYNTH_OPT82_MAX] = {
+	[SYNTH_OPT82_NONE]	= "none",
+	[SYNTH_OPT82_DEFAULT]	= "default",
+	[SYNTH_OPT82_IES1248]	= "ies1248",
+	[SYNTH_OPT82_IES5000]	= "ies5000",
+	[SYNTH_OPT82_CDRU]	= "cdru",
+	[SYNTH_OPT82_UNKNOWN]	= "unknown",
+};
+
+static const char *const badnames[SYNTH_BAD_MAX] = {
+	[SYNTH_BAD_NONE]	= "none",
+	[SYNTH_BAD_COOKIE]	= "cookie",
+	[SYNTH_BAD_NOLENGTH]	= "nolength",
+	[SYNTH_BAD_OVERRUN]	= "overrun",
+	[SYNTH_BAD_SHORT]	= "short",
+	[SYNTH_BAD_LONG]	= "long",
+	[SYNTH_BAD_ELSZ]	= "elsz",
+	[SYNTH_BAD_SUBOPT]	= "subopt",
+};
+
+static const char hex[] = "0123456789abcdef";
+
+int
+synth_nfingerprints()
+{
+	return sizeof fingerprints/sizeof fingerprints[0];
+}
+const char *
+synth_fingerprint(int fp, const uint8_t **codes, int *n)
+{
+	if (fp < 0 || fp >= synth_nfingerprints())
+		return NULL;
+	if (codes)
+		*codes = fingerprints[fp].codes;
+	if (n)
+		*n = fingerprints[fp].n;
+	return fingerprints[fp].name;
+}
+const char *
+synth_opt82name(int opt82)
+{
+	return opt82 >= 0 && opt82 < SYNTH_OPT82_MAX ? opt82names[opt82] : NULL;
+}
+const char *
+synth_badname(int bad)
+{
+	return bad >= 0 && bad < SYNTH_BAD_MAX ? badnames[bad] : NULL;
+}
+
+static inline
+uint8_t *
+put_opt(uint8_t *p, uint8_t code, uint8_t len, const void *val)
+{
+	*p++ = code;
+	*p++ = len;
+	memcpy(p, val, len);
+	return p + len;
+}
+static inline
+uint8_t *
+put_u32(uint8_t *p, uint8_t code, uint32_t v)
+{
+	v = htonl(v);
+	return put_opt(p, code, 4, &v);
+}
+static inline
+uint8_t *
+put_hex(uint8_t *p, const uint8_t *data, int len)
+{
+	for (int i = 0; i < len; i++) {
+		*p++ = hex[data[i] >> 4];
+		*p++ = hex[data[i] & 15];
+	}
+	return p;
+}
+
+/* Опция 82 в формате cl->opt82; раскладка подопций - как её разбирает dhcpopt82_research() */
+static
+uint8_t *
+put_opt82(uint8_t *p, const struct synth_client *cl)
+{
+	uint8_t b[64], *q = b;
+	uint16_t vlan = htons(cl->vlan);
+
+	switch (cl->opt82) {
+	case SYNTH_OPT82_DEFAULT:
+		*q++ = DHCPOPT82_SUBOPT1_CIRCUITID; *q++ = 6; *q++ = 0; *q++ = 4;
+		memcpy(q, &vlan, 2), q += 2;
+		*q++ = cl->module; *q++ = cl->port;
+		*q++ = DHCPOPT82_SUBOPT2_REMOTEID; *q++ = 8; *q++ = 0; *q++ = 6;
+		memcpy(q, cl->swmac, 6), q += 6;
+		break;
+	case SYNTH_OPT82_IES1248:
+		*q++ = DHCPOPT82_SUBOPT1_CIRCUITID; *q++ = 8; *q++ = cl->module; *q++ = cl->port;
+		memcpy(q, &vlan, 2), q += 2;
+		memcpy(q, "port", 4), q += 4;
+		*q++ = DHCPOPT82_SUBOPT2_REMOTEID; *q++ = 26; *q++ = '3'; *q++ = '8'; *q++ = '/';
+		q = put_hex(q, cl->swmac, 6);
+		memcpy(q, "/221004017/", 11), q += 11;
+		break;
+	case SYNTH_OPT82_IES5000:
+		*q++ = DHCPOPT82_SUBOPT1_CIRCUITID; *q++ = 16; *q++ = cl->module; *q++ = cl->port;
+		memcpy(q, &vlan, 2), q += 2;
+		q = put_hex(q, cl->swmac, 6);
+		break;
+	case SYNTH_OPT82_CDRU:
+		*q++ = DHCPOPT82_SUBOPT1_CIRCUITID; *q++ = 6; *q++ = 0; *q++ = 4;
+		memcpy(q, &vlan, 2), q += 2;
+		*q++ = cl->module; *q++ = cl->port;
+		*q++ = DHCPOPT82_SUBOPT2_REMOTEID; *q++ = 12; *q++ = 1; *q++ = 10;
+		memcpy(q, "10.2.44.23", 10), q += 10;
+		break;
+	case SYNTH_OPT82_UNKNOWN:
+		/* agent-id строкой, как у некоторых BRAS */
+		*q++ = DHCPOPT82_SUBOPT1_CIRCUITID; *q++ = 12;
+		memcpy(q, "eth0/0/", 7), q += 7;
+		*q++ = '0' + cl->module % 10; *q++ = '/';
+		*q++ = '0' + cl->port / 10 % 10; *q++ = '0' + cl->port % 10; *q++ = ':';
+		*q++ = DHCPOPT82_SUBOPT2_REMOTEID; *q++ = 6;
+		memcpy(q, cl->swmac, 6), q += 6;
+		break;
+	default:
+		return p;
+	}
+	return put_opt(p, DHCPOPT82_RELAYAGENTINFORMATION, q - b, b);
+}
+
+size_t
+synth_dhcp(uint8_t *buf, const struct synth_msg *m)
+{
+	const struct synth_client *cl = m->cl;
+	struct dhcphdr *dhp = (struct dhcphdr *)buf;
+	int request = m->type != DHCPOFFER && m->type != DHCPACK && m->type != DHCPNAK;
+	uint8_t *p, b[16];
+
+	memset(buf, 0, sizeof(struct dhcphdr));
+	dhp->op = request ? BOOTREQUEST : BOOTREPLY;
+	dhp->htype = 1;
+	dhp->hlen = 6;
+	dhp->xid = htonl(m->xid);
+	dhp->ciaddr.s_addr = htonl(m->ciaddr);
+	if (m->type == DHCPOFFER || m->type == DHCPACK)
+		dhp->yiaddr.s_addr = htonl(cl->ip);
+	if (m->relayed && cl->giaddr) {
+		dhp->hops = 1;
+		dhp->giaddr.s_addr = htonl(cl->giaddr);
+	}
+	memcpy(dhp->chaddr, cl->mac, 6);
+
+	p = dhp->options;
+	*p++ = 0x63; *p++ = 0x82; *p++ = 0x53; *p++ = 0x63;
+	b[0] = m->type;
+	p = put_opt(p, DHCPOPT53_DHCP_MESSAGE_TYPE, 1, b);
+	if (request) {
+		b[0] = 1;
+		memcpy(b + 1, cl->mac, 6);
+		p = put_opt(p, 61, 7, b);
+		if (!m->ciaddr && (m->type == DHCPDISCOVER || m->type == DHCPREQUEST))
+			p = put_u32(p, 50, cl->ip);
+		if ((!m->ciaddr && m->type == DHCPREQUEST) || m->type == DHCPRELEASE)
+			p = put_u32(p, 54, m->server);
+		if (m->type != DHCPRELEASE) {
+			const uint8_t *codes;
+			int n;
+
+			b[0] = 0x05; b[1] = 0xdc;
+			p = put_opt(p, 57, 2, b);
+			*p++ = 12; *p++ = 11;
+			memcpy(p, "host-", 5);
+			p = put_hex(p + 5, cl->mac + 3, 3);
+			p = put_opt(p, 60, 8, "MSFT 5.0");
+			synth_fingerprint(cl->fp % synth_nfingerprints(), &codes, &n);
+			p = put_opt(p, 55, n, codes);
+		}
+	} else {
+		p = put_u32(p, 54, m->server);
+		if (m->type != DHCPNAK) {
+			p = put_u32(p, 51, 3600);
+			p = put_u32(p, 58, 1800);
+			p = put_u32(p, 59, 3150);
+			p = put_u32(p, 1, 0xffffff00);
+			p = put_u32(p, 3, (cl->ip & 0xffffff00) | 1);
+			p = put_u32(p, 6, m->server);
+		}
+	}
+	if (m->relayed && cl->giaddr)
+		p = put_opt82(p, cl);
+
+	switch (m->bad) {
+	case SYNTH_BAD_COOKIE:
+		dhp->options[3] = 0x64;
+		break;
+	case SYNTH_BAD_NOLENGTH:
+		*p++ = 12;
+		return p - buf;
+	case SYNTH_BAD_OVERRUN:
+		*p++ = 12; *p++ = 200;
+		memcpy(p, "trunc", 5), p += 5;
+		return p - buf;
+	case SYNTH_BAD_SHORT:
+		p = put_opt(p, 1, 3, "\xff\xff\xff");
+		break;
+	case SYNTH_BAD_LONG:
+		p = put_opt(p, DHCPOPT53_DHCP_MESSAGE_TYPE, 2, "\x01\x01");
+		break;
+	case SYNTH_BAD_ELSZ:
+		p = put_opt(p, 3, 6, "\x0a\x00\x00\x01\x0a\x00");
+		break;
+	case SYNTH_BAD_SUBOPT:
+		p = put_opt(p, DHCPOPT82_RELAYAGENTINFORMATION, 4, "\x01\x09\x00\x04");
+		break;
+	}
+	*p++ = 255;
+	return p - buf;
+}
@@ -0,0 +1,65 @@
+#ifndef __synth_h__
+#define __synth_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <sys/types.h>
+
+/* Синтетические DHCP пакеты для бенчмарков и генератора трафика (dhcpgen).
+ * synth_dhcp() собирает payload UDP: заголовок BOOTP, cookie и опции.
+ */
+
+/* Формат опции 82, которую добавляет relay */
+#define SYNTH_OPT82_NONE	0	/* клиент без relay, опции 82 нет */
+#define SYNTH_OPT82_DEFAULT	1	/* встроенные форматы opt82.c: default */
+#define SYNTH_OPT82_IES1248	2	/* ies1248 */
+#define SYNTH_OPT82_IES5000	3	/* ies5000 */
+#define SYNTH_OPT82_CDRU	4	/* cdru */
+#define SYNTH_OPT82_UNKNOWN	5	/* корректная опция, встроенными форматами не распознаётся
+					 * (см. bras в opt82.conf) */
+#define SYNTH_OPT82_MAX		6
+
+/* Вид повреждения пакета и ошибка, которой он завершает dhcp_decode() */
+#define SYNTH_BAD_NONE		0
+#define SYNTH_BAD_COOKIE	1	/* E_DHCPWRONGCOOKIE */
+#define SYNTH_BAD_NOLENGTH	2	/* E_DHCPDATAINCOMPLETE: код опции последним байтом */
+#define SYNTH_BAD_OVERRUN	3	/* E_DHCPOPTDECODE: длина опции за концом данных */
+#define SYNTH_BAD_SHORT		4	/* E_DHCPOPTDECODE: длина меньше min */
+#define SYNTH_BAD_LONG		5	/* E_DHCPOPTDECODE: длина больше max */
+#define SYNTH_BAD_ELSZ		6	/* E_DHCPOPTDECODE: длина не кратна elsz */
+#define SYNTH_BAD_SUBOPT	7	/* E_DHCPOPTDECODE: подопция 82 за концом опции */
+#define SYNTH_BAD_MAX		8
+
+/* Наибольший размер payload, который собирает synth_dhcp() */
+#define SYNTH_DHCP_MAX		512
+
+struct synth_client {
+	uint8_t		mac[6];
+	uint8_t		swmac[6];	/* MAC коммутатора (relay) в remote-id */
+	uint16_t	vlan;		/* vlan абонента в circuit-id */
+	uint8_t		module, port;
+	uint8_t		opt82;		/* SYNTH_OPT82_* */
+	uint8_t		fp;		/* номер отпечатка опции 55, см. synth_fingerprint() */
+	uint32_t	ip;		/* выданный адрес */
+	uint32_t	giaddr;		/* адрес relay, 0 без relay */
+};
+
+struct synth_msg {
+	const struct synth_client *cl;
+	uint32_t	xid;
+	uint32_t	server;		/* адрес сервера (option 54) */
+	uint32_t	ciaddr;		/* != 0: продление/освобождение адреса клиентом */
+	uint8_t		type;		/* DHCPDISCOVER ... DHCPINFORM */
+	uint8_t		relayed;	/* пакет прошёл через relay: giaddr и опция 82 */
+	uint8_t		bad;		/* SYNTH_BAD_* */
+};
+
+__BEGIN_DECLS
+int		synth_nfingerprints(void);
+const char *	synth_fingerprint(int fp, const uint8_t **codes, int *n);
+const char *	synth_opt82name(int opt82);
+const char *	synth_badname(int bad);
+size_t		synth_dhcp(uint8_t *buf, const struct synth_msg *m);
+__END_DECLS
+
+#endif
@@ -0,0 +1,522 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <arpa/inet.h>
+
+#include "foo.h"
+#include "topn.h"
+
+DEFN_ERROR(E_TOPNSYNTAX,	"Syntax error in --top option.")
+
+#define TOPN_NIL	UINT32_MAX
+
+static const char *const topn_kinds[TOPN_KINDS] = { "client", "port", "relay", "server" };
+
+struct topn_node {
+	uint64_t	key;
+	uint64_t	err;		/* счётчик может быть завышен на столько */
+	uint32_t	bucket;
+	uint32_t	prev, next;	/* в корзине */
+	uint32_t	hnext;		/* в цепочке хэша */
+};
+
+struct topn_bucket {
+	uint64_t	count;
+	uint32_t	head;		/* узлы с этим счётчиком */
+	uint32_t	prev, next;	/* по возрастанию count; у свободной next - следующая свободная */
+};
+
+struct topn_sketch {
+	uint32_t	slots, n;
+	uint32_t	hmask;
+	uint32_t	min;		/* первая корзина */
+	uint32_t	free;		/* свободные корзины */
+	uint64_t	total;
+	uint32_t	*hash;
+	struct topn_node *node;
+	struct topn_bucket *bucket;	/* slots + 1: новая корзина берётся до того, как старая опустеет */
+};
+
+/* для topn_sketch_merge() и отчёта */
+struct topn_ent {
+	uint64_t	key, count, err;
+};
+
+static volatile sig_atomic_t topn_requested = 0;
+
+static inline
+uint32_t
+topn_hash(const struct topn_sketch *s, uint64_t key)
+{
+	key *= 0x9e3779b97f4a7c15ULL;
+	return (key ^ key >> 32) & s->hmask;
+}
+
+void
+topn_sketch_clear(struct topn_sketch *s)
+{
+	s->n = 0;
+	s->total = 0;
+	s->min = TOPN_NIL;
+	memset(s->hash, 0xff, (s->hmask + 1) * sizeof s->hash[0]);
+	for (uint32_t i = 0; i <= s->slots; i++)
+		s->bucket[i].next = i < s->slots ? i + 1 : TOPN_NIL;
+	s->free = 0;
+}
+
+struct topn_sketch *
+topn_sketch_create(uint32_t slots)
+{
+	struct topn_sketch *s;
+	uint32_t hsize = 1;
+
+	while (hsize < 2 * slots)
+		hsize <<= 1;
+	s = MALLOC(sizeof *s);
+	memset(s, 0, sizeof *s);
+	s->slots = slots;
+	s->hmask = hsize - 1;
+	s->hash = MALLOC(hsize * sizeof s->hash[0]);
+	s->node = MALLOC(slots * sizeof s->node[0]);
+	s->bucket = MALLOC((slots + 1) * sizeof s->bucket[0]);
+	topn_sketch_clear(s);
+	return s;
+}
+
+void
+topn_sketch_free(struct topn_sketch *s)
+{
+	if (s) {
+		free(s->hash);
+		free(s->node);
+		free(s->bucket);
+		free(s);
+	}
+}
+
+/* новая корзина count после after (TOPN_NIL - первой) */
+static inline
+uint32_t
+topn_bucket_new(struct topn_sketch *s, uint64_t count, uint32_t after)
+{
+	uint32_t b = s->free;
+	struct topn_bucket *bp = s->bucket + b;
+
+	s->free = bp->next;
+	bp->count = count;
+	bp->head = TOPN_NIL;
+	bp->prev = after;
+	bp->next = after == TOPN_NIL ? s->min : s->bucket[after].next;
+	if (bp->next != TOPN_NIL)
+		s->bucket[bp->next].prev = b;
+	if (after == TOPN_NIL)
+		s->min = b;
+	else
+		s->bucket[after].next = b;
+	return b;
+}
+
+/* узел x - из его корзины; опустевшая корзина освобождается */
+static inline
+void
+topn_node_unlink(struct topn_sketch *s, uint32_t x)
+{
+	struct topn_node *xp = s->node + x;
+	struct topn_bucket *bp = s->bucket + xp->bucket;
+
+	if (xp->prev != TOPN_NIL)
+		s->node[xp->prev].next = xp->next;
+	else
+		bp->head = xp->next;
+	if (xp->next != TOPN_NIL)
+		s->node[xp->next].prev = xp->prev;
+	if (bp->head != TOPN_NIL)
+		return;
+	if (bp->prev != TOPN_NIL)
+		s->bucket[bp->prev].next = bp->next;
+	else
+		s->min = bp->next;
+	if (bp->next != TOPN_NIL)
+		s->bucket[bp->next].prev = bp->prev;
+	bp->next = s->free;
+	s->free = xp->bucket;
+}
+
+static inline
+void
+topn_node_link(struct topn_sketch *s, uint32_t x, uint32_t b)
+{
+	struct topn_node *xp = s->node + x;
+	struct topn_bucket *bp = s->bucket + b;
+
+	xp->bucket = b;
+	xp->prev = TOPN_NIL;
+	xp->next = bp->head;
+	if (bp->head != TOPN_NIL)
+		s->node[bp->head].prev = x;
+	bp->head = x;
+}
+
+/* счётчик узла x + 1: в следующую корзину, если у неё count + 1, иначе в новую */
+static inline
+void
+topn_node_incr(struct topn_sketch *s, uint32_t x)
+{
+	uint32_t b = s->node[x].bucket, nb = s->bucket[b].next;
+	uint64_t count = s->bucket[b].count + 1;
+
+	if (nb == TOPN_NIL || s->bucket[nb].count != count) {
+		/* один в корзине - корзина и растёт, порядок не нарушается */
+		if (s->bucket[b].head == x && s->node[x].next == TOPN_NIL) {
+			s->bucket[b].count = count;
+			return;
+		}
+		nb = topn_bucket_new(s, count, b);
+	}
+	topn_node_unlink(s, x);
+	topn_node_link(s, x, nb);
+}
+
+static inline
+void
+topn_hash_insert(struct topn_sketch *s, uint32_t x)
+{
+	uint32_t *h = s->hash + topn_hash(s, s->node[x].key);
+
+	s->node[x].hnext = *h;
+	*h = x;
+}
+
+static inline
+void
+topn_hash_remove(struct topn_sketch *s, uint32_t x)
+{
+	uint32_t *p = s->hash + topn_hash(s, s->node[x].key);
+
+	while (*p != x)
+		p = &s->node[*p].hnext;
+	*p = s->node[x].hnext;
+}
+
+void
+topn_sketch_add(struct topn_sketch *s, uint64_t key)
+{
+	uint32_t x;
+
+	s->total++;
+	for (x = s->hash[topn_hash(s, key)]; x != TOPN_NIL; x = s->node[x].hnext)
+		if (s->node[x].key == key) {
+			topn_node_incr(s, x);
+			return;
+		}
+	if (s->n < s->slots) {
+		uint32_t b = s->min;
+
+		x = s->n++;
+		s->node[x].key = key;
+		s->node[x].err = 0;
+		topn_hash_insert(s, x);
+		if (b == TOPN_NIL || s->bucket[b].count != 1)
+			b = topn_bucket_new(s, 1, TOPN_NIL);
+		topn_node_link(s, x, b);
+		return;
+	}
+	/* вытесняется любой из наименьших */
+	x = s->bucket[s->min].head;
+	topn_hash_remove(s, x);
+	s->node[x].key = key;
+	s->node[x].err = s->bucket[s->min].count;
+	topn_hash_insert(s, x);
+	topn_node_incr(s, x);
+}
+
+static
+const struct topn_node *
+topn_sketch_find(const struct topn_sketch *s, uint64_t key)
+{
+	for (uint32_t x = s->hash[topn_hash(s, key)]; x != TOPN_NIL; x = s->node[x].hnext)
+		if (s->node[x].key == key)
+			return s->node + x;
+	return NULL;
+}
+
+/* наименьший счётчик полной таблицы; в неполной ключа без счётчика не было */
+static inline
+uint64_t
+topn_sketch_floor(const struct topn_sketch *s)
+{
+	return s->n == s->slots ? s->bucket[s->min].count : 0;
+}
+
+static
+int
+topn_ent_cmp(const void *a, const void *b)
+{
+	const struct topn_ent *x = a, *y = b;
+
+	if (x->count != y->count)
+		return x->count < y->count ? 1 : -1;
+	return x->key < y->key ? -1 : x->key > y->key;
+}
+
+/* все счётчики по убыванию; ents - на s->n */
+static
+void
+topn_sketch_list(const struct topn_sketch *s, struct topn_ent *ents)
+{
+	for (uint32_t i = 0; i < s->n; i++) {
+		ents[i].key = s->node[i].key;
+		ents[i].count = s->bucket[s->node[i].bucket].count;
+		ents[i].err = s->node[i].err;
+	}
+	qsort(ents, s->n, sizeof ents[0], topn_ent_cmp);
+}
+
+void
+topn_sketch_merge(struct topn_sketch *dst, const struct topn_sketch *src)
+{
+	struct topn_ent *ents;
+	uint64_t dfloor = topn_sketch_floor(dst), sfloor = topn_sketch_floor(src), total;
+	uint32_t n = 0, tail = TOPN_NIL;
+
+	if (!src->n)
+		return;
+	ents = MALLOC((dst->n + src->n) * sizeof ents[0]);
+	for (uint32_t i = 0; i < dst->n; i++) {
+		const struct topn_node *x = dst->node + i, *y = topn_sketch_find(src, x->key);
+
+		ents[n].key = x->key;
+		ents[n].count = dst->bucket[x->bucket].count + (y ? src->bucket[y->bucket].count : sfloor);
+		ents[n].err = x->err + (y ? y->err : sfloor);
+		n++;
+	}
+	for (uint32_t i = 0; i < src->n; i++) {
+		const struct topn_node *y = src->node + i;
+
+		if (topn_sketch_find(dst, y->key))
+			continue;
+		ents[n].key = y->key;
+		ents[n].count = src->bucket[y->bucket].count + dfloor;
+		ents[n].err = y->err + dfloor;
+		n++;
+	}
+	qsort(ents, n, sizeof ents[0], topn_ent_cmp);
+	if (n > dst->slots)
+		n = dst->slots;
+	total = dst->total + src->total;
+	topn_sketch_clear(dst);
+	dst->total = total;
+	/* с наименьших: корзины добавляются в конец списка */
+	while (n--) {
+		uint32_t x = dst->n++;
+
+		dst->node[x].key = ents[n].key;
+		dst->node[x].err = ents[n].err;
+		topn_hash_insert(dst, x);
+		if (tail == TOPN_NIL || dst->bucket[tail].count != ents[n].count)
+			tail = topn_bucket_new(dst, ents[n].count, tail);
+		topn_node_link(dst, x, tail);
+	}
+	free(ents);
+}
+
+static
+void
+topn_sighandler(int signo __unused)
+{
+	topn_requested = 1;
+}
+
+struct topn *
+topn_create(FILE *fp, const char *arg)
+{
+	struct ectlfr fr[1];
+	struct topn *volatile t;
+	struct sigaction sa;
+	char *end;
+	double sec = 10.;
+	long n;
+
+	errno = 0;
+	n = strtol(arg, &end, 10);
+	if (errno || end == arg || n < 1 || n > TOPN_MAX)
+		ECTL_TRAP(E_TOPNSYNTAX, "\"%s\": expected N or N/seconds, 0 < N <= %d.\n", arg, TOPN_MAX);
+	if (*end == '/') {
+		const char *p = end + 1;
+
+		sec = strtod(p, &end);
+		if (errno || end == p || !(sec >= 0.) || sec > 86400. * 366)
+			ECTL_TRAP(E_TOPNSYNTAX, "\"%s\": wrong number of seconds.\n", arg);
+	}
+	if (*end)
+		ECTL_TRAP(E_TOPNSYNTAX, "\"%s\": trailing characters.\n", arg);
+
+	ectlfr_begin(fr, L_0);
+	t = MALLOC(sizeof *t);
+	memset(t, 0, sizeof *t);
+	ectlfr_ontrap(fr, L_1);
+	t->fp = fp;
+	t->n = n;
+	t->report_interval = sec * TOPN_NS;
+	for (int k = 0; k < TOPN_KINDS; k++) {
+		t->cur[k] = topn_sketch_create(TOPN_SLOTS(t->n));
+		t->all[k] = topn_sketch_create(TOPN_SLOTS(t->n));
+		t->tmp[k] = topn_sketch_create(TOPN_SLOTS(t->n));
+	}
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = topn_sighandler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(TOPN_SIGNAL, &sa, NULL) < 0)
+		ECTL_PTRAP(errno, "sigaction(%d): %s.\n", TOPN_SIGNAL, strerror(errno));
+	ectlfr_end(fr);
+	return t;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	topn_free(t);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+void
+topn_free(struct topn *t)
+{
+	if (t) {
+		for (int k = 0; k < TOPN_KINDS; k++) {
+			topn_sketch_free(t->cur[k]);
+			topn_sketch_free(t->all[k]);
+			topn_sketch_free(t->tmp[k]);
+		}
+		free(t);
+	}
+}
+
+static
+const char *
+topn_key_text(int kind, uint64_t key, char *buf, size_t size)
+{
+	struct in_addr a;
+
+	switch (kind) {
+	case TOPN_CLIENT:
+		snprintf(buf, size, "%02x:%02x:%02x:%02x:%02x:%02x", (unsigned)(key >> 40) & 0xff, (unsigned)(key >> 32) & 0xff,
+			(unsigned)(key >> 24) & 0xff, (unsigned)(key >> 16) & 0xff, (unsigned)(key >> 8) & 0xff,
+			(unsigned)key & 0xff);
+		break;
+	case TOPN_PORT:
+		if (key >> 16 < 4096)
+			snprintf(buf, size, "vlan %u/%u/%u", (unsigned)(key >> 16), (unsigned)(key >> 8) & 0xff,
+				(unsigned)key & 0xff);
+		else
+			snprintf(buf, size, "%02x:%02x:%02x:%02x:%02x:%02x/%u/%u", (unsigned)(key >> 56) & 0xff,
+				(unsigned)(key >> 48) & 0xff, (unsigned)(key >> 40) & 0xff, (unsigned)(key >> 32) & 0xff,
+				(unsigned)(key >> 24) & 0xff, (unsigned)(key >> 16) & 0xff, (unsigned)(key >> 8) & 0xff,
+				(unsigned)key & 0xff);
+		break;
+	default:
+		a.s_addr = htonl(key);
+		inet_ntop(AF_INET, &a, buf, size);
+		break;
+	}
+	return buf;
+}
+
+/* when - время или "total"; sk - по таблице на вид */
+static
+void
+topn_print(struct topn *t, const char *when, struct topn_sketch *const *sk)
+{
+	struct topn_ent *ents = MALLOC(TOPN_SLOTS(t->n) * sizeof ents[0]);
+
+	for (int k = 0; k < TOPN_KINDS; k++) {
+		uint32_t n = sk[k]->n < (uint32_t)t->n ? sk[k]->n : (uint32_t)t->n;
+
+		topn_sketch_list(sk[k], ents);
+		fprintf(t->fp, "top: %s %s packets %" PRIu64, when, topn_kinds[k], sk[k]->total);
+		for (uint32_t i = 0; i < n; i++) {
+			char buf[64];
+
+			fprintf(t->fp, " %s %" PRIu64, topn_key_text(k, ents[i].key, buf, sizeof buf), ents[i].count);
+			if (ents[i].err)
+				fprintf(t->fp, "~%" PRIu64, ents[i].err);
+		}
+		fprintf(t->fp, "\n");
+	}
+	free(ents);
+}
+
+/* до прошлого отчёта и после - в all */
+static
+void
+topn_fold(struct topn *t)
+{
+	for (int k = 0; k < TOPN_KINDS; k++) {
+		topn_sketch_merge(t->all[k], t->cur[k]);
+		topn_sketch_clear(t->cur[k]);
+	}
+}
+
+void
+topn_add(struct topn *t, uint64_t now, const struct dhcphdr *dh, struct in_addr src,
+	const struct dhcpopt82_value *v)
+{
+	uint64_t key;
+	char when[32];
+	time_t sec;
+
+	if (t->report_interval && now >= t->report_next) {
+		if (t->report_next) {
+			sec = now / TOPN_NS;
+			strftime(when, sizeof when, "%Y%m%d %H:%M:%S", localtime(&sec));
+			fflush(stdout);
+			topn_print(t, when, t->cur);
+			topn_fold(t);
+		}
+		t->report_next = now + t->report_interval;
+	}
+	/* по сигналу - за всё время, интервал не прерывается */
+	if (topn_requested) {
+		topn_requested = 0;
+		for (int k = 0; k < TOPN_KINDS; k++) {
+			topn_sketch_clear(t->tmp[k]);
+			topn_sketch_merge(t->tmp[k], t->all[k]);
+			topn_sketch_merge(t->tmp[k], t->cur[k]);
+		}
+		sec = now / TOPN_NS;
+		strftime(when, sizeof when, "%Y%m%d %H:%M:%S", localtime(&sec));
+		fflush(stdout);
+		topn_print(t, when, t->tmp);
+	}
+	if (dh->hlen == ETHER_ADDR_LEN) {
+		key = 0;
+		for (int i = 0; i < ETHER_ADDR_LEN; i++)
+			key = key << 8 | dh->chaddr[i];
+		topn_sketch_add(t->cur[TOPN_CLIENT], key);
+	}
+	if (v) {
+		if (v->flags & DHCPOPT82_V_ETHER) {
+			key = 0;
+			for (int i = 0; i < ETHER_ADDR_LEN; i++)
+				key = key << 8 | v->ether.octet[i];
+		} else
+			key = v->vlanid & 0xfff;
+		topn_sketch_add(t->cur[TOPN_PORT], key << 16 | v->module << 8 | v->port);
+	}
+	if (dh->giaddr.s_addr)
+		topn_sketch_add(t->cur[TOPN_RELAY], ntohl(dh->giaddr.s_addr));
+	if (dh->op == BOOTREPLY)
+		topn_sketch_add(t->cur[TOPN_SERVER], ntohl(src.s_addr));
+}
+
+void
+topn_report(struct topn *t)
+{
+	topn_fold(t);
+	fflush(stdout);
+	topn_print(t, "total", t->all);
+}
@@ -0,0 +1,85 @@
+#ifndef __topn_h__
+#define __topn_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <signal.h>
+#include <netinet/in.h>
+
+#include "foo.h"
+#include "dhcp.h"
+#include "opt82.h"
+
+DECL_ERROR(E_TOPNSYNTAX)
+
+/* Самые активные при шторме (--top N[/сек]): в stderr - первые N по числу
+ * пакетов за последние сек секунд (10 по умолчанию, 0 - только итог в конце),
+ * по сигналу TOPN_SIGNAL - за всё время на следующем пакете:
+ *	client		chaddr
+ *	port		порт коммутатора из опции 82: MAC/module/port, без MAC -
+ *			vlan V/module/port
+ *	relay		giaddr, кроме 0.0.0.0
+ *	server		источник ответов (BOOTREPLY)
+ * Считаются пакеты, прошедшие фильтры, до прореживания вывода. Время - метка
+ * пакета, как у --sample-report.
+ *
+ * На каждый вид - Space-Saving с TOPN_SLOTS(N) счётчиками: ключ без счётчика
+ * занимает счётчик с наименьшим значением c и продолжает его (c + 1), запомнив
+ * c как возможное завышение. Ключ, у которого больше total / TOPN_SLOTS(N)
+ * пакетов, в таблице есть наверняка, а завышение не больше этой доли.
+ * Счётчики сгруппированы в корзины с равным значением, корзины - в список по
+ * возрастанию: пакет переносит счётчик в соседнюю корзину за O(1), наименьший
+ * - всегда в первой.
+ *
+ * Таблицы сливаются (topn_sketch_merge): у ключа, которого в одной из таблиц
+ * нет, берётся её наименьший счётчик - оценка остаётся оценкой сверху.
+ * Таблица интервала после отчёта вливается в общую, так что итог - за весь
+ * захват; так же сливаются таблицы разных потоков захвата.
+ *
+ * Строка отчёта: "top: время вид ключ пакеты[~завышение] ...".
+ */
+#define TOPN_CLIENT	0
+#define TOPN_PORT	1
+#define TOPN_RELAY	2
+#define TOPN_SERVER	3
+#define TOPN_KINDS	4
+
+#define TOPN_MAX	1000
+#define TOPN_SLOTS(n)	((n) * 16 < 256 ? 256 : (n) * 16)
+#define TOPN_SIGNAL	SIGUSR2
+
+#define TOPN_NS		1000000000ULL
+
+struct topn_sketch;
+
+struct topn {
+	FILE		*fp;
+	int		n;
+	uint64_t	report_interval, report_next;
+	struct topn_sketch *cur[TOPN_KINDS];	/* с прошлого отчёта */
+	struct topn_sketch *all[TOPN_KINDS];	/* до прошлого отчёта */
+	struct topn_sketch *tmp[TOPN_KINDS];	/* отчёт по сигналу: all + cur */
+};
+
+__BEGIN_DECLS
+struct topn_sketch *	topn_sketch_create(uint32_t slots);
+void			topn_sketch_free(struct topn_sketch *s);
+void			topn_sketch_clear(struct topn_sketch *s);
+void			topn_sketch_add(struct topn_sketch *s, uint64_t key);
+/* dst += src; src не меняется */
+void			topn_sketch_merge(struct topn_sketch *dst, const struct topn_sketch *src);
+
+/* arg - аргумент --top; отчёты в fp */
+struct topn *		topn_create(FILE *fp, const char *arg);
+void			topn_free(struct topn *t);
+/* now - время пакета в нс, src - IP-источник, v - опция 82 или NULL; заодно
+ * печатает отчёт, если пора или пришёл TOPN_SIGNAL
+ */
+void			topn_add(struct topn *t, uint64_t now, const struct dhcphdr *dh, struct in_addr src,
+				const struct dhcpopt82_value *v);
+/* итоговый отчёт */
+void			topn_report(struct topn *t);
+__END_DECLS
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef __usdt_h__
+#define __usdt_h__
+
+/* USDT пробы провайдера dhcpdump (см. dhcpdump.d).
+ *
+ * Включаются при сборке: make USDT=1 (-DUSDT). Без него USDT_PROBE() не
+ * раскрывается ни во что, аргументы не вычисляются. С ним проба - один nop,
+ * пока к ней не подключились; дорогие аргументы считаются под USDT_ENABLED().
+ */
+#ifdef USDT
+#include "dhcpdump_dtrace.h"
+#define USDT_PROBE(name, ...)	DHCPDUMP_##name(__VA_ARGS__)
+#define USDT_ENABLED(name)	DHCPDUMP_##name##_ENABLED()
+#else
+#define USDT_PROBE(name, ...)	((void)0)
+#define USDT_ENABLED(name)	0
+#endif
+
+#endif
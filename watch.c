@@ -0,0 +1,162 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <net/ethernet.h>
+#ifdef linux
+#include <netinet/ether.h>
+#endif
+
+#include "foo.h"
+#include "watch.h"
+
+DEFN_ERROR(E_WATCHSYNTAX,	"Syntax error in watch list.")
+
+static
+void
+watchset_alloc(struct watchset *ws, size_t ngroups)
+{
+	ws->gmask = ngroups - 1;
+	ws->ctrl = MALLOC(ngroups * WATCH_GROUP);
+	memset(ws->ctrl, WATCH_EMPTY, ngroups * WATCH_GROUP);
+	ws->keys = MALLOC(ngroups * WATCH_GROUP * sizeof ws->keys[0]);
+}
+
+/* n - ожидаемое число ключей, больше - множество растёт само */
+struct watchset *
+watchset_create(size_t n)
+{
+	struct watchset *ws;
+	size_t ngroups = 1;
+
+	while (ngroups * WATCH_GROUP < 2 * n)
+		ngroups <<= 1;
+	ws = MALLOC(sizeof *ws);
+	ws->n = 0;
+	watchset_alloc(ws, ngroups);
+	return ws;
+}
+
+void
+watchset_free(struct watchset *ws)
+{
+	if (ws) {
+		free(ws->ctrl);
+		free(ws->keys);
+		free(ws);
+	}
+}
+
+static
+void
+watchset_insert(struct watchset *ws, struct watchkey k)
+{
+	uint64_t h = watchkey_hash(k);
+
+	for (size_t g = (h >> 7) & ws->gmask;; g = (g + 1) & ws->gmask)
+		for (int i = 0; i < WATCH_GROUP; i++) {
+			size_t slot = g * WATCH_GROUP + i;
+
+			if (ws->ctrl[slot] == WATCH_EMPTY) {
+				ws->ctrl[slot] = h & 0x7f;
+				ws->keys[slot] = k;
+				ws->n++;
+				return;
+			}
+		}
+}
+
+void
+watchset_add(struct watchset *ws, struct watchkey k)
+{
+	if (watchset_has(ws, k))
+		return;
+	if (2 * (ws->n + 1) > (ws->gmask + 1) * WATCH_GROUP) {
+		struct watchset old = *ws;
+
+		watchset_alloc(ws, 2 * (old.gmask + 1));
+		ws->n = 0;
+		for (size_t i = 0; i < (old.gmask + 1) * WATCH_GROUP; i++)
+			if (old.ctrl[i] != WATCH_EMPTY)
+				watchset_insert(ws, old.keys[i]);
+		free(old.ctrl);
+		free(old.keys);
+	}
+	watchset_insert(ws, k);
+}
+
+static
+struct watchkey
+watch_parse(const char *path, int lineno, char **tok, int ntok, int kind)
+{
+	struct ether_addr *ea;
+	unsigned long vlan, port;
+	char *end;
+
+	if (ntok != (kind == WATCH_MAC ? 1 : 3))
+		ECTL_TRAP(E_WATCHSYNTAX, "%s:%d: expected %s.\n", path, lineno,
+			kind == WATCH_MAC ? "MAC address" : "switch MAC address, vlan and port");
+	if (!(ea = ether_aton(tok[0])))
+		ECTL_TRAP(E_WATCHSYNTAX, "%s:%d: \"%s\": wrong MAC address.\n", path, lineno, tok[0]);
+	if (kind == WATCH_MAC)
+		return watchkey_mac((uint8_t *)ea);
+
+	errno = 0;
+	vlan = strtoul(tok[1], &end, 0);
+	if (errno || *end || vlan < 1 || vlan > 4094)
+		ECTL_TRAP(E_WATCHSYNTAX, "%s:%d: \"%s\": wrong vlan.\n", path, lineno, tok[1]);
+	port = strtoul(tok[2], &end, 0);
+	if (errno || *end || port > 255)
+		ECTL_TRAP(E_WATCHSYNTAX, "%s:%d: \"%s\": wrong port.\n", path, lineno, tok[2]);
+	/* ether_aton() возвращает статический буфер, vlan и port его не трогают */
+	return watchkey_relay((uint8_t *)ea, vlan, port);
+}
+
+struct watchset *
+watchset_load(const char *path, int kind)
+{
+	struct watchset *volatile ws = NULL;
+	FILE *volatile fp;
+	char *volatile line = NULL;
+	size_t size = 0;
+	int lineno = 0;
+	struct ectlfr fr[1];
+
+	if (!(fp = fopen(path, "r")))
+		ECTL_PTRAP(errno, "fopen(\"%s\"): %s.\n", path, strerror(errno));
+	ectlfr_begin(fr, L_1);
+	ws = watchset_create(1024);
+	for (char *l; getline((char **)&line, &size, fp) >= 0; ) {
+		char *tok[4], *p;
+		int ntok = 0;
+
+		lineno++;
+		l = line;
+		if ((p = strchr(l, '#')))
+			*p = 0;
+		while ((p = strsep(&l, " \t\r\n")))
+			if (*p) {
+				if (ntok == sizeof tok/sizeof tok[0])
+					ECTL_TRAP(E_WATCHSYNTAX, "%s:%d: too many fields.\n", path, lineno);
+				tok[ntok++] = p;
+			}
+		if (ntok)
+			watchset_add(ws, watch_parse(path, lineno, tok, ntok, kind));
+	}
+	if (ferror(fp))
+		ECTL_PTRAP(EIO, "getline(\"%s\"): read error.\n", path);
+	free(line);
+	fclose(fp);
+	ectlfr_end(fr);
+	return ws;
+
+L_1:	ectlfr_ontrap(fr, L_0);
+	watchset_free(ws);
+	free(line);
+	fclose(fp);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
@@ -0,0 +1,120 @@
+#ifndef __watch_h__
+#define __watch_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <string.h>
+#include <net/ethernet.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "foo.h"
+
+DECL_ERROR(E_WATCHSYNTAX)
+
+/* Множество наблюдаемых ключей (MAC клиентов -C, порты relay -R) для фильтров
+ * dhcpdump: десятки тысяч записей, проверка на каждый пакет.
+ *
+ * Открытая адресация группами по WATCH_GROUP слотов: у каждого слота байт-метка
+ * (7 бит хэша или WATCH_EMPTY), метки группы сравниваются с искомой одной
+ * инструкцией SSE2, ключи - только у совпавших меток. Заполнение не больше
+ * половины, поэтому проба почти всегда заканчивается в первой группе.
+ * Удаления нет: множество собирается при запуске.
+ */
+#define WATCH_GROUP	16
+#define WATCH_EMPTY	0x80
+
+struct watchkey {
+	uint64_t	lo, hi;
+};
+
+struct watchset {
+	size_t		n;		/* ключей */
+	size_t		gmask;		/* число групп - 1 */
+	uint8_t		*ctrl;		/* метки слотов */
+	struct watchkey	*keys;
+};
+
+/* MAC клиента */
+static inline
+struct watchkey
+watchkey_mac(const uint8_t *mac)
+{
+	struct watchkey k = { 0, 0 };
+
+	memcpy(&k.lo, mac, ETHER_ADDR_LEN);
+	return k;
+}
+
+/* MAC коммутатора, vlan и порт из опции 82 */
+static inline
+struct watchkey
+watchkey_relay(const uint8_t *swmac, uint16_t vlan, uint8_t port)
+{
+	struct watchkey k = { 0, 0 };
+
+	memcpy(&k.lo, swmac, ETHER_ADDR_LEN);
+	k.hi = (uint64_t)vlan << 8 | port | 1ULL << 32;
+	return k;
+}
+
+static inline
+uint64_t
+watchkey_hash(struct watchkey k)
+{
+	uint64_t h = k.lo ^ k.hi * 0x9e3779b97f4a7c15ULL;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static inline
+int
+watchset_has(const struct watchset *ws, struct watchkey k)
+{
+	uint64_t h = watchkey_hash(k);
+	uint8_t tag = h & 0x7f;
+
+	for (size_t g = (h >> 7) & ws->gmask;; g = (g + 1) & ws->gmask) {
+		const uint8_t *ctrl = ws->ctrl + g * WATCH_GROUP;
+		const struct watchkey *keys = ws->keys + g * WATCH_GROUP;
+		unsigned match, empty;
+#ifdef __SSE2__
+		__m128i c = _mm_loadu_si128((const __m128i *)ctrl);
+
+		match = _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(tag)));
+		empty = _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8((char)WATCH_EMPTY)));
+#else
+		match = empty = 0;
+		for (int i = 0; i < WATCH_GROUP; i++) {
+			match |= (ctrl[i] == tag) << i;
+			empty |= (ctrl[i] == WATCH_EMPTY) << i;
+		}
+#endif
+		for (; match; match &= match - 1) {
+			const struct watchkey *p = keys + __builtin_ctz(match);
+			if (p->lo == k.lo && p->hi == k.hi)
+				return 1;
+		}
+		if (empty)
+			return 0;
+	}
+}
+
+#define WATCH_MAC	0	/* строки файла: MAC */
+#define WATCH_RELAY	1	/* строки файла: MAC коммутатора, vlan, порт */
+
+__BEGIN_DECLS
+struct watchset *	watchset_create(size_t n);
+void			watchset_add(struct watchset *ws, struct watchkey k);
+void			watchset_free(struct watchset *ws);
+/* '#' - комментарий до конца строки, пустые строки пропускаются */
+struct watchset *	watchset_load(const char *path, int kind);
+__END_DECLS
+
+#endif
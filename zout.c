@@ -0,0 +1,376 @@
+#include <inttypes.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "foo.h"
+#include "zout.h"
+
+DEFN_ERROR(E_ZOUTFAILED,	"Compressed output failed.")
+
+/* Заголовок члена gzip: 10 байт, XLEN, подполе 'D','D' с длиной члена и
+ * длиной несжатых данных; в конце - CRC32 и ISIZE
+ */
+#define ZOUT_HDR	(10 + 2 + 4 + 8)
+#define ZOUT_TRAILER	8
+
+#define ZOUT_FREE	0		/* пуст или заполняется */
+#define ZOUT_FULL	1		/* ждёт сжатия или сжимается */
+#define ZOUT_DONE	2		/* сжат, ждёт записи */
+
+struct zout_block {
+	uint8_t		*buf;		/* ZOUT_BLOCK несжатых байт */
+	size_t		len;
+	uint8_t		*out;		/* член gzip */
+	size_t		outlen;
+	int		state;
+};
+
+/* Блоки - кольцо; номера fill <= wr + nblocks, wr <= next <= fill, блок номера
+ * n - blocks[n % nblocks]. Меняются под mtx, кроме содержимого блока: его
+ * заполняет писатель FILE (блок fill), сжимает один поток (FULL), пишет в fd
+ * один поток (writing).
+ */
+struct zout {
+	int		fd, close_fd, level;
+	FILE		*fp;
+	struct zout_block *blocks;
+	size_t		nblocks, outcap;
+	uint64_t	fill;		/* заполняется */
+	uint64_t	next;		/* следующий на сжатие */
+	uint64_t	wr;		/* следующий на запись */
+	time_t		started;	/* первый байт в блоке fill */
+	int		writing;	/* кто-то пишет готовые блоки в fd */
+	int		stop, closed;
+	int		err;		/* errno записи; -1 - ошибка zlib */
+	pthread_t	thr[ZOUT_THREADS_MAX];
+	int		nthr;
+	pthread_mutex_t	mtx;
+	pthread_cond_t	work, freed;
+	uint64_t	in, out, blocks_done, waits;
+};
+
+static inline
+void
+zout_put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* 0 - ошибка zlib */
+static
+int
+zout_deflate(struct zout *z, z_stream *zs, struct zout_block *b)
+{
+	uint8_t *p = b->out;
+
+	if (deflateReset(zs) != Z_OK)
+		return 0;
+	zs->next_in = b->buf;
+	zs->avail_in = b->len;
+	zs->next_out = p + ZOUT_HDR;
+	zs->avail_out = z->outcap - ZOUT_HDR - ZOUT_TRAILER;
+	if (deflate(zs, Z_FINISH) != Z_STREAM_END)
+		return 0;
+	b->outlen = ZOUT_HDR + zs->total_out + ZOUT_TRAILER;
+	p[0] = 0x1f;
+	p[1] = 0x8b;
+	p[2] = Z_DEFLATED;
+	p[3] = 0x04;			/* FEXTRA */
+	zout_put32(p + 4, 0);		/* MTIME */
+	p[8] = z->level == 9 ? 2 : z->level == 1 ? 4 : 0;
+	p[9] = 3;			/* OS: Unix */
+	p[10] = 12;			/* XLEN */
+	p[11] = 0;
+	p[12] = 'D';
+	p[13] = 'D';
+	p[14] = 8;
+	p[15] = 0;
+	zout_put32(p + 16, b->outlen);
+	zout_put32(p + 20, b->len);
+	zout_put32(p + b->outlen - 8, crc32(crc32(0, NULL, 0), b->buf, b->len));
+	zout_put32(p + b->outlen - 4, b->len);
+	return 1;
+}
+
+/* Пишет готовые блоки по порядку, пока следующий готов; под mtx, отпускает
+ * его на время write(). После ошибки блоки только освобождаются.
+ */
+static
+void
+zout_drain(struct zout *z)
+{
+	struct zout_block *b;
+
+	z->writing = 1;
+	while (z->wr < z->next && (b = z->blocks + z->wr % z->nblocks)->state == ZOUT_DONE) {
+		const uint8_t *p = b->out;
+		size_t n = z->err ? 0 : b->outlen;
+		int err = 0;
+
+		pthread_mutex_unlock(&z->mtx);
+		while (n) {
+			ssize_t w = write(z->fd, p, n);
+
+			if (w == -1) {
+				if (errno == EINTR)
+					continue;
+				err = errno;
+				break;
+			}
+			p += w;
+			n -= w;
+		}
+		pthread_mutex_lock(&z->mtx);
+		if (err && !z->err)
+			z->err = err;
+		if (!z->err)
+			z->out += b->outlen;
+		z->blocks_done++;
+		b->len = 0;
+		b->state = ZOUT_FREE;
+		z->wr++;
+		pthread_cond_signal(&z->freed);
+	}
+	z->writing = 0;
+}
+
+static
+void *
+zout_thread(void *arg)
+{
+	struct zout *z = arg;
+	z_stream zs[1];
+	int zok;
+
+	memset(zs, 0, sizeof zs);
+	zok = deflateInit2(zs, z->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	pthread_mutex_lock(&z->mtx);
+	for (;;) {
+		struct zout_block *b;
+		int ok;
+
+		while (z->next == z->fill && !z->stop)
+			pthread_cond_wait(&z->work, &z->mtx);
+		if (z->next == z->fill)
+			break;
+		b = z->blocks + z->next++ % z->nblocks;
+		pthread_mutex_unlock(&z->mtx);
+		ok = zok && zout_deflate(z, zs, b);
+		pthread_mutex_lock(&z->mtx);
+		if (!ok && !z->err)
+			z->err = -1;
+		b->state = ZOUT_DONE;
+		if (!z->writing)
+			zout_drain(z);
+	}
+	pthread_mutex_unlock(&z->mtx);
+	if (zok)
+		deflateEnd(zs);
+	return NULL;
+}
+
+/* Отдать блок fill на сжатие и дождаться, пока следующий освободится; под mtx */
+static
+void
+zout_seal(struct zout *z)
+{
+	z->blocks[z->fill % z->nblocks].state = ZOUT_FULL;
+	z->fill++;
+	pthread_cond_signal(&z->work);
+	if (z->blocks[z->fill % z->nblocks].state != ZOUT_FREE) {
+		z->waits++;
+		while (z->blocks[z->fill % z->nblocks].state != ZOUT_FREE)
+			pthread_cond_wait(&z->freed, &z->mtx);
+	}
+}
+
+/* Запись FILE: ошибка потоков видна, когда очередной блок отдаётся на сжатие */
+static
+int
+zout_fwrite(void *cookie, const char *buf, int size)
+{
+	struct zout *z = cookie;
+	size_t left = size;
+
+	if (z->stop) {
+		errno = EBADF;
+		return -1;
+	}
+	while (left) {
+		struct zout_block *b = z->blocks + z->fill % z->nblocks;
+		size_t n;
+
+		if (b->len && (b->len == ZOUT_BLOCK || time(NULL) - z->started >= ZOUT_LINGER)) {
+			int err;
+
+			pthread_mutex_lock(&z->mtx);
+			zout_seal(z);
+			err = z->err;
+			pthread_mutex_unlock(&z->mtx);
+			if (err) {
+				errno = err == -1 ? EIO : err;
+				return -1;
+			}
+			continue;
+		}
+		if (!b->len)
+			z->started = time(NULL);
+		n = ZOUT_BLOCK - b->len < left ? ZOUT_BLOCK - b->len : left;
+		memcpy(b->buf + b->len, buf, n);
+		b->len += n;
+		buf += n;
+		left -= n;
+	}
+	z->in += size;
+	return size;
+}
+
+struct zout *
+zout_create(int fd, int close_fd, int level, int nthreads)
+{
+	struct ectlfr fr[1];
+	struct zout *volatile z;
+	z_stream zs[1];
+
+	ectlfr_begin(fr, L_0);
+	z = MALLOC(sizeof *z);
+	memset(z, 0, sizeof *z);
+	ectlfr_ontrap(fr, L_1);
+	z->fd = fd;
+	z->close_fd = close_fd;
+	z->level = level;
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > ZOUT_THREADS_MAX)
+		nthreads = ZOUT_THREADS_MAX;
+	/* каждому потоку - блок в работе и блок в очереди, плюс заполняемый */
+	z->nblocks = 2 * nthreads + 1;
+	memset(zs, 0, sizeof zs);
+	if (deflateInit2(zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		ECTL_TRAP(E_ZOUTFAILED, "deflateInit2(%d): %s.\n", level, zs->msg ? zs->msg : "bad level");
+	z->outcap = ZOUT_HDR + deflateBound(zs, ZOUT_BLOCK) + ZOUT_TRAILER;
+	deflateEnd(zs);
+	z->blocks = MALLOC(z->nblocks * sizeof z->blocks[0]);
+	memset(z->blocks, 0, z->nblocks * sizeof z->blocks[0]);
+	ectlfr_ontrap(fr, L_2);
+	for (size_t i = 0; i < z->nblocks; i++) {
+		z->blocks[i].buf = MALLOC(ZOUT_BLOCK);
+		z->blocks[i].out = MALLOC(z->outcap);
+	}
+	PTHREAD_MUTEX_INIT(&z->mtx, NULL);
+	ectlfr_ontrap(fr, L_3);
+	PTHREAD_COND_INIT(&z->work, NULL);
+	ectlfr_ontrap(fr, L_4);
+	PTHREAD_COND_INIT(&z->freed, NULL);
+	ectlfr_ontrap(fr, L_5);
+	if (!(z->fp = funopen(z, NULL, zout_fwrite, NULL, NULL)))
+		ECTL_PTRAP(errno, "funopen(): %s.\n", strerror(errno));
+	ectlfr_ontrap(fr, L_6);
+	/* stdio копит мелкие fprintf(), в блок идут большие куски */
+	setvbuf(z->fp, NULL, _IOFBF, 65536);
+	while (z->nthr < nthreads) {
+		PTHREAD_CREATE(z->thr + z->nthr, NULL, zout_thread, z);
+		z->nthr++;
+	}
+	ectlfr_end(fr);
+	return z;
+
+L_6:	ectlfr_ontrap(fr, L_5);
+	pthread_mutex_lock(&z->mtx);
+	z->stop = 1;
+	pthread_cond_broadcast(&z->work);
+	pthread_mutex_unlock(&z->mtx);
+	for (int i = 0; i < z->nthr; i++)
+		pthread_join(z->thr[i], NULL);
+	fclose(z->fp);
+L_5:	ectlfr_ontrap(fr, L_4);
+	pthread_cond_destroy(&z->freed);
+L_4:	ectlfr_ontrap(fr, L_3);
+	pthread_cond_destroy(&z->work);
+L_3:	ectlfr_ontrap(fr, L_2);
+	pthread_mutex_destroy(&z->mtx);
+L_2:	ectlfr_ontrap(fr, L_1);
+	for (size_t i = 0; i < z->nblocks; i++) {
+		free(z->blocks[i].buf);
+		free(z->blocks[i].out);
+	}
+	free(z->blocks);
+L_1:	ectlfr_ontrap(fr, L_0);
+	free(z);
+L_0:	ectlfr_end(fr);
+	ectlfr_trap();
+}
+
+FILE *
+zout_file(struct zout *z)
+{
+	return z->fp;
+}
+
+/* Остановка без ловушек: остаток блока - последним членом (пустой файл -
+ * один пустой член, чтобы gzip -d его принял), потоки дописывают всё
+ */
+static
+void
+zout_stop(struct zout *z)
+{
+	if (z->closed)
+		return;
+	fflush(z->fp);
+	pthread_mutex_lock(&z->mtx);
+	if (z->blocks[z->fill % z->nblocks].len || !z->fill)
+		zout_seal(z);
+	z->stop = 1;
+	pthread_cond_broadcast(&z->work);
+	pthread_mutex_unlock(&z->mtx);
+	for (int i = 0; i < z->nthr; i++)
+		pthread_join(z->thr[i], NULL);
+	if (z->close_fd && close(z->fd) == -1 && !z->err)
+		z->err = errno;
+	z->closed = 1;
+}
+
+void
+zout_close(struct zout *z)
+{
+	zout_stop(z);
+	if (z->err == -1)
+		ECTL_TRAP(E_ZOUTFAILED, "deflate() failed.\n");
+	if (z->err)
+		ECTL_PTRAP(z->err, "write(): %s.\n", strerror(z->err));
+}
+
+void
+zout_free(struct zout *z)
+{
+	if (!z)
+		return;
+	zout_stop(z);
+	fclose(z->fp);
+	pthread_cond_destroy(&z->freed);
+	pthread_cond_destroy(&z->work);
+	pthread_mutex_destroy(&z->mtx);
+	for (size_t i = 0; i < z->nblocks; i++) {
+		free(z->blocks[i].buf);
+		free(z->blocks[i].out);
+	}
+	free(z->blocks);
+	free(z);
+}
+
+void
+zout_report(struct zout *z, FILE *fp)
+{
+	fprintf(fp, "compress: in %" PRIu64 " out %" PRIu64 " ratio %.2f blocks %" PRIu64 " threads %d waits %" PRIu64 "\n",
+		z->in, z->out, z->out ? (double)z->in / z->out : 0.0, z->blocks_done, z->nthr, z->waits);
+}
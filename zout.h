@@ -0,0 +1,44 @@
+#ifndef __zout_h__
+#define __zout_h__
+
+#include <sys/cdefs.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "foo.h"
+
+DECL_ERROR(E_ZOUTFAILED)
+
+/* Сжатый вывод (--compress): текст и JSON идут в FILE, который копит их
+ * блоками по ZOUT_BLOCK байт; полный блок сжимает один из рабочих потоков,
+ * готовые блоки пишутся в fd по порядку. Поток захвата только копирует байты
+ * в блок - не ждёт ни сжатия, ни записи, пока есть свободный блок.
+ *
+ * Каждый блок - отдельный член gzip (RFC 1952): файл читается zcat и gzip -d
+ * как обычный .gz, а любой член распаковывается сам по себе. В заголовке
+ * члена поле FEXTRA с подполем 'D','D' (8 байт, little-endian): длина члена
+ * целиком и длина несжатых данных - по ним границы блоков находятся чтением
+ * одних заголовков, без распаковки, и можно начать с любого блока.
+ *
+ * Блок, начатый ZOUT_LINGER секунд назад, отдаётся на сжатие при следующей
+ * записи и неполным: при редких пакетах вывод не лежит в памяти часами.
+ */
+#define ZOUT_BLOCK	(1 << 20)
+#define ZOUT_LINGER	10
+#define ZOUT_THREADS_MAX	16
+
+struct zout;
+
+__BEGIN_DECLS
+/* fd закрывается в zout_close(), если close_fd */
+struct zout *	zout_create(int fd, int close_fd, int level, int nthreads);
+/* FILE для вывода; fclose() не нужен - его делает zout_close() */
+FILE *		zout_file(struct zout *z);
+/* дописать последний блок, дождаться потоков; ошибка записи - ловушка */
+void		zout_close(struct zout *z);
+/* с zout_close(), если её не было; без ловушек */
+void		zout_free(struct zout *z);
+void		zout_report(struct zout *z, FILE *fp);
+__END_DECLS
+
+#endif